@@ -0,0 +1,443 @@
+/*
+* Modeled sensors for host builds. See SensorSim.h.
+*/
+
+#include <math.h>
+#include "SensorSim.h"
+
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+
+/*******************************************************************************
+* Virtual clock
+*******************************************************************************/
+static uint32_t _sim_now_us = 0;
+
+uint32_t sim_micros() {                 return _sim_now_us;           }
+uint32_t sim_millis() {                 return _sim_now_us / 1000;    }
+void     sim_clock_advance(uint32_t us) {   _sim_now_us += us;        }
+void     sim_clock_set(uint32_t us) {       _sim_now_us = us;         }
+
+
+
+/*******************************************************************************
+* SimGridEYE
+*******************************************************************************/
+#define SIM_AMG_THERMISTOR_REG  0x0E
+#define SIM_AMG_PIXEL_REG       0x80
+
+SimGridEYE::SimGridEYE(uint8_t addr) : I2CSimDevice(addr) {}
+
+
+void SimGridEYE::scene(float background, float gradient, float blob, float blob_radius_px, uint32_t orbit_ms) {
+  _background  = background;
+  _gradient    = gradient;
+  _blob        = blob;
+  _blob_radius = (blob_radius_px > 0.1f) ? blob_radius_px : 0.1f;
+  _orbit_ms    = orbit_ms;
+}
+
+
+float SimGridEYE::pixelAt(uint8_t x, uint8_t y, uint32_t now_ms) {
+  float bx = 3.5f;
+  float by = 3.5f;
+  if (0 < _orbit_ms) {
+    const float theta = (2.0f * M_PI * (now_ms % _orbit_ms)) / _orbit_ms;
+    bx += 2.5f * cosf(theta);
+    by += 2.5f * sinf(theta);
+  }
+  const float dx = x - bx;
+  const float dy = y - by;
+  const float r2 = (dx * dx + dy * dy) / (2.0f * _blob_radius * _blob_radius);
+  return _background + ((_gradient * x) / 7.0f) + (_blob * expf(-r2));
+}
+
+
+/*
+* Pixels are 12-bit two's complement at 0.25C, LSB first.
+* The thermistor is 12-bit sign-magnitude at 0.0625C.
+*/
+void SimGridEYE::_render(uint32_t now_ms) {
+  for (uint8_t i = 0; i < 64; i++) {
+    float c = pixelAt(i & 7, i >> 3, now_ms);
+    if (0.0f < _noise) {
+      _lcg = (_lcg * 1664525) + 1013904223;
+      c += _noise * ((((int32_t) (_lcg >> 16) & 0xFFFF) - 32768) / 32768.0f);
+    }
+    const uint16_t val = ((uint16_t) lroundf(c * 4.0f)) & 0x0FFF;
+    regs[SIM_AMG_PIXEL_REG + (i << 1)]     = (uint8_t) (val & 0xFF);
+    regs[SIM_AMG_PIXEL_REG + (i << 1) + 1] = (uint8_t) (val >> 8);
+  }
+  const int32_t therm = lroundf(_thermistor * 16.0f);
+  uint16_t t_val = (uint16_t) ((therm < 0) ? (-therm) : therm) & 0x07FF;
+  if (therm < 0) {
+    t_val |= 0x0800;
+  }
+  regs[SIM_AMG_THERMISTOR_REG]     = (uint8_t) (t_val & 0xFF);
+  regs[SIM_AMG_THERMISTOR_REG + 1] = (uint8_t) (t_val >> 8);
+}
+
+
+int32_t SimGridEYE::readRegs(uint8_t reg, uint8_t* buf, uint16_t len) {
+  if ((reg + len > SIM_AMG_PIXEL_REG) || (reg <= SIM_AMG_THERMISTOR_REG + 1)) {
+    _render(sim_millis());
+  }
+  return I2CSimDevice::readRegs(reg, buf, len);
+}
+
+
+
+/*******************************************************************************
+* SimBME280
+* The trim values are the worked example from the Bosch datasheet (with
+*   humidity trim from a real part). The compensation below is the datasheet
+*   integer math, used only to solve for raw values.
+*******************************************************************************/
+#define SIM_BME_ID_REG      0xD0
+#define SIM_BME_DATA_REG    0xF7
+
+static const uint16_t BME_T1 = 27504;
+static const int16_t  BME_T2 = 26435;
+static const int16_t  BME_T3 = -1000;
+static const uint16_t BME_P1 = 36477;
+static const int16_t  BME_P2 = -10685;
+static const int16_t  BME_P3 = 3024;
+static const int16_t  BME_P4 = 2855;
+static const int16_t  BME_P5 = 140;
+static const int16_t  BME_P6 = -7;
+static const int16_t  BME_P7 = 15500;
+static const int16_t  BME_P8 = -14600;
+static const int16_t  BME_P9 = 6000;
+static const uint8_t  BME_H1 = 75;
+static const int16_t  BME_H2 = 362;
+static const uint8_t  BME_H3 = 0;
+static const int16_t  BME_H4 = 313;
+static const int16_t  BME_H5 = 50;
+static const int8_t   BME_H6 = 30;
+
+
+/* Returns centi-degrees C. */
+static int32_t _bme_comp_temp(int32_t raw, int32_t* t_fine) {
+  int32_t var1 = ((((raw >> 3) - ((int32_t) BME_T1 << 1))) * ((int32_t) BME_T2)) >> 11;
+  int32_t var2 = (((((raw >> 4) - ((int32_t) BME_T1)) * ((raw >> 4) - ((int32_t) BME_T1))) >> 12) * ((int32_t) BME_T3)) >> 14;
+  *t_fine = var1 + var2;
+  return (*t_fine * 5 + 128) >> 8;
+}
+
+
+/* Returns Pa in Q24.8. Decreases as raw increases. */
+static int64_t _bme_comp_pres(int32_t raw, int32_t t_fine) {
+  int64_t var1 = (int64_t) t_fine - 128000;
+  int64_t var2 = var1 * var1 * (int64_t) BME_P6;
+  var2 = var2 + ((var1 * (int64_t) BME_P5) << 17);
+  var2 = var2 + (((int64_t) BME_P4) << 35);
+  var1 = ((var1 * var1 * (int64_t) BME_P3) >> 8) + ((var1 * (int64_t) BME_P2) << 12);
+  var1 = (((((int64_t) 1) << 47) + var1)) * ((int64_t) BME_P1) >> 33;
+  if (0 == var1) {
+    return 0;
+  }
+  int64_t p = 1048576 - raw;
+  p = (((p << 31) - var2) * 3125) / var1;
+  var1 = (((int64_t) BME_P9) * (p >> 13) * (p >> 13)) >> 25;
+  var2 = (((int64_t) BME_P8) * p) >> 19;
+  return ((p + var1 + var2) >> 8) + (((int64_t) BME_P7) << 4);
+}
+
+
+/* Returns %RH in Q22.10. */
+static int32_t _bme_comp_hum(int32_t raw, int32_t t_fine) {
+  int32_t v = (t_fine - ((int32_t) 76800));
+  v = (((((raw << 14) - (((int32_t) BME_H4) << 20) - (((int32_t) BME_H5) * v)) +
+    ((int32_t) 16384)) >> 15) * (((((((v * ((int32_t) BME_H6)) >> 10) * (((v *
+    ((int32_t) BME_H3)) >> 11) + ((int32_t) 32768))) >> 10) + ((int32_t) 2097152)) *
+    ((int32_t) BME_H2) + 8192) >> 14));
+  v = (v - (((((v >> 15) * (v >> 15)) >> 7) * ((int32_t) BME_H1)) >> 4));
+  v = (v < 0) ? 0 : v;
+  v = (v > 419430400) ? 419430400 : v;
+  return (v >> 12);
+}
+
+
+SimBME280::SimBME280(uint8_t addr) : I2CSimDevice(addr) {
+  const uint16_t TP[12] = {
+    BME_T1, (uint16_t) BME_T2, (uint16_t) BME_T3,
+    BME_P1, (uint16_t) BME_P2, (uint16_t) BME_P3, (uint16_t) BME_P4, (uint16_t) BME_P5,
+    (uint16_t) BME_P6, (uint16_t) BME_P7, (uint16_t) BME_P8, (uint16_t) BME_P9
+  };
+  for (uint8_t i = 0; i < 12; i++) {
+    regs[0x88 + (i << 1)]     = (uint8_t) (TP[i] & 0xFF);
+    regs[0x88 + (i << 1) + 1] = (uint8_t) (TP[i] >> 8);
+  }
+  regs[0xA1] = BME_H1;
+  regs[0xE1] = (uint8_t) (BME_H2 & 0xFF);
+  regs[0xE2] = (uint8_t) (BME_H2 >> 8);
+  regs[0xE3] = BME_H3;
+  regs[0xE4] = (uint8_t) (BME_H4 >> 4);
+  regs[0xE5] = (uint8_t) ((BME_H4 & 0x0F) | ((BME_H5 & 0x0F) << 4));
+  regs[0xE6] = (uint8_t) (BME_H5 >> 4);
+  regs[0xE7] = (uint8_t) BME_H6;
+  regs[SIM_BME_ID_REG] = 0x60;
+}
+
+
+void SimBME280::pressureRamp(float pa_start, float pa_per_sec) {
+  _pa_start   = pa_start;
+  _pa_per_sec = pa_per_sec;
+}
+
+
+float SimBME280::pressureAt(uint32_t now_ms) {
+  return _pa_start + (_pa_per_sec * (now_ms / 1000.0f));
+}
+
+
+/*
+* Each compensation is monotonic in its raw value, so each raw value is found
+*   by bisection. 20 steps covers the 20-bit range.
+*/
+void SimBME280::_render(uint32_t now_ms) {
+  int32_t t_fine = 0;
+  int32_t lo = 0;
+  int32_t hi = 0xFFFFF;
+  const int32_t target_t = lroundf(_temp_c * 100.0f);
+  while (lo < hi) {
+    const int32_t mid = (lo + hi) >> 1;
+    if (_bme_comp_temp(mid, &t_fine) < target_t) lo = mid + 1;
+    else                                         hi = mid;
+  }
+  const int32_t raw_t = lo;
+  _bme_comp_temp(raw_t, &t_fine);
+
+  lo = 0;
+  hi = 0xFFFFF;
+  const int64_t target_p = (int64_t) (pressureAt(now_ms) * 256.0f);
+  while (lo < hi) {
+    const int32_t mid = (lo + hi) >> 1;
+    if (_bme_comp_pres(mid, t_fine) > target_p) lo = mid + 1;
+    else                                        hi = mid;
+  }
+  const int32_t raw_p = lo;
+
+  lo = 0;
+  hi = 0xFFFF;
+  const int32_t target_h = lroundf(_hum_rh * 1024.0f);
+  while (lo < hi) {
+    const int32_t mid = (lo + hi) >> 1;
+    if (_bme_comp_hum(mid, t_fine) < target_h) lo = mid + 1;
+    else                                       hi = mid;
+  }
+  const int32_t raw_h = lo;
+
+  regs[SIM_BME_DATA_REG + 0] = (uint8_t) (raw_p >> 12);
+  regs[SIM_BME_DATA_REG + 1] = (uint8_t) (raw_p >> 4);
+  regs[SIM_BME_DATA_REG + 2] = (uint8_t) ((raw_p & 0x0F) << 4);
+  regs[SIM_BME_DATA_REG + 3] = (uint8_t) (raw_t >> 12);
+  regs[SIM_BME_DATA_REG + 4] = (uint8_t) (raw_t >> 4);
+  regs[SIM_BME_DATA_REG + 5] = (uint8_t) ((raw_t & 0x0F) << 4);
+  regs[SIM_BME_DATA_REG + 6] = (uint8_t) (raw_h >> 8);
+  regs[SIM_BME_DATA_REG + 7] = (uint8_t) (raw_h & 0xFF);
+}
+
+
+int32_t SimBME280::readRegs(uint8_t reg, uint8_t* buf, uint16_t len) {
+  if (reg + len > SIM_BME_DATA_REG) {
+    _render(sim_millis());
+  }
+  return I2CSimDevice::readRegs(reg, buf, len);
+}
+
+
+
+/*******************************************************************************
+* SimVEML6075
+*******************************************************************************/
+SimVEML6075::SimVEML6075(uint8_t addr) : I2CSimDevice(addr) {
+  for (uint8_t i = 0; i < 16; i++) {
+    _words[i] = 0;
+  }
+  _words[0x00] = 0x0001;   // Powered down at reset.
+  _words[0x0C] = 0x0026;   // Device ID.
+}
+
+
+void SimVEML6075::uvProfile(uint16_t uva_peak, uint16_t uvb_peak, uint32_t day_ms) {
+  _uva_peak = uva_peak;
+  _uvb_peak = uvb_peak;
+  _day_ms   = (0 < day_ms) ? day_ms : 1;
+}
+
+
+/*
+* Reads past the end of a register repeat its last byte, and reads of
+*   undefined codes give zeros.
+*/
+int32_t SimVEML6075::readRegs(uint8_t reg, uint8_t* buf, uint16_t len) {
+  if (reg >= 16) {
+    return I2C_ERR_NACK;
+  }
+  if ((0x07 <= reg) && (0x0B >= reg)) {
+    float sun = 0.0f;
+    if (0 == (_words[0x00] & 0x0001)) {
+      const float phase = (float) (sim_millis() % _day_ms) / _day_ms;
+      sun = (phase < 0.5f) ? sinf(2.0f * M_PI * phase) : 0.0f;
+    }
+    // Visible and IR leak into both UV channels in proportion to the
+    //   compensation channels, by the coefficients from the app note.
+    const float leak_a = (2.22f * _comp1) + (1.33f * _comp2);
+    const float leak_b = (2.95f * _comp1) + (1.75f * _comp2);
+    _words[0x07] = (uint16_t) ((_uva_peak * sun) + leak_a + 0.5f);
+    _words[0x09] = (uint16_t) ((_uvb_peak * sun) + leak_b + 0.5f);
+    _words[0x0A] = _comp1;
+    _words[0x0B] = _comp2;
+  }
+  for (uint16_t i = 0; i < len; i++) {
+    *(buf + i) = (uint8_t) (_words[reg] >> ((i > 0) ? 8 : 0));
+  }
+  return len;
+}
+
+
+int32_t SimVEML6075::writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len) {
+  if (reg >= 16) {
+    return I2C_ERR_NACK;
+  }
+  if (0 < len) {
+    _words[reg] = (_words[reg] & 0xFF00) | *buf;
+  }
+  if (1 < len) {
+    _words[reg] = (_words[reg] & 0x00FF) | ((uint16_t) *(buf + 1) << 8);
+  }
+  return len;
+}
+
+
+
+/*******************************************************************************
+* SimTSL2561
+*******************************************************************************/
+#define SIM_TSL_CMD_BIT   0x80
+
+SimTSL2561::SimTSL2561(uint8_t addr) : I2CSimDevice(addr) {
+  regs[0x01] = 0x02;   // 402ms, 1x at reset.
+  regs[0x0A] = 0x50;   // TSL2561T, revision 0.
+}
+
+
+void SimTSL2561::luxStep(uint16_t broadband0, uint16_t ir0, uint16_t broadband1, uint16_t ir1, uint32_t at_ms) {
+  _bb[0]   = broadband0;
+  _ir[0]   = ir0;
+  _bb[1]   = broadband1;
+  _ir[1]   = ir1;
+  _step_ms = at_ms;
+}
+
+
+void SimTSL2561::_render(uint32_t now_ms) {
+  const float  SCALES[4] = {0.034f, 0.252f, 1.0f, 0.0f};   // Manual timing reads nothing.
+  const uint32_t CLIPS[4] = {5047, 37177, 65535, 0};
+  const uint8_t  step    = (now_ms >= _step_ms) ? 1 : 0;
+  const uint8_t  timing  = regs[0x01];
+  uint32_t bb = 0;
+  uint32_t ir = 0;
+  if (0x03 == (regs[0x00] & 0x03)) {
+    const float scale = SCALES[timing & 0x03] * ((timing & 0x10) ? 16.0f : 1.0f);
+    bb = (uint32_t) (_bb[step] * scale);
+    ir = (uint32_t) (_ir[step] * scale);
+    if (bb > CLIPS[timing & 0x03]) bb = CLIPS[timing & 0x03];
+    if (ir > CLIPS[timing & 0x03]) ir = CLIPS[timing & 0x03];
+  }
+  regs[0x0C] = (uint8_t) (bb & 0xFF);
+  regs[0x0D] = (uint8_t) (bb >> 8);
+  regs[0x0E] = (uint8_t) (ir & 0xFF);
+  regs[0x0F] = (uint8_t) (ir >> 8);
+}
+
+
+int32_t SimTSL2561::readRegs(uint8_t reg, uint8_t* buf, uint16_t len) {
+  if (0 == (reg & SIM_TSL_CMD_BIT)) {
+    return I2C_ERR_NACK;
+  }
+  reg &= 0x0F;
+  if (reg + len > 0x0C) {
+    _render(sim_millis());
+  }
+  for (uint16_t i = 0; i < len; i++) {
+    *(buf + i) = regs[(reg + i) & 0x0F];
+  }
+  return len;
+}
+
+
+int32_t SimTSL2561::writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len) {
+  if (0 == (reg & SIM_TSL_CMD_BIT)) {
+    return I2C_ERR_NACK;
+  }
+  reg &= 0x0F;
+  for (uint16_t i = 0; i < len; i++) {
+    if ((reg + i) < 0x0A) {   // ID and data are read-only.
+      regs[reg + i] = *(buf + i);
+    }
+  }
+  return len;
+}
+
+
+
+/*******************************************************************************
+* SimTMP102
+*******************************************************************************/
+SimTMP102::SimTMP102(uint8_t addr) : I2CSimDevice(addr) {
+  _words[0] = 0x0000;
+  _words[1] = 0x60A0;   // Power-on config: 12-bit, 4Hz.
+  _words[2] = 0x4B00;   // T_LOW: 75C
+  _words[3] = 0x5000;   // T_HIGH: 80C
+}
+
+
+int32_t SimTMP102::readRegs(uint8_t reg, uint8_t* buf, uint16_t len) {
+  reg &= 0x03;
+  if (0 == reg) {
+    const float   c  = _temp_c + (_c_per_sec * (sim_millis() / 1000.0f));
+    const int16_t lsbs = (int16_t) lroundf(c * 16.0f);
+    if (_words[1] & 0x0010) {   // Extended mode: 13 bits, with bit 0 set.
+      _words[0] = (uint16_t) ((lsbs << 3) | 0x0001);
+    }
+    else {
+      _words[0] = (uint16_t) (lsbs << 4);
+    }
+  }
+  for (uint16_t i = 0; i < len; i++) {
+    *(buf + i) = (uint8_t) (_words[reg] >> ((i & 1) ? 0 : 8));
+  }
+  return len;
+}
+
+
+/* Partial writes land in the high byte first. */
+int32_t SimTMP102::writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len) {
+  reg &= 0x03;
+  if ((0 < len) && (0 != reg)) {
+    _words[reg] = (_words[reg] & 0x00FF) | ((uint16_t) *buf << 8);
+    if (1 < len) {
+      _words[reg] = (_words[reg] & 0xFF00) | *(buf + 1);
+    }
+  }
+  return len;
+}
+
+
+
+/*******************************************************************************
+* SensorSimRig
+*******************************************************************************/
+SensorSimRig::SensorSimRig(uint32_t bus_hz, uint16_t max_xfer) :
+  bus(sim_clock_advance, bus_hz, max_xfer),
+  queue("sim", &bus, sim_micros) {
+  bus.attach(&grideye);
+  bus.attach(&baro);
+  bus.attach(&uv);
+  bus.attach(&tsl2561);
+  bus.attach(&tmp102);
+}
@@ -0,0 +1,196 @@
+/*
+* Modeled sensors for host builds.
+*
+* Each model is an I2CSimDevice that answers the same register traffic as the
+*   real part, and computes its readings from a virtual clock at the moment
+*   they are read. So the unmodified drivers can be run against them on an
+*   I2CSimBus, and a whole sampling schedule can be played out much faster
+*   than real time.
+*
+* The virtual clock is a free-running microsecond counter. The simulated bus
+*   advances it by the wire time of each transaction. Whatever stands in for
+*   the loop advances it for everything else. sim_micros() and sim_millis()
+*   have the same shape as the Arduino functions, and can be handed to the
+*   scheduler, profiler, and bus queues.
+*
+* Each model's behavior is set by a few parameters, all of which have sane
+*   defaults:
+*   SimGridEYE:  A thermal scene made of a background, a horizontal gradient,
+*                  and a warm blob orbiting the center of the array.
+*   SimBME280:   A linear pressure ramp at fixed temperature and humidity.
+*                  Raw values are solved against a stock trim set, so the
+*                  driver's compensation gives back the modeled values.
+*   SimVEML6075: A half-sine daylight profile for UVA and UVB counts.
+*   SimTSL2561:  A step between two light levels at a given time. Counts
+*                  follow the configured gain and integration time.
+*   SimTMP102:   A linear temperature drift. Honors extended mode.
+*
+* Nothing in here allocates, and nothing depends on Arduino.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include "I2CBusQueue.h"
+
+#ifndef __SENSOR_SIM_H_
+#define __SENSOR_SIM_H_
+
+/* Addresses as wired on Motherflux0r. */
+#define SIM_ADDR_GRIDEYE     0x69
+#define SIM_ADDR_BME280      0x76
+#define SIM_ADDR_VEML6075    0x10
+#define SIM_ADDR_TSL2561     0x39
+#define SIM_ADDR_TMP102      0x49
+
+/* Virtual clock */
+uint32_t sim_micros();
+uint32_t sim_millis();
+void     sim_clock_advance(uint32_t us);
+void     sim_clock_set(uint32_t us);
+
+
+/*******************************************************************************
+* AMG88xx (GridEYE) thermopile array
+*******************************************************************************/
+class SimGridEYE : public I2CSimDevice {
+  public:
+    SimGridEYE(uint8_t addr = SIM_ADDR_GRIDEYE);
+
+    /* All temperatures in degrees C. */
+    void scene(float background, float gradient, float blob, float blob_radius_px, uint32_t orbit_ms);
+    inline void thermistor(float c) {   _thermistor = c;   };
+    inline void noise(float c) {        _noise = c;        };
+    float pixelAt(uint8_t x, uint8_t y, uint32_t now_ms);
+
+    int32_t readRegs(uint8_t reg, uint8_t* buf, uint16_t len);
+
+
+  private:
+    float    _background   = 22.0f;
+    float    _gradient     = 2.0f;    // Added across the rows, left to right.
+    float    _blob         = 12.0f;   // Peak above background.
+    float    _blob_radius  = 1.2f;    // Gaussian sigma, in pixels.
+    uint32_t _orbit_ms     = 8000;    // 0 parks the blob in the center.
+    float    _thermistor   = 25.0f;
+    float    _noise        = 0.0f;
+    uint32_t _lcg          = 0x2545F491;
+
+    void _render(uint32_t now_ms);
+};
+
+
+/*******************************************************************************
+* BME280 barometer
+*******************************************************************************/
+class SimBME280 : public I2CSimDevice {
+  public:
+    SimBME280(uint8_t addr = SIM_ADDR_BME280);
+
+    void pressureRamp(float pa_start, float pa_per_sec);
+    inline void temperature(float c) {  _temp_c = c;    };
+    inline void humidity(float rh) {    _hum_rh = rh;   };
+    float pressureAt(uint32_t now_ms);
+
+    int32_t readRegs(uint8_t reg, uint8_t* buf, uint16_t len);
+
+
+  private:
+    float _pa_start   = 101325.0f;
+    float _pa_per_sec = -12.0f;     // About 1m of climb per second.
+    float _temp_c     = 24.0f;
+    float _hum_rh     = 40.0f;
+
+    void _render(uint32_t now_ms);
+};
+
+
+/*******************************************************************************
+* VEML6075 UV sensor
+* Every command code is a 16-bit register. Reads never cross into the next one.
+*******************************************************************************/
+class SimVEML6075 : public I2CSimDevice {
+  public:
+    SimVEML6075(uint8_t addr = SIM_ADDR_VEML6075);
+
+    void uvProfile(uint16_t uva_peak, uint16_t uvb_peak, uint32_t day_ms);
+    inline void compensation(uint16_t c1, uint16_t c2) {  _comp1 = c1;  _comp2 = c2;  };
+
+    int32_t readRegs(uint8_t reg, uint8_t* buf, uint16_t len);
+    int32_t writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len);
+
+
+  private:
+    uint16_t _words[16];
+    uint16_t _uva_peak = 600;
+    uint16_t _uvb_peak = 800;
+    uint32_t _day_ms   = 60000;   // Daylight for the first half.
+    uint16_t _comp1    = 40;
+    uint16_t _comp2    = 20;
+};
+
+
+/*******************************************************************************
+* TSL2561 light sensor
+* Register access requires the command bit. Counts are given as they would read
+*   at 402ms integration and 1x gain, and are scaled to the configured timing.
+*******************************************************************************/
+class SimTSL2561 : public I2CSimDevice {
+  public:
+    SimTSL2561(uint8_t addr = SIM_ADDR_TSL2561);
+
+    void luxStep(uint16_t broadband0, uint16_t ir0, uint16_t broadband1, uint16_t ir1, uint32_t at_ms);
+
+    int32_t readRegs(uint8_t reg, uint8_t* buf, uint16_t len);
+    int32_t writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len);
+
+
+  private:
+    uint16_t _bb[2]   = {400, 9000};
+    uint16_t _ir[2]   = {120, 2500};
+    uint32_t _step_ms = 10000;
+
+    void _render(uint32_t now_ms);
+};
+
+
+/*******************************************************************************
+* TMP102 temperature sensor
+* Four 16-bit registers behind a pointer register, MSB first.
+*******************************************************************************/
+class SimTMP102 : public I2CSimDevice {
+  public:
+    SimTMP102(uint8_t addr = SIM_ADDR_TMP102);
+
+    inline void temperature(float c, float c_per_sec = 0.0f) {
+      _temp_c     = c;
+      _c_per_sec  = c_per_sec;
+    };
+
+    int32_t readRegs(uint8_t reg, uint8_t* buf, uint16_t len);
+    int32_t writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len);
+
+
+  private:
+    uint16_t _words[4];
+    float    _temp_c    = 31.0f;
+    float    _c_per_sec = 0.01f;
+};
+
+
+/*******************************************************************************
+* The sensor complement of Motherflux0r, on one simulated bus.
+*******************************************************************************/
+class SensorSimRig {
+  public:
+    I2CSimBus     bus;
+    I2CBusQueue   queue;
+    SimGridEYE    grideye;
+    SimBME280     baro;
+    SimVEML6075   uv;
+    SimTSL2561    tsl2561;
+    SimTMP102     tmp102;
+
+    SensorSimRig(uint32_t bus_hz = 400000, uint16_t max_xfer = 32);
+};
+
+#endif   // __SENSOR_SIM_H_
@@ -0,0 +1,19 @@
+/*
+* The host's own monotonic clock, for benchmarks that time real work. The sim's
+*   micros() is the virtual clock, which only moves when the firmware spends
+*   modeled time, so it can't time code running on the host.
+*/
+
+#include <stdint.h>
+#include <chrono>
+
+#ifndef __SIM_HOST_CLOCK_H_
+#define __SIM_HOST_CLOCK_H_
+
+inline uint32_t host_micros() {
+  return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+#endif  // __SIM_HOST_CLOCK_H_
@@ -0,0 +1,16 @@
+/*
+* The accuracy sweep and timing of the BME280 math kernels against their
+*   reference forms. Same as the console's "atmo", with the host's clock.
+*/
+
+#include <stdio.h>
+#include "AtmoMath.h"
+#include "HostClock.h"
+
+
+int main() {
+  StringBuilder out;
+  const int8_t RET = atmo_math_benchmark(&out, host_micros);
+  printf("%s", (char*) out.string());
+  return (0 == RET) ? 0 : 1;
+}
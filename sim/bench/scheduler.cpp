@@ -0,0 +1,84 @@
+/*
+* CoopScheduler on a virtual clock.
+*
+* Runs the firmware's task set (the periods and priorities in the sketch) for
+*   an hour of virtual time. Each task costs some virtual time when it runs,
+*   and each pass of the loop costs a little more, so deadlines are met late
+*   by realistic amounts. Reports what the scheduler itself costs on the host
+*   per pass and per dispatch, and its per-task jitter and overrun stats.
+*
+* Usage: scheduler [virtual seconds]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "Scheduler.h"
+
+static uint32_t fake_us = 0;
+static uint32_t clock_us() {   return fake_us;   }
+
+/* What each task costs, roughly as measured on the Teensy (prof). */
+static void fxn_fast() {      fake_us += 2;     }
+static void fxn_driver() {    fake_us += 10;    }
+static void fxn_display() {   fake_us += 150;   }
+static void fxn_log() {       fake_us += 30;    }
+
+static CoopTask task_touch("touch",            fxn_driver,  50000, 180);
+static CoopTask task_uv("uv",                  fxn_driver,  10000);
+static CoopTask task_baro("baro",              fxn_driver,  200000);
+static CoopTask task_tsl2561("tsl2561",        fxn_driver,  10000);
+static CoopTask task_grideye("grideye",        fxn_driver,  10000);
+static CoopTask task_tmp102("tmp102",          fxn_driver,  50000);
+static CoopTask task_ui_timeout("ui_timeout",  fxn_fast,    1000000, 10);
+static CoopTask task_display("display",        fxn_display, 1000000 / 30, 100);
+static CoopTask task_log("log",                fxn_log,     10000, 60);
+static CoopTask task_replay("replay",          fxn_fast,    1000, 60);
+static CoopTask task_led_off("led_off",        fxn_fast,    0, 200);
+
+static CoopTask* const TASKS[] = {
+  &task_touch, &task_uv, &task_baro, &task_tsl2561, &task_grideye, &task_tmp102,
+  &task_ui_timeout, &task_display, &task_log, &task_replay
+};
+
+
+int main(int argc, char** argv) {
+  const uint32_t SECS = (argc > 1) ? strtoul(argv[1], nullptr, 0) : 3600;
+  CoopScheduler sched(clock_us);
+  fake_us = 0xF0000000;   // So the run crosses the 32-bit wrap.
+  for (CoopTask* t : TASKS) {
+    sched.addTask(t);
+  }
+
+  uint64_t passes     = 0;
+  uint64_t dispatches = 0;
+  uint64_t virtual_us = 0;
+  const auto T0 = std::chrono::steady_clock::now();
+  while (virtual_us < ((uint64_t) SECS * 1000000)) {
+    const uint32_t BEFORE = fake_us;
+    dispatches += sched.serviceTasks();
+    if (0 == (passes % 977)) {
+      sched.fireIn(&task_led_off, 200000);   // A one-shot, now and then.
+    }
+    // The rest of the loop, then sleep toward the next deadline, as the
+    //   firmware does (WFI wakes on SysTick at least every millisecond).
+    fake_us += 3;
+    const uint32_t WAIT = sched.usUntilNextDeadline();
+    fake_us += (WAIT < 1000) ? WAIT : 1000;
+    virtual_us += (uint32_t) (fake_us - BEFORE);
+    passes++;
+  }
+  const double HOST_NS = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - T0).count();
+
+  printf("-- CoopScheduler, %u tasks, %u virtual seconds\n", sched.taskCount(), SECS);
+  printf("\t%llu passes, %llu dispatches in %.3f s of host time (%.0fx real time)\n",
+    (unsigned long long) passes, (unsigned long long) dispatches, HOST_NS / 1e9, ((double) virtual_us * 1000.0) / HOST_NS
+  );
+  printf("\t%.1f ns per pass, %.1f ns per dispatch, on the host\n",
+    HOST_NS / (double) passes, HOST_NS / (double) dispatches
+  );
+  StringBuilder out;
+  sched.printDebug(&out);
+  printf("%s", (char*) out.string());
+  return 0;
+}
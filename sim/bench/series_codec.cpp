@@ -0,0 +1,17 @@
+/*
+* Bytes per sample and encode/decode cost of the history codec on
+*   real-shaped streams, and how many hours of each fit in the RAM of a
+*   96-float window. The console's "codec" command, timed by the host.
+*/
+
+#include <stdio.h>
+#include "SeriesCodec.h"
+#include "HostClock.h"
+
+
+int main() {
+  StringBuilder out;
+  const int8_t RET = series_codec_benchmark(&out, host_micros);
+  printf("%s", (char*) out.string());
+  return (0 == RET) ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+/*
+* The console's "therm" command, on the host: checks the single-pass
+*   thermopile frame pipeline against the old per-pixel path, and times both
+*   on the host's clock.
+*/
+
+#include <stdio.h>
+#include "ThermFrame.h"
+#include "HostClock.h"
+
+
+int main() {
+  StringBuilder out;
+  const int8_t RET = therm_frame_benchmark(&out, host_micros);
+  printf("%s", (char*) out.string());
+  return (0 == RET) ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+/*
+* Host stand-in for Adafruit_GFX. See the header file for the rules.
+* The shape algorithms follow the library's own, so that the pixels come out
+*   the same.
+*/
+
+#include "Adafruit_GFX.h"
+
+#define _gfx_swap(a, b)  { int16_t t = a;  a = b;  b = t; }
+
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) :
+  WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+
+void Adafruit_GFX::writePixel(int16_t x, int16_t y, uint16_t color) {
+  drawPixel(x, y, color);
+}
+
+void Adafruit_GFX::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t i = x; i < x + w; i++) {
+    writeFastVLine(i, y, h, color);
+  }
+}
+
+void Adafruit_GFX::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  writeLine(x, y, x, y + h - 1, color);
+}
+
+void Adafruit_GFX::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  writeLine(x, y, x + w - 1, y, color);
+}
+
+/* Bresenham's algorithm, as the library does it. */
+void Adafruit_GFX::writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  const bool STEEP = abs(y1 - y0) > abs(x1 - x0);
+  if (STEEP) {
+    _gfx_swap(x0, y0);
+    _gfx_swap(x1, y1);
+  }
+  if (x0 > x1) {
+    _gfx_swap(x0, x1);
+    _gfx_swap(y0, y1);
+  }
+  const int16_t DX = x1 - x0;
+  const int16_t DY = abs(y1 - y0);
+  const int16_t YSTEP = (y0 < y1) ? 1 : -1;
+  int16_t err = DX / 2;
+  for (; x0 <= x1; x0++) {
+    if (STEEP) {
+      writePixel(y0, x0, color);
+    }
+    else {
+      writePixel(x0, y0, color);
+    }
+    err -= DY;
+    if (err < 0) {
+      y0 += YSTEP;
+      err += DX;
+    }
+  }
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  startWrite();
+  writeLine(x, y, x, y + h - 1, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  startWrite();
+  writeLine(x, y, x + w - 1, y, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  startWrite();
+  writeFillRect(x, y, w, h, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color) {
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  if (x0 == x1) {
+    if (y0 > y1) _gfx_swap(y0, y1);
+    drawFastVLine(x0, y0, y1 - y0 + 1, color);
+  }
+  else if (y0 == y1) {
+    if (x0 > x1) _gfx_swap(x0, x1);
+    drawFastHLine(x0, y0, x1 - x0 + 1, color);
+  }
+  else {
+    startWrite();
+    writeLine(x0, y0, x1, y1, color);
+    endWrite();
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  startWrite();
+  writeFastHLine(x, y, w, color);
+  writeFastHLine(x, y + h - 1, w, color);
+  writeFastVLine(x, y, h, color);
+  writeFastVLine(x + w - 1, y, h, color);
+  endWrite();
+}
+
+
+void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  startWrite();
+  writePixel(x0, y0 + r, color);
+  writePixel(x0, y0 - r, color);
+  writePixel(x0 + r, y0, color);
+  writePixel(x0 - r, y0, color);
+  _circle_helper(x0, y0, r, 0x0F, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  startWrite();
+  writeFastVLine(x0, y0 - r, 2 * r + 1, color);
+  _fill_circle_helper(x0, y0, r, 3, 0, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+  const int16_t MAX_R = ((w < h) ? w : h) / 2;
+  if (r > MAX_R) r = MAX_R;
+  startWrite();
+  writeFastHLine(x + r, y, w - 2 * r, color);
+  writeFastHLine(x + r, y + h - 1, w - 2 * r, color);
+  writeFastVLine(x, y + r, h - 2 * r, color);
+  writeFastVLine(x + w - 1, y + r, h - 2 * r, color);
+  _circle_helper(x + r, y + r, r, 1, color);
+  _circle_helper(x + w - r - 1, y + r, r, 2, color);
+  _circle_helper(x + w - r - 1, y + h - r - 1, r, 4, color);
+  _circle_helper(x + r, y + h - r - 1, r, 8, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+  const int16_t MAX_R = ((w < h) ? w : h) / 2;
+  if (r > MAX_R) r = MAX_R;
+  startWrite();
+  writeFillRect(x + r, y, w - 2 * r, h, color);
+  _fill_circle_helper(x + w - r - 1, y + r, r, 1, h - 2 * r - 1, color);
+  _fill_circle_helper(x + r, y + r, r, 2, h - 2 * r - 1, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+  // Sort by y.
+  if (y0 > y1) {  _gfx_swap(y0, y1);  _gfx_swap(x0, x1);  }
+  if (y1 > y2) {  _gfx_swap(y2, y1);  _gfx_swap(x2, x1);  }
+  if (y0 > y1) {  _gfx_swap(y0, y1);  _gfx_swap(x0, x1);  }
+
+  startWrite();
+  if (y0 == y2) {   // All on one line.
+    int16_t a = x0;
+    int16_t b = x0;
+    if (x1 < a) a = x1;  else if (x1 > b) b = x1;
+    if (x2 < a) a = x2;  else if (x2 > b) b = x2;
+    writeFastHLine(a, y0, b - a + 1, color);
+    endWrite();
+    return;
+  }
+  const int32_t DX01 = x1 - x0;
+  const int32_t DY01 = y1 - y0;
+  const int32_t DX02 = x2 - x0;
+  const int32_t DY02 = y2 - y0;
+  const int32_t DX12 = x2 - x1;
+  const int32_t DY12 = y2 - y1;
+  int32_t sa = 0;
+  int32_t sb = 0;
+  const int16_t LAST = (y1 == y2) ? y1 : (y1 - 1);
+  int16_t y = y0;
+  for (; y <= LAST; y++) {
+    int16_t a = x0 + sa / DY01;
+    int16_t b = x0 + sb / DY02;
+    sa += DX01;
+    sb += DX02;
+    if (a > b) _gfx_swap(a, b);
+    writeFastHLine(a, y, b - a + 1, color);
+  }
+  sa = DX12 * (y - y1);
+  sb = DX02 * (y - y0);
+  for (; y <= y2; y++) {
+    int16_t a = x1 + sa / DY12;
+    int16_t b = x0 + sb / DY02;
+    sa += DX12;
+    sb += DX02;
+    if (a > b) _gfx_swap(a, b);
+    writeFastHLine(a, y, b - a + 1, color);
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color) {
+  const int16_t BYTE_W = (w + 7) / 8;
+  uint8_t b = 0;
+  startWrite();
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      b = (i & 7) ? (uint8_t) (b << 1) : bitmap[j * BYTE_W + i / 8];
+      if (b & 0x80) {
+        writePixel(x + i, y + j, color);
+      }
+    }
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawRGBBitmap(int16_t x, int16_t y, const uint16_t* bitmap, int16_t w, int16_t h) {
+  startWrite();
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      writePixel(x + i, y + j, bitmap[j * w + i]);
+    }
+  }
+  endWrite();
+}
+
+
+/*
+* Lays the character out on the classic 6x8 cell. Where the text has a
+*   background color, the cell is filled with it, as the library would.
+*/
+size_t Adafruit_GFX::write(uint8_t c) {
+  if ('\n' == c) {
+    cursor_x  = 0;
+    cursor_y += textsize * 8;
+  }
+  else if ('\r' != c) {
+    if (wrap && ((cursor_x + textsize * 6) > _width)) {
+      cursor_x  = 0;
+      cursor_y += textsize * 8;
+    }
+    if (textbgcolor != textcolor) {
+      fillRect(cursor_x, cursor_y, textsize * 6, textsize * 8, textbgcolor);
+    }
+    cursor_x += textsize * 6;
+  }
+  return 1;
+}
+
+
+void Adafruit_GFX::_circle_helper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, uint16_t color) {
+  int16_t f     = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x     = 0;
+  int16_t y     = r;
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    if (corners & 0x4) {
+      writePixel(x0 + x, y0 + y, color);
+      writePixel(x0 + y, y0 + x, color);
+    }
+    if (corners & 0x2) {
+      writePixel(x0 + x, y0 - y, color);
+      writePixel(x0 + y, y0 - x, color);
+    }
+    if (corners & 0x8) {
+      writePixel(x0 - y, y0 + x, color);
+      writePixel(x0 - x, y0 + y, color);
+    }
+    if (corners & 0x1) {
+      writePixel(x0 - y, y0 - x, color);
+      writePixel(x0 - x, y0 - y, color);
+    }
+  }
+}
+
+void Adafruit_GFX::_fill_circle_helper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color) {
+  int16_t f     = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x     = 0;
+  int16_t y     = r;
+  int16_t px    = x;
+  int16_t py    = y;
+  delta++;
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    if (x < (y + 1)) {
+      if (corners & 1) writeFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
+      if (corners & 2) writeFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
+    }
+    if (y != py) {
+      if (corners & 1) writeFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
+      if (corners & 2) writeFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
+      py = y;
+    }
+    px = x;
+  }
+}
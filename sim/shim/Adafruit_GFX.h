@@ -0,0 +1,77 @@
+/*
+* Host stand-in for Adafruit_GFX.
+*
+* The shape primitives are built on the same virtual pixel, span, and rect
+*   calls as the real library, so a subclass (the framebuffer) sees the same
+*   traffic. Text is laid out on the library's 6x8 cell, so the cursor moves
+*   as it would, but glyphs are not drawn.
+*/
+
+#include <Arduino.h>
+
+#ifndef __SIM_ADAFRUIT_GFX_H_
+#define __SIM_ADAFRUIT_GFX_H_
+
+class Adafruit_GFX : public Print {
+  public:
+    Adafruit_GFX(int16_t w, int16_t h);
+    virtual ~Adafruit_GFX() {};
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+    virtual void startWrite() {};
+    virtual void endWrite() {};
+    virtual void writePixel(int16_t x, int16_t y, uint16_t color);
+    virtual void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    virtual void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    virtual void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    virtual void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    virtual void fillScreen(uint16_t color);
+    virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+    virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    virtual void setRotation(uint8_t r) {   rotation = r & 3;   };
+    virtual void invertDisplay(bool) {};
+
+    void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+    void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+    void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+    void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+    void drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color);
+    void drawRGBBitmap(int16_t x, int16_t y, const uint16_t* bitmap, int16_t w, int16_t h);
+
+    inline void setCursor(int16_t x, int16_t y) {  cursor_x = x;  cursor_y = y;   };
+    inline void setTextColor(uint16_t c) {              textcolor = c;  textbgcolor = c;   };
+    inline void setTextColor(uint16_t c, uint16_t bg) { textcolor = c;  textbgcolor = bg;  };
+    inline void setTextSize(uint8_t s) {  textsize = (s > 0) ? s : 1;   };
+    inline void setTextWrap(bool w) {     wrap = w;                      };
+    inline int16_t getCursorX() const {   return cursor_x;   };
+    inline int16_t getCursorY() const {   return cursor_y;   };
+    inline int16_t width() const {        return _width;     };
+    inline int16_t height() const {       return _height;    };
+    inline uint8_t getRotation() const {  return rotation;   };
+
+    size_t write(uint8_t);
+    using Print::write;
+
+
+  protected:
+    const int16_t WIDTH;
+    const int16_t HEIGHT;
+    int16_t  _width;
+    int16_t  _height;
+    int16_t  cursor_x    = 0;
+    int16_t  cursor_y    = 0;
+    uint16_t textcolor   = 0xFFFF;
+    uint16_t textbgcolor = 0xFFFF;
+    uint8_t  textsize    = 1;
+    uint8_t  rotation    = 0;
+    bool     wrap        = true;
+
+    void _circle_helper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, uint16_t color);
+    void _fill_circle_helper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color);
+};
+
+#endif  // __SIM_ADAFRUIT_GFX_H_
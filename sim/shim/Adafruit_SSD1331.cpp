@@ -0,0 +1,109 @@
+/*
+* Host stand-in for Adafruit_SSD1331. See the header file for the rules.
+*/
+
+#include "Adafruit_SSD1331.h"
+
+#define SIM_SSD1331_WINDOW_BYTES    6   // Column and row address commands.
+
+
+Adafruit_SSD1331::Adafruit_SSD1331(SPIClass* spi, int8_t, int8_t, int8_t) :
+  Adafruit_GFX(SIM_SSD1331_WIDTH, SIM_SSD1331_HEIGHT), _spi(spi) {
+  memset(_glass, 0, sizeof(_glass));
+}
+
+
+void Adafruit_SSD1331::begin(uint32_t freq) {
+  if (freq > 0) {
+    _freq = freq;
+  }
+  setAddrWindow(0, 0, SIM_SSD1331_WIDTH, SIM_SSD1331_HEIGHT);
+  _windows = 0;
+  _bytes   = 0;
+}
+
+
+void Adafruit_SSD1331::setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  _wx0 = (x < SIM_SSD1331_WIDTH)  ? x : (SIM_SSD1331_WIDTH - 1);
+  _wy0 = (y < SIM_SSD1331_HEIGHT) ? y : (SIM_SSD1331_HEIGHT - 1);
+  _wx1 = ((x + w - 1) < SIM_SSD1331_WIDTH)  ? (x + w - 1) : (SIM_SSD1331_WIDTH - 1);
+  _wy1 = ((y + h - 1) < SIM_SSD1331_HEIGHT) ? (y + h - 1) : (SIM_SSD1331_HEIGHT - 1);
+  _px  = _wx0;
+  _py  = _wy0;
+  _windows++;
+  _charge(SIM_SSD1331_WINDOW_BYTES);
+}
+
+
+void Adafruit_SSD1331::writePixels(uint16_t* colors, uint32_t len, bool, bool big_endian) {
+  for (uint32_t i = 0; i < len; i++) {
+    const uint16_t C = colors[i];
+    _put(big_endian ? (uint16_t) ((C << 8) | (C >> 8)) : C);
+  }
+  _charge(len * 2);
+}
+
+
+void Adafruit_SSD1331::writeColor(uint16_t color, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    _put(color);
+  }
+  _charge(len * 2);
+}
+
+
+void Adafruit_SSD1331::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if ((x >= 0) && (y >= 0) && (x < SIM_SSD1331_WIDTH) && (y < SIM_SSD1331_HEIGHT)) {
+    setAddrWindow(x, y, 1, 1);
+    writeColor(color, 1);
+  }
+}
+
+
+/*
+* Writes what the panel shows as a binary PPM.
+* Returns 0 on success, or -1 if the file couldn't be written.
+*/
+int8_t Adafruit_SSD1331::simWritePPM(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (nullptr == f) {
+    return -1;
+  }
+  fprintf(f, "P6\n%u %u\n255\n", SIM_SSD1331_WIDTH, SIM_SSD1331_HEIGHT);
+  for (uint16_t i = 0; i < (SIM_SSD1331_WIDTH * SIM_SSD1331_HEIGHT); i++) {
+    const uint16_t C = _glass[i];
+    const uint8_t RGB[3] = {
+      (uint8_t) (((C >> 11) & 0x1F) << 3),
+      (uint8_t) (((C >> 5) & 0x3F) << 2),
+      (uint8_t) ((C & 0x1F) << 3)
+    };
+    fwrite(RGB, 1, 3, f);
+  }
+  fclose(f);
+  return 0;
+}
+
+
+/* Lands one pixel, and moves along the window as the controller does. */
+void Adafruit_SSD1331::_put(uint16_t color) {
+  _glass[(_py * SIM_SSD1331_WIDTH) + _px] = color;
+  if (++_px > _wx1) {
+    _px = _wx0;
+    if (++_py > _wy1) {
+      _py = _wy0;
+    }
+  }
+}
+
+
+void Adafruit_SSD1331::_charge(uint32_t bytes) {
+  _bytes   += bytes;
+  _owed_ns += (uint32_t) (((uint64_t) bytes * 8 * 1000000000) / _freq);
+  if (_owed_ns >= 1000) {
+    delayMicroseconds(_owed_ns / 1000);
+    _owed_ns %= 1000;
+  }
+  if (nullptr != _spi) {
+    _spi->transfer(nullptr, nullptr, bytes);
+  }
+}
@@ -0,0 +1,61 @@
+/*
+* Host stand-in for Adafruit_SSD1331, with a model of the panel behind it.
+*
+* The panel's RAM is kept as a 96x64 RGB565 image. setAddrWindow() and
+*   writePixels() move a write pointer within the window, wrapping as the
+*   controller does, so what lands in the image is what would be on the glass.
+*   Pixel writes are charged to the virtual clock at the SPI rate given to
+*   begin(), so a blocking flush costs what it would on the wire.
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Adafruit_GFX.h>
+
+#ifndef __SIM_ADAFRUIT_SSD1331_H_
+#define __SIM_ADAFRUIT_SSD1331_H_
+
+#define SIM_SSD1331_WIDTH     96
+#define SIM_SSD1331_HEIGHT    64
+
+class Adafruit_SSD1331 : public Adafruit_GFX {
+  public:
+    Adafruit_SSD1331(SPIClass* spi, int8_t cs, int8_t dc, int8_t rst);
+
+    void begin(uint32_t freq = 0);
+    void startWrite() {};
+    void endWrite() {};
+    void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+    void writePixels(uint16_t* colors, uint32_t len, bool block = true, bool big_endian = false);
+    void writeColor(uint16_t color, uint32_t len);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void enableDisplay(bool) {};
+
+    /* Harness side. */
+    inline uint16_t simPixel(uint8_t x, uint8_t y) {
+      return ((x < SIM_SSD1331_WIDTH) && (y < SIM_SSD1331_HEIGHT)) ? _glass[(y * SIM_SSD1331_WIDTH) + x] : 0;
+    };
+    inline uint32_t simBytes() {     return _bytes;     };
+    inline uint32_t simWindows() {   return _windows;   };
+    int8_t simWritePPM(const char* path);
+
+
+  private:
+    SPIClass* _spi;
+    uint32_t  _freq    = 8000000;
+    uint32_t  _bytes   = 0;
+    uint32_t  _windows = 0;
+    uint32_t  _owed_ns = 0;    // Wire time not yet charged to the clock.
+    uint8_t   _wx0 = 0;
+    uint8_t   _wx1 = SIM_SSD1331_WIDTH - 1;
+    uint8_t   _wy0 = 0;
+    uint8_t   _wy1 = SIM_SSD1331_HEIGHT - 1;
+    uint8_t   _px  = 0;
+    uint8_t   _py  = 0;
+    uint16_t  _glass[SIM_SSD1331_WIDTH * SIM_SSD1331_HEIGHT];
+
+    void _put(uint16_t color);
+    void _charge(uint32_t bytes);
+};
+
+#endif  // __SIM_ADAFRUIT_SSD1331_H_
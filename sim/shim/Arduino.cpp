@@ -0,0 +1,217 @@
+/*
+* Host stand-in for the Arduino core. See the header file for the rules.
+*/
+
+#include <stdarg.h>
+#include "Arduino.h"
+#include "SensorSim.h"
+
+HardwareSerial Serial(true);
+HardwareSerial Serial1(false);
+HardwareSerial Serial6(false);
+
+static uint8_t _pin_level[SIM_PIN_COUNT];
+static uint8_t _pin_mode[SIM_PIN_COUNT];
+static int     _pin_analog[SIM_PIN_COUNT];
+static void  (*_pin_isr[SIM_PIN_COUNT])() = { nullptr };
+static int     _pin_isr_mode[SIM_PIN_COUNT];
+
+
+/*******************************************************************************
+* Time
+*******************************************************************************/
+
+/*
+* Reading millis() costs a microsecond of virtual time, so that the sketch's
+*   spin-waits on it (the splash screen) come to an end. micros() is free, so
+*   that it doesn't skew what the profiler measures.
+*/
+uint32_t millis() {
+  sim_clock_advance(1);
+  return sim_millis();
+}
+
+uint32_t micros() {   return sim_micros();   }
+
+void delay(uint32_t ms) {               sim_clock_advance(ms * 1000);  }
+void delayMicroseconds(uint32_t us) {   sim_clock_advance(us);         }
+void yield() {}
+
+
+
+/*******************************************************************************
+* Pins
+*******************************************************************************/
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < SIM_PIN_COUNT) {
+    _pin_mode[pin] = mode;
+    if (INPUT_PULLUP == mode) {
+      _pin_level[pin] = HIGH;
+    }
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < SIM_PIN_COUNT) ? _pin_level[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < SIM_PIN_COUNT) {
+    _pin_level[pin] = (val) ? HIGH : LOW;
+  }
+}
+
+int analogRead(uint8_t pin) {
+  return (pin < SIM_PIN_COUNT) ? _pin_analog[pin] : 0;
+}
+
+void analogWrite(uint8_t pin, int val) {
+  if (pin < SIM_PIN_COUNT) {
+    _pin_analog[pin] = val;
+    _pin_level[pin]  = (val > 0) ? HIGH : LOW;
+  }
+}
+
+void analogWriteResolution(int) {}
+
+int digitalPinToInterrupt(uint8_t pin) {
+  return (pin < SIM_PIN_COUNT) ? pin : -1;
+}
+
+void attachInterrupt(int irq, void (*isr)(), int mode) {
+  if ((irq >= 0) && (irq < SIM_PIN_COUNT)) {
+    _pin_isr[irq]      = isr;
+    _pin_isr_mode[irq] = mode;
+  }
+}
+
+void detachInterrupt(int irq) {
+  if ((irq >= 0) && (irq < SIM_PIN_COUNT)) {
+    _pin_isr[irq] = nullptr;
+  }
+}
+
+
+/*
+* Sets the level on an input, as the part on the other end would. The
+*   attached ISR (if any) runs right away, as though the CPU took it.
+*/
+void sim_pin_drive(uint8_t pin, uint8_t level) {
+  if (pin >= SIM_PIN_COUNT) {
+    return;
+  }
+  const uint8_t WAS = _pin_level[pin];
+  _pin_level[pin] = (level) ? HIGH : LOW;
+  if ((nullptr != _pin_isr[pin]) && (WAS != _pin_level[pin])) {
+    const bool FELL = (HIGH == WAS);
+    switch (_pin_isr_mode[pin]) {
+      case FALLING:  if (FELL)  _pin_isr[pin]();   break;
+      case RISING:   if (!FELL) _pin_isr[pin]();   break;
+      case CHANGE:   _pin_isr[pin]();              break;
+      default:       break;
+    }
+  }
+}
+
+int sim_pin_output(uint8_t pin) {
+  return (pin < SIM_PIN_COUNT) ? _pin_analog[pin] : 0;
+}
+
+void sim_analog_set(uint8_t pin, int val) {
+  if (pin < SIM_PIN_COUNT) {
+    _pin_analog[pin] = val;
+  }
+}
+
+
+
+/*******************************************************************************
+* Print
+*******************************************************************************/
+
+size_t Print::write(const uint8_t* buf, size_t len) {
+  size_t n = 0;
+  while (n < len) {
+    n += write(buf[n]);
+  }
+  return n;
+}
+
+size_t Print::print(const char* s) {
+  return (nullptr == s) ? 0 : write((const uint8_t*) s, strlen(s));
+}
+
+size_t Print::print(char c) {                       return write((uint8_t) c);       }
+size_t Print::print(int n, int base) {              return _print_int(n, base);      }
+size_t Print::print(unsigned int n, int base) {     return _print_int(n, base);      }
+size_t Print::print(long n, int base) {             return _print_int(n, base);      }
+size_t Print::print(unsigned long n, int base) {    return _print_int(n, base);      }
+
+size_t Print::print(double n, int digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+size_t Print::println() {                                  return print("\r\n");                  }
+size_t Print::println(const char* s) {                     return print(s) + println();           }
+size_t Print::println(char c) {                            return print(c) + println();           }
+size_t Print::println(int n, int base) {                   return print(n, base) + println();     }
+size_t Print::println(unsigned int n, int base) {          return print(n, base) + println();     }
+size_t Print::println(long n, int base) {                  return print(n, base) + println();     }
+size_t Print::println(unsigned long n, int base) {         return print(n, base) + println();     }
+size_t Print::println(double n, int digits) {              return print(n, digits) + println();   }
+
+int Print::printf(const char* fmt, ...) {
+  char buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  const int LEN = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  print(buf);
+  return LEN;
+}
+
+size_t Print::_print_int(long long n, int base) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), (HEX == base) ? "%llX" : "%lld", n);
+  return print(buf);
+}
+
+
+
+/*******************************************************************************
+* HardwareSerial
+*******************************************************************************/
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (_console) {
+    fputc(c, stdout);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+  if (_console) {
+    fwrite(buf, 1, len, stdout);
+  }
+  return len;
+}
+
+int HardwareSerial::available() {
+  return (uint16_t) (_rx_head - _rx_tail);
+}
+
+int HardwareSerial::read() {
+  if (_rx_head == _rx_tail) {
+    return -1;
+  }
+  return _rx[_rx_tail++ % sizeof(_rx)];
+}
+
+void HardwareSerial::simInput(const char* str) {
+  while ((nullptr != str) && (0 != *str) && (available() < (int) sizeof(_rx))) {
+    _rx[_rx_head++ % sizeof(_rx)] = *str++;
+  }
+}
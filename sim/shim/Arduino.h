@@ -0,0 +1,134 @@
+/*
+* Host stand-in for the parts of the Arduino/Teensyduino core that the
+*   firmware uses.
+*
+* Time comes from the virtual clock in SensorSim. millis() and micros() read
+*   it, and delay() and delayMicroseconds() advance it, rather than waiting.
+*   A millis() read also costs a microsecond, so that spin-waits end.
+*   Pins are a table of levels. Serial writes to stdout, and reads from a
+*   buffer that the harness fills.
+*
+* None of this is meant to be cycle-accurate. It is only enough to let the
+*   unmodified firmware compile and run on a Linux box.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#ifndef __SIM_ARDUINO_H_
+#define __SIM_ARDUINO_H_
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define INPUT          0
+#define OUTPUT         1
+#define INPUT_PULLUP   2
+#define LOW            0
+#define HIGH           1
+#define FALLING        2
+#define RISING         3
+#define CHANGE         4
+#define DEC           10
+#define HEX           16
+
+#define BUILTIN_SDCARD        254
+#define SIM_PIN_COUNT          64
+
+#define sq(x)  ((x) * (x))
+using std::abs;
+
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+void     delayMicroseconds(uint32_t us);
+void     yield();
+
+void     pinMode(uint8_t pin, uint8_t mode);
+int      digitalRead(uint8_t pin);
+void     digitalWrite(uint8_t pin, uint8_t val);
+int      analogRead(uint8_t pin);
+void     analogWrite(uint8_t pin, int val);
+void     analogWriteResolution(int bits);
+int      digitalPinToInterrupt(uint8_t pin);
+void     attachInterrupt(int irq, void (*isr)(), int mode);
+void     detachInterrupt(int irq);
+inline void noInterrupts() {};
+inline void interrupts() {};
+
+/* Harness side of the pins. Driving an input can fire its interrupt. */
+void     sim_pin_drive(uint8_t pin, uint8_t level);
+int      sim_pin_output(uint8_t pin);
+void     sim_analog_set(uint8_t pin, int val);
+
+
+class Print {
+  public:
+    virtual ~Print() {};
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len);
+
+    size_t print(const char*);
+    size_t print(char);
+    size_t print(int, int base = DEC);
+    size_t print(unsigned int, int base = DEC);
+    size_t print(long, int base = DEC);
+    size_t print(unsigned long, int base = DEC);
+    size_t print(double, int digits = 2);
+    size_t println();
+    size_t println(const char*);
+    size_t println(char);
+    size_t println(int, int base = DEC);
+    size_t println(unsigned int, int base = DEC);
+    size_t println(long, int base = DEC);
+    size_t println(unsigned long, int base = DEC);
+    size_t println(double, int digits = 2);
+    int    printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+
+  private:
+    size_t _print_int(long long, int base);
+};
+
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+
+class HardwareSerial : public Stream {
+  public:
+    HardwareSerial(bool console) : _console(console) {};
+
+    void   begin(uint32_t) {};
+    void   setRX(uint8_t) {};
+    void   setTX(uint8_t) {};
+    size_t write(uint8_t);
+    size_t write(const uint8_t* buf, size_t len);
+    int    available();
+    int    read();
+    inline operator bool() {   return true;   };
+
+    void   simInput(const char*);   // Queue text as though it were typed.
+
+
+  private:
+    const bool _console;   // Only Serial goes to stdout.
+    char       _rx[512];
+    uint16_t   _rx_head = 0;
+    uint16_t   _rx_tail = 0;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial6;
+
+#endif  // __SIM_ARDUINO_H_
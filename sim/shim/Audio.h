@@ -0,0 +1,53 @@
+/*
+* Host stand-in for the Teensy Audio library. There is no audio on the host.
+*   The objects exist, and take their settings, and do nothing.
+*/
+
+#include <Arduino.h>
+
+#ifndef __SIM_AUDIO_H_
+#define __SIM_AUDIO_H_
+
+#define AudioMemory(n)
+
+class AudioStream {};
+
+class AudioSynthWaveformSine : public AudioStream {
+  public:
+    void amplitude(float) {};
+    void frequency(float) {};
+    void phase(float) {};
+};
+
+class AudioSynthNoisePink : public AudioStream {
+  public:
+    void amplitude(float) {};
+};
+
+class AudioPlayQueue : public AudioStream {};
+class AudioOutputI2S : public AudioStream {};
+
+class AudioMixer4 : public AudioStream {
+  public:
+    void gain(unsigned int, float) {};
+};
+
+class AudioAmplifier : public AudioStream {
+  public:
+    void gain(float) {};
+};
+
+class AudioAnalyzeFFT256 : public AudioStream {
+  public:
+    bool  available() {            return false;   };
+    float read(unsigned int) {     return 0.0f;    };
+    float read(unsigned int, unsigned int) {  return 0.0f;  };
+};
+
+class AudioConnection {
+  public:
+    AudioConnection(AudioStream&, AudioStream&) {};
+    AudioConnection(AudioStream&, unsigned char, AudioStream&, unsigned char) {};
+};
+
+#endif  // __SIM_AUDIO_H_
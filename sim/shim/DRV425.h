@@ -0,0 +1,20 @@
+/*
+* Host stand-in for the DRV425 magnetometer driver. There is no model behind
+*   it, so it is never found.
+*/
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#ifndef __SIM_DRV425_H_
+#define __SIM_DRV425_H_
+
+class DRV425 {
+  public:
+    DRV425(uint8_t adc_irq_pin, uint8_t gpio_irq_pin, uint8_t reset_pin, uint8_t cs_pin) {};
+
+    int8_t init(TwoWire*) {   return -1;   };
+    int8_t poll() {           return 0;    };
+};
+
+#endif  // __SIM_DRV425_H_
@@ -0,0 +1,8 @@
+/*
+* Host stand-in for EEPROM.h. The firmware includes it, but keeps nothing in it
+*   yet.
+*/
+
+#ifndef __SIM_EEPROM_H_
+#define __SIM_EEPROM_H_
+#endif  // __SIM_EEPROM_H_
@@ -0,0 +1,48 @@
+/*
+* Host stand-in for the SparkFun ICM-20948 library. The firmware only builds
+*   its configuration structures. The IMU itself is not brought up.
+*/
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#ifndef __SIM_ICM_20948_H_
+#define __SIM_ICM_20948_H_
+
+typedef enum {
+  gpm2 = 0,
+  gpm4,
+  gpm8,
+  gpm16
+} ICM_20948_ACCEL_CONFIG_FS_SEL_e;
+
+typedef enum {
+  dps250 = 0,
+  dps500,
+  dps1000,
+  dps2000
+} ICM_20948_GYRO_CONFIG_1_FS_SEL_e;
+
+typedef enum {
+  acc_d246bw_n265bw = 0,
+  acc_d473bw_n499bw = 7
+} ICM_20948_ACCEL_CONFIG_DLPCFG_e;
+
+typedef enum {
+  gyr_d196bw6_n229bw8 = 0,
+  gyr_d361bw4_n376bw5 = 7
+} ICM_20948_GYRO_CONFIG_1_DLPCFG_e;
+
+typedef struct {
+  uint8_t a;
+  uint8_t g;
+} ICM_20948_fss_t;
+
+typedef struct {
+  uint8_t a;
+  uint8_t g;
+} ICM_20948_dlpcfg_t;
+
+class ICM_20948_SPI {};
+
+#endif  // __SIM_ICM_20948_H_
@@ -0,0 +1,102 @@
+/*
+* Host stand-in for ParsingConsole. See the header file for the rules.
+*/
+
+#include <string.h>
+#include "ParsingConsole.h"
+
+
+ParsingConsole::ParsingConsole(const uint16_t max_len) : _MAX_LEN(max_len) {}
+
+
+int8_t ParsingConsole::defineCommand(const char* cmd, char shortcut, const TCode*, const char* help, const char*, uint8_t, consoleCallback fxn) {
+  if (_cmd_count >= SIM_CONSOLE_MAX_COMMANDS) {
+    return -1;
+  }
+  _cmds[_cmd_count++] = { cmd, shortcut, help, fxn };
+  return 0;
+}
+
+int8_t ParsingConsole::defineCommand(const char* cmd, const TCode* args, const char* help, const char* param_help, uint8_t req_count, consoleCallback fxn) {
+  return defineCommand(cmd, 0, args, help, param_help, req_count, fxn);
+}
+
+
+/*
+* Returns...
+*   -1 if the character was buffered.
+*   0  if a line came in that named no command.
+*   1  if a callback was called.
+*/
+int8_t ParsingConsole::feed(char c) {
+  if (('\r' == c) || ('\n' == c)) {
+    if (_line.empty()) {
+      return -1;
+    }
+    const int8_t RET = _exec();
+    _line.clear();
+    return RET;
+  }
+  if (_line.length() < _MAX_LEN) {
+    _line += c;
+  }
+  return -1;
+}
+
+
+void ParsingConsole::fetchLog(StringBuilder* output) {
+  if (_log.length() > 0) {
+    output->concat((char*) _log.string());
+    _log.clear();
+  }
+}
+
+
+void ParsingConsole::printHelp(StringBuilder* output, char* cmd) {
+  for (uint8_t i = 0; i < _cmd_count; i++) {
+    if ((nullptr == cmd) || (0 == strcmp(cmd, _cmds[i].name))) {
+      output->concatf("%-12s %s\n", _cmds[i].name, _cmds[i].help);
+    }
+  }
+}
+
+
+void ParsingConsole::printHistory(StringBuilder* output) {
+  for (uint8_t i = 0; i < _hist_count; i++) {
+    output->concatf("%u: %s\n", i, _history[i].c_str());
+  }
+}
+
+
+int8_t ParsingConsole::_exec() {
+  if (_hist_count == SIM_CONSOLE_HISTORY) {
+    for (uint8_t i = 1; i < SIM_CONSOLE_HISTORY; i++) {
+      _history[i - 1] = _history[i];
+    }
+    _hist_count--;
+  }
+  _history[_hist_count++] = _line;
+
+  StringBuilder args(_line.c_str());
+  if (0 == args.split(" \t")) {
+    return 0;
+  }
+  const std::string NAME(args.position(0));
+  StringBuilder rest;
+  for (int i = 1; i < args.count(); i++) {
+    rest.concat(args.position(i));
+  }
+  for (uint8_t i = 0; i < _cmd_count; i++) {
+    const bool MATCH = (NAME == _cmds[i].name) || ((1 == NAME.length()) && (NAME[0] == _cmds[i].shortcut));
+    if (MATCH) {
+      StringBuilder text_return;
+      _cmds[i].fxn(&text_return, &rest);
+      if (text_return.length() > 0) {
+        _log.concat((char*) text_return.string());
+      }
+      return 1;
+    }
+  }
+  _log.concatf("Unknown command: %s\n", NAME.c_str());
+  return 0;
+}
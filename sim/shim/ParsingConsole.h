@@ -0,0 +1,73 @@
+/*
+* Host stand-in for the ParsingConsole in CppPotpourri.
+*
+* Lines are cut into whitespace-separated tokens. The first names the command
+*   (or is its one-character shortcut), and the rest are handed to the
+*   command's callback as the fragments of a StringBuilder. Argument types are
+*   not checked. Callback output is kept until fetchLog() collects it.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include "StringBuilder.h"
+
+#ifndef __SIM_PARSING_CONSOLE_H_
+#define __SIM_PARSING_CONSOLE_H_
+
+#define SIM_CONSOLE_MAX_COMMANDS   64
+#define SIM_CONSOLE_HISTORY         8
+
+enum class TCode : uint8_t {
+  NONE   = 0,
+  STR    = 1,
+  UINT   = 2,
+  INT    = 3,
+  FLOAT  = 4
+};
+
+enum class LineTerm : uint8_t {
+  ZEROBYTE = 0,
+  CR       = 1,
+  LF       = 2,
+  CRLF     = 3
+};
+
+typedef int (*consoleCallback)(StringBuilder* text_return, StringBuilder* args);
+
+class ParsingConsole {
+  public:
+    ParsingConsole(const uint16_t max_len);
+
+    int8_t init() {   return 0;   };
+    int8_t feed(char c);
+    void   fetchLog(StringBuilder* output);
+    void   printHelp(StringBuilder* output, char* cmd = nullptr);
+    void   printHistory(StringBuilder* output);
+    void   setTXTerminator(LineTerm) {};
+    void   setRXTerminator(LineTerm) {};
+    void   localEcho(bool) {};
+
+    int8_t defineCommand(const char* cmd, char shortcut, const TCode* args, const char* help, const char* param_help, uint8_t req_count, consoleCallback);
+    int8_t defineCommand(const char* cmd, const TCode* args, const char* help, const char* param_help, uint8_t req_count, consoleCallback);
+
+
+  private:
+    struct Command {
+      const char*     name;
+      char            shortcut;
+      const char*     help;
+      consoleCallback fxn;
+    };
+
+    const uint16_t _MAX_LEN;
+    Command        _cmds[SIM_CONSOLE_MAX_COMMANDS];
+    uint8_t        _cmd_count = 0;
+    std::string    _line;
+    std::string    _history[SIM_CONSOLE_HISTORY];
+    uint8_t        _hist_count = 0;
+    StringBuilder  _log;
+
+    int8_t _exec();
+};
+
+#endif  // __SIM_PARSING_CONSOLE_H_
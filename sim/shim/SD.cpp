@@ -0,0 +1,190 @@
+/*
+* Host stand-in for the SD library. See the header file for the rules.
+*/
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SD.h"
+
+SDClass SD;
+
+
+/*******************************************************************************
+* SDClass
+*******************************************************************************/
+
+/*
+* The card is present if its directory is, or can be made.
+*/
+bool SDClass::begin(uint8_t) {
+  char root[SIM_SD_PATH_MAX];
+  if (!sdfs.simPath("", root, sizeof(root))) {
+    return false;
+  }
+  mkdir(root, 0755);
+  struct stat st;
+  return ((0 == stat(root, &st)) && S_ISDIR(st.st_mode));
+}
+
+
+
+/*******************************************************************************
+* SdFs
+*******************************************************************************/
+
+FsFile SdFs::open(const char* path, int flags) {
+  FsFile ret;
+  char host_path[SIM_SD_PATH_MAX];
+  if (simPath(path, host_path, sizeof(host_path))) {
+    ret.simOpen(host_path, flags);
+  }
+  return ret;
+}
+
+
+bool SdFs::exists(const char* path) {
+  char host_path[SIM_SD_PATH_MAX];
+  return (simPath(path, host_path, sizeof(host_path)) && (0 == access(host_path, F_OK)));
+}
+
+
+bool SdFs::remove(const char* path) {
+  char host_path[SIM_SD_PATH_MAX];
+  return (simPath(path, host_path, sizeof(host_path)) && (0 == unlink(host_path)));
+}
+
+
+void SdFs::simRoot(const char* host_dir) {
+  snprintf(_root, sizeof(_root), "%s", host_dir);
+}
+
+
+/*
+* Puts the host path for a path on the card into out.
+* Returns false if it doesn't fit, in which case nothing should be opened.
+*/
+bool SdFs::simPath(const char* path, char* out, size_t len) {
+  while ('/' == *path) {
+    path++;
+  }
+  const int ret = snprintf(out, len, "%s/%s", _root, path);
+  return ((ret >= 0) && ((size_t) ret < len));
+}
+
+
+
+/*******************************************************************************
+* FsFile
+*******************************************************************************/
+
+bool FsFile::simOpen(const char* path, int flags) {
+  close();
+  struct stat st;
+  if ((0 == stat(path, &st)) && S_ISDIR(st.st_mode)) {
+    _dir = opendir(path);
+  }
+  else if (flags & O_TRUNC) {
+    _f = fopen(path, "w+b");
+  }
+  else if (flags & (O_WRONLY | O_RDWR)) {
+    _f = fopen(path, "r+b");
+    if ((nullptr == _f) && (flags & O_CREAT)) {
+      _f = fopen(path, "w+b");
+    }
+  }
+  else {
+    _f = fopen(path, "rb");
+  }
+  snprintf(_path, sizeof(_path), "%s", path);
+  return isOpen();
+}
+
+
+size_t FsFile::write(const void* buf, size_t len) {
+  return (nullptr != _f) ? fwrite(buf, 1, len, _f) : 0;
+}
+
+int FsFile::read(void* buf, size_t len) {
+  return (nullptr != _f) ? (int) fread(buf, 1, len, _f) : -1;
+}
+
+bool FsFile::seekSet(uint64_t pos) {
+  return (nullptr != _f) && (0 == fseeko(_f, (off_t) pos, SEEK_SET));
+}
+
+uint64_t FsFile::curPosition() {
+  return (nullptr != _f) ? (uint64_t) ftello(_f) : 0;
+}
+
+uint64_t FsFile::fileSize() {
+  if (nullptr == _f) {
+    return 0;
+  }
+  fflush(_f);
+  struct stat st;
+  return (0 == fstat(fileno(_f), &st)) ? (uint64_t) st.st_size : 0;
+}
+
+bool FsFile::truncate() {
+  return truncate(curPosition());
+}
+
+bool FsFile::truncate(uint64_t len) {
+  if (nullptr == _f) {
+    return false;
+  }
+  fflush(_f);
+  return (0 == ftruncate(fileno(_f), (off_t) len));
+}
+
+bool FsFile::sync() {
+  return (nullptr != _f) && (0 == fflush(_f));
+}
+
+bool FsFile::close() {
+  const bool WAS_OPEN = isOpen();
+  if (nullptr != _f) {
+    fclose(_f);
+    _f = nullptr;
+  }
+  if (nullptr != _dir) {
+    closedir(_dir);
+    _dir = nullptr;
+  }
+  return WAS_OPEN;
+}
+
+
+bool FsFile::getName(char* name, size_t len) {
+  const char* base = strrchr(_path, '/');
+  base = (nullptr == base) ? _path : (base + 1);
+  if (strlen(base) >= len) {
+    return false;
+  }
+  strcpy(name, base);
+  return true;
+}
+
+
+/*
+* Opens the next entry of a directory. Skips the dot entries, as SdFat does,
+*   and any entry whose host path is too long for the shim.
+*/
+bool FsFile::openNext(FsFile* dir, int flags) {
+  close();
+  if ((nullptr == dir) || (nullptr == dir->_dir)) {
+    return false;
+  }
+  struct dirent* ent;
+  while (nullptr != (ent = readdir(dir->_dir))) {
+    if ((0 != strcmp(ent->d_name, ".")) && (0 != strcmp(ent->d_name, ".."))) {
+      char path[SIM_SD_PATH_MAX];
+      const int ret = snprintf(path, sizeof(path), "%s/%s", dir->_path, ent->d_name);
+      if ((ret >= 0) && ((size_t) ret < sizeof(path))) {
+        return simOpen(path, flags);
+      }
+      // The host path would be truncated. Skip the entry.
+    }
+  }
+  return false;
+}
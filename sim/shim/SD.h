@@ -0,0 +1,80 @@
+/*
+* Host stand-in for the Teensy SD library, and the SdFat calls that the
+*   firmware makes on SD.sdfs.
+*
+* The card is a directory on the host (sim_sd, unless the harness picks
+*   another). Files are ordinary files in it. Writes are never busy.
+*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <dirent.h>
+
+#ifndef __SIM_SD_H_
+#define __SIM_SD_H_
+
+#define O_RDONLY    0x00
+#define O_WRONLY    0x01
+#define O_RDWR      0x02
+#define O_CREAT     0x40
+#define O_TRUNC     0x200
+#define O_READ      O_RDONLY
+#define O_WRITE     O_WRONLY
+
+#define SIM_SD_PATH_MAX   256
+
+/* A file or a directory. Copies share the handle, as they do in SdFat. */
+class FsFile {
+  public:
+    bool     preAllocate(uint64_t) {   return isOpen();   };
+    size_t   write(const void* buf, size_t len);
+    int      read(void* buf, size_t len);
+    bool     seekSet(uint64_t pos);
+    uint64_t curPosition();
+    uint64_t fileSize();
+    bool     truncate();
+    bool     truncate(uint64_t len);
+    bool     sync();
+    bool     close();
+    bool     isBusy() {    return false;   };
+    bool     isDir() {     return (nullptr != _dir);   };
+    bool     isOpen() {    return ((nullptr != _f) || (nullptr != _dir));   };
+    bool     getName(char* name, size_t len);
+    bool     openNext(FsFile* dir, int flags = O_RDONLY);
+    inline operator bool() {   return isOpen();   };
+
+    bool     simOpen(const char* path, int flags);
+
+
+  private:
+    FILE* _f   = nullptr;
+    DIR*  _dir = nullptr;
+    char  _path[SIM_SD_PATH_MAX] = "";
+};
+
+
+class SdFs {
+  public:
+    FsFile open(const char* path, int flags = O_RDONLY);
+    bool   exists(const char* path);
+    bool   remove(const char* path);
+
+    void   simRoot(const char* host_dir);
+    bool   simPath(const char* path, char* out, size_t len);
+
+
+  private:
+    char _root[SIM_SD_PATH_MAX] = "sim_sd";
+};
+
+
+class SDClass {
+  public:
+    SdFs sdfs;
+
+    bool begin(uint8_t cs_pin);
+};
+
+extern SDClass SD;
+
+#endif  // __SIM_SD_H_
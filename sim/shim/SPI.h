@@ -0,0 +1,43 @@
+/*
+* Host stand-in for the Teensy SPI library. Bytes go nowhere, but are counted.
+*   There is no DMA here, so nothing on the host takes the asynchronous path.
+*/
+
+#include <Arduino.h>
+
+#ifndef __SIM_SPI_H_
+#define __SIM_SPI_H_
+
+#define MSBFIRST    1
+#define LSBFIRST    0
+#define SPI_MODE0   0x00
+#define SPI_MODE3   0x0C
+
+class SPISettings {
+  public:
+    SPISettings() {};
+    SPISettings(uint32_t, uint8_t, uint8_t) {};
+};
+
+class SPIClass {
+  public:
+    void    begin() {};
+    void    setSCK(uint8_t) {};
+    void    setMISO(uint8_t) {};
+    void    setMOSI(uint8_t) {};
+    void    beginTransaction(SPISettings) {};
+    void    endTransaction() {};
+    inline uint8_t  transfer(uint8_t) {     _bytes++;  return 0xFF;   };
+    inline uint16_t transfer16(uint16_t) {  _bytes += 2;  return 0xFFFF;  };
+    void    transfer(const void* tx, void* rx, size_t len);
+
+    inline uint32_t simBytes() {   return _bytes;   };
+
+
+  private:
+    uint32_t _bytes = 0;
+};
+
+extern SPIClass SPI;
+
+#endif  // __SIM_SPI_H_
@@ -0,0 +1,74 @@
+/*
+* Host stand-in for the SX8634 touch driver. See the header file for the rules.
+*/
+
+#include "SX8634.h"
+
+
+int8_t SX8634::init(TwoWire*) {
+  pinMode(_opts->irq_pin, INPUT_PULLUP);
+  _mode = SX8634OpMode::ACTIVE;
+  return 0;
+}
+
+
+/*
+* Reports whatever the harness changed since the last call.
+* Returns 1 if anything changed, or 0 if not.
+*/
+int8_t SX8634::poll() {
+  int8_t ret = 0;
+  const uint16_t DIFF = _buttons ^ _buttons_reported;
+  for (uint8_t i = 0; i < SX8634_BUTTON_COUNT; i++) {
+    if ((DIFF & (1 << i)) && (nullptr != _button_fxn)) {
+      _button_fxn(i, (_buttons & (1 << i)));
+    }
+  }
+  if (0 != DIFF) {
+    _buttons_reported = _buttons;
+    ret = 1;
+  }
+  if (_slider != _slider_reported) {
+    if (nullptr != _slider_fxn) {
+      _slider_fxn(0, _slider);
+    }
+    _slider_reported = _slider;
+    ret = 1;
+  }
+  sim_pin_drive(_opts->irq_pin, HIGH);   // Serviced. The line lets go.
+  return ret;
+}
+
+
+void SX8634::printDebug(StringBuilder* output) {
+  output->concatf("-- SX8634 (simulated)\n\tMode:    %s\n\tButtons: 0x%03x\n\tSlider:  %d\n",
+    getModeStr(_mode), _buttons, _slider
+  );
+}
+
+
+const char* SX8634::getModeStr(SX8634OpMode m) {
+  switch (m) {
+    case SX8634OpMode::ACTIVE:   return "ACTIVE";
+    case SX8634OpMode::DOZE:     return "DOZE";
+    case SX8634OpMode::SLEEP:    return "SLEEP";
+    case SX8634OpMode::MONITOR:  return "MONITOR";
+    default:                     break;
+  }
+  return "RESERVED";
+}
+
+
+/* The IRQ line is asserted (low) until the next poll(). */
+void SX8634::simButton(uint8_t i, bool pressed) {
+  if (i < SX8634_BUTTON_COUNT) {
+    _buttons = pressed ? (_buttons | (1 << i)) : (_buttons & ~(1 << i));
+    sim_pin_drive(_opts->irq_pin, LOW);
+  }
+}
+
+
+void SX8634::simSlider(int value) {
+  _slider = value;
+  sim_pin_drive(_opts->irq_pin, LOW);
+}
@@ -0,0 +1,73 @@
+/*
+* Host stand-in for the SX8634 touch driver.
+*
+* The harness plays the part of the finger. simButton() and simSlider() change
+*   the touch state, and the registered callbacks are called from the next
+*   poll(), as the real driver does after servicing its IRQ.
+*/
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "StringBuilder.h"
+
+#ifndef __SIM_SX8634_H_
+#define __SIM_SX8634_H_
+
+#define SX8634_DEFAULT_I2C_ADDR   0x2B
+#define SX8634_BUTTON_COUNT         12
+
+enum class SX8634OpMode : uint8_t {
+  ACTIVE   = 0,
+  DOZE     = 1,
+  SLEEP    = 2,
+  MONITOR  = 3,
+  RESERVED = 4
+};
+
+class SX8634Opts {
+  public:
+    const uint8_t i2c_addr;
+    const uint8_t reset_pin;
+    const uint8_t irq_pin;
+
+    SX8634Opts(uint8_t addr, uint8_t rst, uint8_t irq) : i2c_addr(addr), reset_pin(rst), irq_pin(irq) {};
+};
+
+class SX8634 {
+  public:
+    SX8634(const SX8634Opts* o) : _opts(o) {};
+
+    int8_t init(TwoWire*);
+    int8_t reset() {   return 0;   };
+    int8_t poll();
+    int8_t setMode(SX8634OpMode m) {           _mode = m;   return 0;   };
+    inline SX8634OpMode operationalMode() {    return _mode;      };
+    inline bool     deviceFound() {            return true;       };
+    inline bool     buttonPressed(uint8_t i) { return (i < SX8634_BUTTON_COUNT) && (_buttons & (1 << i));  };
+    inline uint16_t buttonStates() {           return _buttons;   };
+    inline int      sliderValue() {            return _slider;    };
+    int8_t setLongpress(int, int) {            return 0;          };
+    void   setButtonFxn(void (*fxn)(int, bool)) {        _button_fxn = fxn;     };
+    void   setSliderFxn(void (*fxn)(int, int)) {         _slider_fxn = fxn;     };
+    void   setLongpressFxn(void (*fxn)(int, uint32_t)) { _longpress_fxn = fxn;  };
+    void   printDebug(StringBuilder*);
+    static const char* getModeStr(SX8634OpMode);
+
+    /* Harness side. */
+    void   simButton(uint8_t i, bool pressed);
+    void   simSlider(int value);
+
+
+  private:
+    const SX8634Opts* _opts;
+    SX8634OpMode _mode       = SX8634OpMode::SLEEP;
+    uint16_t     _buttons    = 0;
+    uint16_t     _buttons_reported = 0;
+    int          _slider     = 0;
+    int          _slider_reported  = 0;
+    void (*_button_fxn)(int, bool)        = nullptr;
+    void (*_slider_fxn)(int, int)         = nullptr;
+    void (*_longpress_fxn)(int, uint32_t) = nullptr;
+};
+
+#endif  // __SIM_SX8634_H_
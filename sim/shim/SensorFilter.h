@@ -0,0 +1,73 @@
+/*
+* Host stand-in for the SensorFilter in CppPotpourri. Only the RAW strategy is
+*   modeled, which is the only one the firmware uses: value() is the last
+*   sample, and the window is a ring in memPtr(), written at lastIndex().
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#ifndef __SIM_SENSOR_FILTER_H_
+#define __SIM_SENSOR_FILTER_H_
+
+enum class FilteringStrategy : uint8_t {
+  RAW        = 0,
+  MOVING_AVG = 1
+};
+
+template <typename T> class SensorFilter {
+  public:
+    SensorFilter(FilteringStrategy s, int window, int) : _strat(s), _window((uint16_t) window) {};
+    ~SensorFilter() {
+      if (nullptr != _mem) {
+        delete[] _mem;
+      }
+    };
+
+    int8_t init() {
+      if (nullptr != _mem) {
+        delete[] _mem;
+      }
+      _mem   = (_window > 0) ? new T[_window]() : nullptr;
+      _idx   = 0;
+      _value = T(0);
+      _dirty = false;
+      return ((_window == 0) || (nullptr != _mem)) ? 0 : -1;
+    };
+
+    int8_t feedFilter(T v) {
+      if (nullptr == _mem) {
+        return -1;
+      }
+      _mem[_idx++] = v;
+      if (_idx >= _window) {
+        _idx = 0;
+      }
+      _value = v;
+      _dirty = true;
+      return 1;
+    };
+
+    inline T value() {                _dirty = false;  return _value;   };
+    inline bool dirty() {             return _dirty;                    };
+    inline bool initialized() {       return (nullptr != _mem);         };
+    inline uint16_t windowSize() {    return _window;                   };
+    inline uint16_t lastIndex() {     return _idx;                      };
+    inline T* memPtr() {              return _mem;                      };
+    inline FilteringStrategy strategy() {  return _strat;               };
+    int8_t windowSize(uint16_t n) {
+      _window = n;
+      return init();
+    };
+
+
+  private:
+    FilteringStrategy _strat;
+    uint16_t _window;
+    uint16_t _idx   = 0;
+    T*       _mem   = nullptr;
+    T        _value = T(0);
+    bool     _dirty = false;
+};
+
+#endif  // __SIM_SENSOR_FILTER_H_
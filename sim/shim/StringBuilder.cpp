@@ -0,0 +1,110 @@
+/*
+* Host stand-in for StringBuilder. See the header file for the rules.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "StringBuilder.h"
+
+
+StringBuilder::StringBuilder(const char* s) {
+  concat(s);
+}
+
+void StringBuilder::concat(const char* s) {
+  if ((nullptr != s) && (0 != *s)) {
+    _frags.push_back(s);
+  }
+}
+
+void StringBuilder::concat(char c) {
+  _frags.push_back(std::string(1, c));
+}
+
+void StringBuilder::concat(int n) {           concatf("%d", n);   }
+void StringBuilder::concat(unsigned int n) {  concatf("%u", n);   }
+void StringBuilder::concat(double n) {        concatf("%f", n);   }
+
+void StringBuilder::concatf(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  const int LEN = vsnprintf(nullptr, 0, fmt, ap);
+  va_end(ap);
+  if (LEN > 0) {
+    std::string s(LEN, '\0');
+    va_start(ap, fmt);
+    vsnprintf(&s[0], LEN + 1, fmt, ap);
+    va_end(ap);
+    _frags.push_back(s);
+  }
+}
+
+int StringBuilder::length() {
+  int ret = 0;
+  for (const std::string& f : _frags) {
+    ret += f.length();
+  }
+  return ret;
+}
+
+/* Collapses the fragments into one. */
+uint8_t* StringBuilder::string() {
+  if (_frags.size() != 1) {
+    std::string all;
+    for (const std::string& f : _frags) {
+      all += f;
+    }
+    _frags.clear();
+    _frags.push_back(all);
+  }
+  return (uint8_t*) _frags[0].c_str();
+}
+
+void StringBuilder::clear() {
+  _frags.clear();
+}
+
+int StringBuilder::count() {
+  return (int) _frags.size();
+}
+
+char* StringBuilder::position(int i) {
+  return ((i >= 0) && (i < count())) ? (char*) _frags[i].c_str() : nullptr;
+}
+
+char* StringBuilder::position_trimmed(int i) {
+  const char* s = position(i);
+  if (nullptr == s) {
+    return nullptr;
+  }
+  _scratch = s;
+  const size_t A = _scratch.find_first_not_of(" \t\r\n");
+  const size_t B = _scratch.find_last_not_of(" \t\r\n");
+  _scratch = (std::string::npos == A) ? std::string() : _scratch.substr(A, (B - A) + 1);
+  return (char*) _scratch.c_str();
+}
+
+int StringBuilder::position_as_int(int i) {
+  const char* s = position(i);
+  return (nullptr != s) ? (int) strtol(s, nullptr, 0) : 0;
+}
+
+double StringBuilder::position_as_double(int i) {
+  const char* s = position(i);
+  return (nullptr != s) ? strtod(s, nullptr) : 0.0;
+}
+
+/* Re-cuts the whole string into tokens. Returns how many there are. */
+int StringBuilder::split(const char* delims) {
+  const std::string ALL((const char*) string());
+  _frags.clear();
+  size_t start = ALL.find_first_not_of(delims);
+  while (std::string::npos != start) {
+    const size_t END = ALL.find_first_of(delims, start);
+    _frags.push_back(ALL.substr(start, (std::string::npos == END) ? std::string::npos : (END - start)));
+    start = (std::string::npos == END) ? END : ALL.find_first_not_of(delims, END);
+  }
+  return count();
+}
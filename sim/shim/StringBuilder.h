@@ -0,0 +1,45 @@
+/*
+* Host stand-in for the StringBuilder in CppPotpourri.
+*
+* As in the real one, the string is a list of fragments. concat() adds one,
+*   string() collapses them, and the position_*() calls read them one at a
+*   time, which is how the console hands a command its arguments.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef __SIM_STRING_BUILDER_H_
+#define __SIM_STRING_BUILDER_H_
+
+class StringBuilder {
+  public:
+    StringBuilder() {};
+    StringBuilder(const char*);
+
+    void     concat(const char*);
+    void     concat(char);
+    void     concat(int);
+    void     concat(unsigned int);
+    void     concat(double);
+    void     concatf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    int      length();
+    uint8_t* string();
+    void     clear();
+
+    int      count();
+    char*    position(int);
+    char*    position_trimmed(int);
+    int      position_as_int(int);
+    double   position_as_double(int);
+    int      split(const char* delims);
+
+
+  private:
+    std::vector<std::string> _frags;
+    std::string              _scratch;
+};
+
+#endif  // __SIM_STRING_BUILDER_H_
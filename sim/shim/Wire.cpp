@@ -0,0 +1,105 @@
+/*
+* Host stand-in for the Teensy Wire library. See the header file for the rules.
+*/
+
+#include "Wire.h"
+#include "SensorSim.h"
+
+TwoWire Wire;
+TwoWire Wire1;
+
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  _tx_addr = addr;
+  _tx_len  = 0;
+}
+
+
+/*
+* Returns 0 on success, or 2 if no device answered its address, as Wire does.
+*/
+uint8_t TwoWire::endTransmission(bool) {
+  _charge(_tx_len);
+  I2CSimDevice* dev = _find(_tx_addr);
+  if (nullptr == dev) {
+    return 2;
+  }
+  if (_tx_len > 0) {
+    dev->pointer = _tx[0];
+    if (_tx_len > 1) {
+      dev->writeRegs(_tx[0], &_tx[1], _tx_len - 1);
+    }
+  }
+  return 0;
+}
+
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len, uint8_t) {
+  _rx_len = 0;
+  _rx_idx = 0;
+  if (len > BUFFER_LENGTH) {
+    len = BUFFER_LENGTH;
+  }
+  _charge(len);
+  I2CSimDevice* dev = _find(addr);
+  if (nullptr != dev) {
+    const int32_t RET = dev->readRegs(dev->pointer, _rx, len);
+    _rx_len = (RET > 0) ? (uint8_t) RET : 0;
+  }
+  return _rx_len;
+}
+
+
+size_t TwoWire::write(uint8_t c) {
+  if (_tx_len < BUFFER_LENGTH) {
+    _tx[_tx_len++] = c;
+    return 1;
+  }
+  return 0;
+}
+
+size_t TwoWire::write(const uint8_t* buf, size_t len) {
+  size_t n = 0;
+  while ((n < len) && (1 == write(buf[n]))) {
+    n++;
+  }
+  return n;
+}
+
+int TwoWire::available() {   return _rx_len - _rx_idx;   }
+
+int TwoWire::read() {
+  return (_rx_idx < _rx_len) ? _rx[_rx_idx++] : -1;
+}
+
+
+int8_t TwoWire::simAttach(I2CSimDevice* dev) {
+  for (uint8_t i = 0; i < SIM_WIRE_MAX_DEVICES; i++) {
+    if (nullptr == _devs[i]) {
+      _devs[i] = dev;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+
+I2CSimDevice* TwoWire::_find(uint8_t addr) {
+  for (uint8_t i = 0; i < SIM_WIRE_MAX_DEVICES; i++) {
+    if ((nullptr != _devs[i]) && (addr == _devs[i]->ADDR)) {
+      return _devs[i];
+    }
+  }
+  return nullptr;
+}
+
+
+/*
+* The address byte, the payload, and about a byte-time for start and stop, at
+*   nine clocks per byte.
+*/
+void TwoWire::_charge(uint16_t bytes) {
+  const uint32_t US = ((uint32_t) (bytes + 2) * 9 * 1000000) / _hz;
+  _wire_us += US;
+  sim_clock_advance(US);
+}
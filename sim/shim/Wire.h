@@ -0,0 +1,66 @@
+/*
+* Host stand-in for the Teensy Wire library.
+*
+* Each TwoWire is a bus with I2CSimDevice models attached to it. Traffic is
+*   handed to the model at the addressed slave, in the same way that I2CSimBus
+*   does it: the first byte written is the register address, anything after it
+*   is written from there, and a read starts from wherever the last
+*   transaction left the device's pointer. Each transaction advances the
+*   virtual clock by its time on the wire.
+*/
+
+#include <Arduino.h>
+
+#ifndef __SIM_WIRE_H_
+#define __SIM_WIRE_H_
+
+#define BUFFER_LENGTH           136
+#define SIM_WIRE_MAX_DEVICES      8
+
+class I2CSimDevice;
+
+class TwoWire : public Stream {
+  public:
+    TwoWire() {};
+
+    void    begin() {};
+    void    setSDA(uint8_t) {};
+    void    setSCL(uint8_t) {};
+    inline void setClock(uint32_t hz) {   _hz = hz;   };
+    inline uint32_t clock() {             return _hz;   };
+
+    void    beginTransmission(uint8_t addr);
+    inline void beginTransmission(int addr) {   beginTransmission((uint8_t) addr);   };
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t addr, uint8_t len, uint8_t stop = 1);
+    inline uint8_t requestFrom(int addr, int len) {   return requestFrom((uint8_t) addr, (uint8_t) len);  };
+
+    size_t  write(uint8_t);
+    size_t  write(const uint8_t* buf, size_t len);
+    int     available();
+    int     read();
+
+    /* Harness side. */
+    int8_t   simAttach(I2CSimDevice*);
+    inline uint32_t simWireTimeUs() {  return _wire_us;   };
+
+
+  private:
+    I2CSimDevice* _devs[SIM_WIRE_MAX_DEVICES] = { nullptr };
+    uint32_t      _hz      = 100000;   // As Wire.begin() leaves it.
+    uint32_t      _wire_us = 0;
+    uint8_t       _tx_addr = 0;
+    uint8_t       _tx_len  = 0;
+    uint8_t       _rx_len  = 0;
+    uint8_t       _rx_idx  = 0;
+    uint8_t       _tx[BUFFER_LENGTH];
+    uint8_t       _rx[BUFFER_LENGTH];
+
+    I2CSimDevice* _find(uint8_t addr);
+    void          _charge(uint16_t bytes);
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif  // __SIM_WIRE_H_
@@ -0,0 +1,148 @@
+/*
+* Runs the firmware on the host, against modeled sensors and a virtual clock.
+*
+* The sensor models are attached to the stand-in Wire buses where the parts
+*   are wired on the board. Then setup() is called once, and loop() until the
+*   virtual clock reaches the end of the run. The clock only moves when the
+*   firmware spends time on a bus, sleeps, or delays, plus a fixed charge per
+*   pass through loop(). So a run goes as fast as the host can execute the
+*   firmware, which is usually many times real time.
+*
+* Usage: motherflux0r-sim [options]
+*   -t <sec>     Virtual seconds to run for. Default 10.
+*   -c <cmd>     Console command to give once setup() is done. May be repeated.
+*   -e <cmd>     Console command to give at the end of the run. May be repeated.
+*   -l <us>      Virtual time charged per pass through loop(). Default 2.
+*   -s <dir>     Host directory to use as the SD card. Default sim_sd.
+*   -p <file>    Write what the display shows at the end, as a PPM.
+*   -q           Don't print the run summary.
+*/
+
+#include <unistd.h>
+#include <chrono>
+#include <Arduino.h>
+#include <Wire.h>
+#include <SD.h>
+#include <Adafruit_SSD1331.h>
+#include "SensorSim.h"
+
+#define SIM_MAX_COMMANDS   16
+
+/* The sketch's entry points, and the panel it draws on. */
+void setup();
+void loop();
+extern Adafruit_SSD1331 panel;
+
+/* The parts on Wire1, as wired on the board. The TMP102 is on Wire. */
+static SimGridEYE  model_grideye;
+static SimBME280   model_baro;
+static SimVEML6075 model_uv;
+static SimTSL2561  model_tsl2561;
+static SimTMP102   model_tmp102;
+
+
+/*
+* Runs loop() until the console has taken everything in the Serial buffer, and
+*   there is nothing left to print, or a limit is hit.
+*/
+static uint32_t drain_console(uint32_t loop_cost_us) {
+  uint32_t passes = 0;
+  do {
+    loop();
+    sim_clock_advance(loop_cost_us);
+    passes++;
+  } while ((Serial.available() > 0) && (passes < 100000));
+  loop();   // One more, for the output.
+  return passes + 1;
+}
+
+
+static void give_commands(const char* const* cmds, uint8_t count) {
+  for (uint8_t i = 0; i < count; i++) {
+    Serial.simInput(cmds[i]);
+    Serial.simInput("\r");
+  }
+}
+
+
+int main(int argc, char** argv) {
+  float       run_secs     = 10.0f;
+  uint32_t    loop_cost_us = 2;
+  const char* ppm_path     = nullptr;
+  bool        quiet        = false;
+  const char* start_cmds[SIM_MAX_COMMANDS];
+  const char* end_cmds[SIM_MAX_COMMANDS];
+  uint8_t     start_count  = 0;
+  uint8_t     end_count    = 0;
+
+  int opt;
+  while (-1 != (opt = getopt(argc, argv, "t:c:e:l:s:p:q"))) {
+    switch (opt) {
+      case 't':  run_secs     = strtof(optarg, nullptr);          break;
+      case 'l':  loop_cost_us = strtoul(optarg, nullptr, 0);      break;
+      case 's':  SD.sdfs.simRoot(optarg);                         break;
+      case 'p':  ppm_path     = optarg;                           break;
+      case 'q':  quiet        = true;                             break;
+      case 'c':
+        if (start_count < SIM_MAX_COMMANDS) start_cmds[start_count++] = optarg;
+        break;
+      case 'e':
+        if (end_count < SIM_MAX_COMMANDS) end_cmds[end_count++] = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-t sec] [-c cmd]... [-e cmd]... [-l us] [-s dir] [-p out.ppm] [-q]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  Wire1.simAttach(&model_grideye);
+  Wire1.simAttach(&model_baro);
+  Wire1.simAttach(&model_uv);
+  Wire1.simAttach(&model_tsl2561);
+  Wire.simAttach(&model_tmp102);
+
+  const auto WALL_T0 = std::chrono::steady_clock::now();
+  sim_clock_set(0);
+  setup();
+  uint64_t passes = 0;
+  if (start_count > 0) {
+    give_commands(start_cmds, start_count);
+    passes += drain_console(loop_cost_us);
+  }
+
+  const uint64_t RUN_US = (uint64_t) (run_secs * 1000000.0f);
+  uint64_t elapsed_us   = 0;
+  uint32_t last_us      = sim_micros();
+  while (elapsed_us < RUN_US) {
+    loop();
+    sim_clock_advance(loop_cost_us);
+    passes++;
+    const uint32_t NOW = sim_micros();
+    elapsed_us += (uint32_t) (NOW - last_us);   // Survives the 32-bit wrap.
+    last_us = NOW;
+  }
+
+  if (end_count > 0) {
+    give_commands(end_cmds, end_count);
+    passes += drain_console(loop_cost_us);
+  }
+  fflush(stdout);
+
+  const double WALL_S = std::chrono::duration<double>(std::chrono::steady_clock::now() - WALL_T0).count();
+  if (nullptr != ppm_path) {
+    if (0 != panel.simWritePPM(ppm_path)) {
+      fprintf(stderr, "Couldn't write %s\n", ppm_path);
+    }
+  }
+  if (!quiet) {
+    fprintf(stderr,
+      "\n-- Simulated %.3fs in %.3fs of host time (%.1fx real time).\n"
+      "\t%llu passes through loop(), %.2f us of host time each.\n"
+      "\tWire: %uus, Wire1: %uus on the wire. Display: %u bytes in %u windows.\n",
+      (double) elapsed_us / 1000000.0, WALL_S, ((double) elapsed_us / 1000000.0) / WALL_S,
+      (unsigned long long) passes, (WALL_S * 1000000.0) / (double) passes,
+      Wire.simWireTimeUs(), Wire1.simWireTimeUs(), panel.simBytes(), panel.simWindows()
+    );
+  }
+  return 0;
+}
@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# A GridEYE frame should be read in one 128-byte transaction, even though the
+#   Wire driver caps everyone else's chunks well below that.
+#
+# Usage: grideye_frame_burst.sh <path to motherflux0r-sim>
+
+SIM="$1"
+OUT=$("$SIM" -q -t 3 -e grideye) || exit 1
+
+FRAMES=$(echo "$OUT" | awk '/Frames:/ && /ok,/ { print $2; exit }')
+XFERS=$(echo "$OUT"  | awk '/Last read:/ { print $3; exit }')
+
+if [ -z "$FRAMES" ] || [ -z "$XFERS" ]; then
+  echo "FAIL: couldn't find the frame stats in the console output."
+  exit 1
+fi
+if [ "$FRAMES" -eq 0 ] || [ "$XFERS" -ne 1 ]; then
+  echo "FAIL: $FRAMES GridEYE frames, the last in $XFERS transactions."
+  exit 1
+fi
+echo "PASS: $FRAMES GridEYE frames, the last in $XFERS transaction."
@@ -0,0 +1,101 @@
+/*
+* LogReplay timing, driven by an injected clock.
+*
+* A recording with uneven spacing is written to RAM, then played back at a
+*   few speeds. Records must come out in order, none before it is due, and
+*   each stamped with its recorded time moved to the start of the replay, no
+*   matter the speed, the lag, or the wrap of micros().
+*/
+
+#include <stdio.h>
+#include "SampleLogger.h"
+#include "LogReader.h"
+#include "LogReplay.h"
+
+#define TEST_SECTORS   32
+#define TEST_RECORDS   200
+#define TEST_T0_MS     7000
+
+static uint32_t fake_ms = 0;
+static uint32_t clock_ms() {   return fake_ms;          }
+static uint32_t clock_us() {   return fake_ms * 1000;   }
+
+static uint8_t      mem[TEST_SECTORS * LOG_SECTOR_BYTES];
+static LogMemSink   sink(mem, TEST_SECTORS);
+static SampleLogger logger(&sink, clock_ms, clock_us);
+static uint32_t     rec_t[TEST_RECORDS];
+
+static int fails = 0;
+
+#define CHECK(cond, ...) \
+  if (!(cond)) {  printf("FAIL %s:%d: ", __func__, __LINE__);  printf(__VA_ARGS__);  printf("\n");  fails++;  }
+
+
+/* Records every 10 to 250ms, alternating between two sensors. */
+static void write_recording() {
+  uint32_t t = TEST_T0_MS;
+  logger.start("test", TEST_SECTORS);
+  for (uint32_t i = 0; i < TEST_RECORDS; i++) {
+    const float VAL = (float) i;
+    rec_t[i] = t;
+    fake_ms  = t;
+    logger.logFloats(1 + (i & 1), t, &VAL, 1);
+    logger.service();
+    t += 10 + ((i * 37) % 241);
+  }
+  logger.stop();
+}
+
+
+/*
+* Plays the whole recording, stepping the clock by step_ms between polls.
+*/
+static void play(uint16_t speed, uint32_t wall0_ms, uint32_t step_ms) {
+  LogMemSource src(mem, sink.sectors());
+  LogReader    reader(&src);
+  LogReplay    replay(&reader, clock_ms);
+  CHECK(0 == reader.open(), "open");
+  fake_ms = wall0_ms;
+  CHECK(0 == replay.start(speed), "start(%u)", speed);
+
+  const uint32_t WALL0_US = wall0_ms * 1000;
+  uint32_t n = 0;
+  LogRecord rec;
+  for (uint32_t polls = 0; polls < 1000000; polls++) {
+    const int8_t RET = replay.poll(&rec);
+    if (-1 == RET) {
+      break;
+    }
+    if (1 == RET) {
+      const uint32_t OFFSET_MS = rec_t[n] - TEST_T0_MS;
+      CHECK(rec.t_ms == rec_t[n], "speed %u: record %u is t=%u, not %u", speed, n, rec.t_ms, rec_t[n]);
+      CHECK((float) n == rec.getFloat(0), "speed %u: record %u out of order", speed, n);
+      if (REPLAY_FREE_RUN != speed) {
+        const int32_t EARLY = (int32_t) ((wall0_ms + (OFFSET_MS / speed)) - fake_ms);
+        CHECK(EARLY <= 0, "speed %u: record %u handed out %dms early", speed, n, EARLY);
+      }
+      const uint32_t STAMP = replay.sampleTimeUs(&rec);
+      CHECK(STAMP == (uint32_t) (WALL0_US + (OFFSET_MS * 1000)),
+        "speed %u: record %u stamped %+dus from the start, not %+dus",
+        speed, n, (int32_t) (STAMP - WALL0_US), OFFSET_MS * 1000
+      );
+      n++;
+      continue;   // Drain everything that is due before the clock moves.
+    }
+    fake_ms += step_ms;
+  }
+  CHECK(TEST_RECORDS == n, "speed %u: %u of %u records", speed, n, TEST_RECORDS);
+  CHECK(!replay.running(), "speed %u: still running", speed);
+}
+
+
+int main() {
+  write_recording();
+  play(1, 100, 1);
+  play(20, 100, 1);
+  play(20, 100, 333);           // Polled late. Lag, but the same stamps.
+  play(REPLAY_FREE_RUN, 100, 0);
+  play(4, 4294967000, 3);       // micros() wraps partway through.
+  printf("%s\n", (0 == fails) ? "PASS" : "FAIL");
+  return (0 == fails) ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Records a few seconds from the modeled sensors, then replays the file
+#   through the whole sketch, free-running. Every record logged must be
+#   published again, and the replay must reach the end of the recording.
+#
+# Usage: replay_recording.sh <path to motherflux0r-sim>
+
+SIM="$1"
+SD_DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$SD_DIR"' EXIT
+
+LOGGED=$("$SIM" -q -t 3 -s "$SD_DIR" -c "log 1" -e "log 0" -e "log" | awk '$1 == "Records:" { print $2; exit }')
+OUT=$("$SIM" -q -t 1 -s "$SD_DIR" -c "replay 1 0 0" -e "replay")
+REPLAYED=$(echo "$OUT" | awk '$1 == "Records:" { print $2; exit }')
+POSITION=$(echo "$OUT" | awk '$1 == "Position:" { print $2, $5; exit }')
+
+if [ -z "$LOGGED" ] || [ "$LOGGED" -eq 0 ]; then
+  echo "FAIL: nothing was logged."
+  exit 1
+fi
+if [ "$LOGGED" != "$REPLAYED" ]; then
+  echo "FAIL: $LOGGED records logged, $REPLAYED replayed."
+  exit 1
+fi
+set -- $POSITION
+if [ "$1" != "$2" ]; then
+  echo "FAIL: replay stopped at $1 ms of $2."
+  exit 1
+fi
+echo "PASS: $LOGGED records logged and replayed, $2 ms of recording."
@@ -0,0 +1,93 @@
+/*
+* SampleLogger::stop() with the RAM ring full.
+*
+* The card is held busy while records are logged, until the ring has no free
+*   sector left and records start to drop. Then the card is let go and the
+*   logger is stopped. Every record that log() took must read back, and no
+*   chunk may fail its CRC.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "SampleLogger.h"
+#include "LogReader.h"
+
+#define TEST_SECTORS   64
+#define TEST_PAYLOAD   100
+
+/* A RAM sink whose card can be held busy. */
+class HeldMemSink : public LogMemSink {
+  public:
+    HeldMemSink(uint8_t* mem, uint32_t sectors) : LogMemSink(mem, sectors) {};
+    bool busy() {   return held;   };
+    bool held = false;
+};
+
+static uint32_t fake_ms = 0;
+static uint32_t clock_ms() {   return fake_ms;          }
+static uint32_t clock_us() {   return fake_ms * 1000;   }
+
+static uint8_t     mem[TEST_SECTORS * LOG_SECTOR_BYTES];
+static HeldMemSink sink(mem, TEST_SECTORS);
+static SampleLogger logger(&sink, clock_ms, clock_us);
+
+
+int main() {
+  int fails = 0;
+  uint8_t payload[TEST_PAYLOAD];
+  uint32_t taken = 0;
+
+  if (0 != logger.start("test", TEST_SECTORS)) {
+    printf("FAIL: start()\n");
+    return 1;
+  }
+  sink.held = true;
+  for (uint32_t i = 0; i < 1000; i++) {
+    memset(payload, (uint8_t) i, sizeof(payload));
+    fake_ms = i;
+    if (0 != logger.log(1, i, payload, sizeof(payload))) {
+      break;
+    }
+    logger.service();
+    taken++;
+  }
+  printf("Backlog %u of %u sectors, %u records taken.\n", logger.backlog(), LOG_BUFFER_SECTORS, taken);
+  if (logger.backlog() != (LOG_BUFFER_SECTORS - 1)) {
+    printf("FAIL: the ring didn't fill.\n");
+    fails++;
+  }
+
+  sink.held = false;
+  if (0 != logger.stop()) {
+    printf("FAIL: stop() didn't close cleanly.\n");
+    fails++;
+  }
+
+  LogMemSource src(mem, sink.sectors());
+  LogReader reader(&src);
+  if (0 != reader.open()) {
+    printf("FAIL: couldn't open what was written.\n");
+    return 1;
+  }
+  LogRecord rec;
+  uint32_t read_back = 0;
+  while (1 == reader.next(&rec)) {
+    if ((rec.t_ms != read_back) || (rec.len != TEST_PAYLOAD) || (rec.payload[0] != (uint8_t) read_back)) {
+      printf("FAIL: record %u came back as t=%u len=%u.\n", read_back, rec.t_ms, rec.len);
+      fails++;
+      break;
+    }
+    read_back++;
+  }
+  printf("%u of %u records read back, %u bad chunks.\n", read_back, taken, reader.badChunks());
+  if ((read_back != taken) || (0 != reader.badChunks())) {
+    fails++;
+  }
+  if (reader.records() != taken) {
+    printf("FAIL: the trailer counts %u records.\n", reader.records());
+    fails++;
+  }
+
+  printf("%s\n", (0 == fails) ? "PASS" : "FAIL");
+  return (0 == fails) ? 0 : 1;
+}
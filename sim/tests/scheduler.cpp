@@ -0,0 +1,175 @@
+/*
+* CoopScheduler, driven by an injected clock.
+*
+* Checks that tasks run in deadline order (priority breaking ties), that
+*   lateness is accounted as jitter and whole missed periods as overruns,
+*   and that none of it cares about the 32-bit wrap of micros().
+*/
+
+#include <stdio.h>
+#include <utility>
+#include "Scheduler.h"
+
+#define TEST_TASKS   COOP_SCHEDULER_MAX_TASKS
+
+static uint32_t fake_us = 0;
+static uint32_t clock_us() {   return fake_us;   }
+
+/* Each task notes its number in the run order, and may take some time. */
+static uint8_t  run_order[256];
+static uint16_t run_count = 0;
+static uint32_t run_cost  = 0;
+
+template <uint8_t I> static void task_fxn() {
+  run_order[run_count++ & 0xFF] = I;
+  fake_us += run_cost;
+}
+
+template <size_t... I> static CoopTaskFxn* fxn_table(std::index_sequence<I...>) {
+  static CoopTaskFxn table[] = { task_fxn<I>... };
+  return table;
+}
+static CoopTaskFxn* const FXNS = fxn_table(std::make_index_sequence<TEST_TASKS>{});
+
+static int fails = 0;
+
+#define CHECK(cond, ...) \
+  if (!(cond)) {  printf("FAIL %s:%d: ", __func__, __LINE__);  printf(__VA_ARGS__);  printf("\n");  fails++;  }
+
+
+/* Reset the run log, and set the clock. */
+static void begin(uint32_t now) {
+  fake_us   = now;
+  run_count = 0;
+  run_cost  = 0;
+}
+
+
+/*
+* One-shots at scattered deadlines (some equal, at different priorities), with
+*   a few moved after they were queued. They must come out in deadline order,
+*   then by priority.
+*/
+static void test_heap_order(uint32_t t0) {
+  begin(t0);
+  CoopScheduler sched(clock_us);
+  CoopTask* tasks[TEST_TASKS];
+  uint32_t  lcg = 12345;
+  for (uint8_t i = 0; i < TEST_TASKS; i++) {
+    lcg = (lcg * 1103515245) + 12345;
+    const uint32_t DELAY = (1 + ((lcg >> 8) % 8)) * 100;   // Plenty of ties.
+    tasks[i] = new CoopTask("t", FXNS[i], 0, (uint8_t) (lcg >> 24));
+    CHECK(0 == sched.fireIn(tasks[i], DELAY), "fireIn(%u)", i);
+  }
+  CoopTask extra("extra", FXNS[0], 0);
+  CHECK(-2 == sched.fireIn(&extra, 0), "the heap took more than it holds");
+  sched.fireIn(tasks[3], 50);     // Earlier, while queued.
+  sched.fireIn(tasks[7], 900);    // Later.
+  sched.removeTask(tasks[11]);
+
+  fake_us += 1000;
+  const int8_t RAN = sched.serviceTasks();
+  CHECK(RAN == (TEST_TASKS - 1), "%d ran", RAN);
+  CHECK(0 == sched.taskCount(), "%u one-shots still queued", sched.taskCount());
+  for (uint8_t n = 1; n < run_count; n++) {
+    CoopTask* a = tasks[run_order[n - 1]];
+    CoopTask* b = tasks[run_order[n]];
+    const int32_t DIFF = (int32_t) (b->deadline() - a->deadline());
+    CHECK((DIFF > 0) || ((0 == DIFF) && (a->priority() >= b->priority())),
+      "task %u (deadline %+d, pri %u) ran before task %u (deadline %+d, pri %u)",
+      run_order[n - 1], (int32_t) (a->deadline() - t0), a->priority(),
+      run_order[n], (int32_t) (b->deadline() - t0), b->priority()
+    );
+  }
+  CHECK(3 == run_order[0], "the task moved earlier ran %s", "late");
+  CHECK(7 == run_order[run_count - 1], "the task moved later ran %s", "early");
+  for (uint8_t n = 0; n < run_count; n++) {
+    CHECK(11 != run_order[n], "a removed task ran");
+  }
+  for (uint8_t i = 0; i < TEST_TASKS; i++) {
+    delete tasks[i];
+  }
+}
+
+
+/*
+* A periodic task, run on time, late, and very late. Lateness is jitter. Each
+*   whole period missed is an overrun, and the next deadline stays on the
+*   task's own grid.
+*/
+static void test_jitter_and_overruns(uint32_t t0) {
+  begin(t0);
+  CoopScheduler sched(clock_us);
+  CoopTask task("periodic", FXNS[0], 1000);
+  sched.addTask(&task);
+  CHECK(1000 == sched.usUntilNextDeadline(), "%u us to the first deadline", sched.usUntilNextDeadline());
+
+  fake_us = t0 + 999;
+  CHECK(0 == sched.serviceTasks(), "ran early");
+  fake_us = t0 + 1000;
+  run_cost = 40;
+  CHECK(1 == sched.serviceTasks(), "didn't run on time");
+  CHECK(0 == task.jitterMax(), "jitter %u on time", task.jitterMax());
+  CHECK(40 == task.execMax(), "exec %u, not 40", task.execMax());
+  CHECK((uint32_t) (t0 + 2000) == task.deadline(), "next deadline %+d", (int32_t) (task.deadline() - t0));
+
+  fake_us = t0 + 2300;
+  run_cost = 10;
+  CHECK(1 == sched.serviceTasks(), "didn't run late");
+  CHECK(300 == task.jitterMax(), "jitter max %u, not 300", task.jitterMax());
+  CHECK(0 == task.overruns(), "%u overruns for 300us late", task.overruns());
+  CHECK((uint32_t) (t0 + 3000) == task.deadline(), "drifted to %+d", (int32_t) (task.deadline() - t0));
+  CHECK(150 == task.jitterMean(), "jitter mean %u, not 150", task.jitterMean());
+
+  // 3.5 periods late. Three are missed, and it runs once.
+  fake_us = t0 + 6500;
+  CHECK(1 == sched.serviceTasks(), "ran more than once for one late dispatch");
+  CHECK(3 == task.overruns(), "%u overruns, not 3", task.overruns());
+  CHECK(3500 == task.jitterMax(), "jitter max %u, not 3500", task.jitterMax());
+  CHECK((uint32_t) (t0 + 7000) == task.deadline(), "off the grid at %+d", (int32_t) (task.deadline() - t0));
+  CHECK(3 == task.runCount(), "%u runs", task.runCount());
+  CHECK(490 == sched.usUntilNextDeadline(), "%u us to the next deadline", sched.usUntilNextDeadline());
+
+  task.resetStats();
+  CHECK((0 == task.runCount()) && (0 == task.overruns()) && (0 == task.jitterMax()), "stats survived a reset");
+}
+
+
+/*
+* Deadlines on both sides of the clock's wrap must order as times, not as
+*   numbers, and a task must neither run early nor stall across the wrap.
+*/
+static void test_wraparound() {
+  const uint32_t T0 = 0xFFFFFC00;   // 1024us before the wrap.
+  test_heap_order(T0 - 300);        // Deadlines land on both sides of it.
+  test_jitter_and_overruns(T0);
+
+  begin(T0);
+  CoopScheduler sched(clock_us);
+  CoopTask before_wrap("before", FXNS[0], 0, 1);
+  CoopTask after_wrap("after", FXNS[1], 0, 255);
+  sched.fireAt(&after_wrap, 0x00000010);
+  sched.fireAt(&before_wrap, 0xFFFFFFF0);
+  uint32_t next = 0;
+  CHECK(sched.nextDeadline(&next) && (0xFFFFFFF0 == next), "next deadline 0x%08x", next);
+  CHECK(0x3F0 == sched.usUntilNextDeadline(), "0x%x us to the next deadline", sched.usUntilNextDeadline());
+
+  fake_us = 0xFFFFFFF8;
+  CHECK(1 == sched.serviceTasks(), "%s", "");
+  CHECK(0 == run_order[0], "the deadline after the wrap ran first");
+  CHECK(0x18 == sched.usUntilNextDeadline(), "0x%x us to the deadline across the wrap", sched.usUntilNextDeadline());
+  fake_us = 0x0000000F;
+  CHECK(0 == sched.serviceTasks(), "ran early across the wrap");
+  fake_us = 0x00000014;
+  CHECK(1 == sched.serviceTasks(), "stalled across the wrap");
+  CHECK(4 == after_wrap.jitterMax(), "jitter %u across the wrap", after_wrap.jitterMax());
+}
+
+
+int main() {
+  test_heap_order(1000);
+  test_jitter_and_overruns(1000);
+  test_wraparound();
+  printf("%s\n", (0 == fails) ? "PASS" : "FAIL");
+  return (0 == fails) ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+#
+# One GridEYE frame should put exactly one sample into the thermopile graph.
+#   The graph is subscribed to both the frame and its stats, and once took a
+#   pixel of the frame as a second "mean".
+#
+# Usage: therm_graph_per_frame.sh <path to motherflux0r-sim>
+
+SIM="$1"
+OUT=$("$SIM" -q -t 3 -s "${TMPDIR:-/tmp}" -e grideye -e graph) || exit 1
+
+FRAMES=$(echo "$OUT"  | awk '/Frames:/ && /ok,/ { print $2; exit }')
+SAMPLES=$(echo "$OUT" | awk '$1 == "therm_mean" && $3 == "samples" { print $2; exit }')
+
+if [ -z "$FRAMES" ] || [ -z "$SAMPLES" ]; then
+  echo "FAIL: couldn't find the frame and sample counts in the console output."
+  exit 1
+fi
+if [ "$FRAMES" -eq 0 ] || [ "$FRAMES" -ne "$SAMPLES" ]; then
+  echo "FAIL: $FRAMES GridEYE frames gave $SAMPLES therm_mean graph samples."
+  exit 1
+fi
+echo "PASS: $FRAMES GridEYE frames gave $SAMPLES therm_mean graph samples."
@@ -33,19 +33,26 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
 #include "AMG88xx.h"
+#include "IRQEventQueue.h"
 
 volatile static bool amg_irq_fired = false;
 
 /* ISR */
-void amg_isr_fxn() {   amg_irq_fired = true;   }
+void amg_isr_fxn() {
+  amg_irq_fired = true;
+  irq_queue.push(IRQSource::GRIDEYE, micros());
+}
 
 
 
 /*
 * Constructor
 */
-GridEYE::GridEYE(uint8_t addr, uint8_t irq) : _ADDR(addr), _IRQ_PIN(irq) {}
+GridEYE::GridEYE(uint8_t addr, uint8_t irq) : I2CDevice(addr), _IRQ_PIN(irq) {
+  _frame_op.max_chunk = 128;   // One transaction per frame. See _read_full_frame().
+}
 
 /*
 * Detructor
@@ -57,16 +64,17 @@ GridEYE::~GridEYE() {}
 * Init the sensor on the given bus.
 * Successful init() means the sensor is running at 10FPS.
 */
-int8_t GridEYE::init(TwoWire* b) {
+int8_t GridEYE::init(I2CBusQueue* b) {
   int8_t ret = -1;
-  _ll_pin_init();  // Idempotent. Ok to call twice.
-  _amg_clear_flag(GRIDEYE_FLAG_INITIALIZED);
+  _amg_clear_flag(GRIDEYE_FLAG_INITIALIZED | GRIDEYE_FLAG_WATCHING | GRIDEYE_FLAG_WATCH_STANDBY);
   for (uint8_t i = 0; i < 64; i++) {
     _frame[i] = 0;   // Zero the local framebuffer.
   }
   if (nullptr != b) {
-    _i2c = b;
-    if (0 == setFramerate10FPS()) {
+    _bus_queue = b;
+    _ll_pin_init();  // Idempotent. Ok to call twice.
+    // Until watch() says otherwise, the chip's interrupt output stays off.
+    if ((0 == setFramerate10FPS()) && (0 == _write_register(INT_CONTROL_REGISTER, 0x00))) {
       _amg_set_flag(GRIDEYE_FLAG_DEVICE_PRESENT);
       if (0 == wake()) {
         _amg_set_flag(GRIDEYE_FLAG_INITIALIZED);
@@ -79,28 +87,48 @@ int8_t GridEYE::init(TwoWire* b) {
 
 
 /*
-* Poll the class for updates.
+* Poll the class for updates. Reads are queued, and reported by a later call
+*   to poll() once they have landed.
 * Returns...
 *   -3 if not initialized and enabled.
-*   -1 if the frame needed to be read, but doing so failed.
+*   -1 if a read was due, but couldn't be queued.
 *   0  if nothing needs doing.
 *   1  if a frame was read and is waiting.
+*   2  if watch mode read the interrupt table, and found pixels in it.
 */
 int8_t GridEYE::poll() {
   int8_t ret = -3;
   if (initialized() && enabled()) {
     ret = 0;
-    if (255 != _IRQ_PIN) {
-      if (amg_irq_fired) {
-        ret = (0 == _read_full_frame()) ? 1 : -1;
-        amg_irq_fired = !digitalRead(_IRQ_PIN);
+    const uint32_t NOW = millis();
+    if (_amg_flag(GRIDEYE_FLAG_FRAME_FRESH)) {
+      _amg_clear_flag(GRIDEYE_FLAG_FRAME_FRESH);
+      ret = 1;
+    }
+    else if (_amg_flag(GRIDEYE_FLAG_ALARM_FRESH)) {
+      _amg_clear_flag(GRIDEYE_FLAG_ALARM_FRESH);
+      ret = 2;
+    }
+    else if (watching()) {
+      if (!_alarm_op.inFlight() && !_clear_op.inFlight()) {
+        if (255 != _IRQ_PIN) {
+          if (amg_irq_fired) {
+            amg_irq_fired = false;
+            ret = (0 == _read_alarm_table()) ? 0 : -1;
+          }
+        }
+        else {
+          const uint32_t R_INTERVAL = _amg_flag(GRIDEYE_FLAG_WATCH_STANDBY) ? 10000 : 1000;
+          if ((NOW - _last_read) >= R_INTERVAL) {
+            ret = (0 == _read_alarm_table()) ? 0 : -1;
+          }
+        }
       }
     }
-    else {
-      uint32_t now = millis();
-      uint32_t r_interval = isFramerate10FPS() ? 100 : 1000;
-      if ((now - _last_read) >= r_interval) {
-        ret = (0 == _read_full_frame()) ? 1 : -1;
+    else if (!_frame_op.inFlight()) {
+      const uint32_t R_INTERVAL = isFramerate10FPS() ? 100 : 1000;
+      if ((NOW - _last_read) >= R_INTERVAL) {
+        ret = (0 == _read_full_frame()) ? 0 : -1;
       }
     }
   }
@@ -108,6 +136,115 @@ int8_t GridEYE::poll() {
 }
 
 
+/*
+* Called by the bus queue when the thermistor or frame read finishes. The
+*   device sends each value LSB first.
+*/
+int8_t GridEYE::io_op_callback(I2CBusOp* op) {
+  if (op == &_therm_op) {
+    if (op->complete()) {
+      _therm_raw = (int16_t) (((uint16_t) _therm_buf[1] << 8) | _therm_buf[0]);
+      _amg_set_flag(GRIDEYE_FLAG_THERM_VALID);
+    }
+  }
+  else if (op == &_alarm_op) {
+    if (op->complete()) {
+      _therm_raw = (int16_t) (((uint16_t) _alarm_buf[1] << 8) | _alarm_buf[0]);
+      _amg_set_flag(GRIDEYE_FLAG_THERM_VALID);
+      memcpy(_alarm_table, &_alarm_buf[2], 8);
+      _alarm_pixels = 0;
+      for (uint8_t i = 0; i < 8; i++) {
+        for (uint8_t row = _alarm_table[i]; 0 != row; row &= (row - 1)) {
+          _alarm_pixels++;
+        }
+      }
+      _stat_table_reads++;
+      if (_alarm_pixels > 0) {
+        // Let go of the pin. The chip will raise it again on the next frame
+        //   if anything is still out of bounds.
+        _bus_write_async(&_clear_op, STATUS_CLEAR_REGISTER, &_clear_val, 1);
+        _stat_alarms++;
+        _amg_set_flag(GRIDEYE_FLAG_ALARM_FRESH);
+        _count_sample();
+      }
+    }
+  }
+  else if (op == &_frame_op) {
+    if (I2C_ERR_SHORT_READ == op->error) {
+      _stat_short++;
+    }
+    if (op->complete()) {
+      for (uint8_t i = 0; i < 64; i++) {
+        _frame[i] = (int16_t) (((uint16_t) _frame_buf[(i << 1) + 1] << 8) | _frame_buf[i << 1]);
+      }
+      const uint32_t READ_US = op->t_done - op->t_started;
+      const uint32_t WAIT_US = op->t_started - op->t_queued;
+      if ((_stat_frames > 0) && ((op->t_done - _stat_last_done) > _stat_gap_max)) {
+        _stat_gap_max = op->t_done - _stat_last_done;
+      }
+      if (READ_US < _stat_read_min) _stat_read_min = READ_US;
+      if (READ_US > _stat_read_max) _stat_read_max = READ_US;
+      if (WAIT_US > _stat_wait_max) _stat_wait_max = WAIT_US;
+      _stat_read_last = READ_US;
+      _stat_read_sum += READ_US;
+      _stat_last_done = op->t_done;
+      _stat_chunks    = op->chunks;
+      _stat_bytes     = op->xfer_len + (op->chunks * op->wireBytes(0));
+      _stat_frames++;
+      _amg_set_flag(GRIDEYE_FLAG_FRAME_FRESH);
+      _count_sample();
+    }
+    else {
+      _stat_failed++;
+    }
+  }
+  return 0;
+}
+
+
+void GridEYE::resetFrameStats() {
+  _stat_frames    = 0;
+  _stat_failed    = 0;
+  _stat_short     = 0;
+  _stat_read_last = 0;
+  _stat_read_min  = 0xFFFFFFFF;
+  _stat_read_max  = 0;
+  _stat_read_sum  = 0;
+  _stat_wait_max  = 0;
+  _stat_gap_max   = 0;
+  _stat_alarms    = 0;
+  _stat_table_reads = 0;
+}
+
+
+void GridEYE::printFrameStats(StringBuilder* output) {
+  output->concatf("GridEYE 0x%02x at %s\n", i2cAddress(), isFramerate10FPS() ? "10FPS" : "1FPS");
+  output->concatf("\tFrames:       %u ok, %u failed, %u short\n", _stat_frames, _stat_failed, _stat_short);
+  if (_stat_frames > 0) {
+    output->concatf(
+      "\tRead time:    %u us last, %u / %u / %u us min/mean/max\n",
+      _stat_read_last, _stat_read_min, (uint32_t) (_stat_read_sum / _stat_frames), _stat_read_max
+    );
+    output->concatf("\tLast read:    %u transactions, %u wire bytes\n", _stat_chunks, _stat_bytes);
+    output->concatf("\tWorst wait:   %u us in the queue\n", _stat_wait_max);
+    output->concatf("\tWorst gap:    %u us between frames\n", _stat_gap_max);
+  }
+  if (watching()) {
+    output->concatf(
+      "\tWatching:     %s, %s. %u table reads, %u alarms\n",
+      _amg_flag(GRIDEYE_FLAG_WATCH_STANDBY) ? "10s standby" : "1FPS",
+      (255 != _IRQ_PIN) ? "on IRQ" : "polled", _stat_table_reads, _stat_alarms
+    );
+    output->concatf("\tLast alarm:   %u pixels", _alarm_pixels);
+    for (uint8_t i = 0; i < 8; i++) {
+      output->concatf(" %02x", _alarm_table[i]);
+    }
+    output->concat("\n");
+  }
+  output->concatf("\tThermistor:   %.4f\n", (double) getDeviceTemperature());
+}
+
+
 /**
 *
 */
@@ -121,15 +258,18 @@ float GridEYE::getPixelTemperature(uint8_t pixel) {
 *
 */
 float GridEYE::getDeviceTemperature() {
-  int16_t temperature = _dev_int16_to_float(_read_registers(THERMISTOR_REGISTER_LSB, 2));
+  int16_t temperature = _dev_int16_to_float(getDeviceTemperatureRaw());
   return _normalize_units_returned(temperature * 0.0625);
 }
 
 
 /**
-*
+* From the last frame read, if there has been one.
 */
 int16_t GridEYE::getDeviceTemperatureRaw() {
+  if (_amg_flag(GRIDEYE_FLAG_THERM_VALID)) {
+    return _therm_raw;
+  }
   return _read_registers(THERMISTOR_REGISTER_LSB, 2);
 }
 
@@ -325,6 +465,55 @@ bool GridEYE::pixelInterruptSet(uint8_t pixel){
 }
 
 
+/*
+* Puts the sensor into watch mode. Pixels above upper or below lower (absolute,
+*   in the class's units) raise the chip's interrupt. The sensor runs at 1FPS,
+*   or in 10-second standby if asked to. Frames stop until unwatch().
+* Returns 0 on success, -3 if not initialized, or -1 if a register write
+*   failed.
+*/
+int8_t GridEYE::watch(float upper, float lower, float hysteresis, bool standby) {
+  if (!initialized()) {
+    return -3;
+  }
+  int8_t ret = -1;
+  if ((0 == setUpperInterruptValue(upper)) && (0 == setLowerInterruptValue(lower))) {
+    if (0 == setInterruptHysteresis(hysteresis)) {
+      // Absolute mode, output enabled.
+      if (0 == _write_register(INT_CONTROL_REGISTER, 0x03)) {
+        const int8_t RATE_RET = standby ? standby10seconds() : setFramerate1FPS();
+        if ((0 == RATE_RET) && (0 == clearAllStatusFlags())) {
+          memset(_alarm_table, 0, sizeof(_alarm_table));
+          _alarm_pixels = 0;
+          amg_irq_fired = false;
+          _last_read    = millis();
+          _amg_set_flag(GRIDEYE_FLAG_WATCH_STANDBY, standby);
+          _amg_set_flag(GRIDEYE_FLAG_WATCHING);
+          ret = 0;
+        }
+      }
+    }
+  }
+  return ret;
+}
+
+
+/*
+* Leaves watch mode, and goes back to reading frames at 10FPS.
+* Returns 0 on success, or -1 if a register write failed.
+*/
+int8_t GridEYE::unwatch() {
+  int8_t ret = -1;
+  if (0 == _write_register(INT_CONTROL_REGISTER, 0x00)) {
+    if ((0 == wake()) && (0 == setFramerate10FPS()) && (0 == clearAllStatusFlags())) {
+      ret = 0;
+    }
+  }
+  _amg_clear_flag(GRIDEYE_FLAG_WATCHING | GRIDEYE_FLAG_WATCH_STANDBY | GRIDEYE_FLAG_ALARM_FRESH);
+  return ret;
+}
+
+
 /**
 *
 */
@@ -520,30 +709,17 @@ int16_t GridEYE::getInterruptHysteresisRaw() {
 *
 */
 int8_t GridEYE::_write_register(uint8_t reg, uint8_t val) {
-  _i2c->beginTransmission(_ADDR);
-  _i2c->write(reg);
-  _i2c->write(val);
-  return _i2c->endTransmission();
+  return _bus_write8(reg, val);
 }
 
 
 /**
-*
+* Reads one or two bytes, and returns them as a little-endian value.
 */
 int16_t GridEYE::_read_registers(uint8_t reg, uint8_t len) {
-  int16_t result = 0;
-  _i2c->beginTransmission(_ADDR);
-  _i2c->write(reg);
-  _i2c->endTransmission(false);
-  _i2c->requestFrom(_ADDR, len);
-
-  while(_i2c->available()) {      // client may send less than requested
-    uint8_t lsb = _i2c->read();   // Get bytes from sensor
-    uint8_t msb = _i2c->read();
-    result = (uint16_t)msb << 8 | lsb;   // concat bytes into int
-  }
-  _i2c->endTransmission();
-  return result;
+  uint8_t buf[2] = {0, 0};
+  _bus_read(reg, buf, (len > 2) ? 2 : len);
+  return (int16_t) (((uint16_t) buf[1] << 8) | buf[0]);
 }
 
 
@@ -556,7 +732,6 @@ int8_t GridEYE::_ll_pin_init() {
     if (255 != _IRQ_PIN) {
       pinMode(_IRQ_PIN, INPUT);
       attachInterrupt(digitalPinToInterrupt(_IRQ_PIN), amg_isr_fxn, FALLING);
-      interruptPinEnable();
     }
     _amg_set_flag(GRIDEYE_FLAG_PINS_CONFIGURED);
   }
@@ -565,31 +740,38 @@ int8_t GridEYE::_ll_pin_init() {
 
 
 /*
-* Read the entire frame.
+* Queue a read of the entire frame. The frame op asks the bus queue for the
+*   whole 128 bytes in one chunk, so it is a single transaction wherever the
+*   bus driver can take that much (the Teensy4 Wire buffer can). That stalls
+*   loop() for about 3ms at 400kHz, once per frame, where the driver's usual
+*   chunks would be four stalls of about 0.8ms. The thermistor is queued just
+*   ahead of it. The registers between the two are mostly reserved, so reading
+*   across them would cost more than the second transaction does. If the
+*   thermistor read can't be queued, the frame goes without it.
 */
 int8_t GridEYE::_read_full_frame() {
   int8_t ret = -1;
   if (initialized() && enabled()) {
-    uint8_t dev_reg = TEMPERATURE_REGISTER_START;
-    uint8_t offset = 0;
-    const uint8_t READ_BLOCK_SIZE  = 16;
-    const uint8_t READ_BLOCK_COUNT = 128 / READ_BLOCK_SIZE;
-    // Break up the 128-byte transfer into blocks to accomodate small buffers.
-    for (uint8_t i = 0; i < READ_BLOCK_COUNT; i++) {
-      _i2c->beginTransmission(_ADDR);
-      _i2c->write(dev_reg);
-      _i2c->endTransmission(false);
-      _i2c->requestFrom((uint8_t) _ADDR, (uint8_t) READ_BLOCK_SIZE);
-      while(_i2c->available()) {      // client may send less than requested
-        uint8_t lsb = _i2c->read();
-        uint8_t msb = _i2c->read();
-        _frame[offset++] = (uint16_t)msb << 8 | lsb;
-      }
-      _i2c->endTransmission();
-      dev_reg += READ_BLOCK_SIZE;
+    if (!_therm_op.inFlight()) {
+      _bus_read_async(&_therm_op, THERMISTOR_REGISTER_LSB, _therm_buf, 2);
+    }
+    ret = _bus_read_async(&_frame_op, TEMPERATURE_REGISTER_START, _frame_buf, 128);
+    if (0 == ret) {
+      _last_read = millis();
     }
+  }
+  return ret;
+}
+
+
+/*
+* Queue one burst from the thermistor through the end of the interrupt table.
+*   The two are adjacent, so the thermistor comes along for two more bytes.
+*/
+int8_t GridEYE::_read_alarm_table() {
+  int8_t ret = _bus_read_async(&_alarm_op, THERMISTOR_REGISTER_LSB, _alarm_buf, sizeof(_alarm_buf));
+  if (0 == ret) {
     _last_read = millis();
-    ret = (64 == offset) ? 0 : -2;
   }
   return ret;
 }
@@ -30,6 +30,23 @@
 * Unified member name convention. Encapsulated members now start with an
 *   underscore.
 *                                                  ---J. Ian Lindsay  2020.02.03
+*
+* Frame reads are queued on the I2CBusQueue. The queue normally caps chunks
+*   at the bus driver's limit (32 bytes on the Teensy4, to bound the stall in
+*   loop()), but the frame op overrides that with its max_chunk, so the whole
+*   128-byte frame is one burst. That costs one stall of about 3ms per frame,
+*   rather than four of about 0.8ms. The thermistor is read in the same pass,
+*   as a separate 2-byte op just ahead of the frame, so getDeviceTemperature()
+*   doesn't need the bus. Each frame read is timed, and printFrameStats()
+*   shows the results.
+*
+* Frames are read on a timer, at the sensor's frame rate. The IRQ pin is only
+*   used by watch mode, in which the sensor runs slowly (1FPS, or a frame
+*   every 10 seconds in standby), frames are not read at all, and the chip's
+*   own thresholds decide when the host has anything to do. When the chip
+*   raises its interrupt, the thermistor and the 8-byte interrupt table are
+*   read in one burst, and the flag is cleared. Without an IRQ pin, the same
+*   burst is polled at the sensor's frame rate instead.
 */
 
 /*
@@ -62,30 +79,11 @@
 */
 
 #include <Arduino.h>
-#include <Wire.h>
+#include "I2CBusQueue.h"
 
 #ifndef __AMG88XX_DRIVER_H_
 #define __AMG88XX_DRIVER_H_
 
-//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-//Platform specific configurations
-//Define the size of the I2C buffer based on the platform the user has
-#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
-  //I2C_BUFFER_LENGTH is defined in Wire.H
-  #define I2C_BUFFER_LENGTH BUFFER_LENGTH
-#elif defined(__SAMD21G18A__)
-  //SAMD21 uses RingBuffer.h
-  #define I2C_BUFFER_LENGTH SERIAL_BUFFER_SIZE
-#elif __MK20DX256__
-  //Teensy
-#elif ARDUINO_ARCH_ESP32
-  //ESP32 based platforms
-#else
-  //The catch-all default is 32
-  #define I2C_BUFFER_LENGTH 32
-#endif
-//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-
 /* Class flags */
 #define GRIDEYE_FLAG_DEVICE_PRESENT   0x0001  // Part was found.
 #define GRIDEYE_FLAG_PINS_CONFIGURED  0x0002  // Low-level pin setup is complete.
@@ -94,6 +92,11 @@
 #define GRIDEYE_FLAG_10FPS            0x0010  // 10Hz update rate if true. 1Hz if not.
 #define GRIDEYE_FLAG_FREEDOM_UNITS    0x0020  // Units in Fahrenheit if true. Celcius if not.
 #define GRIDEYE_FLAG_HW_AVERAGING     0x0040  // Use the sensor's hardware averaging?
+#define GRIDEYE_FLAG_FRAME_FRESH      0x0080  // A frame arrived that poll() hasn't reported.
+#define GRIDEYE_FLAG_THERM_VALID      0x0100  // _therm_raw came from a frame read.
+#define GRIDEYE_FLAG_WATCHING         0x0200  // Watch mode. See watch().
+#define GRIDEYE_FLAG_WATCH_STANDBY    0x0400  // Watch mode is in 10-second standby.
+#define GRIDEYE_FLAG_ALARM_FRESH      0x0800  // An alarm arrived that poll() hasn't reported.
 
 
 /* Registers */
@@ -122,14 +125,17 @@
 * Class defaults on construction:
 *   - All temperatures in Celcius
 *******************************************************************************/
-class GridEYE {
+class GridEYE : public I2CDevice {
   public:
     GridEYE(uint8_t addr = 0x69, uint8_t irq_pin = 255);
     ~GridEYE();
 
-    int8_t init(TwoWire* bus = &Wire);
+    int8_t init(I2CBusQueue*);
     int8_t poll();
 
+    /* Overrides from I2CDevice. */
+    int8_t io_op_callback(I2CBusOp*);
+
     inline bool devFound() {         return _amg_flag(GRIDEYE_FLAG_DEVICE_PRESENT);  };
     inline bool enabled() {          return _amg_flag(GRIDEYE_FLAG_ENABLED);         };
     inline bool initialized() {      return _amg_flag(GRIDEYE_FLAG_INITIALIZED);     };
@@ -138,6 +144,7 @@ class GridEYE {
 
     float   getPixelTemperature(uint8_t pixel);
     inline int16_t getPixelRaw(uint8_t pixel) {   return (pixel < 64) ? _frame[pixel] : 0;  };
+    inline const int16_t* frameRaw() {            return _frame;  };
 
     float   getDeviceTemperature();
     int16_t getDeviceTemperatureRaw();
@@ -168,9 +175,23 @@ class GridEYE {
     int8_t clearAllStatusFlags();
     bool   pixelInterruptSet(uint8_t pixel);
 
+    /* Watch mode. */
+    int8_t watch(float upper, float lower, float hysteresis, bool standby = false);
+    int8_t unwatch();
+    inline bool watching() {          return _amg_flag(GRIDEYE_FLAG_WATCHING);   };
+    inline const uint8_t* alarmTable() {   return _alarm_table;    };   // Row per byte, as the sensor gives it.
+    inline uint8_t  alarmPixels() {   return _alarm_pixels;    };
+    inline uint32_t alarms() {        return _stat_alarms;     };
+
     int8_t movingAverage(bool);
     inline bool movingAverage() {  return _amg_flag(GRIDEYE_FLAG_HW_AVERAGING);   };
 
+    /* Frame read telemetry. */
+    inline uint32_t frames() {       return _stat_frames;     };
+    inline uint32_t frameReadUs() {  return _stat_read_last;  };
+    void resetFrameStats();
+    void printFrameStats(StringBuilder*);
+
     int8_t setUpperInterruptValue(float degrees);
     int8_t setUpperInterruptValueRaw(int16_t regValue);
     int8_t setLowerInterruptValue(float degrees);
@@ -187,18 +208,44 @@ class GridEYE {
 
 
   private:
-    const uint8_t _ADDR;
     const uint8_t _IRQ_PIN;
     uint16_t      _flags     = 0;
     uint32_t      _last_read = 0;
-    TwoWire*      _i2c       = nullptr;
+    I2CBusOp      _frame_op;
+    I2CBusOp      _therm_op;
+    I2CBusOp      _alarm_op;
+    I2CBusOp      _clear_op;
     int16_t       _frame[64];
+    int16_t       _therm_raw = 0;
+    uint8_t       _frame_buf[128];   // Landing zone for the frame read.
+    uint8_t       _therm_buf[2];
+    uint8_t       _alarm_buf[10];    // Thermistor, then the interrupt table.
+    uint8_t       _alarm_table[8];
+    uint8_t       _alarm_pixels = 0;
+    uint8_t       _clear_val    = 0x02;
+
+    /* Frame read telemetry. Times are from the bus queue's clock. */
+    uint32_t      _stat_frames     = 0;
+    uint32_t      _stat_failed     = 0;
+    uint32_t      _stat_short      = 0;   // Reads that came back with fewer bytes.
+    uint32_t      _stat_read_last  = 0;   // First chunk to done.
+    uint32_t      _stat_read_min   = 0xFFFFFFFF;
+    uint32_t      _stat_read_max   = 0;
+    uint64_t      _stat_read_sum   = 0;
+    uint32_t      _stat_wait_max   = 0;   // Queued to first chunk.
+    uint32_t      _stat_gap_max    = 0;   // Between completed frames.
+    uint32_t      _stat_last_done  = 0;
+    uint16_t      _stat_bytes      = 0;   // Wire bytes in the last frame read.
+    uint8_t       _stat_chunks     = 0;   // Transactions in the last frame read.
+    uint32_t      _stat_alarms     = 0;   // Table reads that found pixels.
+    uint32_t      _stat_table_reads = 0;
 
     int8_t  _ll_pin_init();
 
     int8_t  _write_register(uint8_t reg, uint8_t val);
     int16_t _read_registers(uint8_t reg, uint8_t len);
     int8_t  _read_full_frame();
+    int8_t  _read_alarm_table();
 
     float   _normalize_units_accepted(float deg);
     float   _normalize_units_returned(float deg);
@@ -0,0 +1,297 @@
+/*
+* Single-precision kernels for the atmospheric formulas in the BME280 driver.
+* See the header file for the rules, and the error bounds.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "AtmoMath.h"
+
+#define ATMO_LN2     0.69314718056f
+
+
+/*******************************************************************************
+* Kernels
+*******************************************************************************/
+
+/*
+* log2(m) for m in [sqrt(1/2), sqrt(2)) is (2/ln2) * atanh(t), with
+*   t = (m-1)/(m+1) in (-0.172, 0.172). The series is cut after t^7, which
+*   leaves a truncation error under 1e-8.
+*/
+float atmo_log2f(float x) {
+  if (!(x > 0.0f)) {
+    return (0.0f == x) ? -INFINITY : NAN;
+  }
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int32_t e = (int32_t) ((bits >> 23) & 0xFF) - 127;
+  bits = (bits & 0x007FFFFF) | 0x3F800000;
+  float m;
+  memcpy(&m, &bits, sizeof(m));
+  if (m > 1.41421356f) {
+    m *= 0.5f;
+    e++;
+  }
+  const float T  = (m - 1.0f) / (m + 1.0f);
+  const float T2 = T * T;
+  return (float) e + T * (2.88539008f + T2 * (0.96179669f + T2 * (0.57707802f + T2 * 0.41219858f)));
+}
+
+
+/*
+* 2^f for f in [-1/2, 1/2] is the Taylor series of e^(f*ln2) out to f^6,
+*   which leaves a relative error under 2e-7. The integer part goes into the
+*   exponent.
+*/
+float atmo_exp2f(float x) {
+  if (x < -126.0f) {
+    return 0.0f;
+  }
+  if (x >= 128.0f) {
+    return INFINITY;
+  }
+  const int32_t I = (int32_t) floorf(x + 0.5f);
+  const float   F = x - (float) I;
+  float p = 1.0f + F * (0.69314718f + F * (0.24022651f + F * (0.05550411f +
+    F * (0.00961813f + F * (0.00133336f + F * 0.00015404f)))));
+  uint32_t bits;
+  memcpy(&bits, &p, sizeof(bits));
+  bits += (uint32_t) I << 23;
+  memcpy(&p, &bits, sizeof(p));
+  return p;
+}
+
+
+/* For x > 0. */
+float atmo_powf(float x, float y) {
+  return atmo_exp2f(y * atmo_log2f(x));
+}
+
+
+
+/*******************************************************************************
+* Fast forms
+*******************************************************************************/
+
+float atmo_altitude(float pressure, float sea_level_pressure) {
+  return (sea_level_pressure - pressure) * (1000.0f / 3386.3752577878f);
+}
+
+
+/* The log term and the temperature term are each worked out once. */
+float atmo_dew_point(float temp, float hum) {
+  const float GAMMA = (atmo_log2f(hum * 0.01f) * ATMO_LN2) + ((17.625f * temp) / (243.04f + temp));
+  return (243.04f * GAMMA) / (17.625f - GAMMA);
+}
+
+
+/* Multiplies by the negative power, rather than dividing by the positive. */
+float atmo_sea_level(float altitude, float temp, float pres) {
+  const float H = 0.0065f * altitude;
+  return pres * atmo_powf(1.0f - (H / (temp + H + 273.15f)), -5.257f);
+}
+
+
+float atmo_heat_index(float temp, float hum) {
+  const float T  = (temp * 1.8f) + 32.0f;
+  float hi = 0.5f * (T + 61.0f + ((T - 68.0f) * 1.2f) + (hum * 0.094f));
+  if (((hi + T) * 0.5f) >= 80.0f) {
+    const float T2 = T * T;
+    const float H2 = hum * hum;
+    hi = -42.379f + (2.04901523f * T) + (10.14333127f * hum) - (0.22475541f * T * hum)
+      - (0.00683783f * T2) - (0.05481717f * H2) + (0.00122874f * T2 * hum)
+      + (0.00085282f * T * H2) - (0.00000199f * T2 * H2);
+  }
+  return (hi - 32.0f) * (5.0f / 9.0f);
+}
+
+
+/* The library's expf(). See the header. */
+float atmo_abs_humidity(float temp, float hum) {
+  const float E = expf((17.67f * temp) / (temp + 243.5f));
+  return ((6.112f * 2.1674f) * E * hum) / (273.15f + temp);
+}
+
+
+
+/*******************************************************************************
+* Reference forms. These are the driver's original math.
+*******************************************************************************/
+
+double atmo_altitude_ref(double pressure, double sea_level_pressure) {
+  return 1000.0 * (sea_level_pressure - pressure) / 3386.3752577878;
+}
+
+
+double atmo_dew_point_ref(double temp, double hum) {
+  return 243.04 * (log(hum/100.0) + ((17.625 * temp)/(243.04 + temp))) /(17.625 - log(hum/100.0) - ((17.625 * temp)/(243.04 + temp)));
+}
+
+
+double atmo_sea_level_ref(double altitude, double temp, double pres) {
+  return (pres / pow(1-((0.0065 *altitude) / (temp + (0.0065 *altitude) + 273.15)),5.257));
+}
+
+
+double atmo_heat_index_ref(double temp, double hum) {
+  const double T  = temp * 9.0 / 5.0 + 32.0;
+  double hi = 0.5 * (T + 61.0 + ((T - 68.0) * 1.2) + (hum * 0.094));
+  if (((hi + T) / 2.0) >= 80.0) {
+    hi = -42.379 + (2.04901523 * T) + (10.14333127 * hum) - (0.22475541 * T * hum)
+      - (0.00683783 * T * T) - (0.05481717 * hum * hum) + (0.00122874 * T * T * hum)
+      + (0.00085282 * T * hum * hum) - (0.00000199 * T * T * hum * hum);
+  }
+  return (hi - 32.0) * 5.0 / 9.0;
+}
+
+
+double atmo_abs_humidity_ref(double temp, double hum) {
+  return (6.112 * exp((17.67 * temp) / (temp + 243.5)) * hum * 2.1674) / (273.15 + temp);
+}
+
+
+
+/*******************************************************************************
+* Accuracy sweep and benchmark
+*******************************************************************************/
+
+/* Operating range of the BME280. */
+#define ATMO_T_MIN     -40.0f
+#define ATMO_T_MAX      85.0f
+#define ATMO_H_MIN       1.0f     // Dew point is undefined at 0 %RH.
+#define ATMO_H_MAX     100.0f
+#define ATMO_P_MIN   30000.0f
+#define ATMO_P_MAX  110000.0f
+#define ATMO_BENCH_CALLS  20000    // Per timed run. Long enough for a us clock.
+#define ATMO_BENCH_RUNS   9        // The fastest run of each form is the one reported.
+
+typedef struct {
+  const char* name;
+  float       bound;
+  double      max_err;
+  float       at_a;         // Inputs at the worst error.
+  float       at_b;
+} AtmoSweep;
+
+static volatile float _atmo_sink = 0.0f;   // Keeps timed loops from being optimized away.
+
+
+static void _atmo_note(AtmoSweep* s, double err, float a, float b) {
+  err = fabs(err);
+  if (!(err <= s->max_err)) {   // Catches NAN, too.
+    s->max_err = err;
+    s->at_a    = a;
+    s->at_b    = b;
+  }
+}
+
+
+static void _atmo_report(StringBuilder* output, AtmoSweep* s, uint32_t ref_us, uint32_t fast_us, uint8_t* fails) {
+  const bool PASS = (s->max_err <= s->bound);
+  if (!PASS) (*fails)++;
+  output->concatf(
+    "%-13s %10.3g %10.3g  %s  (at %.2f, %.2f)",
+    s->name, s->max_err, (double) s->bound, PASS ? "ok  " : "FAIL", (double) s->at_a, (double) s->at_b
+  );
+  if ((ref_us > 0) || (fast_us > 0)) {
+    output->concatf(
+      "  %6u %6u ns  %5.1fx",
+      (uint32_t) (((uint64_t) ref_us * 1000) / ATMO_BENCH_CALLS),
+      (uint32_t) (((uint64_t) fast_us * 1000) / ATMO_BENCH_CALLS),
+      (fast_us > 0) ? ((double) ref_us / fast_us) : 0.0
+    );
+  }
+  output->concat("\n");
+}
+
+
+/*
+* Times ATMO_BENCH_CALLS calls of one form of one formula. Inputs walk the
+*   range so that nothing is constant-folded.
+*/
+static uint32_t _atmo_time(uint8_t f, bool fast, AtmoClockFxn clock_us) {
+  const uint32_t T0 = clock_us();
+  for (uint32_t i = 0; i < ATMO_BENCH_CALLS; i++) {
+    const float T = ATMO_T_MIN + ((i % 125) * 1.0f);
+    const float H = ATMO_H_MIN + ((i % 99) * 1.0f);
+    const float P = ATMO_P_MIN + ((i % 2000) * 40.0f);
+    switch (f) {
+      case 0:  _atmo_sink = fast ? atmo_altitude(P, 101325.0f)     : (float) atmo_altitude_ref(P, 101325.0);       break;
+      case 1:  _atmo_sink = fast ? atmo_dew_point(T, H)            : (float) atmo_dew_point_ref(T, H);             break;
+      case 2:  _atmo_sink = fast ? atmo_sea_level(P * 0.01f, T, P) : (float) atmo_sea_level_ref(P * 0.01f, T, P);  break;
+      case 3:  _atmo_sink = fast ? atmo_heat_index(T, H)           : (float) atmo_heat_index_ref(T, H);            break;
+      case 4:  _atmo_sink = fast ? atmo_abs_humidity(T, H)         : (float) atmo_abs_humidity_ref(T, H);          break;
+    }
+  }
+  return clock_us() - T0;
+}
+
+
+/*
+* Sweeps each fast form against its reference over the operating range, and
+*   times both. This blocks for a while.
+* Returns 0 if every bound held, or -1 if any didn't.
+*/
+int8_t atmo_math_benchmark(StringBuilder* output, AtmoClockFxn clock_us) {
+  uint8_t fails = 0;
+  AtmoSweep s_log2  = {"log2 (rel)",   ATMO_ERR_LOG2,         0.0, 0.0f, 0.0f};
+  AtmoSweep s_exp2  = {"exp2 (rel)",   ATMO_ERR_EXP2_REL,     0.0, 0.0f, 0.0f};
+  AtmoSweep s_alt   = {"altitude",     ATMO_ERR_ALTITUDE,     0.0, 0.0f, 0.0f};
+  AtmoSweep s_dew   = {"dew_point",    ATMO_ERR_DEW_POINT,    0.0, 0.0f, 0.0f};
+  AtmoSweep s_sea   = {"sea_level",    ATMO_ERR_SEA_LEVEL,    0.0, 0.0f, 0.0f};
+  AtmoSweep s_heat  = {"heat_index",   ATMO_ERR_HEAT_INDEX,   0.0, 0.0f, 0.0f};
+  AtmoSweep s_abs   = {"abs_humidity", ATMO_ERR_ABS_HUMIDITY, 0.0, 0.0f, 0.0f};
+
+  // Kernels, over their whole domains.
+  for (float x = 1.0e-37f; x < 1.0e38f; x *= 1.0137f) {
+    const double REF = log2((double) x);
+    _atmo_note(&s_log2, (atmo_log2f(x) - REF) / ((fabs(REF) > 1.0) ? fabs(REF) : 1.0), x, 0.0f);
+  }
+  for (float x = -125.0f; x < 127.0f; x += 0.00731f) {
+    const double REF = exp2((double) x);
+    _atmo_note(&s_exp2, (atmo_exp2f(x) - REF) / REF, x, 0.0f);
+  }
+
+  // Formulas, over temperature and humidity, or temperature and pressure.
+  for (float t = ATMO_T_MIN; t <= ATMO_T_MAX; t += 0.25f) {
+    for (float h = ATMO_H_MIN; h <= ATMO_H_MAX; h += 0.5f) {
+      _atmo_note(&s_dew,  atmo_dew_point(t, h)    - atmo_dew_point_ref(t, h),    t, h);
+      _atmo_note(&s_heat, atmo_heat_index(t, h)   - atmo_heat_index_ref(t, h),   t, h);
+      _atmo_note(&s_abs,  atmo_abs_humidity(t, h) - atmo_abs_humidity_ref(t, h), t, h);
+    }
+  }
+  for (float t = ATMO_T_MIN; t <= ATMO_T_MAX; t += 1.0f) {
+    for (float p = ATMO_P_MIN; p <= ATMO_P_MAX; p += 100.0f) {
+      const float A = atmo_altitude(p, 101325.0f);
+      _atmo_note(&s_alt, A - atmo_altitude_ref(p, 101325.0), p, 0.0f);
+      _atmo_note(&s_sea, atmo_sea_level(A, t, p) - atmo_sea_level_ref(atmo_altitude_ref(p, 101325.0), t, p), t, p);
+    }
+  }
+
+  // Timing. The two forms take turns, so that both see the same conditions,
+  //   and each keeps its fastest run.
+  uint32_t ref_us[5];
+  uint32_t fast_us[5];
+  for (uint8_t f = 0; f < 5; f++) {
+    ref_us[f]  = 0xFFFFFFFF;
+    fast_us[f] = 0xFFFFFFFF;
+    for (uint8_t run = 0; run < ATMO_BENCH_RUNS; run++) {
+      const uint32_t REF_US  = _atmo_time(f, false, clock_us);
+      const uint32_t FAST_US = _atmo_time(f, true, clock_us);
+      if (REF_US < ref_us[f])   ref_us[f]  = REF_US;
+      if (FAST_US < fast_us[f]) fast_us[f] = FAST_US;
+    }
+  }
+
+  output->concatf("Atmospheric math (BME280_FAST_MATH = %d)\n", BME280_FAST_MATH);
+  output->concat("              max error       bound              worst case     ref   fast        speedup\n");
+  _atmo_report(output, &s_log2, 0, 0, &fails);
+  _atmo_report(output, &s_exp2, 0, 0, &fails);
+  _atmo_report(output, &s_alt,  ref_us[0], fast_us[0], &fails);
+  _atmo_report(output, &s_dew,  ref_us[1], fast_us[1], &fails);
+  _atmo_report(output, &s_sea,  ref_us[2], fast_us[2], &fails);
+  _atmo_report(output, &s_heat, ref_us[3], fast_us[3], &fails);
+  _atmo_report(output, &s_abs,  ref_us[4], fast_us[4], &fails);
+  return (0 == fails) ? 0 : -1;
+}
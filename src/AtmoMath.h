@@ -0,0 +1,87 @@
+/*
+* Single-precision kernels for the atmospheric formulas in the BME280 driver.
+*
+* The reference forms of these formulas (the *_ref() functions, which are
+*   the driver's original math) work in double, and call log(), exp(), and
+*   pow(). The iMXRT1062's FPU does double arithmetic in hardware, but more
+*   slowly than float (a double divide takes about twice as long), and the
+*   library's log(), exp(), and pow() are long routines built from those
+*   operations. A single pow() costs more than the rest of a baro sample put
+*   together. The fast forms here stay in float, share subexpressions, and
+*   replace the library calls with:
+*   - log2: The exponent is taken from the float's bits. The mantissa is
+*       folded into [sqrt(1/2), sqrt(2)), and log2 of it is an odd series in
+*       (m-1)/(m+1), out to the 7th power.
+*   - exp2: Split at the nearest integer, which goes straight into the
+*       exponent bits. 2^f for the remainder in [-1/2, 1/2] is a 6th order
+*       polynomial.
+*   - pow(x, y) is exp2(y * log2(x)), and ln is scaled from log2.
+*   Both kernels are good to a few ulp. The formulas lose more than that, but
+*   mostly to being done in float at all: with the library's powf() in place
+*   of the kernels, sea level is still off by 0.25 Pa, against 0.31 Pa with
+*   them. Raising to the -5.257th power multiplies the rounding error of the
+*   base about five-fold. Absolute humidity is the exception. Its one exp()
+*   has nothing to share with, and the scaled exp2() came out slower than the
+*   reference, so it calls the library's expf().
+*
+* The bounds below are the worst absolute error against the reference forms
+*   over the BME280's whole operating range (-40 to 85C, 1 to 100 %RH, 300 to
+*   1100 hPa), with some margin. atmo_math_benchmark() sweeps that range, and
+*   reports the error it found against these bounds, and the time per call of
+*   each form. It runs from the console on the device, and as sim/bench/
+*   atmo_math in the host build. The accuracy half is the same in both, but
+*   the timings are each machine's own. A desktop's double math is much closer
+*   to its float math than the M7's is.
+*
+* BME280_FAST_MATH picks which form the driver uses. Build with it set to 0
+*   to get the reference math back.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __ATMO_MATH_H_
+#define __ATMO_MATH_H_
+
+#ifndef BME280_FAST_MATH
+  #define BME280_FAST_MATH   1
+#endif
+
+/*
+* Maximum error of the fast forms versus the reference forms. log2 is relative
+*   where |log2(x)| > 1, since its result runs out of float precision before
+*   its error does.
+*/
+#define ATMO_ERR_LOG2          2.0e-7f    // For x in [2^-126, 2^128)
+#define ATMO_ERR_EXP2_REL      4.0e-7f    // Relative, for x in [-126, 127]
+#define ATMO_ERR_ALTITUDE      0.01f      // m
+#define ATMO_ERR_DEW_POINT     0.0005f    // C
+#define ATMO_ERR_SEA_LEVEL     0.5f       // Pa, about 64 ulp at 1000 hPa
+#define ATMO_ERR_HEAT_INDEX    0.001f     // C
+#define ATMO_ERR_ABS_HUMIDITY  0.0005f    // g/m^3
+
+typedef uint32_t (*AtmoClockFxn)();
+
+/* Kernels */
+float atmo_log2f(float x);
+float atmo_exp2f(float x);
+float atmo_powf(float x, float y);
+
+/* Fast forms. Temperatures in C, pressures in Pa, humidity in %RH. */
+float atmo_altitude(float pressure, float sea_level_pressure);
+float atmo_dew_point(float temp, float hum);
+float atmo_sea_level(float altitude, float temp, float pres);
+float atmo_heat_index(float temp, float hum);
+float atmo_abs_humidity(float temp, float hum);
+
+/* Reference forms */
+double atmo_altitude_ref(double pressure, double sea_level_pressure);
+double atmo_dew_point_ref(double temp, double hum);
+double atmo_sea_level_ref(double altitude, double temp, double pres);
+double atmo_heat_index_ref(double temp, double hum);
+double atmo_abs_humidity_ref(double temp, double hum);
+
+int8_t atmo_math_benchmark(StringBuilder*, AtmoClockFxn clock_us);
+
+#endif  // __ATMO_MATH_H_
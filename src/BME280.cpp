@@ -38,10 +38,27 @@ courtesy of Brian McNoldy at http://andrew.rsmas.miami.edu.
 */
 
 #include <Arduino.h>
-#include <Wire.h>
+#include <string.h>
 #include "BME280.h"
+#include "AtmoMath.h"
+
+/* The formulas below come from AtmoMath, in whichever form the build picks. */
+#if BME280_FAST_MATH
+  #define BME280_ALTITUDE(p, slp)      atmo_altitude(p, slp)
+  #define BME280_SEA_LEVEL(a, t, p)    atmo_sea_level(a, t, p)
+  #define BME280_DEW_POINT(t, h)       atmo_dew_point(t, h)
+  #define BME280_HEAT_INDEX(t, h)      atmo_heat_index(t, h)
+  #define BME280_ABS_HUMIDITY(t, h)    atmo_abs_humidity(t, h)
+#else
+  #define BME280_ALTITUDE(p, slp)      atmo_altitude_ref(p, slp)
+  #define BME280_SEA_LEVEL(a, t, p)    atmo_sea_level_ref(a, t, p)
+  #define BME280_DEW_POINT(t, h)       atmo_dew_point_ref(t, h)
+  #define BME280_HEAT_INDEX(t, h)      atmo_heat_index_ref(t, h)
+  #define BME280_ABS_HUMIDITY(t, h)    atmo_abs_humidity_ref(t, h)
+#endif
 
 #define CTRL_HUM_ADDR          0xF2
+#define STATUS_ADDR            0xF3
 #define CTRL_MEAS_ADDR         0xF4
 #define CONFIG_ADDR            0xF5
 #define PRESS_ADDR             0xF7
@@ -58,7 +75,9 @@ courtesy of Brian McNoldy at http://andrew.rsmas.miami.edu.
 #define HUM_DIG_ADDR1_LENGTH   1
 #define HUM_DIG_ADDR2_LENGTH   7
 #define DIG_LENGTH             32
-#define SENSOR_DATA_LENGTH     8
+#define SENSOR_DATA_LENGTH     BME280_SENSOR_DATA_LENGTH
+#define BURST_LENGTH           12     // STATUS_ADDR through the end of the data.
+#define STATUS_MEASURING       0x08
 
 
 /* Delegate constructor. */
@@ -72,7 +91,7 @@ bool BME280::_priv_init() {
       ret = WriteSettings();
     }
   }
-  _baro_set_flag(BME280_FLAG_INITIALIZED, (0 == ret));
+  _baro_set_flag(BME280_FLAG_INITIALIZED, ret);
   return ret;
 }
 
@@ -92,15 +111,20 @@ int8_t BME280::_read_chip_id() {
 }
 
 
+/*
+* Writes to config may be ignored in normal mode, and ctrl_hum only takes
+*   effect after a write to ctrl_meas. So the part is put to sleep before
+*   config is written, and ctrl_meas goes last.
+*/
 bool BME280::WriteSettings() {
   bool ret = false;
   uint8_t ctrlHum, ctrlMeas, config;
 
   CalculateRegisters(ctrlHum, ctrlMeas, config);
   if (WriteRegister(CTRL_HUM_ADDR, ctrlHum)) {
-    if (WriteRegister(CTRL_MEAS_ADDR, ctrlMeas)) {
+    if (WriteRegister(CTRL_MEAS_ADDR, ctrlMeas & 0xFC)) {
       if (WriteRegister(CONFIG_ADDR, config)) {
-        ret = true;
+        ret = WriteRegister(CTRL_MEAS_ADDR, ctrlMeas);
       }
     }
   }
@@ -125,7 +149,27 @@ void BME280::CalculateRegisters(uint8_t& ctrlHum, uint8_t& ctrlMeas, uint8_t& co
   // ctrl_meas register. (ctrl_meas[7:5] = temperature oversampling rate, ctrl_meas[4:2] = pressure oversampling rate, ctrl_meas[1:0] = mode.)
   ctrlMeas = ((uint8_t)m_settings.tempOSR << 5) | ((uint8_t)m_settings.presOSR << 2) | (uint8_t)m_settings.mode;
   // config register. (config[7:5] = standby time, config[4:2] = filter, ctrl_meas[0] = spi enable.)
-  config = ((uint8_t)m_settings.standbyTime << 5) | ((uint8_t)m_settings.filter << 2) | _useSPI() ? 1 : 0;
+  config = ((uint8_t)m_settings.standbyTime << 5) | ((uint8_t)m_settings.filter << 2) | (_useSPI() ? 1 : 0);
+}
+
+
+/*
+* Maximum measurement time from the datasheet (appendix B), plus the standby
+*   time in normal mode.
+*/
+uint32_t BME280::measurementPeriod() {
+  const uint32_t STANDBY_US[8] = {500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000};
+  const uint8_t  T_OSR = (uint8_t) m_settings.tempOSR;
+  const uint8_t  P_OSR = (uint8_t) m_settings.presOSR;
+  const uint8_t  H_OSR = (uint8_t) m_settings.humOSR;
+  uint32_t ret = 1250;
+  if (T_OSR) ret += 2300 * (1 << (T_OSR - 1));
+  if (P_OSR) ret += 2300 * (1 << (P_OSR - 1)) + 575;
+  if (H_OSR) ret += 2300 * (1 << (H_OSR - 1)) + 575;
+  if (BME280Mode::Normal == m_settings.mode) {
+    ret += STANDBY_US[(uint8_t) m_settings.standbyTime & 0x07];
+  }
+  return ret;
 }
 
 
@@ -153,23 +197,49 @@ bool BME280::ReadTrim() {
 }
 
 
-bool BME280::ReadData(int32_t data[SENSOR_DATA_LENGTH]) {
-  // For forced mode we need to write the mode to BME280 register before reading
-  bool success = (m_settings.mode == BME280Mode::Forced) ? WriteSettings() : true;
+bool BME280::ReadData() {
+  bool success = true;
+  if (m_settings.mode == BME280Mode::Forced) {
+    // For forced mode, only ctrl_meas needs to be re-written to start a conversion.
+    uint8_t ctrlHum, ctrlMeas, config;
+    CalculateRegisters(ctrlHum, ctrlMeas, config);
+    success = WriteRegister(CTRL_MEAS_ADDR, ctrlMeas);
+  }
 
   // Registers are in order. So we can start at the pressure register and read 8 bytes.
   if (success) {
-    uint8_t buffer[SENSOR_DATA_LENGTH];
-    success = ReadRegister(PRESS_ADDR, buffer, SENSOR_DATA_LENGTH);
-    for(int i = 0; i < SENSOR_DATA_LENGTH; ++i) {
-      data[i] = static_cast<int32_t>(buffer[i]);
-    }
+    success = ReadRegister(PRESS_ADDR, _sample_buf, SENSOR_DATA_LENGTH);
+    _baro_clear_flag(BME280_FLAG_SNAPSHOT_VALID);
+    _baro_set_flag(BME280_FLAG_SAMPLE_VALID, success);
   }
   return success;
 }
 
 
-float BME280::CalculateTemperature(int32_t raw, int32_t& t_fine, TempUnit unit) {
+/*
+* Compensates the raw sample. Temperature goes first, since the other two
+*   depend on t_fine.
+*/
+bool BME280::_snapshot() {
+  if (!_baro_flag(BME280_FLAG_SAMPLE_VALID)) {
+    return false;
+  }
+  if (!_baro_flag(BME280_FLAG_SNAPSHOT_VALID)) {
+    const uint8_t* data = _sample_buf;
+    const int32_t RAW_P = ((uint32_t) data[0] << 12) | ((uint32_t) data[1] << 4) | (data[2] >> 4);
+    const int32_t RAW_T = ((uint32_t) data[3] << 12) | ((uint32_t) data[4] << 4) | (data[5] >> 4);
+    const int32_t RAW_H = ((uint32_t) data[6] << 8) | data[7];
+    _snap_temp = CalculateTemperature(RAW_T, _t_fine);
+    _snap_pres = CalculatePressure(RAW_P, _t_fine);
+    _snap_hum  = hasHumidity() ? CalculateHumidity(RAW_H, _t_fine) : NAN;
+    _compensations++;
+    _baro_set_flag(BME280_FLAG_SNAPSHOT_VALID);
+  }
+  return true;
+}
+
+
+float BME280::CalculateTemperature(int32_t raw, int32_t& t_fine) {
   // Code based on calibration algorthim provided by Bosch.
   int32_t var1, var2, final;
   uint16_t dig_T1 = (m_dig[1] << 8) | m_dig[0];
@@ -179,7 +249,7 @@ float BME280::CalculateTemperature(int32_t raw, int32_t& t_fine, TempUnit unit)
   var2 = (((((raw >> 4) - ((int32_t)dig_T1)) * ((raw >> 4) - ((int32_t)dig_T1))) >> 12) * ((int32_t)dig_T3)) >> 14;
   t_fine = var1 + var2;
   final = (t_fine * 5 + 128) >> 8;
-  return unit == TempUnit::Celsius ? final/100.0 : final/100.0*9.0/5.0 + 32.0;
+  return final/100.0f;
 }
 
 
@@ -205,10 +275,9 @@ float BME280::CalculateHumidity(int32_t raw, int32_t t_fine) {
 }
 
 
-float BME280::CalculatePressure(int32_t raw, int32_t t_fine, PresUnit unit) {
+float BME280::CalculatePressure(int32_t raw, int32_t t_fine) {
    // Code based on calibration algorthim provided by Bosch.
    int64_t var1, var2, pressure;
-   float final;
 
    uint16_t dig_P1 = (m_dig[7]   << 8) | m_dig[6];
    int16_t   dig_P2 = (m_dig[9]   << 8) | m_dig[8];
@@ -233,8 +302,16 @@ float BME280::CalculatePressure(int32_t raw, int32_t t_fine, PresUnit unit) {
    var2 = (((int64_t)dig_P8) * pressure) >> 19;
    pressure = ((pressure + var1 + var2) >> 8) + (((int64_t)dig_P7) << 4);
 
-   final = ((uint32_t)pressure)/256.0;
+   return ((uint32_t)pressure)/256.0f;
+}
+
+
+float BME280::_convert_temp(float c, TempUnit unit) {
+   return (TempUnit::Celsius == unit) ? c : (c * 9.0f/5.0f + 32.0f);
+}
 
+
+float BME280::_convert_pres(float final, PresUnit unit) {
    // Conversion units courtesy of www.endmemo.com.
    switch(unit){
       case PresUnit::hPa: /* hPa */
@@ -263,51 +340,47 @@ float BME280::CalculatePressure(int32_t raw, int32_t t_fine, PresUnit unit) {
 
 
 float BME280::temp(TempUnit unit) {
-  int32_t data[8];
-  int32_t t_fine;
-  if(!ReadData(data)){ return NAN; }
-  uint32_t rawTemp   = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
-  return CalculateTemperature(rawTemp, t_fine, unit);
+  if (!_baro_flag(BME280_FLAG_SAMPLE_VALID) && !ReadData()) { return NAN; }
+  _snapshot();
+  return _convert_temp(_snap_temp, unit);
 }
 
 
 float BME280::pres(PresUnit unit) {
-  int32_t data[8];
-  int32_t t_fine;
-  if(!ReadData(data)){ return NAN; }
-  uint32_t rawTemp       = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
-  uint32_t rawPressure = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
-  CalculateTemperature(rawTemp, t_fine);
-  return CalculatePressure(rawPressure, t_fine, unit);
+  if (!_baro_flag(BME280_FLAG_SAMPLE_VALID) && !ReadData()) { return NAN; }
+  _snapshot();
+  return _convert_pres(_snap_pres, unit);
 }
 
 
 float BME280::hum() {
-   int32_t data[8];
-   int32_t t_fine;
-   if(!ReadData(data)){ return NAN; }
-   uint32_t rawTemp = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
-   uint32_t rawHumidity = (data[6] << 8) | data[7];
-   CalculateTemperature(rawTemp, t_fine);
-   return CalculateHumidity(rawHumidity, t_fine);
+  if (!_baro_flag(BME280_FLAG_SAMPLE_VALID) && !ReadData()) { return NAN; }
+  _snapshot();
+  return _snap_hum;
 }
 
 
 bool BME280::read(float* pressure, float* temp, float* humidity, TempUnit tempUnit, PresUnit presUnit) {
-   int32_t data[8];
-   int32_t t_fine;
-   if (!ReadData(data)) {
+   if (!ReadData()) {
       *pressure = NAN;
       *temp = NAN;
       *humidity = NAN;
       return false;
    }
-   uint32_t rawPressure = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
-   uint32_t rawTemp = (data[3] << 12) | (data[4] << 4) | (data[5] >> 4);
-   uint32_t rawHumidity = (data[6] << 8) | data[7];
-   *temp = CalculateTemperature(rawTemp, t_fine, tempUnit);
-   *pressure = CalculatePressure(rawPressure, t_fine, presUnit);
-   *humidity = CalculateHumidity(rawHumidity, t_fine);
+   return lastSample(pressure, temp, humidity, tempUnit, presUnit);
+}
+
+
+bool BME280::lastSample(float* pressure, float* temp, float* humidity, TempUnit tempUnit, PresUnit presUnit) {
+   if (!_snapshot()) {
+      *pressure = NAN;
+      *temp = NAN;
+      *humidity = NAN;
+      return false;
+   }
+   *temp     = _convert_temp(_snap_temp, tempUnit);
+   *pressure = _convert_pres(_snap_pres, presUnit);
+   *humidity = _snap_hum;
    return true;
 }
 
@@ -320,19 +393,19 @@ float BME280::Altitude(float pressure, float seaLevelPressure) {
   // Equations courtesy of NOAA;
   float altitude = NAN;
   if (!isnan(pressure) && !isnan(seaLevelPressure)){
-    altitude = 1000.0 * (seaLevelPressure - pressure) / 3386.3752577878;
+    altitude = BME280_ALTITUDE(pressure, seaLevelPressure);
   }
   return (LengthUnit::Meters == _unit_length) ? altitude : altitude * 0.3048;
 }
 
 
 float BME280::SealevelAlitude(float A, float T, float P) {
-  return (P / pow(1-((0.0065 *A) / (T + (0.0065 *A) + 273.15)),5.257));
+  return BME280_SEA_LEVEL(A, T, P);
 }
 
 
 float BME280::EquivalentSeaLevelPressure(float altitude, float temp, float pres) {
-  return (pres / pow(1-((0.0065 *altitude) / (temp + (0.0065 *altitude) + 273.15)),5.257));
+  return BME280_SEA_LEVEL(altitude, temp, pres);
 }
 
 
@@ -343,11 +416,11 @@ float BME280::DewPoint(float temp, float hum, TempUnit tempUnit) {
   float dewPoint = NAN;
   if (!isnan(temp) && !isnan(hum)) {
     if (TempUnit::Celsius == _unit_temp) {
-      dewPoint = 243.04 * (log(hum/100.0) + ((17.625 * temp)/(243.04 + temp))) /(17.625 - log(hum/100.0) - ((17.625 * temp)/(243.04 + temp)));
+      dewPoint = BME280_DEW_POINT(temp, hum);
     }
     else {
       float ctemp = (temp - 32.0) * 5.0/9.0;
-      dewPoint = 243.04 * (log(hum/100.0) + ((17.625 * ctemp)/(243.04 + ctemp))) /(17.625 - log(hum/100.0) - ((17.625 * ctemp)/(243.04 + ctemp)));
+      dewPoint = BME280_DEW_POINT(ctemp, hum);
       dewPoint = dewPoint * 9.0/5.0 + 32.0;
     }
   }
@@ -355,46 +428,129 @@ float BME280::DewPoint(float temp, float hum, TempUnit tempUnit) {
 }
 
 
+/*
+* Equations courtesy of NOAA (Rothfusz regression, with Steadman's simple
+*   form below 80F, as the NWS does it). The regression works in Fahrenheit.
+*/
+float BME280::HeatIndex(float temp, float hum) {
+  if (isnan(temp) || isnan(hum)) {
+    return NAN;
+  }
+  return BME280_HEAT_INDEX(temp, hum);
+}
+
+
+/*
+* Saturation vapor pressure by the Magnus formula, scaled by RH, and put
+*   through the ideal gas law for water vapor.
+*/
+float BME280::AbsoluteHumidity(float temp, float hum) {
+  if (isnan(temp) || isnan(hum)) {
+    return NAN;
+  }
+  return BME280_ABS_HUMIDITY(temp, hum);
+}
+
+
 /*******************************************************************************
 * Members and logic specific to the i2c package
 *******************************************************************************/
-BME280I2C::BME280I2C(const BME280Settings& settings) : BME280(settings) {}
+BME280I2C::BME280I2C(const BME280Settings& settings) : BME280(settings), I2CDevice(settings.BUS_BYTE) {}
 
 
 bool BME280I2C::WriteRegister(uint8_t addr, uint8_t data) {
   bool ret = false;
   if (devFound()) {
-    _bus->beginTransmission(m_settings.BUS_BYTE);
-    _bus->write(addr);
-    _bus->write(data);
-    ret = (0 == _bus->endTransmission());
+    ret = (0 == _bus_write8(addr, data));
   }
   return ret;
 }
 
 
 bool BME280I2C::ReadRegister(uint8_t addr, uint8_t data[], uint8_t length) {
-  bool ret = false;
-  uint8_t ord = 0;
-  _bus->beginTransmission(m_settings.BUS_BYTE);
-  _bus->write(addr);
-  if (0 == _bus->endTransmission()) {
-    _bus->requestFrom(m_settings.BUS_BYTE, length);
-    while(_bus->available()) {
-      data[ord++] = _bus->read();
-    }
-    ret = (ord == length);
-  }
-  return ret;
+  return (0 == _bus_read(addr, data, length));
 }
 
 
-int8_t BME280I2C::init(TwoWire* b) {
+int8_t BME280I2C::init(I2CBusQueue* b) {
   int8_t ret = -1;
   if (nullptr != b) {
     _baro_clear_flag(BME280_FLAG_USE_SPI);
-    _bus = b;
+    _bus_queue = b;
     ret = _priv_init() ? 0 : -2;
   }
   return ret;
 }
+
+
+/*
+* Poll the class for updates. Each call that finds the bus free queues a read
+*   of the sample registers, followed (in forced mode) by the trigger for the
+*   next conversion. So the sample reported by a given call to poll() was
+*   converted during the previous poll interval.
+* In normal mode, nothing is written. The read starts at the status register,
+*   and the sample is only reported if the part converted since the last read.
+*   So this can be polled faster than measurementPeriod() without reporting
+*   the same measurement twice.
+* Returns...
+*   -3 if not initialized.
+*   -1 if a read was due, but couldn't be queued.
+*   0  if nothing new is available.
+*   1  if a sample arrived, and can be had with lastSample().
+*/
+int8_t BME280I2C::poll() {
+  int8_t ret = -3;
+  if (initialized()) {
+    ret = 0;
+    if (_baro_flag(BME280_FLAG_SAMPLE_FRESH)) {
+      _baro_clear_flag(BME280_FLAG_SAMPLE_FRESH);
+      ret = 1;
+    }
+    if (!_data_op.inFlight() && !_trigger_op.inFlight()) {
+      const bool NORMAL = (BME280Mode::Normal == m_settings.mode);
+      const int8_t RES = NORMAL ?
+        _bus_read_async(&_data_op, STATUS_ADDR, _burst_buf, BURST_LENGTH) :
+        _bus_read_async(&_data_op, PRESS_ADDR, _sample_buf, SENSOR_DATA_LENGTH);
+      if (0 != RES) {
+        ret = -1;
+      }
+      else if (BME280Mode::Forced == m_settings.mode) {
+        // Only ctrl_meas needs to be re-written to start a forced conversion.
+        uint8_t ctrlHum, config;
+        CalculateRegisters(ctrlHum, _ctrl_meas, config);
+        _bus_write_async(&_trigger_op, CTRL_MEAS_ADDR, &_ctrl_meas, 1);
+      }
+    }
+  }
+  return ret;
+}
+
+
+/*
+* In normal mode, the data registers are shadowed, so they are consistent even
+*   if a conversion is running. A new measurement shows up as changed data, or
+*   as the "measuring" bit falling since the last read.
+*/
+int8_t BME280I2C::io_op_callback(I2CBusOp* op) {
+  if ((op == &_data_op) && op->complete()) {
+    bool fresh = true;
+    if (BME280Mode::Normal == m_settings.mode) {
+      const uint8_t* DATA          = &_burst_buf[BURST_LENGTH - SENSOR_DATA_LENGTH];
+      const bool     WAS_MEASURING = _baro_flag(BME280_FLAG_MEASURING);
+      const bool     MEASURING     = (_burst_buf[0] & STATUS_MEASURING);
+      _baro_set_flag(BME280_FLAG_MEASURING, MEASURING);
+      fresh = !_baro_flag(BME280_FLAG_SAMPLE_VALID) ||
+        (WAS_MEASURING && !MEASURING) ||
+        (0 != memcmp(DATA, _sample_buf, SENSOR_DATA_LENGTH));
+      if (fresh) {
+        memcpy(_sample_buf, DATA, SENSOR_DATA_LENGTH);
+      }
+    }
+    if (fresh) {
+      _baro_clear_flag(BME280_FLAG_SNAPSHOT_VALID);
+      _baro_set_flag(BME280_FLAG_SAMPLE_VALID | BME280_FLAG_SAMPLE_FRESH);
+      _count_sample();
+    }
+  }
+  return 0;
+}
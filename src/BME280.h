@@ -14,6 +14,15 @@
 *   a TwoWire pointer. Data operations are now guarded by hardware error checks.
 * Encapsulated data is now (mostly) condensed and aligned.
 *                                                  ---J. Ian Lindsay  2020.02.04
+*
+* The i2c package now lives on an I2CBusQueue. Sample reads are queued by
+*   poll(), and the result is picked up with lastSample().
+*
+* In Normal mode, the part converts on its own (at the pace of its standby
+*   timer), and poll() only reads. Each read takes the status register along
+*   with the data, and only a new conversion is reported. Every measurement is
+*   compensated once (on first use) into a snapshot, and all of the accessors
+*   serve from that.
 */
 
 /*
@@ -50,6 +59,7 @@ courtesy of Brian McNoldy at http://andrew.rsmas.miami.edu.
 */
 
 #include <Arduino.h>
+#include "I2CBusQueue.h"
 
 #ifndef TG_BME_280_H
 #define TG_BME_280_H
@@ -62,6 +72,12 @@ courtesy of Brian McNoldy at http://andrew.rsmas.miami.edu.
 #define BME280_FLAG_INITIALIZED      0x0004  // Registers are initialized.
 #define BME280_FLAG_ENABLED          0x0008  // Device is measuring.
 #define BME280_FLAG_USE_SPI          0x0010  // Enable the SPI interface.
+#define BME280_FLAG_SAMPLE_VALID     0x0020  // _sample_buf holds a real sample.
+#define BME280_FLAG_SAMPLE_FRESH     0x0040  // A sample arrived that poll() hasn't reported.
+#define BME280_FLAG_SNAPSHOT_VALID   0x0080  // The snapshot is compensated from _sample_buf.
+#define BME280_FLAG_MEASURING        0x0100  // Status said "measuring" at the last read.
+
+#define BME280_SENSOR_DATA_LENGTH    8
 
 
 enum class PhysicalUnits : uint8_t {
@@ -108,7 +124,7 @@ enum class BME280StandbyTime : uint8_t {
   StandbyTime_62500us = 1,
   StandbyTime_125ms   = 2,
   StandbyTime_250ms   = 3,
-  StandbyTime_50ms    = 4,
+  StandbyTime_500ms   = 4,
   StandbyTime_1000ms  = 5,
   StandbyTime_10ms    = 6,
   StandbyTime_20ms    = 7
@@ -163,17 +179,22 @@ class BME280 {
     inline bool  hasHumidity() {    return _baro_flag(BME280_FLAG_HAS_HUMIDITY);    };
 
 
-    // Read the temperature from the BME280 and return a float.
+    // The temperature from the latest measurement. Only touches the bus
+    // if there hasn't been one yet.
     float temp(TempUnit unit = TempUnit::Celsius);
 
-    // Read the pressure from the BME280 and return a float with the
-    // specified unit.
+    // The pressure from the latest measurement, in the specified unit.
     float pres(PresUnit unit = PresUnit::Pa);
 
-    // Read the humidity from the BME280 and return a percentage
-    // as a float.
+    // The humidity from the latest measurement, as a percentage.
     float hum();
 
+    // Time between measurements with the current settings, in microseconds.
+    // In forced mode, this is only the conversion time.
+    uint32_t measurementPeriod();
+
+    inline uint32_t compensations() {   return _compensations;   };
+
     // Calculate the altitude based on the pressure with the
     // specified units.
     float Altitude(float pressure, float seaLevelPressure = PRESSURE_AT_SEALEVEL); // Pressure given in Pa.
@@ -194,18 +215,40 @@ class BME280 {
     // humidity with the specified units.
     float DewPoint(float temp, float hum, TempUnit tempUnit = TempUnit::Celsius);
 
-    // Read the data from the BME280 in the specified unit.
+    // Apparent temperature (NOAA heat index), in Celsius.
+    // @param temp in Celsius.
+    float HeatIndex(float temp, float hum);
+
+    // Water vapor density in g/m^3.
+    // @param temp in Celsius.
+    float AbsoluteHumidity(float temp, float hum);
+
+    // Read a new sample from the BME280 (blocking), in the specified unit.
     bool read(
       float* pressure, float* temperature, float* humidity,
       TempUnit tempUnit = TempUnit::Celsius,
       PresUnit presUnit = PresUnit::Pa);
 
+    // Convert the most recent sample fetched by poll(), without bus I/O.
+    bool lastSample(
+      float* pressure, float* temperature, float* humidity,
+      TempUnit tempUnit = TempUnit::Celsius,
+      PresUnit presUnit = PresUnit::Pa);
+
     bool setSettings(const BME280Settings& settings);
     const BME280Settings& getSettings() const;
 
 
   protected:
     BME280Settings m_settings;   // Main grouping of operational settings.
+    uint8_t _sample_buf[BME280_SENSOR_DATA_LENGTH];  // Raw data from the last poll().
+
+    /* The compensated snapshot of _sample_buf. */
+    float    _snap_pres = NAN;    // Pa
+    float    _snap_temp = NAN;    // C
+    float    _snap_hum  = NAN;    // %RH
+    int32_t  _t_fine    = 0;
+    uint32_t _compensations = 0;
 
     /* This constructor is only a delegate to an extending class. */
     BME280(const BME280Settings& settings);
@@ -229,6 +272,9 @@ class BME280 {
 
     inline bool _useSPI() {     return _baro_flag(BME280_FLAG_USE_SPI);     };
 
+    // Calculates registers based on settings.
+    void CalculateRegisters(uint8_t& ctrlHum, uint8_t& ctrlMeas, uint8_t& config);
+
 
   private:
     LengthUnit _unit_length = LengthUnit::Meters;
@@ -242,10 +288,6 @@ class BME280 {
     // Read values from BME280 registers.
     virtual bool ReadRegister(uint8_t addr, uint8_t data[], uint8_t length) =0;
 
-
-    // Calculates registers based on settings.
-    void CalculateRegisters(uint8_t& ctrlHum, uint8_t& ctrlMeas, uint8_t& config);
-
     // Write the settings to the chip.
     bool WriteSettings();
 
@@ -257,37 +299,50 @@ class BME280 {
     // successful.
     bool ReadTrim();
 
-    // Read the raw data from the BME280 into an array and return
+    // Read the raw data from the BME280 into _sample_buf and return
     // true if successful.
-    bool ReadData(int32_t data[8]);
+    bool ReadData();
 
-    // Calculate the temperature from the BME280 raw data and
-    // BME280 trim, return a float.
-    float CalculateTemperature(int32_t raw, int32_t& t_fine, TempUnit unit = TempUnit::Celsius);
+    // Compensate _sample_buf into the snapshot, unless that's already done.
+    bool _snapshot();
+
+    // Calculate the temperature (C) from the BME280 raw data and
+    // BME280 trim, and leave t_fine for the others.
+    float CalculateTemperature(int32_t raw, int32_t& t_fine);
 
     // Calculate the humidity from the BME280 raw data and BME280
     // trim, return a float.
     float CalculateHumidity(int32_t raw, int32_t t_fine);
 
-    // Calculate the pressure from the BME280 raw data and BME280
-    // trim, return a float.
-    float CalculatePressure(int32_t raw, int32_t t_fine, PresUnit unit = PresUnit::Pa);
+    // Calculate the pressure (Pa) from the BME280 raw data and
+    // BME280 trim, return a float.
+    float CalculatePressure(int32_t raw, int32_t t_fine);
+
+    static float _convert_temp(float c, TempUnit);
+    static float _convert_pres(float pa, PresUnit);
 };
 
 
 //////////////////////////////////////////////////////////////////
 /// BME280I2C - I2C Implementation of BME280.
-class BME280I2C: public BME280 {
+class BME280I2C: public BME280, public I2CDevice {
   public:
     // Constructor used to create the class. All parameters have
     // default values.
     BME280I2C(const BME280Settings& settings);
 
-    int8_t init(TwoWire* b = &Wire);     // Method used to initialize the class.
+    int8_t init(I2CBusQueue*);     // Method used to initialize the class.
+    int8_t poll();
+
+    /* Overrides from I2CDevice. */
+    int8_t io_op_callback(I2CBusOp*);
 
 
   private:
-    TwoWire* _bus = nullptr;
+    I2CBusOp _data_op;      // Reads the sample registers.
+    I2CBusOp _trigger_op;   // Starts a conversion in forced mode.
+    uint8_t  _ctrl_meas = 0;
+    uint8_t  _burst_buf[12];  // status through hum_lsb, for normal mode.
 
     // Write values to BME280 registers.
     virtual bool WriteRegister(uint8_t addr, uint8_t data);
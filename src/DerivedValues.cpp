@@ -0,0 +1,118 @@
+/*
+* Lazily computed quantities that are worked out from raw readings.
+* See the header file for the rules.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "DerivedValues.h"
+
+
+/*
+* Adds a raw input. It stays invalid until the first set().
+* Returns its ID, or -1 if there is no room.
+*/
+int8_t DerivedValues::defineInput(const char* name) {
+  return _add(name, nullptr);
+}
+
+
+/*
+* Adds a derived value, computed by the given function from the IDs in the
+*   bitmask. Those must already be defined.
+* Returns its ID, or -1 on failure.
+*/
+int8_t DerivedValues::define(const char* name, DerivedFxn fxn, uint16_t depends_on) {
+  if ((nullptr == fxn) || (0 != (depends_on >> _count))) {
+    return -1;
+  }
+  const int8_t ID = _add(name, fxn);
+  if (0 > ID) {
+    return ID;
+  }
+  // Anything that invalidates one of our dependencies also invalidates us.
+  for (uint8_t i = 0; i < ID; i++) {
+    const bool DIRECT   = (depends_on & (1 << i));
+    const bool INDIRECT = (0 != (_dependents[i] & depends_on));
+    if (DIRECT || INDIRECT) {
+      _dependents[i] |= (1 << ID);
+    }
+  }
+  return ID;
+}
+
+
+/*
+* Sets a raw input. If it changed, everything that depends on it is marked
+*   for recomputation.
+*/
+void DerivedValues::set(uint8_t id, float value) {
+  if ((id >= _count) || (nullptr != _fxns[id])) {
+    return;
+  }
+  const bool SAME = (_valid & (1 << id)) && (0 == memcmp(&value, &_values[id], sizeof(float)));
+  if (!SAME) {
+    _values[id] = value;
+    _valid = (_valid | (1 << id)) & ~_dependents[id];
+  }
+}
+
+
+/*
+* Returns the value of the given ID, computing it first if it isn't current.
+*   An input that was never set gives NAN.
+*/
+float DerivedValues::get(uint8_t id) {
+  if (id >= _count) {
+    return NAN;
+  }
+  if (_valid & (1 << id)) {
+    _hits[id]++;
+    return _values[id];
+  }
+  if (nullptr == _fxns[id]) {
+    return NAN;
+  }
+  _values[id] = _fxns[id](this);
+  _valid |= (1 << id);
+  _computes[id]++;
+  return _values[id];
+}
+
+
+void DerivedValues::resetStats() {
+  for (uint8_t i = 0; i < _count; i++) {
+    _computes[i] = 0;
+    _hits[i]     = 0;
+  }
+}
+
+
+void DerivedValues::printDebug(StringBuilder* output) {
+  output->concat("Derived values:\n");
+  for (uint8_t i = 0; i < _count; i++) {
+    if (nullptr == _fxns[i]) {
+      output->concatf("\t%-12s input     %.3f\n", _names[i], (double) _values[i]);
+    }
+    else {
+      output->concatf(
+        "\t%-12s %-9s %.3f  (%u computed, %u cached)\n",
+        _names[i], valid(i) ? "current" : "stale", (double) _values[i], _computes[i], _hits[i]
+      );
+    }
+  }
+}
+
+
+int8_t DerivedValues::_add(const char* name, DerivedFxn fxn) {
+  if (_count >= DERIVED_MAX_IDS) {
+    return -1;
+  }
+  _names[_count]      = name;
+  _fxns[_count]       = fxn;
+  _dependents[_count] = 0;
+  _values[_count]     = NAN;
+  _computes[_count]   = 0;
+  _hits[_count]       = 0;
+  return (int8_t) _count++;
+}
@@ -0,0 +1,59 @@
+/*
+* Lazily computed quantities that are worked out from raw readings.
+*
+* A DerivedValues holds a few raw inputs and the values derived from them,
+*   all sharing one small ID space. Each derived value names what it is
+*   computed from, which may be inputs or other derived values. From that,
+*   the set works out (once, at definition) which derived values every ID
+*   invalidates. So setting an input only clears a bitmask, and nothing is
+*   computed until something asks for it with get(). The result is then
+*   cached until one of the inputs it depends on changes.
+*
+* A derived value must be defined after everything it depends on, so the
+*   graph can't have cycles. Compute functions fetch their own inputs with
+*   get(), so a chain of derived values is filled in on demand.
+*
+* Nothing in here allocates.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __DERIVED_VALUES_H_
+#define __DERIVED_VALUES_H_
+
+#define DERIVED_MAX_IDS   16
+
+class DerivedValues;
+
+typedef float (*DerivedFxn)(DerivedValues*);
+
+
+class DerivedValues {
+  public:
+    int8_t defineInput(const char* name);
+    int8_t define(const char* name, DerivedFxn, uint16_t depends_on);
+    void   set(uint8_t id, float value);
+    float  get(uint8_t id);
+    void   resetStats();
+    void   printDebug(StringBuilder*);
+
+    inline bool    valid(uint8_t id) {   return (id < _count) && (_valid & (1 << id));  };
+    inline uint8_t count() {             return _count;   };
+
+
+  private:
+    const char* _names[DERIVED_MAX_IDS];
+    DerivedFxn  _fxns[DERIVED_MAX_IDS];        // nullptr for inputs.
+    uint16_t    _dependents[DERIVED_MAX_IDS];  // Derived values that each ID invalidates.
+    float       _values[DERIVED_MAX_IDS];
+    uint32_t    _computes[DERIVED_MAX_IDS];
+    uint32_t    _hits[DERIVED_MAX_IDS];
+    uint16_t    _valid = 0;
+    uint8_t     _count = 0;
+
+    int8_t _add(const char* name, DerivedFxn);
+};
+
+#endif  // __DERIVED_VALUES_H_
@@ -0,0 +1,337 @@
+/*
+* Graph-side helpers for SensorFilter histories.
+*
+* RingView is a non-owning window over a ring of samples. It indexes from the
+*   oldest sample to the newest, so a renderer can walk a filter's memory in
+*   place, without un-rotating it into a copy first. Wrapping is done with a
+*   compare instead of a modulo.
+*
+* GraphSeries is a SensorFilter that also keeps the running minimum and
+*   maximum of its window. Each is a monotonic deque of slot indices into the
+*   filter's own memory, updated as samples are fed. So min/max are O(1) to
+*   read, and amortized O(1) to maintain, no matter how long the window is.
+*   The deques are allocated once, by init(), as the filter's memory is.
+*
+* For windows much longer than a graph is wide, GraphSeries also keeps a min/max
+*   envelope for each block of consecutive slots, sized so that the window
+*   comes to GRAPH_SERIES_COLUMNS blocks. Blocks are updated as samples land in
+*   them, so a renderer can draw any length of history by reading one (or a
+*   few) envelopes per column. The block being written holds only the samples
+*   written since it was last started. Until it fills, the older samples left
+*   in it are not reported. A long window always comes to exactly
+*   GRAPH_SERIES_COLUMNS blocks, so the graph fills its width. Windows that
+*   are a multiple of that make every block the same width. Otherwise, block
+*   widths differ by at most one slot. At or below GRAPH_SERIES_COLUMNS,
+*   each slot is its own block, and no envelopes are stored.
+*
+* A RollupSeries may be attached to hold the same stream at coarser tiers, and
+*   a CompressedSeries to hold it at full resolution for longer than the
+*   window. Both are fed by feedFilter(), and initialized by init().
+*
+* Only samples that were actually fed are tracked. Slots that the filter has
+*   not yet written are ignored by minimum()/maximum(), but are still part of view().
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <SensorFilter.h>
+#include "RollupSeries.h"
+#include "SeriesCodec.h"
+
+#ifndef __GRAPH_SERIES_H_
+#define __GRAPH_SERIES_H_
+
+#ifndef GRAPH_SERIES_COLUMNS
+  #define GRAPH_SERIES_COLUMNS   96   // Envelope blocks in a long window.
+#endif
+
+
+/*******************************************************************************
+* A read-only view of a ring buffer, oldest sample first.
+*******************************************************************************/
+template <typename T> class RingView {
+  public:
+    class iterator {
+      public:
+        iterator(const RingView* v, uint16_t i) : _v(v), _i(i) {};
+        inline T         operator*() const {  return (*_v)[_i];  };
+        inline iterator& operator++() {       _i++;  return *this;  };
+        inline bool operator!=(const iterator& o) const {  return (_i != o._i);  };
+
+      private:
+        const RingView* _v;
+        uint16_t        _i;
+    };
+
+    RingView(const T* mem, uint16_t size, uint16_t oldest) :
+      RingView(mem, size, ((oldest < size) ? oldest : 0), size) {};
+
+    inline uint16_t size() const {    return _len;   };
+    inline T        newest() const {  return (*this)[_len - 1];  };
+    inline T operator[](uint16_t i) const {
+      uint32_t idx = (uint32_t) _oldest + i;
+      if (idx >= _size) idx -= _size;
+      return _mem[idx];
+    };
+
+    /* The newest n samples, as a view of their own. */
+    inline RingView tail(uint16_t n) const {
+      if (n >= _len) return *this;
+      uint32_t start = (uint32_t) _oldest + (_len - n);
+      if (start >= _size) start -= _size;
+      return RingView(_mem, _size, (uint16_t) start, n);
+    };
+
+    inline iterator begin() const {   return iterator(this, 0);     };
+    inline iterator end() const {     return iterator(this, _len);  };
+
+
+  private:
+    const T* _mem;
+    uint16_t _size;     // Length of the ring in memory.
+    uint16_t _oldest;   // Slot of the first sample in the view.
+    uint16_t _len;      // Samples in the view.
+
+    RingView(const T* mem, uint16_t size, uint16_t oldest, uint16_t len) :
+      _mem(mem), _size(size), _oldest(oldest), _len(len) {};
+};
+
+
+/*******************************************************************************
+* A SensorFilter that knows the extremes of its window.
+*******************************************************************************/
+template <typename T> class GraphSeries : public SensorFilter<T> {
+  public:
+    GraphSeries(FilteringStrategy s, int window, int param) : SensorFilter<T>(s, window, param) {};
+    ~GraphSeries() {
+      _free();
+    };
+
+    using SensorFilter<T>::windowSize;
+
+    /* These shadow the SensorFilter versions, and keep the deques in step. */
+    int8_t init();
+    int8_t windowSize(uint16_t);
+    int8_t feedFilter(T);
+
+    inline uint16_t samples() {  return _count;                          };
+    inline T newest() {   return (_count > 0) ? _at(_newest) : T(0);     };
+    inline T minimum() {  return (_min_len > 0) ? _at(_min_q[_min_head]) : T(0);  };
+    inline T maximum() {  return (_max_len > 0) ? _at(_max_q[_max_head]) : T(0);  };
+
+    inline void          rollup(RollupSeries* r) {  _rollup = r;     };
+    inline RollupSeries* rollup() {                 return _rollup;  };
+    inline void              archive(CompressedSeries* a) {  _archive = a;     };
+    inline CompressedSeries* archive() {                     return _archive;  };
+
+    /* Envelope blocks that hold samples, oldest first. */
+    inline uint16_t blockSize() {  return _blk_size;  };   // The widest block.
+    uint16_t blocks();
+    void     block(uint16_t i, T* lo, T* hi);
+
+    /* The whole window, oldest first, read from the filter's own memory. */
+    inline RingView<T> view() {
+      return RingView<T>(this->memPtr(), this->windowSize(), this->lastIndex());
+    };
+
+
+  private:
+    uint16_t* _min_q    = nullptr;   // Slot indices, oldest first.
+    uint16_t* _max_q    = nullptr;
+    uint16_t  _cap      = 0;
+    uint16_t  _count    = 0;
+    uint16_t  _newest   = 0;         // Slot of the last sample fed.
+    T*        _blk_min  = nullptr;
+    T*        _blk_max  = nullptr;
+    uint16_t  _blk_size = 1;
+    uint16_t  _blk_count = 0;
+    RollupSeries*     _rollup  = nullptr;
+    CompressedSeries* _archive = nullptr;
+    uint16_t  _min_head = 0;
+    uint16_t  _min_len  = 0;
+    uint16_t  _max_head = 0;
+    uint16_t  _max_len  = 0;
+
+    int8_t _alloc();
+    void   _free();
+
+    inline T _at(uint16_t slot) {  return *(this->memPtr() + slot);  };
+    inline bool     _enveloped() {  return (_blk_count < _cap);  };
+    inline uint16_t _block_of(uint16_t slot) {
+      return _enveloped() ? (uint16_t) (((uint32_t) slot * _blk_count) / _cap) : slot;
+    };
+    inline uint16_t _wrap(uint32_t i) {  return (uint16_t) ((i >= _cap) ? (i - _cap) : i);  };
+    inline uint16_t _back(uint16_t head, uint16_t len) {  return _wrap((uint32_t) head + len - 1);  };
+};
+
+
+template <typename T> int8_t GraphSeries<T>::init() {
+  int8_t ret = SensorFilter<T>::init();
+  if (ret >= 0) {
+    ret = _alloc();
+  }
+  if ((ret >= 0) && (nullptr != _rollup)) {
+    ret = _rollup->init();
+  }
+  if ((ret >= 0) && (nullptr != _archive)) {
+    ret = _archive->init();
+  }
+  return ret;
+}
+
+
+template <typename T> int8_t GraphSeries<T>::windowSize(uint16_t n) {
+  int8_t ret = SensorFilter<T>::windowSize(n);
+  if (ret >= 0) {
+    ret = _alloc();
+  }
+  return ret;
+}
+
+
+template <typename T> int8_t GraphSeries<T>::feedFilter(T val) {
+  int8_t ret = SensorFilter<T>::feedFilter(val);
+  if ((ret < 0) || (0 == _cap)) {
+    return ret;
+  }
+  if (nullptr != _rollup) {
+    _rollup->feed((float) val);
+  }
+  if (nullptr != _archive) {
+    _archive->feed((float) val);
+  }
+  // The filter advances its index past the slot it just wrote.
+  const uint16_t IDX  = this->lastIndex();
+  const uint16_t SLOT = (IDX > 0) ? (IDX - 1) : (_cap - 1);
+  _newest = SLOT;
+
+  if (_enveloped()) {
+    const uint16_t B = _block_of(SLOT);
+    if ((0 == SLOT) || (B != _block_of(SLOT - 1))) {
+      _blk_min[B] = val;
+      _blk_max[B] = val;
+    }
+    else {
+      if (val < _blk_min[B]) _blk_min[B] = val;
+      if (val > _blk_max[B]) _blk_max[B] = val;
+    }
+  }
+
+  if (_count < _cap) {
+    _count++;
+  }
+  else {
+    // The window was full, so the sample in SLOT was the oldest. If it was
+    //   still an extreme, it is at the front of its deque.
+    if ((_min_len > 0) && (SLOT == _min_q[_min_head])) {
+      _min_head = _wrap((uint32_t) _min_head + 1);
+      _min_len--;
+    }
+    if ((_max_len > 0) && (SLOT == _max_q[_max_head])) {
+      _max_head = _wrap((uint32_t) _max_head + 1);
+      _max_len--;
+    }
+  }
+
+  while ((_min_len > 0) && (_at(_min_q[_back(_min_head, _min_len)]) >= val)) {
+    _min_len--;
+  }
+  _min_q[_wrap((uint32_t) _min_head + _min_len)] = SLOT;
+  _min_len++;
+
+  while ((_max_len > 0) && (_at(_max_q[_back(_max_head, _max_len)]) <= val)) {
+    _max_len--;
+  }
+  _max_q[_wrap((uint32_t) _max_head + _max_len)] = SLOT;
+  _max_len++;
+  return ret;
+}
+
+
+template <typename T> uint16_t GraphSeries<T>::blocks() {
+  if (_count >= _cap) {
+    return _blk_count;
+  }
+  return (_count > 0) ? (_block_of(_count - 1) + 1) : 0;
+}
+
+
+/*
+* Gives the envelope of the i-th oldest block. Out-of-range blocks are empty,
+*   and leave the outputs alone.
+*/
+template <typename T> void GraphSeries<T>::block(uint16_t i, T* lo, T* hi) {
+  const uint16_t FILLED = blocks();
+  if (i >= FILLED) {
+    return;
+  }
+  // Count back from the block holding the newest sample.
+  uint32_t b = (uint32_t) _block_of(_newest) + _blk_count - (FILLED - 1) + i;
+  if (b >= _blk_count) b -= _blk_count;
+  if (_enveloped()) {
+    *lo = _blk_min[b];
+    *hi = _blk_max[b];
+  }
+  else {
+    *lo = _at((uint16_t) b);
+    *hi = *lo;
+  }
+}
+
+
+template <typename T> int8_t GraphSeries<T>::_alloc() {
+  const uint16_t N = this->windowSize();
+  if (N != _cap) {
+    _free();
+    if (N > 0) {
+      // Slot s lands in block (s * NB) / N, so a long window is always NB blocks.
+      const uint16_t NB = (N > GRAPH_SERIES_COLUMNS) ? GRAPH_SERIES_COLUMNS : N;
+      const uint16_t B  = (uint16_t) ((N + NB - 1) / NB);
+      _min_q = new uint16_t[N];
+      _max_q = new uint16_t[N];
+      if (NB < N) {
+        _blk_min = new T[NB];
+        _blk_max = new T[NB];
+      }
+      if ((nullptr == _min_q) || (nullptr == _max_q) || ((NB < N) && ((nullptr == _blk_min) || (nullptr == _blk_max)))) {
+        _free();
+        return -1;
+      }
+      _cap       = N;
+      _blk_size  = B;
+      _blk_count = NB;
+    }
+  }
+  _count    = 0;
+  _newest   = 0;
+  _min_head = 0;
+  _min_len  = 0;
+  _max_head = 0;
+  _max_len  = 0;
+  return 0;
+}
+
+
+template <typename T> void GraphSeries<T>::_free() {
+  if (nullptr != _min_q) {
+    delete[] _min_q;
+    _min_q = nullptr;
+  }
+  if (nullptr != _max_q) {
+    delete[] _max_q;
+    _max_q = nullptr;
+  }
+  if (nullptr != _blk_min) {
+    delete[] _blk_min;
+    _blk_min = nullptr;
+  }
+  if (nullptr != _blk_max) {
+    delete[] _blk_max;
+    _blk_max = nullptr;
+  }
+  _cap       = 0;
+  _blk_size  = 1;
+  _blk_count = 0;
+}
+
+#endif  // __GRAPH_SERIES_H_
@@ -0,0 +1,433 @@
+/*
+* A queued, non-blocking transaction engine for an I2C bus.
+* See the header file for the rules.
+*/
+
+#include "I2CBusQueue.h"
+
+#define I2C_BUS_QUEUE_MASK   (I2C_BUS_QUEUE_DEPTH - 1)
+
+
+/*******************************************************************************
+* I2CBusOp
+*******************************************************************************/
+
+void I2CBusOp::set(I2CDevice* dev, I2COpcode op, uint8_t addr, int16_t reg, uint8_t* b, uint16_t l) {
+  requester = dev;
+  opcode    = op;
+  dev_addr  = addr;
+  sub_addr  = reg;
+  buf       = b;
+  len       = l;
+  xfer_len  = 0;
+  chunks    = 0;
+  error     = I2C_ERR_NONE;
+  state     = I2COpState::IDLE;
+}
+
+
+
+#if defined(ARDUINO)
+/*******************************************************************************
+* TwoWireBusDriver
+*******************************************************************************/
+
+int32_t TwoWireBusDriver::xferChunk(I2CBusOp* op, uint16_t offset, uint16_t len) {
+  int32_t ret = 0;
+  switch (op->opcode) {
+    case I2COpcode::READ:
+      if (op->sub_addr >= 0) {
+        _bus->beginTransmission(op->dev_addr);
+        _bus->write((uint8_t) (op->sub_addr + offset));
+        if (0 != _bus->endTransmission(false)) {   // Repeated start.
+          return I2C_ERR_NACK;
+        }
+      }
+      _bus->requestFrom(op->dev_addr, (uint8_t) len);
+      while ((ret < len) && _bus->available()) {
+        *(op->buf + offset + ret++) = _bus->read();
+      }
+      break;
+
+    case I2COpcode::WRITE:
+      _bus->beginTransmission(op->dev_addr);
+      if (op->sub_addr >= 0) {
+        _bus->write((uint8_t) (op->sub_addr + offset));
+      }
+      _bus->write(op->buf + offset, len);
+      ret = (0 == _bus->endTransmission()) ? len : I2C_ERR_NACK;
+      break;
+
+    case I2COpcode::PING:
+      _bus->beginTransmission(op->dev_addr);
+      ret = (0 == _bus->endTransmission()) ? 0 : I2C_ERR_NACK;
+      break;
+
+    default:
+      break;
+  }
+  return ret;
+}
+
+
+/*
+* The Teensy4 Wire buffer would take a larger transfer, but each chunk blocks
+*   loop() for as long as it is on the wire. Chunks are capped at
+*   I2C_WIRE_CHUNK_LIMIT bytes to bound that stall.
+*/
+uint16_t TwoWireBusDriver::maxXferLength() {
+  return I2C_WIRE_MAX_XFER;
+}
+#endif   // ARDUINO
+
+
+
+/*******************************************************************************
+* I2CSimDevice
+*******************************************************************************/
+
+I2CSimDevice::I2CSimDevice(uint8_t addr) : ADDR(addr) {
+  for (uint16_t i = 0; i < 256; i++) {
+    regs[i] = 0;
+  }
+}
+
+
+int32_t I2CSimDevice::readRegs(uint8_t reg, uint8_t* buf, uint16_t len) {
+  for (uint16_t i = 0; i < len; i++) {
+    *(buf + i) = regs[(uint8_t) (reg + i)];
+  }
+  return len;
+}
+
+
+int32_t I2CSimDevice::writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len) {
+  for (uint16_t i = 0; i < len; i++) {
+    regs[(uint8_t) (reg + i)] = *(buf + i);
+  }
+  return len;
+}
+
+
+
+/*******************************************************************************
+* I2CSimBus
+*******************************************************************************/
+
+I2CSimBus::I2CSimBus(void (*advance_us)(uint32_t), uint32_t bus_hz, uint16_t max_xfer) :
+  _advance_us(advance_us), _BUS_HZ(bus_hz), _MAX_XFER(max_xfer) {
+  for (uint8_t i = 0; i < I2C_SIM_BUS_MAX_DEVICES; i++) {
+    _devs[i] = nullptr;
+  }
+}
+
+
+int8_t I2CSimBus::attach(I2CSimDevice* dev) {
+  for (uint8_t i = 0; i < I2C_SIM_BUS_MAX_DEVICES; i++) {
+    if (nullptr == _devs[i]) {
+      _devs[i] = dev;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+
+int32_t I2CSimBus::xferChunk(I2CBusOp* op, uint16_t offset, uint16_t len) {
+  int32_t ret = I2C_ERR_NACK;
+  // Start and stop cost about a byte-time between them.
+  uint32_t byte_times = 1 + op->wireBytes(len);
+  I2CSimDevice* dev = _find(op->dev_addr);
+  if (nullptr != dev) {
+    // Without a register address, the device's pointer is where it was left.
+    const int16_t reg = (op->sub_addr >= 0) ? (op->sub_addr + offset) : dev->pointer;
+    switch (op->opcode) {
+      case I2COpcode::READ:
+        ret = dev->readRegs((uint8_t) reg, op->buf + offset, len);
+        dev->pointer = (uint8_t) reg;
+        break;
+      case I2COpcode::WRITE:
+        ret = dev->writeRegs((uint8_t) reg, op->buf + offset, len);
+        dev->pointer = (uint8_t) reg;
+        break;
+      case I2COpcode::PING:
+        ret = 0;
+        break;
+      default:
+        break;
+    }
+  }
+  const uint32_t us = (byte_times * 9 * 1000000) / _BUS_HZ;
+  _wire_us += us;
+  if (nullptr != _advance_us) {
+    _advance_us(us);
+  }
+  return ret;
+}
+
+
+I2CSimDevice* I2CSimBus::_find(uint8_t addr) {
+  for (uint8_t i = 0; i < I2C_SIM_BUS_MAX_DEVICES; i++) {
+    if ((nullptr != _devs[i]) && (addr == _devs[i]->ADDR)) {
+      return _devs[i];
+    }
+  }
+  return nullptr;
+}
+
+
+
+/*******************************************************************************
+* I2CBusQueue
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+I2CBusQueue::I2CBusQueue(const char* name, I2CBusDriver* d, I2CClockFxn c) :
+  _NAME(name), _driver(d), _clock(c) {
+  for (uint8_t i = 0; i < I2C_BUS_QUEUE_DEPTH; i++) {
+    _ring[i] = nullptr;
+  }
+}
+
+
+/*
+* Put an op in line.
+* Returns 0 on success, or one of the I2C_ERR_* codes.
+*/
+int8_t I2CBusQueue::submit(I2CBusOp* op) {
+  if (op->inFlight()) {
+    return I2C_ERR_BUSY;
+  }
+  if ((I2COpcode::WRITE == op->opcode) && (op->wireBytes(op->len) > _driver->maxXferLength() + 1)) {
+    return I2C_ERR_TOO_LONG;
+  }
+  const uint8_t d = depth();
+  if (d >= I2C_BUS_QUEUE_DEPTH) {
+    return I2C_ERR_QUEUE_FULL;
+  }
+  op->xfer_len = 0;
+  op->chunks   = 0;
+  op->error    = I2C_ERR_NONE;
+  op->state    = I2COpState::QUEUED;
+  op->t_queued = _clock();
+  _ring[_head++ & I2C_BUS_QUEUE_MASK] = op;
+  if (d >= _depth_max) {
+    _depth_max = d + 1;
+  }
+  return 0;
+}
+
+
+/*
+* Run an op to completion right now, ahead of anything queued. This is safe
+*   because the queue never leaves a transaction open between calls to
+*   service(). The requester's callback is not called.
+* Returns 0 on success, or one of the I2C_ERR_* codes.
+*/
+int8_t I2CBusQueue::runNow(I2CBusOp* op) {
+  if (op->inFlight()) {
+    return I2C_ERR_BUSY;
+  }
+  if ((I2COpcode::WRITE == op->opcode) && (op->wireBytes(op->len) > _driver->maxXferLength() + 1)) {
+    return I2C_ERR_TOO_LONG;
+  }
+  op->xfer_len = 0;
+  op->chunks   = 0;
+  op->error    = I2C_ERR_NONE;
+  op->state    = I2COpState::ACTIVE;
+  op->t_queued = _clock();
+  int32_t ret = 0;
+  do {
+    ret = _xfer_chunk(op);
+  } while (ret > 0);
+  return op->error;
+}
+
+
+/*
+* Move one chunk of the op at the head of the line. If that finishes the op,
+*   it is removed from the queue, and its requester is called back.
+* Returns 1 if any work was done, 0 if the queue was idle.
+*/
+int8_t I2CBusQueue::service() {
+  if (idle()) {
+    return 0;
+  }
+  I2CBusOp* op = _ring[_tail & I2C_BUS_QUEUE_MASK];
+  op->state = I2COpState::ACTIVE;
+  const uint16_t moved_before = op->xfer_len;
+  const int32_t  more = _xfer_chunk(op);
+  if (nullptr != op->requester) {
+    op->requester->_stat_xfers++;
+    op->requester->_stat_bytes += op->wireBytes(op->xfer_len - moved_before);
+  }
+  if (0 >= more) {
+    _ring[_tail++ & I2C_BUS_QUEUE_MASK] = nullptr;
+    const uint32_t wait = op->t_done - op->t_queued;
+    if (wait > _wait_max) {
+      _wait_max = wait;
+    }
+    if (nullptr != op->requester) {
+      op->requester->io_op_callback(op);
+    }
+  }
+  return 1;
+}
+
+
+/*
+* Moves one chunk, and updates the op and the stats.
+* Returns 1 if the op has more to do, 0 if it completed, or -1 if it failed.
+*/
+int32_t I2CBusQueue::_xfer_chunk(I2CBusOp* op) {
+  const uint16_t remaining = op->len - op->xfer_len;
+  uint16_t max_chunk = _driver->maxXferLength();
+  if (0 < op->max_chunk) {
+    const uint16_t burst = _driver->maxBurstLength();
+    max_chunk = (op->max_chunk < burst) ? op->max_chunk : burst;
+  }
+  const uint16_t chunk     = ((I2COpcode::READ == op->opcode) && (remaining > max_chunk)) ? max_chunk : remaining;
+  const uint32_t t0 = _clock();
+  const int32_t  moved = _driver->xferChunk(op, op->xfer_len, chunk);
+  const uint32_t t1 = _clock();
+  _busy_us += (t1 - t0);
+  _xfers++;
+  if (0 == op->chunks++) {
+    op->t_started = t0;
+  }
+
+  if (moved < 0) {
+    op->error = (int8_t) moved;
+  }
+  else {
+    op->xfer_len += (uint16_t) moved;
+    _bytes += (uint32_t) moved;
+    if (moved < chunk) {
+      op->error = I2C_ERR_SHORT_READ;
+    }
+    else if (op->xfer_len < op->len) {
+      return 1;
+    }
+  }
+
+  op->t_done = t1;
+  if (I2C_ERR_NONE == op->error) {
+    op->state = I2COpState::COMPLETE;
+    _ops_ok++;
+    return 0;
+  }
+  op->state = I2COpState::FAILED;
+  _ops_failed++;
+  return -1;
+}
+
+
+void I2CBusQueue::resetStats() {
+  _depth_max  = depth();
+  _ops_ok     = 0;
+  _ops_failed = 0;
+  _xfers      = 0;
+  _bytes      = 0;
+  _busy_us    = 0;
+  _wait_max   = 0;
+  _stats_t0   = _clock();
+}
+
+
+void I2CBusQueue::printDebug(StringBuilder* output) {
+  const uint32_t elapsed = _clock() - _stats_t0;
+  output->concatf("-- I2CBusQueue %s (max xfer %u bytes)\n", _NAME, _driver->maxXferLength());
+  output->concatf("\tDepth:      %u/%u (max %u)\n", depth(), I2C_BUS_QUEUE_DEPTH, _depth_max);
+  output->concatf("\tOps:        %u ok, %u failed\n", _ops_ok, _ops_failed);
+  output->concatf("\tXfers:      %u (%u bytes)\n", _xfers, _bytes);
+  output->concatf("\tWorst wait: %uus\n", _wait_max);
+  output->concatf(
+    "\tBus busy:   %uus of %uus (%.1f%%)\n",
+    _busy_us, elapsed, (elapsed > 0) ? (100.0 * _busy_us / elapsed) : 0.0
+  );
+}
+
+
+
+/*******************************************************************************
+* I2CDevice
+*******************************************************************************/
+
+void I2CDevice::resetBusStats() {
+  _stat_samples = 0;
+  _stat_xfers   = 0;
+  _stat_bytes   = 0;
+}
+
+
+void I2CDevice::printBusStats(StringBuilder* output, const char* name) {
+  output->concatf("\t%-10s 0x%02x %8u samples", name, _DEV_ADDR, _stat_samples);
+  if (_stat_samples > 0) {
+    output->concatf(
+      "  %5.2f xfers  %6.1f bytes per sample",
+      (double) _stat_xfers / _stat_samples, (double) _stat_bytes / _stat_samples
+    );
+  }
+  output->concat("\n");
+}
+
+
+int8_t I2CDevice::_bus_read(int16_t reg, uint8_t* buf, uint16_t len) {
+  if (nullptr == _bus_queue) {
+    return I2C_ERR_NO_BUS;
+  }
+  I2CBusOp op;
+  op.set(this, I2COpcode::READ, _DEV_ADDR, reg, buf, len);
+  return _bus_queue->runNow(&op);
+}
+
+
+int8_t I2CDevice::_bus_write(int16_t reg, uint8_t* buf, uint16_t len) {
+  if (nullptr == _bus_queue) {
+    return I2C_ERR_NO_BUS;
+  }
+  I2CBusOp op;
+  op.set(this, I2COpcode::WRITE, _DEV_ADDR, reg, buf, len);
+  return _bus_queue->runNow(&op);
+}
+
+
+int8_t I2CDevice::_bus_write8(int16_t reg, uint8_t val) {
+  return _bus_write(reg, &val, 1);
+}
+
+
+int8_t I2CDevice::_bus_ping() {
+  if (nullptr == _bus_queue) {
+    return I2C_ERR_NO_BUS;
+  }
+  I2CBusOp op;
+  op.set(this, I2COpcode::PING, _DEV_ADDR, -1, nullptr, 0);
+  return _bus_queue->runNow(&op);
+}
+
+
+int8_t I2CDevice::_bus_read_async(I2CBusOp* op, int16_t reg, uint8_t* buf, uint16_t len) {
+  if (nullptr == _bus_queue) {
+    return I2C_ERR_NO_BUS;
+  }
+  if (op->inFlight()) {
+    return I2C_ERR_BUSY;
+  }
+  op->set(this, I2COpcode::READ, _DEV_ADDR, reg, buf, len);
+  return _bus_queue->submit(op);
+}
+
+
+int8_t I2CDevice::_bus_write_async(I2CBusOp* op, int16_t reg, uint8_t* buf, uint16_t len) {
+  if (nullptr == _bus_queue) {
+    return I2C_ERR_NO_BUS;
+  }
+  if (op->inFlight()) {
+    return I2C_ERR_BUSY;
+  }
+  op->set(this, I2COpcode::WRITE, _DEV_ADDR, reg, buf, len);
+  return _bus_queue->submit(op);
+}
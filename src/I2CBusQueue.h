@@ -0,0 +1,317 @@
+/*
+* A queued, non-blocking transaction engine for an I2C bus.
+*
+* Drivers derive from I2CDevice, own their I2CBusOp objects, and submit them to
+*   the I2CBusQueue for their bus. The queue moves one chunk of the op at the
+*   head of the line per call to service(), and calls the requesting device's
+*   io_op_callback() when the op is finished. Nothing is allocated. Ops are
+*   never copied.
+*
+* The queue is agnostic about how the bytes actually move. That is the job of
+*   an I2CBusDriver. On the Teensy, TwoWireBusDriver moves one chunk per call
+*   with the Wire API, which blocks for the length of the chunk. Chunks are
+*   capped at I2C_WIRE_CHUNK_LIMIT bytes (well under the Wire buffer), so the
+*   worst stall in loop() is about 0.8ms at 400kHz. A long read is spread
+*   across several passes through loop(), with the display and touch being
+*   serviced in between. The GridEYE frame (128 bytes) is the exception, by
+*   its own choice (see max_chunk, below). A driver that runs the bus from the
+*   LPI2C interrupt (or DMA) can be dropped in later without touching the
+*   sensor drivers.
+*   I2CSimBus moves bytes to and from simulated register files, so that the
+*   queue and the drivers can be exercised in a host build.
+*
+* Reads with a register address are assumed to auto-increment, and are split
+*   into chunks of whatever size the bus driver can handle. An op that would
+*   rather take one long stall than several short ones can set its own
+*   max_chunk, up to the most the driver can move at once. Writes are never
+*   split. An op with no register address reads from wherever the device's
+*   pointer was left, which saves a write and a repeated start on parts like
+*   the TMP102.
+*
+* Each device counts the bus transactions and wire bytes spent on its queued
+*   ops, and the samples they produced. Blocking ops (runNow()) are
+*   configuration, and are not counted.
+*
+* All queue and op state is touched only from the main loop. Callbacks happen
+*   from service() (or never, for ops run with runNow()).
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#if defined(ARDUINO)
+  #include <Arduino.h>
+  #include <Wire.h>
+#endif
+
+#ifndef __I2C_BUS_QUEUE_H_
+#define __I2C_BUS_QUEUE_H_
+
+#define I2C_BUS_QUEUE_DEPTH       16   // Must be a power of two.
+#define I2C_SIM_BUS_MAX_DEVICES    8
+
+/*
+* The largest transfer TwoWireBusDriver will do in one call. The Wire buffer
+*   would hold more, but each chunk is a blocking transaction from loop().
+*/
+#define I2C_WIRE_CHUNK_LIMIT      32
+#if defined(BUFFER_LENGTH) && (BUFFER_LENGTH < I2C_WIRE_CHUNK_LIMIT)
+  #define I2C_WIRE_MAX_XFER  BUFFER_LENGTH
+#else
+  #define I2C_WIRE_MAX_XFER  I2C_WIRE_CHUNK_LIMIT
+#endif
+
+/*
+* The largest transfer the Wire buffer will hold, for ops that ask to go past
+*   the chunk limit. requestFrom() takes a byte.
+*/
+#if defined(BUFFER_LENGTH)
+  #define I2C_WIRE_MAX_BURST  ((BUFFER_LENGTH > 255) ? 255 : BUFFER_LENGTH)
+#else
+  #define I2C_WIRE_MAX_BURST  I2C_WIRE_MAX_XFER
+#endif
+
+/* Error codes left in I2CBusOp::error */
+#define I2C_ERR_NONE               0
+#define I2C_ERR_NO_BUS            -1   // Device has no bus assigned.
+#define I2C_ERR_SHORT_READ        -2   // Slave returned fewer bytes than asked.
+#define I2C_ERR_NACK              -3   // No acknowledgement.
+#define I2C_ERR_TOO_LONG          -4   // Write exceeds the bus driver's limit.
+#define I2C_ERR_QUEUE_FULL        -5
+#define I2C_ERR_BUSY              -6   // The op is already in flight.
+
+class I2CBusQueue;
+class I2CDevice;
+
+typedef uint32_t (*I2CClockFxn)();
+
+enum class I2COpcode : uint8_t {
+  UNDEF = 0,
+  READ  = 1,
+  WRITE = 2,
+  PING  = 3
+};
+
+enum class I2COpState : uint8_t {
+  IDLE     = 0,  // Never submitted, or the caller has reset it.
+  QUEUED   = 1,  // Waiting in line.
+  ACTIVE   = 2,  // At the head of the line, and partially moved.
+  COMPLETE = 3,  // Finished without error.
+  FAILED   = 4   // Finished with an error.
+};
+
+
+/*******************************************************************************
+* A single bus transaction.
+* sub_addr is the register (or command byte) written ahead of the data. A
+*   value of -1 means there is none.
+*******************************************************************************/
+class I2CBusOp {
+  public:
+    I2CDevice* requester = nullptr;
+    uint8_t*   buf       = nullptr;
+    uint16_t   len       = 0;
+    uint16_t   xfer_len  = 0;     // Bytes moved so far.
+    int16_t    sub_addr  = -1;
+    uint8_t    dev_addr  = 0;
+    I2COpcode  opcode    = I2COpcode::UNDEF;
+    I2COpState state     = I2COpState::IDLE;
+    int8_t     error     = I2C_ERR_NONE;
+    uint8_t    chunks    = 0;     // Bus transactions so far.
+    uint16_t   max_chunk = 0;     // If nonzero, overrides the driver's chunk size. Kept by set().
+    uint32_t   t_queued  = 0;     // Clock at submission.
+    uint32_t   t_started = 0;     // Clock when the first chunk began to move.
+    uint32_t   t_done    = 0;     // Clock at completion.
+
+    void set(I2CDevice*, I2COpcode, uint8_t dev, int16_t reg, uint8_t* buf, uint16_t len);
+
+    inline bool inFlight() {
+      return ((I2COpState::QUEUED == state) || (I2COpState::ACTIVE == state));
+    };
+    inline bool complete() {    return (I2COpState::COMPLETE == state);   };
+    inline bool failed() {      return (I2COpState::FAILED == state);     };
+
+    /*
+    * Bytes on the wire for a chunk of the given length. Each address byte and
+    *   the register byte count. Start, stop, and ACK bits are ignored.
+    */
+    inline uint16_t wireBytes(uint16_t chunk) {
+      switch (opcode) {
+        case I2COpcode::READ:   return chunk + ((sub_addr >= 0) ? 3 : 1);
+        case I2COpcode::WRITE:  return chunk + ((sub_addr >= 0) ? 2 : 1);
+        default:                return 1;
+      }
+    };
+};
+
+
+/*******************************************************************************
+* Base class for anything that moves bytes on behalf of the queue.
+*******************************************************************************/
+class I2CBusDriver {
+  public:
+    /*
+    * Move len bytes of the op, starting at offset. The register address (if
+    *   any) is advanced by offset. Returns the number of bytes moved, or one of
+    *   the I2C_ERR_* codes.
+    */
+    virtual int32_t  xferChunk(I2CBusOp*, uint16_t offset, uint16_t len) = 0;
+    virtual uint16_t maxXferLength() = 0;
+
+    /*
+    * The most an op may ask for in one chunk with I2CBusOp::max_chunk. By
+    *   default, no more than any other op gets.
+    */
+    virtual uint16_t maxBurstLength() {   return maxXferLength();   };
+};
+
+
+#if defined(ARDUINO)
+/*******************************************************************************
+* Bus driver for the Arduino Wire API.
+*******************************************************************************/
+class TwoWireBusDriver : public I2CBusDriver {
+  public:
+    TwoWireBusDriver(TwoWire* b) : _bus(b) {};
+
+    int32_t  xferChunk(I2CBusOp*, uint16_t offset, uint16_t len);
+    uint16_t maxXferLength();
+    uint16_t maxBurstLength() {   return I2C_WIRE_MAX_BURST;   };
+    inline TwoWire* bus() {   return _bus;   };
+
+
+  private:
+    TwoWire* _bus;
+};
+#endif   // ARDUINO
+
+
+/*******************************************************************************
+* Simulated bus for host builds. Devices are register files, which may be
+*   extended to model sensor behavior. Each transaction advances a caller-
+*   supplied clock by the time it would have taken on the wire.
+*******************************************************************************/
+class I2CSimDevice {
+  public:
+    const uint8_t ADDR;
+    uint8_t regs[256];
+    uint8_t pointer = 0;   // Where a read without a register address starts.
+
+    I2CSimDevice(uint8_t addr);
+    virtual ~I2CSimDevice() {};
+
+    /* Default behavior is an auto-incrementing register file. */
+    virtual int32_t readRegs(uint8_t reg, uint8_t* buf, uint16_t len);
+    virtual int32_t writeRegs(uint8_t reg, const uint8_t* buf, uint16_t len);
+};
+
+class I2CSimBus : public I2CBusDriver {
+  public:
+    I2CSimBus(void (*advance_us)(uint32_t), uint32_t bus_hz = 400000, uint16_t max_xfer = 32);
+
+    int8_t   attach(I2CSimDevice*);
+    int32_t  xferChunk(I2CBusOp*, uint16_t offset, uint16_t len);
+    uint16_t maxXferLength() {      return _MAX_XFER;    };
+    inline uint32_t wireTimeUs() {  return _wire_us;     };
+
+
+  private:
+    void   (*_advance_us)(uint32_t);
+    const uint32_t _BUS_HZ;
+    const uint16_t _MAX_XFER;
+    uint32_t       _wire_us = 0;
+    I2CSimDevice*  _devs[I2C_SIM_BUS_MAX_DEVICES];
+
+    I2CSimDevice* _find(uint8_t addr);
+};
+
+
+/*******************************************************************************
+* The queue itself. One per bus.
+*******************************************************************************/
+class I2CBusQueue {
+  public:
+    I2CBusQueue(const char* name, I2CBusDriver*, I2CClockFxn);
+
+    int8_t submit(I2CBusOp*);
+    int8_t runNow(I2CBusOp*);    // Blocking. No callback. For setup and config.
+    int8_t service();            // Move one chunk. Returns 1 if work was done.
+    void   resetStats();
+    void   printDebug(StringBuilder*);
+
+    inline bool     idle() {        return (_head == _tail);            };
+    inline uint8_t  depth() {       return (uint8_t) (_head - _tail);   };
+    inline uint8_t  depthMax() {    return _depth_max;                  };
+    inline uint32_t busyUs() {      return _busy_us;                    };
+    inline uint16_t maxXferLength() {  return _driver->maxXferLength(); };
+
+
+  private:
+    const char*   _NAME;
+    I2CBusDriver* _driver;
+    I2CClockFxn   _clock;
+    I2CBusOp*     _ring[I2C_BUS_QUEUE_DEPTH];
+    uint8_t       _head       = 0;
+    uint8_t       _tail       = 0;
+    uint8_t       _depth_max  = 0;
+    uint32_t      _ops_ok     = 0;
+    uint32_t      _ops_failed = 0;
+    uint32_t      _xfers      = 0;   // Bus transactions (chunks).
+    uint32_t      _bytes      = 0;
+    uint32_t      _busy_us    = 0;   // Time spent with the bus driver.
+    uint32_t      _wait_max   = 0;   // Worst submission-to-completion time.
+    uint32_t      _stats_t0   = 0;
+
+    int32_t _xfer_chunk(I2CBusOp*);
+};
+
+
+/*******************************************************************************
+* Base class for drivers that live on an I2CBusQueue.
+*******************************************************************************/
+class I2CDevice {
+  public:
+    I2CDevice(uint8_t addr) : _DEV_ADDR(addr) {};
+    virtual ~I2CDevice() {};
+
+    /* Called from I2CBusQueue::service() when one of our ops finishes. */
+    virtual int8_t io_op_callback(I2CBusOp*) = 0;
+
+    inline uint8_t  i2cAddress() {   return _DEV_ADDR;        };
+    inline uint32_t busSamples() {   return _stat_samples;    };
+    inline uint32_t busXfers() {     return _stat_xfers;      };
+    inline uint32_t busBytes() {     return _stat_bytes;      };
+    void resetBusStats();
+    void printBusStats(StringBuilder*, const char* name);
+
+
+  protected:
+    const uint8_t _DEV_ADDR;
+    I2CBusQueue*  _bus_queue = nullptr;
+
+    /*
+    * Blocking helpers. Return 0 on success, or an I2C_ERR_* code.
+    * A negative register means no register address is sent.
+    */
+    int8_t _bus_read(int16_t reg, uint8_t* buf, uint16_t len);
+    int8_t _bus_write(int16_t reg, uint8_t* buf, uint16_t len);
+    int8_t _bus_write8(int16_t reg, uint8_t val);
+    int8_t _bus_ping();
+
+    /* Non-blocking helpers. The op must outlive the transfer. */
+    int8_t _bus_read_async(I2CBusOp*, int16_t reg, uint8_t* buf, uint16_t len);
+    int8_t _bus_write_async(I2CBusOp*, int16_t reg, uint8_t* buf, uint16_t len);
+
+    /* Drivers call this each time their queued ops produce a sample. */
+    inline void _count_sample() {   _stat_samples++;   };
+
+
+  private:
+    friend class I2CBusQueue;
+    uint32_t _stat_samples = 0;
+    uint32_t _stat_xfers   = 0;
+    uint32_t _stat_bytes   = 0;
+};
+
+#endif  // __I2C_BUS_QUEUE_H_
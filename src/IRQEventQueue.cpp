@@ -0,0 +1,85 @@
+/*
+* A lock-free queue of timestamped interrupt events.
+* See the header file for the concurrency rules.
+*/
+
+#include "IRQEventQueue.h"
+
+#define IRQ_EVENT_QUEUE_MASK   (IRQ_EVENT_QUEUE_DEPTH - 1)
+
+/* Keeps the compiler from reordering the payload write past the index write. */
+#define IRQ_QUEUE_BARRIER()    __atomic_signal_fence(__ATOMIC_SEQ_CST)
+
+
+IRQEventQueue irq_queue;
+
+
+/*
+* Constructor
+*/
+IRQEventQueue::IRQEventQueue() {
+  for (uint8_t i = 0; i < IRQ_EVENT_QUEUE_DEPTH; i++) {
+    _ring[i].ts_us = 0;
+    _ring[i].src   = IRQSource::NONE;
+  }
+}
+
+
+/*
+* Called from ISRs. Returns false if the event was dropped.
+*/
+bool IRQEventQueue::push(IRQSource src, uint32_t ts_us) {
+  const uint8_t head  = _head;
+  const uint8_t depth = (uint8_t) (head - _tail);
+  if (depth >= IRQ_EVENT_QUEUE_DEPTH) {
+    _dropped = _dropped + 1;
+    return false;
+  }
+  IRQEvent* slot = &_ring[head & IRQ_EVENT_QUEUE_MASK];
+  slot->ts_us = ts_us;
+  slot->src   = src;
+  IRQ_QUEUE_BARRIER();
+  _head = head + 1;
+  if (depth >= _high_water) {
+    _high_water = depth + 1;
+  }
+  return true;
+}
+
+
+/*
+* Called from the main loop. Returns false if the queue was empty.
+*/
+bool IRQEventQueue::pop(IRQEvent* evt) {
+  const uint8_t tail = _tail;
+  if (_head == tail) {
+    return false;
+  }
+  IRQ_QUEUE_BARRIER();
+  *evt = _ring[tail & IRQ_EVENT_QUEUE_MASK];
+  IRQ_QUEUE_BARRIER();
+  _tail = tail + 1;
+  _delivered++;
+  return true;
+}
+
+
+void IRQEventQueue::printDebug(StringBuilder* output) {
+  output->concatf(
+    "-- IRQEventQueue: %u/%u pending (high water %u), %u delivered, %u dropped\n",
+    count(), IRQ_EVENT_QUEUE_DEPTH, _high_water, _delivered, _dropped
+  );
+}
+
+
+const char* IRQEventQueue::sourceStr(IRQSource src) {
+  switch (src) {
+    case IRQSource::IMU:         return "IMU";
+    case IRQSource::GRIDEYE:     return "GRIDEYE";
+    case IRQSource::TSL2561:     return "TSL2561";
+    case IRQSource::TOUCH:       return "TOUCH";
+    case IRQSource::DRV425_ADC:  return "DRV425_ADC";
+    default:                     break;
+  }
+  return "NONE";
+}
@@ -0,0 +1,73 @@
+/*
+* A lock-free queue of timestamped interrupt events.
+*
+* ISRs push, and the main loop drains. The ring is single-producer and
+*   single-consumer. That holds on the Teensy4 even with several pin ISRs
+*   feeding it, because every GPIO interrupt is funneled through the same
+*   vector (and NVIC priority), so no pin ISR can preempt another. Anything
+*   pushing from a different priority level must not share this queue.
+*
+* The producer owns _head and the consumer owns _tail. Each side only ever
+*   writes its own index, and the event payload is written before the index
+*   that publishes it. Indices are free-running and masked on use, so the
+*   full ring depth is usable.
+*
+* On overflow, the newest event is dropped and counted. The drivers keep their
+*   own IRQ flags, so a dropped event costs latency, not data.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __IRQ_EVENT_QUEUE_H_
+#define __IRQ_EVENT_QUEUE_H_
+
+#define IRQ_EVENT_QUEUE_DEPTH   32   // Must be a power of two, and <= 128.
+
+enum class IRQSource : uint8_t {
+  NONE        = 0,
+  IMU         = 1,  // ICM-20948 data ready.
+  GRIDEYE     = 2,  // AMG88xx threshold interrupt.
+  TSL2561     = 3,  // TSL2561 conversion complete.
+  TOUCH       = 4,  // SX8634 NIRQ.
+  DRV425_ADC  = 5   // Magnetometer ADC data ready.
+};
+
+/* A single event. */
+typedef struct {
+  uint32_t  ts_us;   // micros() at the time of the interrupt.
+  IRQSource src;     // What fired.
+} IRQEvent;
+
+
+class IRQEventQueue {
+  public:
+    IRQEventQueue();
+
+    bool push(IRQSource, uint32_t ts_us);   // Producer (ISR) side only.
+    bool pop(IRQEvent*);                    // Consumer (main loop) side only.
+
+    inline bool     empty() {       return (_head == _tail);           };
+    inline uint8_t  count() {       return (uint8_t) (_head - _tail);  };
+    inline uint8_t  highWater() {   return _high_water;                };
+    inline uint32_t dropped() {     return _dropped;                   };
+    inline uint32_t delivered() {   return _delivered;                 };
+    void printDebug(StringBuilder*);
+
+    static const char* sourceStr(IRQSource);
+
+
+  private:
+    IRQEvent          _ring[IRQ_EVENT_QUEUE_DEPTH];
+    volatile uint8_t  _head       = 0;   // Next slot to write. Producer-owned.
+    volatile uint8_t  _tail       = 0;   // Next slot to read. Consumer-owned.
+    uint8_t           _high_water = 0;   // Producer-owned.
+    volatile uint32_t _dropped    = 0;   // Producer-owned.
+    uint32_t          _delivered  = 0;   // Consumer-owned.
+};
+
+/* The one queue that all pin ISRs feed. */
+extern IRQEventQueue irq_queue;
+
+#endif  // __IRQ_EVENT_QUEUE_H_
@@ -0,0 +1,403 @@
+/*
+* Reader for the files written by SampleLogger.
+* See the header file for the rules.
+*/
+
+#include "LogReader.h"
+
+
+#if defined(ARDUINO)
+/*******************************************************************************
+* SdLogSource
+*******************************************************************************/
+
+int8_t SdLogSource::open(const char* name) {
+  close();
+  _file = _fs->open(name, O_RDONLY);
+  return (_file) ? 0 : -1;
+}
+
+
+void SdLogSource::close() {
+  if (_file) {
+    _file.close();
+  }
+}
+
+
+uint32_t SdLogSource::sectors() {
+  return (_file) ? (uint32_t) (_file.fileSize() / LOG_SECTOR_BYTES) : 0;
+}
+
+
+int8_t SdLogSource::readSector(uint32_t n, uint8_t* buf) {
+  if (!_file.seekSet((uint64_t) n * LOG_SECTOR_BYTES)) {
+    return -1;
+  }
+  return (LOG_SECTOR_BYTES == _file.read(buf, LOG_SECTOR_BYTES)) ? 0 : -1;
+}
+
+#else
+/*******************************************************************************
+* LogFileSource
+*******************************************************************************/
+
+int8_t LogFileSource::open(const char* path) {
+  close();
+  _file = fopen(path, "rb");
+  return (nullptr != _file) ? 0 : -1;
+}
+
+
+void LogFileSource::close() {
+  if (nullptr != _file) {
+    fclose(_file);
+    _file = nullptr;
+  }
+}
+
+
+uint32_t LogFileSource::sectors() {
+  if ((nullptr == _file) || (0 != fseek(_file, 0, SEEK_END))) {
+    return 0;
+  }
+  const long LEN = ftell(_file);
+  return (LEN > 0) ? (uint32_t) (LEN / LOG_SECTOR_BYTES) : 0;
+}
+
+
+int8_t LogFileSource::readSector(uint32_t n, uint8_t* buf) {
+  if ((nullptr == _file) || (0 != fseek(_file, (long) n * LOG_SECTOR_BYTES, SEEK_SET))) {
+    return -1;
+  }
+  return (LOG_SECTOR_BYTES == fread(buf, 1, LOG_SECTOR_BYTES, _file)) ? 0 : -1;
+}
+#endif   // ARDUINO
+
+
+
+/*******************************************************************************
+* LogMemSource
+*******************************************************************************/
+
+int8_t LogMemSource::readSector(uint32_t n, uint8_t* buf) {
+  if (n >= _sectors) {
+    return -1;
+  }
+  memcpy(buf, _mem + (n * LOG_SECTOR_BYTES), LOG_SECTOR_BYTES);
+  return 0;
+}
+
+
+
+/*******************************************************************************
+* LogReader
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+LogReader::LogReader(LogSource* src) : _src(src) {}
+
+
+/*
+* Destructor
+*/
+LogReader::~LogReader() {
+  if (nullptr != _index) {
+    delete[] _index;
+    _index = nullptr;
+  }
+}
+
+
+/*
+* Reads the trailer and the index, or failing that, finds the end of the data
+*   by searching the chunk headers.
+* Returns 0 on success, -1 if the source is empty or unreadable, or -2 if it
+*   isn't a log.
+*/
+int8_t LogReader::open() {
+  close();
+  _reads       = 0;
+  _bad_chunks  = 0;
+  _skipped     = 0;
+  _index_count = 0;
+  _records     = 0;
+  if (0 == _src->sectors()) {
+    return -1;
+  }
+  int8_t ret = _open_trailer();
+  if (0 != ret) {
+    ret = _open_unindexed();
+  }
+  if (0 == ret) {
+    _open = true;
+    filter(LOG_ALL_SENSORS);
+    seek(0);
+  }
+  return ret;
+}
+
+
+void LogReader::close() {
+  _open       = false;
+  _chunks     = 0;
+  _next_chunk = 0;
+  _pos        = 0;
+  _end        = 0;
+}
+
+
+/*
+* Positions the reader so that the next record returned is the first one at
+*   or after the given time.
+*/
+int8_t LogReader::seek(uint32_t t_ms) {
+  if (!_open) {
+    return -1;
+  }
+  // We want the last chunk that starts before t_ms. It lies in [lo, hi).
+  uint32_t lo = 0;
+  uint32_t hi = _chunks;
+  if (_index_count > 0) {
+    uint16_t a = 0;
+    uint16_t b = _index_count;
+    while (a < b) {
+      const uint16_t MID = (a + b) >> 1;
+      if (_index[MID].t_ms < t_ms) a = MID + 1;
+      else b = MID;
+    }
+    // Entries [0, a) start before t_ms.
+    if (a > 0) {
+      lo = _index[a - 1].chunk;
+    }
+    hi = (a < _index_count) ? _index[a].chunk : _chunks;
+    if (hi <= lo) hi = lo + 1;
+  }
+  while ((hi - lo) > 1) {
+    const uint32_t MID = lo + ((hi - lo) >> 1);
+    if ((0 == _read(MID)) && _chunk_ok(MID) && (log_get32(_buf + 12) < t_ms)) {
+      lo = MID;
+    }
+    else {
+      hi = MID;
+    }
+  }
+  _next_chunk = lo;
+  _pos        = 0;
+  _end        = 0;
+  _t_start    = t_ms;
+  return 0;
+}
+
+
+/*
+* Limits what next() returns to the given sensors (a bitmask of SensorIDs),
+*   and to records no later than t_end.
+*/
+void LogReader::filter(uint16_t sensor_mask, uint32_t t_end) {
+  _want  = sensor_mask;
+  _t_end = t_end;
+}
+
+
+/*
+* Returns 1 and fills the record if there was one, 0 at the end of the file
+*   (or of the filter's range), or -1 on a read error.
+*/
+int8_t LogReader::next(LogRecord* out) {
+  while (true) {
+    if (_pos >= _end) {
+      if (_next_chunk >= _chunks) {
+        return 0;
+      }
+      const int8_t RET = _load(_next_chunk++);
+      if (RET < 0) {
+        return RET;
+      }
+      if (0 == RET) {
+        continue;
+      }
+    }
+    const uint8_t* rec = &_buf[_pos];
+    const uint16_t REC_LEN = LOG_RECORD_HEADER + rec[1];
+    if ((_pos + REC_LEN) > _end) {
+      _bad_chunks++;   // The CRC passed, but the records don't add up.
+      _pos = _end;
+      continue;
+    }
+    _pos += REC_LEN;
+    const uint32_t T = log_get32(rec + 2);
+    if (T > _t_end) {
+      _next_chunk = _chunks;
+      _pos = _end;
+      return 0;
+    }
+    if ((T < _t_start) || (rec[0] > 15) || (0 == (_want & (1 << rec[0])))) {
+      continue;
+    }
+    out->sensor  = rec[0];
+    out->len     = rec[1];
+    out->t_ms    = T;
+    out->payload = rec + LOG_RECORD_HEADER;
+    return 1;
+  }
+}
+
+
+void LogReader::printDebug(StringBuilder* output) {
+  if (!_open) {
+    output->concat("Log reader: closed\n");
+    return;
+  }
+  output->concatf("Log reader: %u chunks, %s\n", _chunks, indexed() ? "indexed" : "no index");
+  output->concatf("\tTime:          %u to %u ms\n", _t_first, _t_last);
+  output->concatf("\tSensors:       0x%04x\n", _sensor_mask);
+  if (_records > 0) {
+    output->concatf("\tRecords:       %u\n", _records);
+  }
+  if (indexed()) {
+    output->concatf("\tIndex entries: %u\n", _index_count);
+  }
+  output->concatf("\tSector reads:  %u\n", _reads);
+  output->concatf("\tSkipped:       %u\n", _skipped);
+  output->concatf("\tBad chunks:    %u\n", _bad_chunks);
+}
+
+
+int8_t LogReader::_read(uint32_t n) {
+  _reads++;
+  return _src->readSector(n, _buf);
+}
+
+
+/* Checks the header of the chunk in the buffer, but not its CRC. */
+bool LogReader::_chunk_ok(uint32_t n) {
+  const uint16_t USED = log_get16(_buf + 2);
+  return ((LOG_SECTOR_MAGIC == log_get16(_buf)) && (n == log_get32(_buf + 4)) &&
+    (USED >= LOG_SECTOR_HEADER) && (USED <= LOG_SECTOR_BYTES));
+}
+
+
+/* Verifies a CRC stored at the given offset in the buffer. */
+static bool _crc_ok(uint8_t* buf, uint8_t offset) {
+  uint8_t stored[4];
+  memcpy(stored, buf + offset, 4);
+  memset(buf + offset, 0, 4);
+  const bool RET = (log_get32(stored) == log_crc32(buf, LOG_SECTOR_BYTES));
+  memcpy(buf + offset, stored, 4);
+  return RET;
+}
+
+
+/*
+* Loads a chunk for iteration.
+* Returns 1 if it was loaded, 0 if it was passed over, or -1 on a read error.
+*/
+int8_t LogReader::_load(uint32_t n) {
+  if (0 != _read(n)) {
+    return -1;
+  }
+  if (!_chunk_ok(n)) {
+    _bad_chunks++;
+    return 0;
+  }
+  if (log_get32(_buf + 12) > _t_end) {
+    _next_chunk = _chunks;   // This chunk, and all after it, are too late.
+    return 0;
+  }
+  if (0 == (log_get16(_buf + 8) & _want)) {
+    _skipped++;
+    return 0;
+  }
+  if (!_crc_ok(_buf, 16)) {
+    _bad_chunks++;
+    return 0;
+  }
+  _pos = LOG_SECTOR_HEADER;
+  _end = log_get16(_buf + 2);
+  return 1;
+}
+
+
+/*
+* Reads the trailer from the last sector, and the index sectors before it.
+*   A bad index is not fatal, since the chunks can be searched without it.
+*/
+int8_t LogReader::_open_trailer() {
+  const uint32_t SECTORS = _src->sectors();
+  if ((0 != _read(SECTORS - 1)) || (LOG_TRAILER_MAGIC != log_get16(_buf)) || !_crc_ok(_buf, 4)) {
+    return -1;
+  }
+  const uint32_t DATA    = log_get32(_buf + 8);
+  const uint32_t IDX_SEC = log_get32(_buf + 12);
+  const uint32_t ENTRIES = log_get32(_buf + 16);
+  if ((LOG_FORMAT_VERSION != log_get16(_buf + 2)) || ((DATA + IDX_SEC + 1) != SECTORS)) {
+    return -2;
+  }
+  _chunks      = DATA;
+  _t_first     = log_get32(_buf + 24);
+  _t_last      = log_get32(_buf + 28);
+  _sensor_mask = log_get16(_buf + 32);
+  _records     = log_get32(_buf + 36);
+
+  if ((ENTRIES > 0) && (ENTRIES <= LOG_INDEX_ENTRIES)) {
+    if (nullptr == _index) {
+      _index = new LogIndexEntry[LOG_INDEX_ENTRIES];
+    }
+    uint32_t got = 0;
+    for (uint32_t s = 0; s < IDX_SEC; s++) {
+      if ((0 != _read(DATA + s)) || (LOG_INDEX_MAGIC != log_get16(_buf)) || !_crc_ok(_buf, 4)) {
+        return 0;   // Go without.
+      }
+      const uint16_t COUNT = log_get16(_buf + 2);
+      for (uint16_t i = 0; (i < COUNT) && (i < LOG_INDEX_PER_SECTOR) && (got < ENTRIES); i++) {
+        _index[got].t_ms  = log_get32(_buf + 8 + (i * 8));
+        _index[got].chunk = log_get32(_buf + 12 + (i * 8));
+        got++;
+      }
+    }
+    if (got == ENTRIES) {
+      _index_count = (uint16_t) got;
+    }
+  }
+  return 0;
+}
+
+
+/*
+* For a file that never got its footer. Chunks are numbered from 0 with no
+*   gaps, so the end of the data is where the sequence numbers stop matching,
+*   and can be found by binary search. Without the trailer, the sensor mask
+*   is only that of the first and last chunks.
+*/
+int8_t LogReader::_open_unindexed() {
+  const uint32_t SECTORS = _src->sectors();
+  if ((0 != _read(0)) || !_chunk_ok(0)) {
+    return -2;
+  }
+  _t_first     = log_get32(_buf + 12);
+  _sensor_mask = log_get16(_buf + 8);
+  uint32_t lo = 1;        // Chunks [0, lo) are good.
+  uint32_t hi = SECTORS;  // Chunks [hi, SECTORS) are not.
+  while (lo < hi) {
+    const uint32_t MID = lo + ((hi - lo) >> 1);
+    if ((0 == _read(MID)) && _chunk_ok(MID)) lo = MID + 1;
+    else hi = MID;
+  }
+  _chunks = lo;
+
+  // The last record of the last chunk gives the end time.
+  _t_last = _t_first;
+  if ((0 == _read(_chunks - 1)) && _chunk_ok(_chunks - 1)) {
+    _sensor_mask |= log_get16(_buf + 8);
+    const uint16_t USED = log_get16(_buf + 2);
+    uint16_t pos = LOG_SECTOR_HEADER;
+    while ((pos + LOG_RECORD_HEADER) <= USED) {
+      _t_last = log_get32(_buf + pos + 2);
+      pos += LOG_RECORD_HEADER + _buf[pos + 1];
+    }
+  }
+  return 0;
+}
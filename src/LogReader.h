@@ -0,0 +1,189 @@
+/*
+* Reader for the files written by SampleLogger. See SampleLogger.h for the
+*   format.
+*
+* A LogReader opens a file through a LogSource, which only has to hand back
+*   whole sectors by number. SdLogSource reads from an SdFat volume,
+*   LogMemSource from RAM, and (in host builds) LogFileSource from a file on
+*   the host's own filesystem. So the same decoder runs in the Data Manager
+*   app and on a PC.
+*
+* Opening a file reads its trailer and loads its sparse index. seek() then
+*   binary-searches the index in RAM, and binary-searches the chunks between
+*   two index entries on the card, so finding a time costs O(log n) sector
+*   reads. A file that has no footer is searched over its chunk headers alone.
+*
+* next() walks records forward from the seek point, and returns only those
+*   from the sensors and time range given to filter(). Chunks that hold none
+*   of the wanted sensors are skipped without their records being parsed (or
+*   their CRC checked). A chunk that fails its CRC is skipped, and counted.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+#include <StringBuilder.h>
+#include "SampleLogger.h"
+
+#if defined(ARDUINO)
+  #include <SD.h>
+#else
+  #include <stdio.h>
+#endif
+
+#ifndef __LOG_READER_H_
+#define __LOG_READER_H_
+
+#define LOG_ALL_SENSORS   0xFFFF
+
+
+/*******************************************************************************
+* Base class for anything that can hand sectors of a log to the reader.
+*******************************************************************************/
+class LogSource {
+  public:
+    virtual uint32_t sectors() = 0;
+    virtual int8_t   readSector(uint32_t n, uint8_t* buf) = 0;
+};
+
+
+#if defined(ARDUINO)
+/*******************************************************************************
+* Source for a file on an SdFat volume.
+*******************************************************************************/
+class SdLogSource : public LogSource {
+  public:
+    SdLogSource(SdFs* fs) : _fs(fs) {};
+
+    int8_t   open(const char* name);
+    void     close();
+    uint32_t sectors();
+    int8_t   readSector(uint32_t n, uint8_t* buf);
+
+
+  private:
+    SdFs*  _fs;
+    FsFile _file;
+};
+
+#else
+/*******************************************************************************
+* Source for a file on the host. For host builds.
+*******************************************************************************/
+class LogFileSource : public LogSource {
+  public:
+    ~LogFileSource() {   close();   };
+
+    int8_t   open(const char* path);
+    void     close();
+    uint32_t sectors();
+    int8_t   readSector(uint32_t n, uint8_t* buf);
+
+
+  private:
+    FILE* _file = nullptr;
+};
+#endif   // ARDUINO
+
+
+/*******************************************************************************
+* Source for a block of RAM, such as what LogMemSink wrote.
+*******************************************************************************/
+class LogMemSource : public LogSource {
+  public:
+    LogMemSource(const uint8_t* mem, uint32_t sectors) : _mem(mem), _sectors(sectors) {};
+
+    inline uint32_t sectors() {   return _sectors;   };
+    int8_t readSector(uint32_t n, uint8_t* buf);
+
+
+  private:
+    const uint8_t* _mem;
+    uint32_t       _sectors;
+};
+
+
+/*******************************************************************************
+* One decoded record. The payload points into the reader's sector buffer, and
+*   is only good until the next call to the reader.
+*******************************************************************************/
+class LogRecord {
+  public:
+    const uint8_t* payload = nullptr;
+    uint32_t       t_ms    = 0;
+    uint8_t        sensor  = 0;
+    uint8_t        len     = 0;
+
+    /* Payloads are packed, so values are copied out rather than cast. */
+    inline float getFloat(uint8_t i) const {
+      float ret = 0.0f;
+      if (((i + 1) * sizeof(float)) <= len) memcpy(&ret, payload + (i * sizeof(float)), sizeof(float));
+      return ret;
+    };
+
+    inline int16_t getInt16(uint8_t i) const {
+      int16_t ret = 0;
+      if (((i + 1) * sizeof(int16_t)) <= len) memcpy(&ret, payload + (i * sizeof(int16_t)), sizeof(int16_t));
+      return ret;
+    };
+};
+
+
+/*******************************************************************************
+* The reader itself.
+*******************************************************************************/
+class LogReader {
+  public:
+    LogReader(LogSource*);
+    ~LogReader();
+
+    int8_t open();
+    void   close();
+    int8_t seek(uint32_t t_ms);
+    void   filter(uint16_t sensor_mask, uint32_t t_end = 0xFFFFFFFF);
+    int8_t next(LogRecord*);
+    void   printDebug(StringBuilder*);
+
+    inline bool     isOpen() {      return _open;          };
+    inline bool     indexed() {     return (_index_count > 0);  };
+    inline uint32_t chunks() {      return _chunks;        };
+    inline uint32_t firstTime() {   return _t_first;       };
+    inline uint32_t lastTime() {    return _t_last;        };
+    inline uint16_t sensors() {     return _sensor_mask;   };
+    inline uint32_t records() {     return _records;       };
+    inline uint32_t badChunks() {   return _bad_chunks;    };
+    inline uint32_t sectorReads() { return _reads;         };
+
+
+  private:
+    LogSource*     _src;
+    LogIndexEntry* _index       = nullptr;
+    uint16_t       _index_count = 0;
+    uint32_t       _chunks      = 0;     // Data chunks in the file.
+    uint32_t       _t_first     = 0;
+    uint32_t       _t_last      = 0;
+    uint16_t       _sensor_mask = 0;
+    uint32_t       _records     = 0;     // From the trailer. 0 if there isn't one.
+    bool           _open        = false;
+
+    /* Iteration state */
+    uint8_t  _buf[LOG_SECTOR_BYTES];
+    uint32_t _next_chunk = 0;      // Next chunk to load.
+    uint16_t _pos        = 0;      // Read position in the loaded chunk.
+    uint16_t _end        = 0;      // Bytes used in the loaded chunk.
+    uint32_t _t_start    = 0;
+    uint32_t _t_end      = 0xFFFFFFFF;
+    uint16_t _want       = LOG_ALL_SENSORS;
+
+    uint32_t _reads      = 0;
+    uint32_t _bad_chunks = 0;
+    uint32_t _skipped    = 0;      // Chunks passed over by the sensor filter.
+
+    int8_t _read(uint32_t n);
+    bool   _chunk_ok(uint32_t n);
+    int8_t _load(uint32_t n);
+    int8_t _open_trailer();
+    int8_t _open_unindexed();
+};
+
+#endif  // __LOG_READER_H_
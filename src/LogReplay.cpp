@@ -0,0 +1,102 @@
+/*
+* Plays a recording back in time order.
+* See the header file for the rules.
+*/
+
+#include "LogReplay.h"
+
+
+/*
+* Constructor
+*/
+LogReplay::LogReplay(LogReader* reader, ReplayClockFxn clock_ms) :
+  _reader(reader), _clock(clock_ms) {}
+
+
+/*
+* Starts playback from the given offset into the recording, limited to the
+*   given sensors. The reader must already be open.
+*/
+int8_t LogReplay::start(uint16_t speed, uint32_t from_ms, uint16_t sensors) {
+  if (!_reader->isOpen()) {
+    return -1;
+  }
+  _log0 = _reader->firstTime() + from_ms;
+  _reader->filter(sensors);
+  if (0 != _reader->seek(_log0)) {
+    return -2;
+  }
+  _speed        = speed;
+  _position     = _log0;
+  _have_pending = false;
+  resetStats();
+  _wall0        = _clock();
+  _running      = true;
+  return 0;
+}
+
+
+void LogReplay::stop() {
+  _running      = false;
+  _have_pending = false;
+}
+
+
+/*
+* Returns 1 and fills the record if one is due, 0 if the next one isn't due
+*   yet, or -1 if playback has ended (or was never started). The record's
+*   payload is only good until the next call.
+*/
+int8_t LogReplay::poll(LogRecord* out) {
+  if (!_running) {
+    return -1;
+  }
+  if (!_have_pending) {
+    if (1 != _reader->next(&_pending)) {
+      _running = false;
+      return -1;
+    }
+    _have_pending = true;
+  }
+  if (REPLAY_FREE_RUN != _speed) {
+    const uint32_t NOW = _clock();
+    const uint32_t DUE = _wall0 + ((_pending.t_ms - _log0) / _speed);
+    const int32_t  LAG = (int32_t) (NOW - DUE);
+    if (LAG < 0) {
+      return 0;
+    }
+    _lag_sum += (uint32_t) LAG;
+    if ((uint32_t) LAG > _lag_max) _lag_max = (uint32_t) LAG;
+  }
+  *out          = _pending;
+  _have_pending = false;
+  _position     = _pending.t_ms;
+  _records++;
+  return 1;
+}
+
+
+void LogReplay::resetStats() {
+  _records  = 0;
+  _lag_sum  = 0;
+  _lag_max  = 0;
+  _stats_t0 = _clock();
+}
+
+
+void LogReplay::printDebug(StringBuilder* output) {
+  const uint32_t ELAPSED_MS = _clock() - _stats_t0;
+  output->concatf("Replay: %s", _running ? "running" : "stopped");
+  if (REPLAY_FREE_RUN == _speed) {
+    output->concat(" (free-run)\n");
+  }
+  else {
+    output->concatf(" (%ux)\n", _speed);
+  }
+  output->concatf("\tPosition:   %u ms of %u\n", _position - _reader->firstTime(), _reader->lastTime() - _reader->firstTime());
+  output->concatf("\tRecords:    %u\n", _records);
+  output->concatf("\tRate:       %u records/s\n", (ELAPSED_MS > 0) ? (uint32_t) (((uint64_t) _records * 1000) / ELAPSED_MS) : 0);
+  if (REPLAY_FREE_RUN != _speed) {
+    output->concatf("\tLag (ms):   mean %u  max %u\n", (_records > 0) ? (_lag_sum / _records) : 0, _lag_max);
+  }
+}
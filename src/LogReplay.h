@@ -0,0 +1,82 @@
+/*
+* Plays a recording back in time order, so that it can stand in for the
+*   sensors.
+*
+* A LogReplay walks a LogReader forward, and hands out each record when its
+*   time comes. The schedule is anchored at start(): a record is due once the
+*   wall clock has advanced by (its offset into the recording / speed). So a
+*   speed of 1 keeps the original timing, and a speed of 20 plays an hour in
+*   three minutes. A speed of REPLAY_FREE_RUN ignores the clock entirely, and
+*   hands out records as fast as poll() is called.
+*
+* Every record in the range is returned exactly once, and in file order, no
+*   matter how late poll() is called. Lateness is measured rather than made up
+*   for by skipping. So two runs over the same file feed the same inputs to
+*   whatever consumes them, and differ only in timing.
+*
+* Consumers that want a timestamp should take it from sampleTimeUs(), not from
+*   the clock. That is the record's own time, moved to the start of the
+*   replay: the first record is stamped with the clock at start(), and the
+*   rest keep their recorded spacing, whatever the speed or lag.
+*
+* Nothing in here depends on Arduino. On the device, the reader sits on an
+*   SdLogSource and the clock is millis(). A host build can put the reader on
+*   a LogFileSource and drive it from sim_millis().
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+#include "LogReader.h"
+
+#ifndef __LOG_REPLAY_H_
+#define __LOG_REPLAY_H_
+
+#define REPLAY_FREE_RUN   0
+
+typedef uint32_t (*ReplayClockFxn)();
+
+
+class LogReplay {
+  public:
+    LogReplay(LogReader*, ReplayClockFxn clock_ms);
+
+    int8_t start(uint16_t speed, uint32_t from_ms = 0, uint16_t sensors = LOG_ALL_SENSORS);
+    void   stop();
+    int8_t poll(LogRecord*);
+    void   resetStats();
+    void   printDebug(StringBuilder*);
+
+    inline bool     running() {   return _running;    };
+    inline uint16_t speed() {     return _speed;      };
+    inline uint32_t records() {   return _records;    };
+    /* Recording time of the last record handed out. */
+    inline uint32_t position() {  return _position;   };
+    /*
+    * The record's recorded time, offset to the start of the replay, in the
+    *   microseconds of a micros() that runs in step with the clock. It wraps
+    *   as micros() does.
+    */
+    inline uint32_t sampleTimeUs(const LogRecord* rec) {
+      return (_wall0 + (rec->t_ms - _log0)) * 1000;
+    };
+
+
+  private:
+    LogReader*           _reader;
+    const ReplayClockFxn _clock;
+    LogRecord _pending;
+    bool      _have_pending = false;
+    bool      _running      = false;
+    uint16_t  _speed        = 1;
+    uint32_t  _wall0        = 0;     // Wall time at start().
+    uint32_t  _log0         = 0;     // Recording time at start().
+    uint32_t  _position     = 0;
+
+    uint32_t  _records      = 0;
+    uint32_t  _lag_sum      = 0;     // Wall ms between due and handed out.
+    uint32_t  _lag_max      = 0;
+    uint32_t  _stats_t0     = 0;
+};
+
+#endif  // __LOG_REPLAY_H_
@@ -0,0 +1,114 @@
+/*
+* Cheap, always-on timing instrumentation for the main loop.
+* See the header file for notes.
+*/
+
+#include "LoopProfiler.h"
+
+
+/*******************************************************************************
+* StageProfile
+*******************************************************************************/
+
+void StageProfile::record(uint32_t cycles) {
+  _sum += cycles;
+  _count++;
+  if (cycles < _min) {   _min = cycles;   }
+  if (cycles > _max) {   _max = cycles;   }
+  // Bin n holds values in [2^(n-1), 2^n). Bin 0 holds zero.
+  uint8_t bin = (0 == cycles) ? 0 : (32 - __builtin_clz(cycles));
+  if (bin >= LOOP_PROFILER_HIST_BINS) {
+    bin = LOOP_PROFILER_HIST_BINS - 1;
+  }
+  _hist[bin]++;
+}
+
+
+void StageProfile::reset() {
+  _sum   = 0;
+  _count = 0;
+  _min   = 0xFFFFFFFF;
+  _max   = 0;
+  for (uint8_t i = 0; i < LOOP_PROFILER_HIST_BINS; i++) {
+    _hist[i] = 0;
+  }
+}
+
+
+void StageProfile::printDebug(StringBuilder* output, const char* name, uint32_t cpu, bool hist) {
+  output->concatf(
+    "%-10s %9u %10.2f %10.2f %10.2f\n",
+    name, _count,
+    (double) minimum() / cpu, (double) mean() / cpu, (double) maximum() / cpu
+  );
+  if (hist && (_count > 0)) {
+    output->concat("           ");
+    for (uint8_t i = 0; i < LOOP_PROFILER_HIST_BINS; i++) {
+      if (_hist[i] > 0) {
+        output->concatf(" <2^%u:%u", i, _hist[i]);
+      }
+    }
+    output->concat("\n");
+  }
+}
+
+
+
+/*******************************************************************************
+* LoopProfiler
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+LoopProfiler::LoopProfiler(const char* const* stage_names, uint8_t stage_count) :
+  _STAGE_NAMES(stage_names),
+  _STAGE_COUNT((stage_count > LOOP_PROFILER_MAX_STAGES) ? LOOP_PROFILER_MAX_STAGES : stage_count) {}
+
+
+/*
+* The first mark after a reset only sets the reference point.
+*/
+void LoopProfiler::markLoop() {
+  const uint32_t now = cycles();
+  if (0 != _last_loop_mark) {
+    const uint32_t period = now - _last_loop_mark;
+    _loop.record(period);
+    _loop_cycles += period;
+  }
+  _last_loop_mark = now;
+}
+
+
+void LoopProfiler::reset() {
+  _last_loop_mark = 0;
+  _loop_cycles    = 0;
+  _loop.reset();
+  for (uint8_t i = 0; i < _STAGE_COUNT; i++) {
+    _stages[i].reset();
+  }
+}
+
+
+void LoopProfiler::printDebug(StringBuilder* output, bool hist) {
+  const uint32_t cpu = cyclesPerMicrosecond();
+  const double   elapsed_s = (double) _loop_cycles / (cpu * 1000000.0);
+  output->concatf("-- LoopProfiler (%u cycles/us, %.3fs sampled)\n", cpu, elapsed_s);
+  if (elapsed_s > 0.0) {
+    output->concatf("Loop rate: %.1f Hz\n", _loop.count() / elapsed_s);
+  }
+  output->concat("Stage          Count     Min us    Mean us     Max us\n");
+  _loop.printDebug(output, "loop", cpu, hist);
+  for (uint8_t i = 0; i < _STAGE_COUNT; i++) {
+    _stages[i].printDebug(output, _STAGE_NAMES[i], cpu, hist);
+  }
+}
+
+
+uint32_t LoopProfiler::cyclesPerMicrosecond() {
+  #if defined(__IMXRT1062__)
+    return (F_CPU_ACTUAL / 1000000);
+  #else
+    return 1000;   // The host clock is in nanoseconds.
+  #endif
+}
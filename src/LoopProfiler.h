@@ -0,0 +1,105 @@
+/*
+* Cheap, always-on timing instrumentation for the main loop.
+*
+* Each stage keeps min/mean/max and a log2 histogram of its execution time,
+*   measured in CPU cycles. On the Teensy4, the cycle source is the DWT cycle
+*   counter (which the core already enables for micros()). On a host build, it
+*   is a steady clock in nanoseconds. Either way, the cost of a measurement is
+*   two counter reads, a handful of adds, and a CLZ.
+*
+* Stage indices are defined by the caller, and must be less than
+*   LOOP_PROFILER_MAX_STAGES.
+*
+* The counter is 32 bits. At 600MHz, that wraps every ~7 seconds, which is far
+*   longer than any stage should take.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#if defined(__IMXRT1062__)
+  #include <Arduino.h>
+#else
+  #include <chrono>
+#endif
+
+#ifndef __LOOP_PROFILER_H_
+#define __LOOP_PROFILER_H_
+
+#define LOOP_PROFILER_MAX_STAGES   16
+#define LOOP_PROFILER_HIST_BINS    32
+
+
+/*******************************************************************************
+* Statistics for a single stage.
+*******************************************************************************/
+class StageProfile {
+  public:
+    void record(uint32_t cycles);
+    void reset();
+    void printDebug(StringBuilder*, const char* name, uint32_t cycles_per_us, bool hist);
+
+    inline uint32_t count() {   return _count;   };
+    inline uint32_t minimum() { return (_count > 0) ? _min : 0;  };
+    inline uint32_t maximum() { return _max;     };
+    inline uint32_t mean() {
+      return (_count > 0) ? (uint32_t) (_sum / _count) : 0;
+    };
+
+
+  private:
+    uint64_t _sum   = 0;
+    uint32_t _count = 0;
+    uint32_t _min   = 0xFFFFFFFF;
+    uint32_t _max   = 0;
+    uint32_t _hist[LOOP_PROFILER_HIST_BINS] = {0};
+};
+
+
+/*******************************************************************************
+* A set of named stages, plus loop iteration accounting.
+*******************************************************************************/
+class LoopProfiler {
+  public:
+    LoopProfiler(const char* const* stage_names, uint8_t stage_count);
+
+    /* Record the time since start_cycles against the given stage. */
+    inline void record(uint8_t stage, uint32_t start_cycles) {
+      if (stage < _STAGE_COUNT) {
+        _stages[stage].record(cycles() - start_cycles);
+      }
+    };
+
+    void markLoop();    // Call once per pass through loop().
+    void reset();
+    void printDebug(StringBuilder*, bool hist = false);
+
+    inline uint32_t loopCount() {    return _loop.count();    };
+    inline StageProfile* stage(uint8_t s) {
+      return (s < _STAGE_COUNT) ? &_stages[s] : nullptr;
+    };
+
+    static uint32_t cyclesPerMicrosecond();
+
+    static inline uint32_t cycles() {
+      #if defined(__IMXRT1062__)
+        return ARM_DWT_CYCCNT;
+      #else
+        return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+      #endif
+    };
+
+
+  private:
+    const char* const* _STAGE_NAMES;
+    const uint8_t      _STAGE_COUNT;
+    uint32_t           _last_loop_mark = 0;
+    uint64_t           _loop_cycles    = 0;   // Total cycles spent in loop().
+    StageProfile       _loop;                 // Loop iteration period.
+    StageProfile       _stages[LOOP_PROFILER_MAX_STAGES];
+};
+
+#endif  // __LOOP_PROFILER_H_
@@ -42,7 +42,7 @@
 #define TOUCH_RESET_PIN     28
 #define DRV425_GPIO_IRQ_PIN 29
 #define DRV425_CS_PIN       30
-#define AMG8866_IRQ_PIN     255  //31
+#define AMG8866_IRQ_PIN     31
 #define DISPLAY_RST_PIN     32
 #define LED_B_PIN           33
 
@@ -87,6 +87,28 @@ enum class SensorID : uint8_t {
   BATT_VOLTAGE  = 9   //
 };
 
+/*
+* Sample bus channels. Channel 0 of every sensor is the reading as the driver
+*   gives it, which is also what gets logged. Anything worked out from it goes
+*   on a later channel. (Quantities derived from the baro are not published.
+*   They are computed on demand. See BARO_DV_*.)
+*/
+#define BUS_CH_READING          0
+#define BUS_CH_THERM_STATS      1   // {min, max, mean, stdev}, in C
+#define BUS_CH_THERM_PEAKS      2   // {min pixel, max pixel}, as frame indices
+#define BUS_CH_THERM_BLOBS      3   // {blob count, hottest track ID, its x, its y}
+#define BUS_CH_THERM_ALARM      4   // {pixels in alarm, first of them, thermistor C}
+
+/* IDs in the baro's DerivedValues. These are in order of definition. */
+#define BARO_DV_PRESSURE        0   // Pa
+#define BARO_DV_TEMPERATURE     1   // C
+#define BARO_DV_HUMIDITY        2   // %RH
+#define BARO_DV_ALTITUDE        3   // m
+#define BARO_DV_DEW_POINT       4   // C
+#define BARO_DV_SEA_LEVEL       5   // Pa
+#define BARO_DV_HEAT_INDEX      6   // C
+#define BARO_DV_ABS_HUMIDITY    7   // g/m^3
+
 /* Struct for tracking application state. */
 typedef struct {
   const char* const title;           // Name of tha application.
@@ -121,6 +143,23 @@ typedef struct {
 #define ICON_MAGNET   10
 #define ICON_BATTERY  11
 
+/* Main loop profiler stages */
+#define LOOP_STAGE_CONSOLE     0
+#define LOOP_STAGE_IRQ         1
+#define LOOP_STAGE_TOUCH       2
+#define LOOP_STAGE_UV          3
+#define LOOP_STAGE_BARO        4
+#define LOOP_STAGE_TSL2561     5
+#define LOOP_STAGE_GRIDEYE     6
+#define LOOP_STAGE_TMP102      7
+#define LOOP_STAGE_DISPLAY     8
+#define LOOP_STAGE_SLEEP       9
+#define LOOP_STAGE_I2C        10
+#define LOOP_STAGE_FLUSH      11
+#define LOOP_STAGE_LOG        12
+#define LOOP_STAGE_REPLAY     13
+#define LOOP_STAGE_COUNT      14
+
 uint8_t* bitmapPointer(unsigned int idx);
 inline uint16_t strict_max(uint16_t a, uint16_t b) { return (a > b) ? a:b; };
 inline uint16_t strict_min(uint16_t a, uint16_t b) { return (a > b) ? b:a; };
@@ -4,6 +4,9 @@
 #include <Arduino.h>
 #include <StringBuilder.h>
 #include <SensorFilter.h>
+#include "RollupSeries.h"
+#include "SeriesCodec.h"
+#include "GraphSeries.h"
 
 #include <Audio.h>
 #include <Wire.h>
@@ -14,6 +17,8 @@
 
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1331.h>
+#include "SPIBusLock.h"
+#include "SSD1331Framebuffer.h"
 #include "VEML6075.h"
 #include <ICM_20948.h>
 #include "BME280.h"
@@ -22,6 +27,20 @@
 #include "TSL2561.h"
 #include "TMP102.h"
 #include "ParsingConsole.h"
+#include "I2CBusQueue.h"
+#include "Scheduler.h"
+#include "IRQEventQueue.h"
+#include "LoopProfiler.h"
+#include "SampleLogger.h"
+#include "LogReader.h"
+#include "LogReplay.h"
+#include "SampleBus.h"
+#include "DerivedValues.h"
+#include "AtmoMath.h"
+#include "ThermFrame.h"
+#include "ThermPalette.h"
+#include "ThermUpscaler.h"
+#include "ThermBlobs.h"
 
 
 /*
@@ -59,7 +78,9 @@ const float THERM_TEMP_MIN = 0.0;
 /*******************************************************************************
 * Globals
 *******************************************************************************/
-Adafruit_SSD1331 display = Adafruit_SSD1331(&SPI, DISPLAY_CS_PIN, DISPLAY_DC_PIN, DISPLAY_RST_PIN);
+Adafruit_SSD1331 panel = Adafruit_SSD1331(&SPI, DISPLAY_CS_PIN, DISPLAY_DC_PIN, DISPLAY_RST_PIN);
+SPIBusLock spi0_lock;   // Advisory. Only the display takes it, for the length of a flush.
+SSD1331Framebuffer display(&panel, &SPI, &spi0_lock);   // All drawing goes here. Flushed once per frame.
 
 /* Audio library... */
 AudioSynthWaveformSine   sineL;          //xy=86.00000762939453,296.0000877380371
@@ -99,14 +120,18 @@ AudioConnection          patchCord17(ampL, 0, i2s_dac, 0);
 uint8_t fft_bars_shown[96];
 
 
+/*
+* The baro converts on its own timer. These settings give a measurement about
+*   every 171ms, with the IIR filter taking out door slams and breath.
+*/
 BME280Settings baro_settings(
   0x76,
+  BME280OSR::X2,
   BME280OSR::X1,
-  BME280OSR::X1,
-  BME280OSR::X1,
-  BME280Mode::Forced,
-  BME280StandbyTime::StandbyTime_1000ms,
-  BME280Filter::Off
+  BME280OSR::X16,
+  BME280Mode::Normal,
+  BME280StandbyTime::StandbyTime_125ms,
+  BME280Filter::X4
 );
 
 /* Touch board */
@@ -127,51 +152,148 @@ ICM_20948_SPI imu;
 TSL2561 tsl2561(0x39, TSL2561_IRQ_PIN);
 BME280I2C baro(baro_settings);
 
-/* Immediate data... */
-static Vector3f64 grav;       // Gravity vector from the IMU.
-static Vector3f64 acc_vect;   // Acceleration vector from the IMU.
-static Vector3f64 gyr_vect;   // Gyroscopic vector from the IMU.
-static Vector3f64 mag_vect0;  // Magnetism vector from the IMU.
-static Vector3f64 mag_vect1;  // Magnetism vector from the DRV425 complex.
-static float    temperature       = 0.0;    // TMP102
-static float    altitude          = 0.0;    // BME280
-static float    dew_point         = 0.0;    // BME280
-static float    sea_level         = 0.0;    // BME280
-static float    battery_voltage   = 0.0;    //
-static float    therm_pixels[64];
-static float    therm_field_min   = THERM_TEMP_MAX;
-static float    therm_field_max   = THERM_TEMP_MIN;
-static float    therm_field_stdev = 0.0;
-static double   therm_field_sum   = 0.0;
-
-/* Data buffers for sensors. */
-static SensorFilter<float> graph_array_pressure(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_humidity(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_air_temp(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_psu_temp(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_uva(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_uvb(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_uvi(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_ana_light(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_visible(FilteringStrategy::RAW, 96, 0);
-static SensorFilter<float> graph_array_therm_mean(FilteringStrategy::RAW, 96, 0);
+/* Immediate data. Drivers publish here, and everything else subscribes. */
+static SampleBus sample_bus;
+static DerivedValues baro_derived;   // Computed only when asked for.
+static ThermUpscaler therm_upscaler(32);   // Thermopile frame, as the tricorder draws it.
+static ThermPalette  therm_palette(ThermPaletteID::IRONBOW);
+static ThermBlobTracker therm_blobs(micros);   // Fed by the sample bus.
+
+/* Data buffers for sensors. The baro series hold about five minutes at 5Hz. */
+static GraphSeries<float> graph_array_pressure(FilteringStrategy::RAW, 1536, 0);
+static GraphSeries<float> graph_array_humidity(FilteringStrategy::RAW, 1536, 0);
+static GraphSeries<float> graph_array_air_temp(FilteringStrategy::RAW, 1536, 0);
+static GraphSeries<float> graph_array_psu_temp(FilteringStrategy::RAW, 96, 0);
+static GraphSeries<float> graph_array_uva(FilteringStrategy::RAW, 96, 0);
+static GraphSeries<float> graph_array_uvb(FilteringStrategy::RAW, 96, 0);
+static GraphSeries<float> graph_array_uvi(FilteringStrategy::RAW, 96, 0);
+static GraphSeries<float> graph_array_ana_light(FilteringStrategy::RAW, 96, 0);
+static GraphSeries<float> graph_array_visible(FilteringStrategy::RAW, 96, 0);
+static GraphSeries<float> graph_array_therm_mean(FilteringStrategy::RAW, 96, 0);
+
+/* Coarser tiers of the same streams, for trends. Attached in setup(). */
+static RollupSeries rollup_pressure(millis);
+static RollupSeries rollup_humidity(millis);
+static RollupSeries rollup_air_temp(millis);
+static RollupSeries rollup_psu_temp(millis);
+static RollupSeries rollup_uva(millis);
+static RollupSeries rollup_uvb(millis);
+static RollupSeries rollup_uvi(millis);
+static RollupSeries rollup_ana_light(millis);
+static RollupSeries rollup_visible(millis);
+static RollupSeries rollup_therm_mean(millis);
+
+/*
+* Full-resolution archives of the slow streams. Values are rounded to about
+*   the sensor's resolution, which costs 8-12 bits per sample instead of 32.
+*/
+static CompressedSeries archive_pressure(millis, 128, SeriesCodecMode::QUANT_DELTA, 0.25);
+static CompressedSeries archive_humidity(millis, 128, SeriesCodecMode::QUANT_DELTA, 0.01);
+static CompressedSeries archive_air_temp(millis, 128, SeriesCodecMode::QUANT_DELTA, 0.01);
+static CompressedSeries archive_uva(millis, 64, SeriesCodecMode::QUANT_DELTA, 0.1);
+static CompressedSeries archive_uvb(millis, 64, SeriesCodecMode::QUANT_DELTA, 0.1);
+static CompressedSeries archive_uvi(millis, 64, SeriesCodecMode::QUANT_DELTA, 0.001);
+static CompressedSeries archive_visible(millis, 64, SeriesCodecMode::QUANT_DELTA, 0.1);
+static CompressedSeries archive_therm_mean(millis, 64, SeriesCodecMode::QUANT_DELTA, 0.01);
+
+/* 0 is raw. 1 to tiers() are rollups. One past that is the archive. */
+static uint8_t      graph_tier = 0;
 
 /* Cheeseball async support stuff. */
 static uint8_t  update_disp_rate  = 30;     // Update in Hz for the display
-static uint8_t  update_baro_rate  = 5;      // Update in Hz for baro.
+static uint8_t  update_baro_rate  = 5;      // Update in Hz for baro, until it reports its own.
 
 static uint32_t boot_time         = 0;      // millis() at boot.
 static uint32_t config_time       = 0;      // millis() at end of setup().
-static uint32_t off_time_vib      = 0;      // millis() when vibrator should be disabled.
-static uint32_t off_time_led_r    = 0;      // millis() when LED_R should be disabled.
-static uint32_t off_time_led_g    = 0;      // millis() when LED_G should be disabled.
-static uint32_t off_time_led_b    = 0;      // millis() when LED_B should be disabled.
 static uint32_t off_time_display  = 0;      // millis() when the display should be blanked.
 static uint32_t last_interaction  = 0;      // millis() when the user last interacted.
-static uint32_t update_baro_last  = 0;      // millis() when the baro sensor last updated.
-static uint32_t update_baro_next  = 0;      // millis() when the baro sensor next updates.
-static uint32_t disp_update_last  = 0;      // millis() when the display last updated.
-static uint32_t disp_update_next  = 0;      // millis() when the display next updates.
+
+/* I2C buses. Wire1 carries the sensors. */
+static TwoWireBusDriver i2c0_driver(&Wire);
+static TwoWireBusDriver i2c1_driver(&Wire1);
+static I2CBusQueue i2c0("i2c0", &i2c0_driver, micros);
+static I2CBusQueue i2c1("i2c1", &i2c1_driver, micros);
+
+/*
+* The Arduino IDE writes prototypes for the sketch. The host build in sim/
+*   compiles it as plain C++, so the ones used before their definitions are
+*   declared here.
+*/
+void task_fxn_led_r_off();
+void task_fxn_led_g_off();
+void task_fxn_led_b_off();
+void task_fxn_vib_off();
+void task_fxn_touch();
+void task_fxn_uv();
+void task_fxn_baro();
+void task_fxn_tsl2561();
+void task_fxn_grideye();
+void task_fxn_tmp102();
+void task_fxn_ui_timeout();
+void task_fxn_display();
+void task_fxn_log();
+void task_fxn_replay();
+void draw_graph_obj(
+  int x, int y, int w, int h, uint16_t color,
+  bool draw_base, bool draw_v_ticks, bool draw_h_ticks,
+  GraphSeries<float>* filt
+);
+
+/* Scheduled tasks. Periods are in microseconds. */
+static CoopScheduler scheduler(micros);
+static CoopTask task_led_r_off("led_r_off",  task_fxn_led_r_off, 0, 200);
+static CoopTask task_led_g_off("led_g_off",  task_fxn_led_g_off, 0, 200);
+static CoopTask task_led_b_off("led_b_off",  task_fxn_led_b_off, 0, 200);
+static CoopTask task_vib_off("vib_off",      task_fxn_vib_off,   0, 200);
+static CoopTask task_touch("touch",          task_fxn_touch,     50000, 180);
+static CoopTask task_uv("uv",                task_fxn_uv,        10000);
+static CoopTask task_baro("baro",            task_fxn_baro,      1000000 / update_baro_rate);
+static CoopTask task_tsl2561("tsl2561",      task_fxn_tsl2561,   10000);
+static CoopTask task_grideye("grideye",      task_fxn_grideye,   10000);
+static CoopTask task_tmp102("tmp102",        task_fxn_tmp102,    50000);
+static CoopTask task_ui_timeout("ui_timeout", task_fxn_ui_timeout, 1000000, 10);
+static CoopTask task_display("display",      task_fxn_display,   1000000 / update_disp_rate, 100);
+static CoopTask task_log("log",              task_fxn_log,       10000, 60);
+static CoopTask task_replay("replay",        task_fxn_replay,    1000, 60);
+
+/* Recording to the SD card. About nine hours at the full sensor load. */
+#define LOG_PREALLOC_SECTORS  131072      // 64MB
+static bool         sd_present = false;
+static SdLogSink    sd_sink(&SD.sdfs);
+static SampleLogger logger(&sd_sink, millis, micros);
+
+/* Reading recordings back in the Data Manager. */
+#define DM_MAX_FILES          32
+#define DM_SCRUB_WINDOW_MS    10000       // How far past the scrub point to look for each sensor.
+#define DM_SCRUB_SENSORS      ((1 << (uint8_t) SensorID::BARO) | (1 << (uint8_t) SensorID::LIGHT) | \
+                               (1 << (uint8_t) SensorID::UV))
+static SdLogSource  dm_source(&SD.sdfs);
+static LogReader    dm_reader(&dm_source);
+static char         dm_names[DM_MAX_FILES][13];
+static uint32_t     dm_sizes[DM_MAX_FILES];
+static uint8_t      dm_file_count = 0;
+static int8_t       dm_open_file  = -1;   // Index into dm_names, or -1 for the list.
+
+/*
+* Replay of a recording in place of the sensors. While a replay runs, the
+*   sensor tasks leave the hardware alone, and the replay task publishes each
+*   recorded sample, at its recorded time, as its sensor would have.
+*/
+#define REPLAY_MAX_PER_PASS   32          // Bounds the time one pass can take.
+#define REPLAY_SENSORS        ((1 << (uint8_t) SensorID::BARO) | (1 << (uint8_t) SensorID::LIGHT) | \
+                               (1 << (uint8_t) SensorID::UV) | (1 << (uint8_t) SensorID::TEMP) | \
+                               (1 << (uint8_t) SensorID::THERMOPILE))
+static SdLogSource      replay_source(&SD.sdfs);
+static LogReader        replay_reader(&replay_source);
+static LogReplay        replay(&replay_reader, millis);
+
+/* Profiling. Order must match the LOOP_STAGE_* defines. */
+static const char* const LOOP_STAGE_NAMES[LOOP_STAGE_COUNT] = {
+  "console", "irq", "touch", "uv", "baro",
+  "tsl2561", "grideye", "tmp102", "display", "sleep",
+  "i2c", "flush", "log", "replay"
+};
+static LoopProfiler profiler(LOOP_STAGE_NAMES, LOOP_STAGE_COUNT);
 
 /* Console junk... */
 ParsingConsole console(128);
@@ -181,6 +303,7 @@ static const TCode arg_list_1_uint[]  = {TCode::UINT,  TCode::NONE};
 static const TCode arg_list_1_float[] = {TCode::FLOAT, TCode::NONE};
 static const TCode arg_list_2_uint[]  = {TCode::UINT,  TCode::UINT,  TCode::NONE};
 static const TCode arg_list_3_uint[]  = {TCode::UINT,  TCode::UINT,  TCode::UINT,  TCode::NONE};
+static const TCode arg_list_4_uint[]  = {TCode::UINT,  TCode::UINT,  TCode::UINT,  TCode::UINT,  TCode::NONE};
 static const TCode arg_list_4_uuff[]  = {TCode::UINT,  TCode::UINT,  TCode::FLOAT, TCode::FLOAT, TCode::NONE};
 static const TCode arg_list_4_float[] = {TCode::FLOAT, TCode::FLOAT, TCode::FLOAT, TCode::FLOAT, TCode::NONE};
 
@@ -191,45 +314,46 @@ static AppID    app_page            = AppID::TRICORDER;
 static AppID    app_previous        = AppID::APP_SELECT;
 static bool     dirty_button        = false;
 static bool     dirty_slider        = false;
-static bool     imu_irq_fired       = false;
 
 
 /*******************************************************************************
 * ISRs
+* The GridEYE and TSL2561 drivers own their ISRs, and push to the same queue.
 *******************************************************************************/
-void imu_isr_fxn() {         imu_irq_fired = true;        }
+void imu_isr_fxn() {   irq_queue.push(IRQSource::IMU, micros());   }
 
 
 
 /*******************************************************************************
 * LED and vibrator control
-* Only have enable functions since disable is done by timer in the main loop.
+* Only have enable functions since disable is done by one-shot tasks in the
+*   scheduler. Durations are in milliseconds.
 *******************************************************************************/
 void ledOn(uint8_t idx, uint32_t duration, uint16_t intensity = 3500) {
-  uint32_t* millis_ptr = nullptr;
+  CoopTask* off_task = nullptr;
   switch (idx) {
     case LED_R_PIN:
       analogWrite(LED_R_PIN, intensity);
-      millis_ptr = &off_time_led_r;
+      off_task = &task_led_r_off;
       break;
     case LED_G_PIN:
       analogWrite(LED_G_PIN, intensity);
-      millis_ptr = &off_time_led_g;
+      off_task = &task_led_g_off;
       break;
     case LED_B_PIN:
       analogWrite(LED_B_PIN, intensity);
-      millis_ptr = &off_time_led_b;
+      off_task = &task_led_b_off;
       break;
     default:
       return;
   }
-  *millis_ptr = millis() + duration;
+  scheduler.fireIn(off_task, duration * 1000);
 }
 
 
 void vibrateOn(uint32_t duration, uint16_t intensity = 4095) {
   analogWrite(VIBRATOR_PIN, intensity);
-  off_time_vib = millis() + duration;
+  scheduler.fireIn(&task_vib_off, duration * 1000);
 }
 
 
@@ -415,18 +539,171 @@ void redraw_suspended_window() {
 }
 
 
+/*
+* Fills the Data Manager's list with the recordings in the card's root.
+*/
+void dm_scan_files() {
+  dm_file_count = 0;
+  if (!sd_present) {
+    return;
+  }
+  FsFile root = SD.sdfs.open("/");
+  FsFile f;
+  while ((dm_file_count < DM_MAX_FILES) && f.openNext(&root, O_RDONLY)) {
+    char name[16];
+    if (!f.isDir() && f.getName(name, sizeof(name))) {
+      const size_t LEN = strlen(name);
+      if ((LEN < 13) && (0 == strncmp(name, "LOG", 3)) && (LEN > 4) && (0 == strcmp(name + LEN - 4, ".BIN"))) {
+        strcpy(dm_names[dm_file_count], name);
+        dm_sizes[dm_file_count] = (uint32_t) (f.fileSize() >> 10);
+        dm_file_count++;
+      }
+    }
+    f.close();
+  }
+  root.close();
+}
+
+
+/*
+* Seeks the open recording to the given time, and pulls out the first reading
+*   of each scrubbed sensor that falls within the scrub window. Only the
+*   sensors we show are decoded.
+*/
+void dm_draw_scrub(uint32_t t_ms) {
+  float baro[3] = {NAN, NAN, NAN};
+  float uv[3]   = {NAN, NAN, NAN};
+  float lux     = NAN;
+  uint16_t found = 0;
+  const uint32_t READS_0 = dm_reader.sectorReads();
+  const uint32_t T0      = micros();
+  dm_reader.filter(DM_SCRUB_SENSORS, t_ms + DM_SCRUB_WINDOW_MS);
+  dm_reader.seek(t_ms);
+  LogRecord rec;
+  while ((found != DM_SCRUB_SENSORS) && (1 == dm_reader.next(&rec))) {
+    const uint16_t BIT = 1 << rec.sensor;
+    if (0 == (found & BIT)) {
+      found |= BIT;
+      switch ((SensorID) rec.sensor) {
+        case SensorID::BARO:
+          for (uint8_t i = 0; i < 3; i++) baro[i] = rec.getFloat(i);
+          break;
+        case SensorID::UV:
+          for (uint8_t i = 0; i < 3; i++) uv[i] = rec.getFloat(i);
+          break;
+        case SensorID::LIGHT:  lux = rec.getFloat(0);  break;
+        default:  break;
+      }
+    }
+  }
+  const uint32_t DT = micros() - T0;
+
+  const uint32_t OFFSET_S = (t_ms - dm_reader.firstTime()) / 1000;
+  display.fillRect(0, 27, display.width(), display.height() - 27, BLACK);
+  display.setCursor(0, 27);
+  display.setTextColor(WHITE);
+  display.print("@");
+  display.setTextColor(CYAN, BLACK);
+  display.printf("%02u:%02u:%02u ", OFFSET_S / 3600, (OFFSET_S / 60) % 60, OFFSET_S % 60);
+  display.setTextColor(WHITE, BLACK);
+  display.printf("%uus\n", DT);
+  display.setTextColor(0xFE00, BLACK);
+  display.print("P ");
+  display.print(baro[0]);
+  display.setTextColor(WHITE, BLACK);
+  display.printf(" %ur\n", dm_reader.sectorReads() - READS_0);
+  display.setTextColor(0x83D0, BLACK);
+  display.print("T ");
+  display.print(baro[1]);
+  display.setTextColor(0x03E0, BLACK);
+  display.print(" H ");
+  display.println(baro[2]);
+  display.setTextColor(0xF100, BLACK);
+  display.print("Lx ");
+  display.print(lux);
+  display.setTextColor(MAGENTA, BLACK);
+  display.print(" UVI ");
+  display.println(uv[2]);
+}
+
+
 /*
 * Draws the data manager app.
+* The slider picks a recording from the list, and button 2 opens it. Once
+*   open, the slider scrubs through it, and button 0 goes back to the list.
 */
 void redraw_data_mgmt_window() {
   if (drawn_app != active_app) {
     redraw_app_window("Data Manager", 0, 0);
+    dm_scan_files();
+    dm_open_file = -1;
+    dirty_slider = true;
+  }
+
+  if (dirty_slider) {
+    const uint16_t SVAL = strict_min((uint16_t) touch->sliderValue(), (uint16_t) 60);
+    if (dm_open_file < 0) {
+      display.fillRect(0, 11, display.width(), display.height() - 11, BLACK);
+      display.setCursor(0, 11);
+      if (0 == dm_file_count) {
+        display.setTextColor(RED);
+        display.print(sd_present ? "No recordings" : "No SD card");
+      }
+      else {
+        const uint8_t SEL   = (SVAL * (dm_file_count - 1) + 30) / 60;
+        const uint8_t FIRST = (SEL > 5) ? (SEL - 5) : 0;
+        for (uint8_t i = FIRST; (i < dm_file_count) && (i < (FIRST + 6)); i++) {
+          display.setTextColor((i == SEL) ? YELLOW : WHITE, BLACK);
+          display.printf("%c%-10s%4uK\n", (i == SEL) ? '>' : ' ', dm_names[i], dm_sizes[i]);
+        }
+      }
+    }
+    else if (dm_reader.isOpen()) {
+      const uint32_t SPAN = dm_reader.lastTime() - dm_reader.firstTime();
+      dm_draw_scrub(dm_reader.firstTime() + (uint32_t) (((uint64_t) SPAN * SVAL) / 60));
+    }
+    dirty_slider = false;
   }
 
   if (dirty_button) {
     if (touch->buttonPressed(0)) {
-      // Interpret a cancel press as a return to APP_SELECT.
-      active_app = AppID::APP_SELECT;
+      if (dm_open_file < 0) {
+        // Interpret a cancel press as a return to APP_SELECT.
+        active_app = AppID::APP_SELECT;
+      }
+      else {
+        dm_reader.close();
+        dm_source.close();
+        dm_open_file = -1;
+        redraw_app_window("Data Manager", 0, 0);
+        dirty_slider = true;
+      }
+    }
+    else if (touch->buttonPressed(2) && (dm_open_file < 0) && (dm_file_count > 0)) {
+      const uint16_t SVAL = strict_min((uint16_t) touch->sliderValue(), (uint16_t) 60);
+      dm_open_file = (SVAL * (dm_file_count - 1) + 30) / 60;
+      display.fillRect(0, 11, display.width(), display.height() - 11, BLACK);
+      display.setCursor(0, 11);
+      display.setTextColor(WHITE);
+      display.println(dm_names[dm_open_file]);
+      if ((0 == dm_source.open(dm_names[dm_open_file])) && (0 == dm_reader.open())) {
+        const uint32_t SECS = (dm_reader.lastTime() - dm_reader.firstTime()) / 1000;
+        display.setTextColor(CYAN);
+        display.printf("%02u:%02u:%02u ", SECS / 3600, (SECS / 60) % 60, SECS % 60);
+        // One letter per sensor present, in SensorID order.
+        const char* const SENSOR_CHARS = "BMILAUGTPV";
+        for (uint8_t i = 0; i < 10; i++) {
+          display.setTextColor((dm_reader.sensors() & (1 << i)) ? GREEN : 0x4208);
+          display.print(SENSOR_CHARS[i]);
+        }
+        display.println();
+        dirty_slider = true;
+      }
+      else {
+        dm_source.close();
+        display.setTextColor(RED);
+        display.print("Can't read it.");
+      }
     }
     dirty_button = false;
   }
@@ -537,8 +814,6 @@ void add_to_graph_data_array(float* arr, float x) {
 void redraw_tricorder_window() {
   const uint8_t PIXEL_SIZE  = 4;
   const uint8_t TEXT_OFFSET = (PIXEL_SIZE*8)+5;
-  const float TEMP_RANGE = THERM_TEMP_MAX - THERM_TEMP_MIN;
-  const float BINSIZE_T  = TEMP_RANGE / (PIXEL_SIZE * 8);  // Space of display gives scale size.
 
   if (drawn_app != active_app) {
     redraw_app_window("Tricorder", 0, 0);
@@ -569,7 +844,7 @@ void redraw_tricorder_window() {
       display.setTextColor(WHITE);
       display.print("Alt: ");
       display.setTextColor(GREEN, BLACK);
-      display.print(altitude);
+      display.print(baro_derived.get(BARO_DV_ALTITUDE));
       display.println("m");
       display.setTextColor(WHITE);
       display.print("Humidity: ");
@@ -705,15 +980,24 @@ void redraw_tricorder_window() {
   }
   else {
     // Thermopile
-    if (graph_array_therm_mean.dirty()) {
-      const float MIDPOINT_T = therm_field_max - ((therm_field_max - therm_field_min) / 2);
-      for (uint8_t i = 0; i < 64; i++) {
-        uint x = (i & 0x07) * PIXEL_SIZE;
-        uint y = (i >> 3) * PIXEL_SIZE;
-        float pix_deviation = abs(MIDPOINT_T - therm_pixels[i]);
-        uint8_t pix_intensity = BINSIZE_T * (pix_deviation / (therm_field_max - MIDPOINT_T));
-        uint16_t color = (therm_pixels[i] <= MIDPOINT_T) ? pix_intensity : (pix_intensity << 11);
-        display.fillRect(x, y, PIXEL_SIZE, PIXEL_SIZE, color);
+    const Sample* frame = sample_bus.latest((uint8_t) SensorID::THERMOPILE, BUS_CH_READING);
+    const Sample* stats = sample_bus.latest((uint8_t) SensorID::THERMOPILE, BUS_CH_THERM_STATS);
+    if (graph_array_therm_mean.dirty() && (nullptr != frame) && (nullptr != stats)) {
+      const float* therm_pixels    = frame->values();
+      const float  therm_field_min = stats->value(0);
+      const float  therm_field_max = stats->value(1);
+      therm_palette.autoRange(therm_field_min, therm_field_max);
+      therm_upscaler.render(therm_pixels, &therm_palette);
+      display.blit(0, 0, therm_upscaler.size(), therm_upscaler.size(), therm_upscaler.image());
+      // Mark the things that are being tracked.
+      const float BLOB_SCALE = therm_upscaler.size() / 8.0f;
+      for (uint8_t i = 0; i < therm_blobs.trackCount(); i++) {
+        const ThermTrack* trk = therm_blobs.track(i);
+        if (0 == trk->misses) {
+          const int16_t BX = (int16_t) ((trk->blob.x + 0.5f) * BLOB_SCALE);
+          const int16_t BY = (int16_t) ((trk->blob.y + 0.5f) * BLOB_SCALE);
+          display.drawCircle(BX, BY, 2, WHITE);
+        }
       }
       display.setTextSize(0);
       display.setCursor(TEXT_OFFSET, 0);
@@ -742,7 +1026,7 @@ void redraw_tricorder_window() {
       display.setTextColor(WHITE);
       display.print("STDEV: ");
       display.setTextColor(RED, BLACK);
-      display.println(therm_field_stdev);
+      display.println(stats->value(3));
     }
   }
 
@@ -929,36 +1213,47 @@ void render_button_icon(uint8_t sym, int x, int y, uint16_t color) {
 
 
 /*
-* Given a data array, and parameters for the graph, draw the data to the
-*   display.
+* Given per-column envelopes, the extremes of the data, and parameters for the
+*   graph, draw the data to the display. Each column is a vertical span from
+*   its minimum to its maximum, stretched to meet the column before it, so
+*   that a trace stays connected at any decimation. Columns that are NAN are
+*   left blank.
 */
-void draw_graph_obj(
+void draw_graph_spans(
   int x, int y, int w, int h, uint16_t color,
   bool draw_base, bool draw_v_ticks, bool draw_h_ticks,
-  float* dataset, uint32_t data_len
+  const float* col_lo, const float* col_hi, uint16_t cols,
+  float v_min, float v_max, float last_datum
 ) {
   if (draw_base) {   // Draw the basic frame and axes?
     display.drawFastVLine(x, y, h, WHITE);
     display.drawFastHLine(x, y+h, w, WHITE);
   }
   display.fillRect(x+1, y, w, h-1, BLACK);
-  if (w < data_len) {
-    dataset += (data_len - w);
-    data_len = w;
+  if (0 == cols) {
+    return;
   }
 
-  float v_max = 0.0;
-  float v_min = 0.0;
-  for (uint32_t i = 0; i < data_len; i++) {
-    float tmp = *(dataset + i);
-    v_max = strict_max(v_max, tmp);
-    v_min = strict_min(v_min, tmp);
-  }
-  float h_scale = data_len / w;
+  // The baseline is always zero.
+  v_max = strict_max(v_max, 0.0f);
+  v_min = strict_min(v_min, 0.0f);
   float v_scale = (v_max - v_min) / h;
-  for (uint32_t i = 0; i < data_len; i++) {
-    uint8_t tmp = *(dataset + i) / v_scale;
-    display.writePixel(i + x, (y+h)-tmp, color);
+  if (0.0f == v_scale) {
+    v_scale = 1.0f;
+  }
+  for (uint16_t c = 0; c < cols; c++) {
+    if (isnan(col_lo[c])) {
+      continue;
+    }
+    float top = col_hi[c];
+    float bot = col_lo[c];
+    if ((c > 0) && !isnan(col_lo[c-1])) {
+      top = strict_max(top, col_lo[c-1]);
+      bot = strict_min(bot, col_hi[c-1]);
+    }
+    int y_top = (y+h) - (int) ((top - v_min) / v_scale);
+    int y_bot = (y+h) - (int) ((bot - v_min) / v_scale);
+    display.drawFastVLine(x + c, y_top, (y_bot - y_top) + 1, color);
   }
   if (draw_v_ticks) {
     display.drawFastHLine(x+1, y, 2, WHITE);
@@ -969,33 +1264,153 @@ void draw_graph_obj(
     display.print(v_min);
   }
   if (draw_h_ticks) {
-    float last_datum = *(dataset + (data_len-1));
-    uint8_t tmp = last_datum / v_scale;
+    uint8_t tmp = (last_datum - v_min) / v_scale;
     //display.fillCircle(x+w, tmp+y, 1, color);
     display.setCursor(x, strict_min((uint16_t) ((y+h)-tmp), (uint16_t) (h-1)));
     display.setTextColor(color);
-    display.print(*(dataset + (data_len-1)));
+    display.print(last_datum);
+  }
+}
+
+
+/*
+* Given a data array, and parameters for the graph, draw the data to the
+*   display. If there are more samples than columns, each column shows the
+*   envelope of its share of them.
+*/
+void draw_graph_obj(
+  int x, int y, int w, int h, uint16_t color,
+  bool draw_base, bool draw_v_ticks, bool draw_h_ticks,
+  float* dataset, uint32_t data_len
+) {
+  float col_lo[SSD1331_FB_WIDTH];
+  float col_hi[SSD1331_FB_WIDTH];
+  const uint32_t MAX_COLS = strict_min((uint16_t) w, (uint16_t) SSD1331_FB_WIDTH);
+  const uint32_t PER_COL  = (MAX_COLS > 0) ? ((data_len + MAX_COLS - 1) / MAX_COLS) : 0;
+  float    v_max = 0.0;
+  float    v_min = 0.0;
+  uint16_t cols  = 0;
+  for (uint32_t i = 0; (PER_COL > 0) && (i < data_len); i += PER_COL) {
+    const uint32_t END = (i + PER_COL < data_len) ? (i + PER_COL) : data_len;
+    float lo = *(dataset + i);
+    float hi = lo;
+    for (uint32_t n = i + 1; n < END; n++) {
+      lo = strict_min(lo, *(dataset + n));
+      hi = strict_max(hi, *(dataset + n));
+    }
+    col_lo[cols] = lo;
+    col_hi[cols] = hi;
+    v_min = strict_min(v_min, lo);
+    v_max = strict_max(v_max, hi);
+    cols++;
+  }
+  const float LAST_DATUM = (data_len > 0) ? *(dataset + (data_len-1)) : 0.0f;
+  draw_graph_spans(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, col_lo, col_hi, cols, v_min, v_max, LAST_DATUM);
+}
+
+
+/*
+* Given a rollup series, a tier, and parameters for the graph, draw the last
+*   span_ms of that tier to the display. A span of 0 draws all of it. Periods
+*   with no samples are left blank.
+*/
+void draw_graph_obj(
+  int x, int y, int w, int h, uint16_t color,
+  bool draw_base, bool draw_v_ticks, bool draw_h_ticks,
+  RollupSeries* rollup, uint8_t tier, uint32_t span_ms
+) {
+  RollupBucket buckets[SSD1331_FB_WIDTH];
+  float col_lo[SSD1331_FB_WIDTH];
+  float col_hi[SSD1331_FB_WIDTH];
+  const uint16_t MAX_COLS = strict_min((uint16_t) w, (uint16_t) SSD1331_FB_WIDTH);
+  const uint16_t COLS     = rollup->query(tier, span_ms, buckets, MAX_COLS);
+  float v_max = 0.0;
+  float v_min = 0.0;
+  for (uint16_t c = 0; c < COLS; c++) {
+    if (buckets[c].empty()) {
+      col_lo[c] = NAN;
+      col_hi[c] = NAN;
+    }
+    else {
+      col_lo[c] = buckets[c].min;
+      col_hi[c] = buckets[c].max;
+      v_min = strict_min(v_min, buckets[c].min);
+      v_max = strict_max(v_max, buckets[c].max);
+    }
   }
+  draw_graph_spans(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, col_lo, col_hi, COLS, v_min, v_max, rollup->last());
 }
 
 
 /*
-* Given a filter object, and parameters for the graph, draw the data to the
-*   display.
+* Given a compressed archive, and parameters for the graph, draw the last
+*   span_ms of it to the display. A span of 0 draws all of it. Only the blocks
+*   that hold the span are decoded.
 */
 void draw_graph_obj(
   int x, int y, int w, int h, uint16_t color,
   bool draw_base, bool draw_v_ticks, bool draw_h_ticks,
-  SensorFilter<float>* filt
+  CompressedSeries* archive, uint32_t span_ms
 ) {
-  const uint16_t DATA_SIZE = filt->windowSize();
-  const uint16_t LAST_SIDX = filt->lastIndex();
-  const float*   F_MEM     = filt->memPtr();
-  float tmp_data[DATA_SIZE];
-  for (uint16_t i = 0; i < DATA_SIZE; i++) {
-    tmp_data[i] = *(F_MEM + ((i + LAST_SIDX) % DATA_SIZE));
+  float col_lo[SSD1331_FB_WIDTH];
+  float col_hi[SSD1331_FB_WIDTH];
+  const uint16_t MAX_COLS = strict_min((uint16_t) w, (uint16_t) SSD1331_FB_WIDTH);
+  const uint16_t COLS     = archive->envelope(span_ms, col_lo, col_hi, MAX_COLS);
+  float v_max = 0.0;
+  float v_min = 0.0;
+  for (uint16_t c = 0; c < COLS; c++) {
+    if (!isnan(col_lo[c])) {
+      v_min = strict_min(v_min, col_lo[c]);
+      v_max = strict_max(v_max, col_hi[c]);
+    }
   }
-  draw_graph_obj(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, tmp_data, (uint32_t) DATA_SIZE);
+  draw_graph_spans(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, col_lo, col_hi, COLS, v_min, v_max, archive->last());
+}
+
+
+/*
+* Given a graph series, and parameters for the graph, draw the data to the
+*   display. The whole window is shown, however long it is. Each column reads
+*   the envelopes of the blocks it covers, and the scale comes from the
+*   series' running extremes. So the cost is the same for any history length.
+* If a rollup tier or the archive is selected, and the series has one, that is
+*   drawn instead.
+*/
+void draw_graph_obj(
+  int x, int y, int w, int h, uint16_t color,
+  bool draw_base, bool draw_v_ticks, bool draw_h_ticks,
+  GraphSeries<float>* filt
+) {
+  if ((graph_tier > rollup_pressure.tiers()) && (nullptr != filt->archive())) {
+    draw_graph_obj(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, filt->archive(), 0);
+    return;
+  }
+  if ((graph_tier > 0) && (graph_tier <= rollup_pressure.tiers()) && (nullptr != filt->rollup())) {
+    draw_graph_obj(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, filt->rollup(), graph_tier - 1, 0);
+    return;
+  }
+  float col_lo[SSD1331_FB_WIDTH];
+  float col_hi[SSD1331_FB_WIDTH];
+  const uint16_t BLOCKS   = filt->blocks();
+  const uint16_t MAX_COLS = strict_min((uint16_t) w, (uint16_t) SSD1331_FB_WIDTH);
+  const uint16_t PER_COL  = (MAX_COLS > 0) ? ((BLOCKS + MAX_COLS - 1) / MAX_COLS) : 0;
+  uint16_t cols = 0;
+  for (uint16_t b = 0; (PER_COL > 0) && (b < BLOCKS); b += PER_COL) {
+    float lo = 0.0f;
+    float hi = 0.0f;
+    filt->block(b, &lo, &hi);
+    for (uint16_t n = 1; (n < PER_COL) && ((b + n) < BLOCKS); n++) {
+      float b_lo = lo;
+      float b_hi = hi;
+      filt->block(b + n, &b_lo, &b_hi);
+      lo = strict_min(lo, b_lo);
+      hi = strict_max(hi, b_hi);
+    }
+    col_lo[cols] = lo;
+    col_hi[cols] = hi;
+    cols++;
+  }
+  draw_graph_spans(x, y, w, h, color, draw_base, draw_v_ticks, draw_h_ticks, col_lo, col_hi, cols, filt->minimum(), filt->maximum(), filt->newest());
 }
 
 
@@ -1025,20 +1440,17 @@ void updateDisplay() {
 *******************************************************************************/
 
 /*
-* Reads the VEML6075 and adds the data to the pile.
+* Reads the VEML6075 and publishes it.
 * A long time ago, this was taken from the aped driver's demo code.
 */
 int8_t read_uv_sensor() {
-  int8_t ret = 0;
-  graph_array_uva.feedFilter(uv.uva());
-  graph_array_uvb.feedFilter(uv.uvb());
-  graph_array_uvi.feedFilter(uv.index());
-  return ret;
+  const float VALS[3] = {uv.uva(), uv.uvb(), uv.index()};
+  return sample_bus.publish((uint8_t) SensorID::UV, BUS_CH_READING, micros(), VALS, 3);
 }
 
 
 /*
-* Reads the BME280 and adds the data to the pile.
+* Reads the BME280 and publishes it.
 * A long time ago, this was taken from the aped driver's demo code.
 */
 int8_t read_baro_sensor() {
@@ -1046,14 +1458,9 @@ int8_t read_baro_sensor() {
   float air_pressure      = 0.0;
   float air_temperature   = 0.0;
   float humidity          = 0.0;
-  if (baro.read(&air_pressure, &air_temperature, &humidity, TempUnit::Celsius, PresUnit::Pa)) {
-    altitude  = baro.Altitude(air_pressure);
-    dew_point = baro.DewPoint(air_temperature, humidity);
-    sea_level = baro.EquivalentSeaLevelPressure(altitude, air_temperature, air_pressure);
-    graph_array_humidity.feedFilter(humidity);
-    graph_array_air_temp.feedFilter(air_temperature);
-    graph_array_pressure.feedFilter(air_pressure);
-    ret = 0;
+  if (baro.lastSample(&air_pressure, &air_temperature, &humidity, TempUnit::Celsius, PresUnit::Pa)) {
+    const float VALS[3] = {air_pressure, air_temperature, humidity};
+    ret = sample_bus.publish((uint8_t) SensorID::BARO, BUS_CH_READING, micros(), VALS, 3);
   }
   return ret;
 }
@@ -1069,52 +1476,437 @@ int8_t read_imu() {
 
 
 /*
-* Reads the TSL2561 and adds the data to the pile.
+* Reads the TSL2561 and publishes it.
 */
 int8_t read_visible_sensor() {
-  int8_t ret = 0;
-  ret = graph_array_visible.feedFilter(1.0 * tsl2561.getLux());
-  return ret;
+  const float LUX = 1.0 * tsl2561.getLux();
+  return sample_bus.publish((uint8_t) SensorID::LIGHT, BUS_CH_READING, micros(), LUX);
 }
 
 
 /*
-* Reads the TMP102 (near the PSU and battery) and adds the data to the pile.
+* Reads the TMP102 (near the PSU and battery) and publishes it.
 */
 int8_t read_battery_temperature_sensor() {
-  return graph_array_psu_temp.feedFilter(tmp102.temperature());
+  const float TEMP = tmp102.temperature();
+  return sample_bus.publish((uint8_t) SensorID::TEMP, BUS_CH_READING, micros(), TEMP);
 }
 
 
 /*
-* Reads the GridEye sensor and adds the data to the pile.
+* Publishes a frame (from acquireFrame()) along with its stats.
+*/
+int8_t publish_thermal_frame(float* pixels, const ThermFrameStats* st, uint32_t t_us) {
+  const float STATS[4] = {st->min, st->max, st->mean, st->stdev};
+  const float PEAKS[2] = {(float) st->min_idx, (float) st->max_idx};
+  const int8_t ret = sample_bus.publishFrame((uint8_t) SensorID::THERMOPILE, BUS_CH_READING, t_us, pixels, 64);
+  sample_bus.publish((uint8_t) SensorID::THERMOPILE, BUS_CH_THERM_STATS, t_us, STATS, 4);
+  sample_bus.publish((uint8_t) SensorID::THERMOPILE, BUS_CH_THERM_PEAKS, t_us, PEAKS, 2);
+  return ret;
+}
+
+
+/*
+* Reads the GridEye sensor into a frame from the bus, and publishes it along
+*   with its stats.
 */
 int8_t read_thermopile_sensor() {
-  int8_t ret = 0;
-  therm_field_min   = THERM_TEMP_MAX;   // Reset range markers.
-  therm_field_max   = THERM_TEMP_MIN;   // Reset range markers.
-  therm_field_sum   = 0.0;
-  for (uint8_t i = 0; i < 8; i++) {
-    for (uint8_t n = 0; n < 8; n++) {
-      uint8_t pix_idx = (7 - n) | (i << 3);  // Sensor is rotated 90-deg.
-      uint8_t arr_idx = (n << 3) | (i);
-      therm_pixels[arr_idx] = grideye.getPixelTemperature(pix_idx);
-      therm_field_min = strict_min(therm_pixels[arr_idx], therm_field_min);
-      therm_field_max = strict_max(therm_pixels[arr_idx], therm_field_max);
-      therm_field_sum += therm_pixels[arr_idx];
-    }
-  }
-  float therm_field_mean = therm_field_sum / 64.0;
-  graph_array_therm_mean.feedFilter(therm_field_mean);
-  double deviation_sum = 0.0;
+  float* pixels = sample_bus.acquireFrame();
+  if (nullptr == pixels) {
+    return -1;
+  }
+  const uint32_t NOW = micros();
+  ThermFrameStats st;
+  therm_frame_process(grideye.frameRaw(), pixels, &st);
+  return publish_thermal_frame(pixels, &st, NOW);
+}
+
+
+/*
+* Publishes a recorded sample as its sensor would have, stamped with the given
+*   time. bus_to_logger() recorded what was on the bus, so everything from here
+*   down (graphs, derived values, blobs, the display) sees what it saw then.
+*   Nothing here touches the hardware.
+*/
+int8_t publish_recorded(const LogRecord* rec, uint32_t t_us) {
+  if ((uint8_t) SensorID::THERMOPILE == rec->sensor) {
+    float* pixels = sample_bus.acquireFrame();
+    if (nullptr == pixels) {
+      return -1;
+    }
+    // Recorded frames are already rotated, in hundredths of a degree.
+    for (uint8_t i = 0; i < 64; i++) {
+      pixels[i] = rec->getInt16(i) / 100.0f;
+    }
+    ThermFrameStats st;
+    therm_frame_stats(pixels, &st);
+    return publish_thermal_frame(pixels, &st, t_us);
+  }
+  float vals[SAMPLE_BUS_INLINE_VALUES];
+  const uint8_t RECORDED = rec->len / sizeof(float);
+  const uint8_t COUNT    = (RECORDED < SAMPLE_BUS_INLINE_VALUES) ? RECORDED : SAMPLE_BUS_INLINE_VALUES;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    vals[i] = rec->getFloat(i);
+  }
+  return sample_bus.publish(rec->sensor, BUS_CH_READING, t_us, vals, COUNT);
+}
+
+
+/*
+* The GridEYE is watching, and something crossed a threshold. Publishes which
+*   pixels (as the frame is displayed), and flashes the red LED.
+*/
+int8_t report_thermal_alarm() {
+  const uint8_t* TABLE = grideye.alarmTable();
+  uint8_t first = 0;
   for (uint8_t i = 0; i < 64; i++) {
-    deviation_sum += sq(therm_pixels[i] - therm_field_mean);
+    const uint8_t P = THERM_ROTATION[i];
+    if (TABLE[P >> 3] & (1 << (P & 0x07))) {
+      first = i;
+      break;
+    }
+  }
+  const float ALARM[3] = {(float) grideye.alarmPixels(), (float) first, grideye.getDeviceTemperature()};
+  ledOn(LED_R_PIN, 60, 3500);
+  return sample_bus.publish((uint8_t) SensorID::THERMOPILE, BUS_CH_THERM_ALARM, micros(), ALARM, 3);
+}
+
+
+/*
+* Quantities derived from the baro. Each is only computed when something asks
+*   for it, and then not again until an input it depends on changes.
+*/
+float dv_altitude(DerivedValues* dv) {
+  return baro.Altitude(dv->get(BARO_DV_PRESSURE));
+}
+
+float dv_dew_point(DerivedValues* dv) {
+  return baro.DewPoint(dv->get(BARO_DV_TEMPERATURE), dv->get(BARO_DV_HUMIDITY));
+}
+
+float dv_sea_level(DerivedValues* dv) {
+  return baro.EquivalentSeaLevelPressure(
+    dv->get(BARO_DV_ALTITUDE), dv->get(BARO_DV_TEMPERATURE), dv->get(BARO_DV_PRESSURE)
+  );
+}
+
+float dv_heat_index(DerivedValues* dv) {
+  return baro.HeatIndex(dv->get(BARO_DV_TEMPERATURE), dv->get(BARO_DV_HUMIDITY));
+}
+
+float dv_abs_humidity(DerivedValues* dv) {
+  return baro.AbsoluteHumidity(dv->get(BARO_DV_TEMPERATURE), dv->get(BARO_DV_HUMIDITY));
+}
+
+/* Definition order must match the BARO_DV_* IDs. */
+void setup_baro_derived() {
+  const uint16_t P = 1 << BARO_DV_PRESSURE;
+  const uint16_t T = 1 << BARO_DV_TEMPERATURE;
+  const uint16_t H = 1 << BARO_DV_HUMIDITY;
+  baro_derived.defineInput("pressure");
+  baro_derived.defineInput("temperature");
+  baro_derived.defineInput("humidity");
+  baro_derived.define("altitude",     dv_altitude,     P);
+  baro_derived.define("dew_point",    dv_dew_point,    T | H);
+  baro_derived.define("sea_level",    dv_sea_level,    (1 << BARO_DV_ALTITUDE) | T | P);
+  baro_derived.define("heat_index",   dv_heat_index,   T | H);
+  baro_derived.define("abs_humidity", dv_abs_humidity, T | H);
+}
+
+
+/*
+* Sample bus subscriber that hands new baro readings to the derived values.
+*   This only marks what is stale. Nothing is computed here.
+*/
+void bus_to_baro_derived(const Sample* s) {
+  baro_derived.set(BARO_DV_PRESSURE,    s->value(0));
+  baro_derived.set(BARO_DV_TEMPERATURE, s->value(1));
+  baro_derived.set(BARO_DV_HUMIDITY,    s->value(2));
+}
+
+
+/*
+* Sample bus subscriber that runs each thermopile frame through the blob
+*   tracker, and publishes where the hottest thing in view is. Track ID 0
+*   means there is nothing.
+*/
+void bus_to_therm_blobs(const Sample* s) {
+  therm_blobs.process(s->values());
+  const ThermTrack* hot = therm_blobs.primary();
+  const float BLOBS[4] = {
+    (float) therm_blobs.blobs(),
+    (nullptr != hot) ? (float) hot->id : 0.0f,
+    (nullptr != hot) ? hot->blob.x : 0.0f,
+    (nullptr != hot) ? hot->blob.y : 0.0f
+  };
+  sample_bus.publish((uint8_t) SensorID::THERMOPILE, BUS_CH_THERM_BLOBS, s->t_us, BLOBS, 4);
+}
+
+
+/*
+* Sample bus subscriber that keeps the graphs.
+*/
+void bus_to_graphs(const Sample* s) {
+  switch ((SensorID) s->sensor) {
+    case SensorID::UV:
+      graph_array_uva.feedFilter(s->value(0));
+      graph_array_uvb.feedFilter(s->value(1));
+      graph_array_uvi.feedFilter(s->value(2));
+      break;
+    case SensorID::BARO:
+      graph_array_pressure.feedFilter(s->value(0));
+      graph_array_air_temp.feedFilter(s->value(1));
+      graph_array_humidity.feedFilter(s->value(2));
+      break;
+    case SensorID::LIGHT:
+      graph_array_visible.feedFilter(s->value(0));
+      break;
+    case SensorID::TEMP:
+      graph_array_psu_temp.feedFilter(s->value(0));
+      break;
+    case SensorID::THERMOPILE:
+      // The frame itself comes on READING. Only the stats are graphed.
+      if (BUS_CH_THERM_STATS == s->channel) {
+        graph_array_therm_mean.feedFilter(s->value(2));
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+/*
+* Sample bus subscriber that records to the SD card. Log times are taken from
+*   millis() as the sample arrives, since micros() wraps in about 71 minutes.
+*/
+void bus_to_logger(const Sample* s) {
+  if (!logger.logging()) {
+    return;
+  }
+  if ((uint8_t) SensorID::THERMOPILE == s->sensor) {
+    // The GridEYE resolves 0.25C. Hundredths in an int16 is plenty.
+    int16_t frame[64];
+    for (uint8_t i = 0; i < 64; i++) {
+      frame[i] = (int16_t) (s->value(i) * 100.0f);
+    }
+    logger.log(s->sensor, millis(), frame, sizeof(frame));
+  }
+  else {
+    logger.logFloats(s->sensor, millis(), s->values(), s->count);
+  }
+}
+
+
+
+/*******************************************************************************
+* Scheduled task functions
+*******************************************************************************/
+void task_fxn_led_r_off() {   pinMode(LED_R_PIN, INPUT);      }
+void task_fxn_led_g_off() {   pinMode(LED_G_PIN, INPUT);      }
+void task_fxn_led_b_off() {   pinMode(LED_B_PIN, INPUT);      }
+void task_fxn_vib_off() {     pinMode(VIBRATOR_PIN, INPUT);   }
+
+void task_fxn_touch() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  int8_t t_res = touch->poll();
+  if (0 < t_res) {
+    // Something changed in the hardware.
+  }
+  profiler.record(LOOP_STAGE_TOUCH, c0);
+}
+
+void task_fxn_uv() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  if (!replay.running() && (0 < uv.poll())) {
+    read_uv_sensor();
+  }
+  profiler.record(LOOP_STAGE_UV, c0);
+}
+
+void task_fxn_baro() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  if (!replay.running() && (0 < baro.poll())) {
+    read_baro_sensor();
+  }
+  profiler.record(LOOP_STAGE_BARO, c0);
+}
+
+void task_fxn_tsl2561() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  if (!replay.running() && (0 < tsl2561.poll())) {
+    read_visible_sensor();
+  }
+  profiler.record(LOOP_STAGE_TSL2561, c0);
+}
+
+void task_fxn_grideye() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  if (!replay.running()) {
+    switch (grideye.poll()) {
+      case 1:   read_thermopile_sensor();   break;
+      case 2:   report_thermal_alarm();     break;
+      default:  break;
+    }
+  }
+  profiler.record(LOOP_STAGE_GRIDEYE, c0);
+}
+
+void task_fxn_tmp102() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  if (!replay.running() && (0 < tmp102.poll())) {
+    read_battery_temperature_sensor();
+  }
+  profiler.record(LOOP_STAGE_TMP102, c0);
+}
+
+void task_fxn_ui_timeout() {
+  if ((last_interaction + 100000) <= millis()) {
+    // After 100 seconds, time-out the display.
+    if (AppID::HOT_STANDBY != active_app) {
+      active_app = AppID::HOT_STANDBY;
+    }
+  }
+}
+
+void task_fxn_log() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  logger.service();
+  profiler.record(LOOP_STAGE_LOG, c0);
+}
+
+/*
+* Publishes each replayed sample that has come due, at its recorded time. Time
+*   spent fetching from the card is charged to the replay stage, and the rest
+*   to the sensor.
+*/
+void task_fxn_replay() {
+  if (!replay.running()) {
+    return;
+  }
+  LogRecord rec;
+  for (uint8_t i = 0; i < REPLAY_MAX_PER_PASS; i++) {
+    const uint32_t c0 = LoopProfiler::cycles();
+    const int8_t   RET = replay.poll(&rec);
+    profiler.record(LOOP_STAGE_REPLAY, c0);
+    if (1 != RET) {
+      break;
+    }
+    const uint32_t c1 = LoopProfiler::cycles();
+    publish_recorded(&rec, replay.sampleTimeUs(&rec));
+    switch ((SensorID) rec.sensor) {
+      case SensorID::UV:          profiler.record(LOOP_STAGE_UV, c1);        break;
+      case SensorID::BARO:        profiler.record(LOOP_STAGE_BARO, c1);      break;
+      case SensorID::LIGHT:       profiler.record(LOOP_STAGE_TSL2561, c1);   break;
+      case SensorID::THERMOPILE:  profiler.record(LOOP_STAGE_GRIDEYE, c1);   break;
+      case SensorID::TEMP:        profiler.record(LOOP_STAGE_TMP102, c1);    break;
+      default:                    profiler.record(LOOP_STAGE_REPLAY, c1);    break;
+    }
+  }
+}
+
+void task_fxn_display() {
+  const uint32_t c0 = LoopProfiler::cycles();
+  updateDisplay();
+  const uint32_t c1 = LoopProfiler::cycles();
+  profiler.record(LOOP_STAGE_DISPLAY, c0);
+  display.flush();
+  profiler.record(LOOP_STAGE_FLUSH, c1);
+  //if (millis() >= off_time_display) { display.fillScreen(BLACK);     }
+}
+
+
+
+
+/*******************************************************************************
+* Interrupt event handling
+*******************************************************************************/
+
+/*
+* The SX8634 and DRV425 libraries own their IRQ pins. Both lines are held
+*   asserted (low) until serviced, so after any wake, we sample them and
+*   queue an event for each that is waiting.
+*/
+void sample_shared_irq_lines() {
+  if (LOW == digitalRead(TOUCH_IRQ_PIN)) {
+    irq_queue.push(IRQSource::TOUCH, micros());
+  }
+  if (LOW == digitalRead(DRV425_ADC_IRQ_PIN)) {
+    irq_queue.push(IRQSource::DRV425_ADC, micros());
+  }
+}
+
+
+/*
+* Drain the IRQ queue, handing each event to the driver that owns it.
+* The task functions charge their time to their own profiler stages. The
+*   cycles spent in them are added to task_cycles, so that the caller can
+*   leave them out of the IRQ stage.
+* Returns the number of events dispatched.
+*/
+int8_t dispatch_irq_events(uint32_t* task_cycles) {
+  int8_t ret = 0;
+  IRQEvent evt;
+  while (irq_queue.pop(&evt)) {
+    const uint32_t c0 = LoopProfiler::cycles();
+    switch (evt.src) {
+      case IRQSource::IMU:
+        read_imu();
+        //imu.clearInterrupts();
+        break;
+      case IRQSource::GRIDEYE:
+        task_fxn_grideye();
+        *task_cycles += LoopProfiler::cycles() - c0;
+        break;
+      case IRQSource::TSL2561:
+        task_fxn_tsl2561();
+        *task_cycles += LoopProfiler::cycles() - c0;
+        break;
+      case IRQSource::TOUCH:
+        task_fxn_touch();
+        *task_cycles += LoopProfiler::cycles() - c0;
+        break;
+      case IRQSource::DRV425_ADC:
+        //if (1 == magnetometer.poll()) {
+          // Magnetometer data is fresh.
+        //}
+        break;
+      default:
+        break;
+    }
+    ret++;
   }
-  therm_field_stdev = sqrt(deviation_sum / 64);
   return ret;
 }
 
 
+/*
+* Put the CPU to sleep until the next interrupt. The SysTick interrupt bounds
+*   this at 1ms, which is finer than any deadline we keep.
+* Interrupts are masked around the final check so that an ISR that lands
+*   between the check and the WFI will still wake us (WFI returns on any
+*   pending interrupt, regardless of PRIMASK).
+*/
+void sleep_until_next_event() {
+  if (!i2c0.idle() || !i2c1.idle()) {
+    return;   // Bus work is pending. Don't sleep on it.
+  }
+  if (0 < scheduler.usUntilNextDeadline()) {
+    #if defined(__IMXRT1062__)
+      __disable_irq();
+      if (irq_queue.empty() && !display.serviceDue()) {
+        asm volatile("wfi");
+      }
+      __enable_irq();
+    #else
+      // No interrupts to wait on in a host build. Let the virtual clock run to
+      //   the deadline, but no further than SysTick would let WFI sleep.
+      const uint32_t US_TO_DEADLINE = scheduler.usUntilNextDeadline();
+      delayMicroseconds((US_TO_DEADLINE < 1000) ? US_TO_DEADLINE : 1000);
+    #endif
+  }
+}
+
 
 
 /*******************************************************************************
@@ -1227,60 +2019,53 @@ int callback_display_test(StringBuilder* text_return, StringBuilder* args) {
       redraw_fft_window();
       break;
     case 5:
-      display.setAddrWindow(0, 0, 96, 64);
-      for (uint8_t h = 0; h < 64; h++) {
-        for (uint8_t w = 0; w < 96; w++) {
-          if (w > 83) {
-            display.writePixel(w, h, WHITE);
-          } else if (w > 71) {
-            display.writePixel(w, h, BLUE);
-          } else if (w > 59) {
-            display.writePixel(w, h, GREEN);
-          } else if (w > 47) {
-            display.writePixel(w, h, CYAN);
-          } else if (w > 35) {
-            display.writePixel(w, h, RED);
-          } else if (w > 23) {
-            display.writePixel(w, h, MAGENTA);
-          } else if (w > 11) {
-            display.writePixel(w, h, YELLOW);
-          } else {
-            display.writePixel(w, h, BLACK);
-          }
+      {
+        const uint16_t BARS[8] = {BLACK, YELLOW, MAGENTA, RED, CYAN, GREEN, BLUE, WHITE};
+        for (uint8_t i = 0; i < 8; i++) {
+          display.fillRect(i * 12, 0, 12, 64, BARS[i]);
         }
       }
-      display.endWrite();
       break;
     case 6:
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_THERMO), 14, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_IMU), 32, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_GPS), 32, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_LIGHT), 28, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_UVI), 32, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_SOUND), 40, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_RH), 22, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_MIC), 19, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_MAGNET), 22, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       display.fillScreen(BLACK);
       display.drawBitmap(0, 0, bitmapPointer(ICON_BATTERY), 52, 32, 0xFFFF);
+      display.flush();
       delay(5000);
       break;
     case 7:
@@ -1300,8 +2085,10 @@ int callback_display_test(StringBuilder* text_return, StringBuilder* args) {
     default:
       return -1;
   }
+  display.flush();
+  display.wait();
   millis_1 = millis();
-  text_return->concatf("Display update took %ums\n", millis_1-millis_0);
+  text_return->concatf("Display update took %ums (%u bytes sent)\n", millis_1-millis_0, display.lastFlushBytes());
   return 0;
 }
 
@@ -1392,6 +2179,370 @@ int callback_active_app(StringBuilder* text_return, StringBuilder* args) {
   return 0;
 }
 
+int callback_sched_info(StringBuilder* text_return, StringBuilder* args) {
+  if ((0 < args->count()) && (1 == args->position_as_int(0))) {
+    scheduler.resetStats();
+    text_return->concat("Scheduler stats reset.\n");
+  }
+  else {
+    scheduler.printDebug(text_return);
+    irq_queue.printDebug(text_return);
+  }
+  return 0;
+}
+
+/*
+* Dumps the I2C bus queues. Pass 1 to reset their stats.
+*/
+int callback_i2c_info(StringBuilder* text_return, StringBuilder* args) {
+  if ((0 < args->count()) && (1 == args->position_as_int(0))) {
+    i2c0.resetStats();
+    i2c1.resetStats();
+    tmp102.resetBusStats();
+    grideye.resetBusStats();
+    baro.resetBusStats();
+    uv.resetBusStats();
+    tsl2561.resetBusStats();
+    text_return->concat("I2C stats reset.\n");
+  }
+  else {
+    i2c0.printDebug(text_return);
+    i2c1.printDebug(text_return);
+    text_return->concat("-- Bus cost per sample:\n");
+    tmp102.printBusStats(text_return, "tmp102");
+    grideye.printBusStats(text_return, "grideye");
+    baro.printBusStats(text_return, "baro");
+    text_return->concatf("\tbaro: %u compensations, one measurement per %u us\n", baro.compensations(), baro.measurementPeriod());
+    uv.printBusStats(text_return, "uv");
+    tsl2561.printBusStats(text_return, "tsl2561");
+  }
+  return 0;
+}
+
+/*
+* GridEYE frame read timing. Pass 1 to reset.
+*/
+int callback_grideye_info(StringBuilder* text_return, StringBuilder* args) {
+  if ((0 < args->count()) && (1 == args->position_as_int(0))) {
+    grideye.resetFrameStats();
+    text_return->concat("GridEYE stats reset.\n");
+  }
+  else {
+    grideye.printFrameStats(text_return);
+  }
+  return 0;
+}
+
+/*
+* Framebuffer flush stats. Pass 1 to reset.
+*/
+int callback_fb_info(StringBuilder* text_return, StringBuilder* args) {
+  if ((0 < args->count()) && (1 == args->position_as_int(0))) {
+    display.resetStats();
+    text_return->concat("Framebuffer stats reset.\n");
+  }
+  else {
+    display.printDebug(text_return);
+  }
+  return 0;
+}
+
+/*
+* Selects the tier drawn by the tricorder graphs. 0 is raw. With no argument,
+*   prints the rollups and archives.
+*/
+int callback_graph_tier(StringBuilder* text_return, StringBuilder* args) {
+  if (0 < args->count()) {
+    int tier = args->position_as_int(0);
+    if ((tier >= 0) && (tier <= (rollup_pressure.tiers() + 1))) {
+      graph_tier = (uint8_t) tier;
+      dirty_slider = true;
+      if (0 == graph_tier) {
+        text_return->concat("Graphs show raw samples.\n");
+      }
+      else if (graph_tier > rollup_pressure.tiers()) {
+        text_return->concat("Graphs show the compressed archives.\n");
+      }
+      else {
+        text_return->concatf("Graphs show %ums buckets.\n", rollup_pressure.period(graph_tier - 1));
+      }
+    }
+    else {
+      text_return->concatf("Tier must be 0 (raw) to %u (archive).\n", rollup_pressure.tiers() + 1);
+    }
+  }
+  else {
+    rollup_pressure.printDebug(text_return, "pressure");
+    rollup_humidity.printDebug(text_return, "humidity");
+    rollup_air_temp.printDebug(text_return, "air_temp");
+    rollup_psu_temp.printDebug(text_return, "psu_temp");
+    rollup_uva.printDebug(text_return, "uva");
+    rollup_uvb.printDebug(text_return, "uvb");
+    rollup_uvi.printDebug(text_return, "uvi");
+    rollup_ana_light.printDebug(text_return, "ana_light");
+    rollup_visible.printDebug(text_return, "visible");
+    rollup_therm_mean.printDebug(text_return, "therm_mean");
+    text_return->concat("\nArchives:\n");
+    archive_pressure.printDebug(text_return, "pressure");
+    archive_humidity.printDebug(text_return, "humidity");
+    archive_air_temp.printDebug(text_return, "air_temp");
+    archive_uva.printDebug(text_return, "uva");
+    archive_uvb.printDebug(text_return, "uvb");
+    archive_uvi.printDebug(text_return, "uvi");
+    archive_visible.printDebug(text_return, "visible");
+    archive_therm_mean.printDebug(text_return, "therm_mean");
+  }
+  return 0;
+}
+
+/*
+* Starts (1) or stops (0) recording to the SD card. With no argument, prints
+*   the logger's stats. 2 resets them.
+*/
+int callback_log(StringBuilder* text_return, StringBuilder* args) {
+  if (0 < args->count()) {
+    switch (args->position_as_int(0)) {
+      case 0:
+        if (logger.logging()) {
+          logger.stop();
+          text_return->concatf("Logging stopped after %u sectors.\n", logger.sectorsWritten());
+        }
+        break;
+      case 1:
+        if (!sd_present) {
+          text_return->concat("No SD card.\n");
+        }
+        else if (!logger.logging()) {
+          char name[16];
+          for (uint16_t i = 0; i < 1000; i++) {
+            sprintf(name, "LOG%03u.BIN", i);
+            if (!SD.sdfs.exists(name)) {
+              break;
+            }
+          }
+          const int8_t RET = logger.start(name, LOG_PREALLOC_SECTORS);
+          if (0 == RET) {
+            text_return->concatf("Logging to %s\n", name);
+          }
+          else {
+            text_return->concatf("Failed to open %s (%d)\n", name, RET);
+          }
+        }
+        break;
+      case 2:
+        logger.resetStats();
+        text_return->concat("Logger stats reset.\n");
+        break;
+    }
+  }
+  else {
+    logger.printDebug(text_return);
+  }
+  return 0;
+}
+
+int callback_bus_info(StringBuilder* text_return, StringBuilder* args) {
+  if ((0 < args->count()) && (1 == args->position_as_int(0))) {
+    sample_bus.resetStats();
+  }
+  sample_bus.printDebug(text_return);
+  return 0;
+}
+
+/*
+* Prints the baro's derived values, and how often each was computed versus
+*   served from cache. 1 computes all of them first, and 2 resets the stats.
+*/
+int callback_derived(StringBuilder* text_return, StringBuilder* args) {
+  if (0 < args->count()) {
+    switch (args->position_as_int(0)) {
+      case 1:
+        for (uint8_t i = 0; i < baro_derived.count(); i++) {
+          baro_derived.get(i);
+        }
+        break;
+      case 2:
+        baro_derived.resetStats();
+        break;
+    }
+  }
+  baro_derived.printDebug(text_return);
+  return 0;
+}
+
+/*
+* Replays a recording in place of the sensors.
+*   replay 1 <file #> [speed] [from s]   Starts LOG<file #>.BIN. Speed is a
+*                                        multiple of real time, and defaults
+*                                        to 1. 0 runs as fast as it can.
+*   replay 0                             Stops.
+*   replay 2                             Resets the stats.
+* With no argument, prints the stats.
+*/
+int callback_replay(StringBuilder* text_return, StringBuilder* args) {
+  if (0 < args->count()) {
+    switch (args->position_as_int(0)) {
+      case 0:
+        if (replay.running()) {
+          replay.stop();
+          text_return->concatf("Replay stopped after %u records.\n", replay.records());
+        }
+        break;
+      case 1:
+        if (!sd_present) {
+          text_return->concat("No SD card.\n");
+        }
+        else if (2 > args->count()) {
+          text_return->concat("Which file?\n");
+        }
+        else {
+          char name[16];
+          sprintf(name, "LOG%03u.BIN", (unsigned) args->position_as_int(1));
+          const uint16_t SPEED  = (2 < args->count()) ? (uint16_t) args->position_as_int(2) : 1;
+          const uint32_t FROM_S = (3 < args->count()) ? (uint32_t) args->position_as_int(3) : 0;
+          replay.stop();
+          if ((0 != replay_source.open(name)) || (0 != replay_reader.open())) {
+            text_return->concatf("Can't read %s\n", name);
+          }
+          else if (0 != replay.start(SPEED, FROM_S * 1000, REPLAY_SENSORS)) {
+            text_return->concatf("Can't replay %s\n", name);
+          }
+          else {
+            text_return->concatf("Replaying %s\n", name);
+          }
+        }
+        break;
+      case 2:
+        replay.resetStats();
+        text_return->concat("Replay stats reset.\n");
+        break;
+    }
+  }
+  else {
+    replay.printDebug(text_return);
+    replay_reader.printDebug(text_return);
+  }
+  return 0;
+}
+
+/*
+* Runs the history codec over modeled data for each stream. This blocks for a
+*   while.
+*/
+int callback_codec_bench(StringBuilder* text_return, StringBuilder* args) {
+  return series_codec_benchmark(text_return, micros);
+}
+
+/*
+* Checks the thermopile frame pipeline against the way it used to be done, and
+*   times both.
+*/
+int callback_therm_bench(StringBuilder* text_return, StringBuilder* args) {
+  return therm_frame_benchmark(text_return, micros);
+}
+
+/*
+* Checks the thermal upscaler against float bilinear, and times it at each
+*   output size.
+*/
+int callback_upscale_bench(StringBuilder* text_return, StringBuilder* args) {
+  return therm_upscaler_benchmark(text_return, &therm_upscaler, micros);
+}
+
+/*
+* GridEYE watch mode. With args, watches for pixels above <upper> or below
+*   [lower], with [hysteresis], in 10-second standby if [standby] is nonzero.
+*   Without args, goes back to streaming frames.
+*/
+int callback_watch(StringBuilder* text_return, StringBuilder* args) {
+  if (0 == args->count()) {
+    if (0 != grideye.unwatch()) {
+      text_return->concat("GridEYE failed to leave watch mode.\n");
+      return -1;
+    }
+    task_grideye.period(10000);
+    text_return->concat("GridEYE streaming.\n");
+    return 0;
+  }
+  const float UPPER = args->position_as_double(0);
+  const float LOWER = (1 < args->count()) ? args->position_as_double(1) : -20.0;
+  const float HYST  = (2 < args->count()) ? args->position_as_double(2) : 1.0;
+  const bool  STBY  = (3 < args->count()) && (0.0 != args->position_as_double(3));
+  if (0 != grideye.watch(UPPER, LOWER, HYST, STBY)) {
+    text_return->concat("GridEYE failed to enter watch mode.\n");
+    return -1;
+  }
+  // Nothing is due until the chip says so. Check in far less often.
+  task_grideye.period(100000);
+  text_return->concatf(
+    "GridEYE watching for < %.2f or > %.2f (hysteresis %.2f), %s.\n",
+    (double) LOWER, (double) UPPER, (double) HYST, STBY ? "10s standby" : "1FPS"
+  );
+  return 0;
+}
+
+/*
+* Thermal blob tracker. 1 resets its stats, 2 forgets the background and the
+*   tracks, and 3 runs its benchmark. No arg prints the tracks.
+*/
+int callback_blobs(StringBuilder* text_return, StringBuilder* args) {
+  const int ARG = (0 < args->count()) ? args->position_as_int(0) : 0;
+  switch (ARG) {
+    case 1:
+      therm_blobs.resetStats();
+      text_return->concat("Blob stats reset.\n");
+      break;
+    case 2:
+      therm_blobs.reset();
+      text_return->concat("Blob background and tracks reset.\n");
+      break;
+    case 3:
+      return therm_blob_benchmark(text_return, micros);
+    default:
+      therm_blobs.printDebug(text_return);
+      break;
+  }
+  return 0;
+}
+
+/*
+* Thermal palette. With an arg, selects the palette. Without, prints it and
+*   the range it currently spans.
+*/
+int callback_palette(StringBuilder* text_return, StringBuilder* args) {
+  if (0 < args->count()) {
+    const ThermPaletteID ID = (ThermPaletteID) args->position_as_int(0);
+    if (0 != therm_palette.setPalette(ID)) {
+      text_return->concatf("No palette %d.\n", args->position_as_int(0));
+      return -1;
+    }
+  }
+  text_return->concatf(
+    "Palette %s, %.2f C to %.2f C\n",
+    ThermPalette::paletteStr(therm_palette.palette()),
+    (double) therm_palette.rangeMin(), (double) therm_palette.rangeMax()
+  );
+  return 0;
+}
+
+/*
+* Checks the baro math against its reference forms over the sensor's range,
+*   and times both. This blocks for a while.
+*/
+int callback_atmo_bench(StringBuilder* text_return, StringBuilder* args) {
+  return atmo_math_benchmark(text_return, micros);
+}
+
+/*
+* Dumps the loop profile, and resets it. Pass 1 to include histograms.
+*/
+int callback_prof(StringBuilder* text_return, StringBuilder* args) {
+  bool hist = (0 < args->count()) && (1 == args->position_as_int(0));
+  profiler.printDebug(text_return, hist);
+  profiler.reset();
+  return 0;
+}
+
 int callback_audio_volume(StringBuilder* text_return, StringBuilder* args) {
   if (1 == args->count()) {
     float arg0 = args->position_as_double(0);
@@ -1425,12 +2576,12 @@ void setup() {
 
   Wire.setSDA(SDA0_PIN);
   Wire.setSCL(SCL0_PIN);
-  Wire.setClock(400000);
   Wire.begin();
+  Wire.setClock(400000);    // begin() resets the clock, so this must follow it.
   Wire1.setSDA(SDA1_PIN);
   Wire1.setSCL(SCL1_PIN);
-  Wire.setClock(400000);
   Wire1.begin();
+  Wire1.setClock(400000);
 
   Serial1.setRX(GPS_TX_PIN);
   Serial1.setTX(GPS_RX_PIN);
@@ -1441,7 +2592,7 @@ void setup() {
   Serial6.begin(115200);    // Comm
   AudioMemory(32);
 
-  //SD.begin(BUILTIN_SDCARD);
+  sd_present = SD.begin(BUILTIN_SDCARD);
 
   sineL.amplitude(1.0);
   sineL.frequency(440);
@@ -1471,18 +2622,37 @@ void setup() {
   ampR.gain(0.4);
 
   analogWriteResolution(12);
+  graph_array_pressure.rollup(&rollup_pressure);
+  graph_array_humidity.rollup(&rollup_humidity);
+  graph_array_air_temp.rollup(&rollup_air_temp);
+  graph_array_psu_temp.rollup(&rollup_psu_temp);
+  graph_array_uva.rollup(&rollup_uva);
+  graph_array_uvb.rollup(&rollup_uvb);
+  graph_array_uvi.rollup(&rollup_uvi);
+  graph_array_ana_light.rollup(&rollup_ana_light);
+  graph_array_visible.rollup(&rollup_visible);
+  graph_array_therm_mean.rollup(&rollup_therm_mean);
+  graph_array_pressure.archive(&archive_pressure);
+  graph_array_humidity.archive(&archive_humidity);
+  graph_array_air_temp.archive(&archive_air_temp);
+  graph_array_uva.archive(&archive_uva);
+  graph_array_uvb.archive(&archive_uvb);
+  graph_array_uvi.archive(&archive_uvi);
+  graph_array_visible.archive(&archive_visible);
+  graph_array_therm_mean.archive(&archive_therm_mean);
   graph_array_ana_light.init();
 
   display.begin();
   display.fillScreen(BLACK);
   display.setCursor(0,0);
   display.println("Motherflux0r ");
+  display.flush();
   //display.setTextColor(CYAN);
   //display.println(TEST_PROG_VERSION);
 
   display.setTextColor(WHITE);
   display.print("GridEye  ");
-  if (0 == grideye.init(&Wire1)) {
+  if (0 == grideye.init(&i2c1)) {
     graph_array_therm_mean.init();
     display.setTextColor(GREEN);
     display.println("found");
@@ -1505,7 +2675,9 @@ void setup() {
 
   display.setTextColor(WHITE);
   display.print("Baro     ");
-  if (0 == baro.init(&Wire1)) {
+  if (0 == baro.init(&i2c1)) {
+    // Poll at twice the part's rate. poll() only reports new measurements.
+    task_baro.period(baro.measurementPeriod() / 2);
     graph_array_pressure.init();
     graph_array_humidity.init();
     graph_array_air_temp.init();
@@ -1519,7 +2691,7 @@ void setup() {
 
   display.setTextColor(WHITE);
   display.print("UVI      ");
-  if (VEML6075_ERROR_SUCCESS == uv.init(&Wire1)) {
+  if (VEML6075_ERROR_SUCCESS == uv.init(&i2c1)) {
     graph_array_uva.init();
     graph_array_uvb.init();
     graph_array_uvi.init();
@@ -1533,7 +2705,7 @@ void setup() {
 
   display.setTextColor(WHITE);
   display.print("TSL2561  ");
-  if (0 == tsl2561.init(&Wire1)) {
+  if (0 == tsl2561.init(&i2c1)) {
     graph_array_visible.init();
     tsl2561.autogain(true);
     tsl2561.integrationTime(TSLIntegrationTime::MS_101);
@@ -1547,7 +2719,7 @@ void setup() {
 
   display.setTextColor(WHITE);
   display.print("TMP102   ");
-  //if (0 == tmp102.init(&Wire)) {
+  //if (0 == tmp102.init(&i2c0)) {
   //  graph_array_psu_temp.init();
   //  display.setTextColor(GREEN);
   //  display.println("found");
@@ -1590,8 +2762,6 @@ void setup() {
   }
 
 
-  disp_update_last = millis();
-  disp_update_next = disp_update_last + 1000;
   console.defineCommand("help",        '?', arg_list_1_str, "Prints help to console.", "", 0, callback_help);
   console.defineCommand("history",     arg_list_0, "Print command history.", "", 0, callback_print_history);
   console.defineCommand("reboot",      arg_list_0, "Reboot the controller.", "", 0, callback_reboot);
@@ -1606,6 +2776,23 @@ void setup() {
   console.defineCommand("synth", 's', arg_list_4_uuff, "Mix volumes for the FFT.", "", 2, callback_synth_set);
   console.defineCommand("app",   'a', arg_list_1_uint, "Select active application.", "", 1, callback_active_app);
   console.defineCommand("vol",   arg_list_1_float, "Audio volume.", "", 0, callback_audio_volume);
+  console.defineCommand("sched", arg_list_1_uint, "Scheduler stats. 1 to reset.", "", 0, callback_sched_info);
+  console.defineCommand("i2c",   arg_list_1_uint, "I2C bus queue stats. 1 to reset.", "", 0, callback_i2c_info);
+  console.defineCommand("grideye", arg_list_1_uint, "GridEYE frame read stats. 1 to reset.", "", 0, callback_grideye_info);
+  console.defineCommand("fb",    arg_list_1_uint, "Framebuffer flush stats. 1 to reset.", "", 0, callback_fb_info);
+  console.defineCommand("graph", arg_list_1_uint, "Graph tier. 0 for raw. No arg to print rollups and archives.", "", 0, callback_graph_tier);
+  console.defineCommand("bus",   arg_list_1_uint, "Sample bus stats. 1 to reset.", "", 0, callback_bus_info);
+  console.defineCommand("derived", arg_list_1_uint, "Baro derived values. 1 to compute all, 2 to reset stats.", "", 0, callback_derived);
+  console.defineCommand("log",   arg_list_1_uint, "SD logging. 1 to start, 0 to stop, 2 to reset stats.", "", 0, callback_log);
+  console.defineCommand("replay", arg_list_4_uint, "Replay a recording. 1 <file#> [speed] [from_s] to start, 0 to stop.", "", 0, callback_replay);
+  console.defineCommand("codec", arg_list_0, "Benchmark the history codec.", "", 0, callback_codec_bench);
+  console.defineCommand("therm", arg_list_0, "Check and benchmark thermopile frame processing.", "", 0, callback_therm_bench);
+  console.defineCommand("upscale", arg_list_0, "Check and benchmark the thermal image upscaler.", "", 0, callback_upscale_bench);
+  console.defineCommand("palette", arg_list_1_uint, "Thermal palette. 0 ironbow, 1 grayscale, 2 rainbow, 3 classic.", "", 0, callback_palette);
+  console.defineCommand("blobs", arg_list_1_uint, "Thermal blobs. 1 resets stats, 2 resets tracking, 3 benchmarks.", "", 0, callback_blobs);
+  console.defineCommand("watch", arg_list_4_float, "GridEYE watch. <upper> [lower] [hysteresis] [standby]. No args to stream.", "", 0, callback_watch);
+  console.defineCommand("atmo",  arg_list_0, "Check and benchmark the baro math.", "", 0, callback_atmo_bench);
+  console.defineCommand("prof",  arg_list_1_uint, "Dump and reset loop profile. 1 for histograms.", "", 0, callback_prof);
   console.setTXTerminator(LineTerm::CRLF);
   console.setRXTerminator(LineTerm::CR);
   console.localEcho(true);
@@ -1614,8 +2801,7 @@ void setup() {
   touch = new SX8634(&_touch_opts);
   touch->init(&Wire);
 
-  disp_update_last = millis();
-  disp_update_next = disp_update_last + 3000;
+  const uint32_t splash_until = millis() + 3000;
 
   config_time = millis();
   //display.setTextColor(GREEN);
@@ -1639,7 +2825,8 @@ void setup() {
   Serial.print("Motherflux0r ");
   Serial.println(TEST_PROG_VERSION);
 
-  while (disp_update_next > millis()) {}
+  display.flush();
+  while (splash_until > millis()) {}
   if (touch->deviceFound()) {
     touch->poll();
     touch->setMode(SX8634OpMode::ACTIVE);
@@ -1648,6 +2835,27 @@ void setup() {
     touch->setSliderFxn(cb_slider);
     touch->setLongpressFxn(cb_longpress);
   }
+
+  // Everything downstream of the drivers hangs off the sample bus.
+  sample_bus.subscribe(bus_to_graphs, SAMPLE_BUS_ALL_SENSORS, (1 << BUS_CH_READING) | (1 << BUS_CH_THERM_STATS));
+  sample_bus.subscribe(bus_to_logger, SAMPLE_BUS_ALL_SENSORS, (1 << BUS_CH_READING));
+  setup_baro_derived();
+  sample_bus.subscribe(bus_to_baro_derived, (1 << (uint8_t) SensorID::BARO), (1 << BUS_CH_READING));
+  sample_bus.subscribe(bus_to_therm_blobs, (1 << (uint8_t) SensorID::THERMOPILE), (1 << BUS_CH_READING));
+
+  // Touch is polled slowly as a backstop. Its IRQ line does the real work.
+  scheduler.addTask(&task_touch);
+  scheduler.addTask(&task_uv);
+  scheduler.addTask(&task_baro);
+  // Reads are queued on the bus, and are reported by a later poll(). So these
+  //   are polled even if their IRQ lines are connected.
+  scheduler.addTask(&task_tsl2561);
+  scheduler.addTask(&task_grideye);
+  scheduler.addTask(&task_tmp102);
+  scheduler.addTask(&task_ui_timeout);
+  scheduler.addTask(&task_display);
+  scheduler.addTask(&task_log);
+  scheduler.addTask(&task_replay);
 }
 
 
@@ -1662,7 +2870,9 @@ void loop() {
   StringBuilder output;
   bool cr_rxd = false;
   memset(ser_buffer, 0, RX_BUF_LEN);
+  profiler.markLoop();
 
+  uint32_t c0 = LoopProfiler::cycles();
   while ((RX_BUF_LEN > rx_len) && (Serial.available())) {
     char c = Serial.read();
     int8_t ret1 = console.feed(c);
@@ -1682,66 +2892,34 @@ void loop() {
     }
   }
   console.fetchLog(&output);
+  profiler.record(LOOP_STAGE_CONSOLE, c0);
 
-  int8_t t_res = touch->poll();
-  if (0 < t_res) {
-    // Something changed in the hardware.
-  }
-  if (imu_irq_fired) {
-    imu_irq_fired = false;
-    read_imu();
-    //imu.clearInterrupts();
-  }
-
-  /* Run our async cleanup stuff. */
-  uint32_t millis_now = millis();
-  if (millis_now >= off_time_led_r) {   pinMode(LED_R_PIN, INPUT);     }
-  if (millis_now >= off_time_led_g) {   pinMode(LED_G_PIN, INPUT);     }
-  if (millis_now >= off_time_led_b) {   pinMode(LED_B_PIN, INPUT);     }
-  if (millis_now >= off_time_vib) {     pinMode(VIBRATOR_PIN, INPUT);  }
-
-  if (0 < uv.poll()) {
-    read_uv_sensor();
-  }
-
-  if (update_baro_next <= millis_now) {
-    read_baro_sensor();
-    update_baro_last = millis();
-    update_baro_next = (1000 / update_baro_rate) + update_baro_last;
-  }
-
-  if (0 < tsl2561.poll()) {
-    read_visible_sensor();
-  }
-
-  if (0 < grideye.poll()) {
-    read_thermopile_sensor();
-  }
-
-  if (0 < tmp102.poll()) {
-    read_battery_temperature_sensor();
-  }
-
-  //if (1 == magnetometer.poll()) {
-    // Magnetometer data is fresh.
-  //}
+  /* Service interrupts first, then run whatever is due. */
+  uint32_t task_cycles = 0;
+  c0 = LoopProfiler::cycles();
+  sample_shared_irq_lines();
+  dispatch_irq_events(&task_cycles);
+  profiler.record(LOOP_STAGE_IRQ, c0 + task_cycles);   // Less what the tasks recorded.
+  scheduler.serviceTasks();
 
-  if ((last_interaction + 100000) <= millis_now) {
-    // After 100 seconds, time-out the display.
-    if (AppID::HOT_STANDBY != active_app) {
-      active_app = AppID::HOT_STANDBY;
-    }
-  }
+  /* Move one chunk on each bus. Long reads span several passes. */
+  c0 = LoopProfiler::cycles();
+  i2c0.service();
+  i2c1.service();
+  profiler.record(LOOP_STAGE_I2C, c0);
 
-  millis_now = millis();
-  if (disp_update_next <= millis_now) {
-    updateDisplay();
-    disp_update_last = millis_now;
-    disp_update_next = (1000 / update_disp_rate) + disp_update_last;
-    //if (millis_now >= off_time_display) { display.fillScreen(BLACK);     }
+  /* Open the next display window, if the last one is out. */
+  c0 = LoopProfiler::cycles();
+  if (0 < display.service()) {
+    profiler.record(LOOP_STAGE_FLUSH, c0);
   }
 
   if (output.length() > 0) {
     Serial.print((char*) output.string());
   }
+  else if (0 == Serial.available()) {
+    c0 = LoopProfiler::cycles();
+    sleep_until_next_event();
+    profiler.record(LOOP_STAGE_SLEEP, c0);
+  }
 }
@@ -0,0 +1,212 @@
+/*
+* Multi-resolution history for a single data stream.
+* See the header file for the rules.
+*/
+
+#include "RollupSeries.h"
+
+/* 96 buckets per tier is one per column of a full-width graph. */
+static const RollupTierDef ROLLUP_TIERS_DEFAULT[] = {
+  {1000,     96},   // ~1.5 minutes
+  {60000,    96},   // ~1.5 hours
+  {3600000,  96}    // 4 days
+};
+
+
+/*
+* Constructor
+*/
+RollupSeries::RollupSeries(RollupClockFxn c, const RollupTierDef* tiers, uint8_t tier_count) : _clock(c) {
+  if ((nullptr == tiers) || (0 == tier_count)) {
+    tiers      = ROLLUP_TIERS_DEFAULT;
+    tier_count = sizeof(ROLLUP_TIERS_DEFAULT) / sizeof(RollupTierDef);
+  }
+  _tier_count = (tier_count < ROLLUP_MAX_TIERS) ? tier_count : ROLLUP_MAX_TIERS;
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    _tier[i].period_ms = (tiers[i].period_ms > 0) ? tiers[i].period_ms : 1;
+    _tier[i].capacity  = tiers[i].buckets;
+  }
+}
+
+/*
+* Destructor
+*/
+RollupSeries::~RollupSeries() {
+  _free();
+}
+
+
+/*
+* Allocates the rings, if they aren't already. Clears all history.
+* Returns 0 on success, or -1 if memory could not be had.
+*/
+int8_t RollupSeries::init() {
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    if ((nullptr == _tier[i].ring) && (_tier[i].capacity > 0)) {
+      _tier[i].ring = new RollupBucket[_tier[i].capacity];
+      if (nullptr == _tier[i].ring) {
+        _free();
+        return -1;
+      }
+    }
+  }
+  reset();
+  return 0;
+}
+
+
+void RollupSeries::reset() {
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    _tier[i].epoch  = 0;
+    _tier[i].head   = 0;
+    _tier[i].filled = 0;
+  }
+  _last    = 0.0f;
+  _samples = 0;
+}
+
+
+void RollupSeries::feed(float v) {
+  feed(v, _clock());
+}
+
+
+/*
+* Adds a sample to the open bucket of every tier.
+*/
+void RollupSeries::feed(float v, uint32_t now_ms) {
+  if (!initialized()) {
+    return;
+  }
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    Tier* t = &_tier[i];
+    if (nullptr == t->ring) {
+      continue;
+    }
+    _advance(t, now_ms);
+    t->ring[t->head].add(v);
+  }
+  _last = v;
+  _samples++;
+}
+
+
+/*
+* Fills out[] with the buckets of the given tier that cover the last span_ms,
+*   oldest first. A span of 0 means everything the tier holds. If there are
+*   more buckets than max_out, neighbors are merged, so the whole span is
+*   always returned. Empty buckets are returned as such.
+* Returns the number of buckets written.
+*/
+uint16_t RollupSeries::query(uint8_t tier, uint32_t span_ms, RollupBucket* out, uint16_t max_out) {
+  if ((tier >= _tier_count) || !initialized() || (0 == max_out)) {
+    return 0;
+  }
+  Tier* t = &_tier[tier];
+  if (nullptr == t->ring) {
+    return 0;
+  }
+  _advance(t, _clock());   // So that the span ends now, and not at the last sample.
+
+  uint32_t n = t->filled;
+  if (span_ms > 0) {
+    const uint32_t WANT = (span_ms + t->period_ms - 1) / t->period_ms;
+    if (WANT < n) n = WANT;
+  }
+  if (0 == n) {
+    return 0;
+  }
+  const uint32_t PER_OUT = (n + max_out - 1) / max_out;
+  uint32_t idx = (uint32_t) t->head + t->capacity - (n - 1);
+  if (idx >= t->capacity) idx -= t->capacity;
+
+  uint16_t count = 0;
+  for (uint32_t i = 0; i < n; i += PER_OUT) {
+    out[count].clear();
+    for (uint32_t j = 0; (j < PER_OUT) && ((i + j) < n); j++) {
+      out[count].merge(t->ring[idx]);
+      if (++idx >= t->capacity) idx = 0;
+    }
+    count++;
+  }
+  return count;
+}
+
+
+/*
+* Returns the finest tier that reaches back as far as span_ms, or the coarsest
+*   tier if none do. Returns -1 if there are no tiers.
+*/
+int8_t RollupSeries::bestTier(uint32_t span_ms) {
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    if (reach(i) >= span_ms) {
+      return i;
+    }
+  }
+  return (int8_t) _tier_count - 1;
+}
+
+
+void RollupSeries::printDebug(StringBuilder* output, const char* name) {
+  output->concatf("%-10s %8u samples  last %.3f\n", name, _samples, (double) _last);
+  if (!initialized()) {
+    output->concat("\t(not initialized)\n");
+    return;
+  }
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    const Tier* t = &_tier[i];
+    if (t->filled > 0) {
+      const RollupBucket* b = &t->ring[t->head];
+      output->concatf(
+        "\t%8ums  %3u/%-3u  open: n %6u  min %.3f  mean %.3f  max %.3f\n",
+        t->period_ms, t->filled, t->capacity, b->count,
+        (double) b->min, (double) b->mean(), (double) b->max
+      );
+    }
+    else {
+      output->concatf("\t%8ums  %3u/%-3u\n", t->period_ms, t->filled, t->capacity);
+    }
+  }
+}
+
+
+/*
+* Moves the open bucket of a tier up to the period containing now_ms. Any
+*   periods skipped over are left as empty buckets. At most one ring's worth
+*   of buckets is touched.
+*/
+void RollupSeries::_advance(Tier* t, uint32_t now_ms) {
+  const uint32_t EPOCH = now_ms / t->period_ms;
+  if (0 == t->filled) {
+    t->head   = 0;
+    t->epoch  = EPOCH;
+    t->filled = 1;
+    t->ring[0].clear();
+    return;
+  }
+  if (EPOCH == t->epoch) {
+    return;
+  }
+  uint32_t steps = EPOCH - t->epoch;
+  if ((EPOCH < t->epoch) || (steps > t->capacity)) {
+    // Clock went backward, or everything has aged out.
+    steps     = t->capacity;
+    t->filled = 0;
+  }
+  for (uint32_t i = 0; i < steps; i++) {
+    if (++t->head >= t->capacity) t->head = 0;
+    t->ring[t->head].clear();
+    if (t->filled < t->capacity) t->filled++;
+  }
+  t->epoch = EPOCH;
+}
+
+
+void RollupSeries::_free() {
+  for (uint8_t i = 0; i < _tier_count; i++) {
+    if (nullptr != _tier[i].ring) {
+      delete[] _tier[i].ring;
+      _tier[i].ring = nullptr;
+    }
+  }
+}
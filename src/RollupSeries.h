@@ -0,0 +1,139 @@
+/*
+* Multi-resolution history for a single data stream.
+*
+* A RollupSeries keeps a ring of fixed-period buckets for each of a few tiers
+*   (by default: 1 second, 1 minute, and 1 hour). Each bucket holds the min,
+*   max, sum, and count (and so the mean) of the samples that fell into its
+*   period. Every
+*   sample updates the open bucket of every tier, so the coarse tiers are
+*   always current, and nothing is ever re-scanned. The raw tier is the
+*   GraphSeries that feeds this object.
+*
+* Memory is fixed when init() is called, and never grows. When a tier's ring
+*   is full, its oldest bucket is reused. Periods in which no samples arrived
+*   are kept as empty buckets, so each tier stays evenly spaced in time.
+*
+* A query names a tier and a span of time back from now. It reads at most the
+*   tier's capacity in buckets, so its cost does not depend on how much
+*   history has built up.
+*
+* All times are in milliseconds, and are taken from a clock function supplied
+*   at construction. A backward step of the clock (including the 32-bit wrap
+*   after ~49 days) clears the tiers.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __ROLLUP_SERIES_H_
+#define __ROLLUP_SERIES_H_
+
+#define ROLLUP_MAX_TIERS    4
+
+typedef uint32_t (*RollupClockFxn)();
+
+/* The shape of a tier. */
+typedef struct {
+  uint32_t period_ms;
+  uint16_t buckets;
+} RollupTierDef;
+
+
+/*******************************************************************************
+* Summary of the samples in one period.
+*******************************************************************************/
+class RollupBucket {
+  public:
+    float    min   = 0.0f;
+    float    max   = 0.0f;
+    double   sum   = 0.0;   // A float runs out of precision in an hour of baro.
+    uint32_t count = 0;
+
+    inline bool  empty() const {  return (0 == count);  };
+    inline float mean() const {   return (count > 0) ? (float) (sum / count) : 0.0f;  };
+
+    inline void clear() {
+      min   = 0.0f;
+      max   = 0.0f;
+      sum   = 0.0;
+      count = 0;
+    };
+
+    inline void add(float v) {
+      if (0 == count) {
+        min = v;
+        max = v;
+      }
+      else {
+        if (v < min) min = v;
+        if (v > max) max = v;
+      }
+      sum += v;
+      count++;
+    };
+
+    inline void merge(const RollupBucket& b) {
+      if (b.empty()) {
+        return;
+      }
+      if (empty()) {
+        *this = b;
+        return;
+      }
+      if (b.min < min) min = b.min;
+      if (b.max > max) max = b.max;
+      sum   += b.sum;
+      count += b.count;
+    };
+};
+
+
+/*******************************************************************************
+* The tiers for one stream.
+*******************************************************************************/
+class RollupSeries {
+  public:
+    RollupSeries(RollupClockFxn, const RollupTierDef* tiers = nullptr, uint8_t tier_count = 0);
+    ~RollupSeries();
+
+    int8_t   init();
+    void     reset();
+    void     feed(float v);
+    void     feed(float v, uint32_t now_ms);
+    uint16_t query(uint8_t tier, uint32_t span_ms, RollupBucket* out, uint16_t max_out);
+    int8_t   bestTier(uint32_t span_ms);
+    void     printDebug(StringBuilder*, const char* name);
+
+    inline bool     initialized() {   return (nullptr != _tier[0].ring);  };
+    inline uint8_t  tiers() {         return _tier_count;  };
+    inline float    last() {          return _last;        };
+    inline uint32_t samples() {       return _samples;     };
+    inline uint32_t period(uint8_t t) {   return (t < _tier_count) ? _tier[t].period_ms : 0;  };
+    inline uint16_t filled(uint8_t t) {   return (t < _tier_count) ? _tier[t].filled : 0;     };
+    inline uint32_t reach(uint8_t t) {
+      return (t < _tier_count) ? (_tier[t].period_ms * _tier[t].capacity) : 0;
+    };
+
+
+  private:
+    struct Tier {
+      RollupBucket* ring      = nullptr;
+      uint32_t      period_ms = 0;
+      uint32_t      epoch     = 0;    // Period number of the open bucket.
+      uint16_t      capacity  = 0;
+      uint16_t      head      = 0;    // Index of the open bucket.
+      uint16_t      filled    = 0;
+    };
+
+    const RollupClockFxn _clock;
+    Tier     _tier[ROLLUP_MAX_TIERS];
+    uint8_t  _tier_count = 0;
+    float    _last       = 0.0f;
+    uint32_t _samples    = 0;
+
+    void _advance(Tier*, uint32_t now_ms);
+    void _free();
+};
+
+#endif  // __ROLLUP_SERIES_H_
@@ -0,0 +1,54 @@
+/*
+* Transaction-level ownership of a shared SPI bus.
+*
+* A device that holds the bus across more than one call (such as a DMA
+*   transfer that spans a whole display frame) takes the lock first. Another
+*   device that checks it before starting a transaction will find the bus
+*   held, and try again later. Nobody waits.
+*
+* The lock is advisory. It only arbitrates between code that takes it. On
+*   SPI0, that is just the display. The DRV425 and the IMU drive the bus from
+*   their own libraries, and don't check it, so they must not be run while a
+*   flush is in progress.
+*
+* Acquisition happens only from the main loop. Release may happen from an ISR
+*   (at the end of a DMA chain). With a single writer in each direction, no
+*   critical section is needed.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#ifndef __SPI_BUS_LOCK_H_
+#define __SPI_BUS_LOCK_H_
+
+class SPIBusLock {
+  public:
+    SPIBusLock() {};
+
+    inline bool tryAcquire(const void* who) {
+      if ((nullptr == _owner) || (who == _owner)) {
+        _owner = who;
+        return true;
+      }
+      _contended++;
+      return false;
+    };
+
+    inline void release(const void* who) {
+      if (who == _owner) {
+        _owner = nullptr;
+      }
+    };
+
+    inline bool     held() {             return (nullptr != _owner);   };
+    inline bool     heldBy(const void* who) {  return (who == _owner);   };
+    inline uint32_t contended() {        return _contended;            };
+
+
+  private:
+    const void* volatile _owner = nullptr;
+    uint32_t             _contended = 0;
+};
+
+#endif  // __SPI_BUS_LOCK_H_
@@ -0,0 +1,408 @@
+/*
+* A double-buffered RAM framebuffer for the SSD1331. See SSD1331Framebuffer.h.
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "SSD1331Framebuffer.h"
+
+
+SSD1331Framebuffer::SSD1331Framebuffer(Adafruit_SSD1331* panel, SPIClass* spi, SPIBusLock* lock) :
+  Adafruit_GFX(SSD1331_FB_WIDTH, SSD1331_FB_HEIGHT), _panel(panel), _spi(spi), _lock(lock) {
+  for (uint16_t i = 0; i < SSD1331_FB_PIXELS; i++) {
+    _fb[i]    = 0;
+    _front[i] = 0;
+  }
+  for (uint8_t y = 0; y < SSD1331_FB_HEIGHT; y++) {
+    _dirty_x0[y] = SSD1331_FB_WIDTH - 1;
+    _dirty_x1[y] = 0;
+  }
+}
+
+
+/*
+* Bring up the panel, and push the whole buffer so that the front buffer is
+*   known to match the glass.
+*/
+void SSD1331Framebuffer::begin(uint32_t freq) {
+  _panel->begin(freq);
+  #if defined(SSD1331_FB_USE_DMA)
+    _dma_event.setContext(this);
+    _dma_event.attachImmediate(_dma_isr);
+  #endif
+  invalidate();
+  flush();
+  wait();
+  resetStats();
+}
+
+
+/*
+* Forget what the panel is showing. The next flush will send every pixel.
+*/
+void SSD1331Framebuffer::invalidate() {
+  wait();
+  for (uint16_t i = 0; i < SSD1331_FB_PIXELS; i++) {
+    _front[i] = ~_swap(_fb[i]);
+  }
+  for (uint8_t y = 0; y < SSD1331_FB_HEIGHT; y++) {
+    _dirty_x0[y] = 0;
+    _dirty_x1[y] = SSD1331_FB_WIDTH - 1;
+  }
+}
+
+
+/*
+* Block until the last flush is on the glass.
+*/
+void SSD1331Framebuffer::wait() {
+  while (_xfer_active) {
+    service();
+  }
+}
+
+
+/*
+* Call from the main loop. Once the DMA interrupt has flagged that a window
+*   is out, opens the next one, or ends the frame and lets go of the bus.
+* Returns 1 if there was anything to do, or 0 if not.
+*/
+int8_t SSD1331Framebuffer::service() {
+  if (!_win_done) {
+    return 0;
+  }
+  _win_done = false;
+  if (++_win_idx < _win_count) {
+    _start_window();
+  }
+  else {
+    _xfer_done();
+  }
+  return 1;
+}
+
+
+/*
+* Start sending everything that changed since the last flush.
+* Returns...
+*   -1 if the last frame (or another device) still has the bus.
+*   0  if nothing needed sending.
+*   1  if a transfer was started.
+*/
+int8_t SSD1331Framebuffer::flush() {
+  service();
+  if (_xfer_active) {
+    _deferred++;
+    return -1;
+  }
+  if ((nullptr != _lock) && !_lock->tryAcquire(this)) {
+    _deferred++;
+    return -1;
+  }
+  const uint32_t t0 = micros();
+  _plan_windows();
+  if (0 == _win_count) {
+    if (nullptr != _lock) {
+      _lock->release(this);
+    }
+    _idle++;
+    return 0;
+  }
+  _last_cpu_us = micros() - t0;
+  _cpu_us += _last_cpu_us;
+  _frames++;
+  _windows += _win_count;
+  _bytes   += _last_bytes;
+
+  _xfer_t0     = micros();
+  _xfer_active = true;
+  _win_idx     = 0;
+  _panel->startWrite();
+  _start_window();
+  return 1;
+}
+
+
+void SSD1331Framebuffer::resetStats() {
+  _frames       = 0;
+  _idle         = 0;
+  _deferred     = 0;
+  _windows      = 0;
+  _bytes        = 0;
+  _cpu_us       = 0;
+  _xfer_us      = 0;
+  _last_bytes   = 0;
+  _last_cpu_us  = 0;
+  _last_xfer_us = 0;
+  _max_xfer_us  = 0;
+}
+
+
+void SSD1331Framebuffer::printDebug(StringBuilder* output) {
+  output->concatf("-- SSD1331Framebuffer (%ux%u, %s)\n", SSD1331_FB_WIDTH, SSD1331_FB_HEIGHT,
+    #if defined(SSD1331_FB_USE_DMA)
+      "DMA"
+    #else
+      "PIO"
+    #endif
+  );
+  output->concatf("\tFlushes:     %u sent, %u idle, %u deferred\n", _frames, _idle, _deferred);
+  if (_frames > 0) {
+    const uint32_t full = (SSD1331_FB_PIXELS * 2) + SSD1331_FB_WINDOW_BYTES;
+    output->concatf("\tBytes/frame: %u (full frame is %u)\n", _bytes / _frames, full);
+    output->concatf("\tWin/frame:   %.2f\n", (double) _windows / _frames);
+    output->concatf("\tCPU time:    %uus mean\n", _cpu_us / _frames);
+    output->concatf("\tXfer time:   %uus mean, %uus max\n", _xfer_us / _frames, _max_xfer_us);
+    output->concatf("\tLast flush:  %u bytes, %uus CPU, %uus on the wire\n", _last_bytes, _last_cpu_us, _last_xfer_us);
+  }
+  if (nullptr != _lock) {
+    output->concatf("\tBus lock:    %s, %u contended\n", (_lock->held() ? "held" : "free"), _lock->contended());
+  }
+}
+
+
+/*******************************************************************************
+* Overrides from Adafruit_GFX
+*******************************************************************************/
+
+void SSD1331Framebuffer::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (_in_bounds(x, y)) {
+    _fb[(y * SSD1331_FB_WIDTH) + x] = color;
+    _mark(x, x, y);
+  }
+}
+
+void SSD1331Framebuffer::writePixel(int16_t x, int16_t y, uint16_t color) {
+  drawPixel(x, y, color);
+}
+
+void SSD1331Framebuffer::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  _fill(x, y, w, h, color);
+}
+
+void SSD1331Framebuffer::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  _fill(x, y, 1, h, color);
+}
+
+void SSD1331Framebuffer::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  _fill(x, y, w, 1, color);
+}
+
+void SSD1331Framebuffer::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  _fill(x, y, 1, h, color);
+}
+
+void SSD1331Framebuffer::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  _fill(x, y, w, 1, color);
+}
+
+void SSD1331Framebuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  _fill(x, y, w, h, color);
+}
+
+void SSD1331Framebuffer::fillScreen(uint16_t color) {
+  _fill(0, 0, SSD1331_FB_WIDTH, SSD1331_FB_HEIGHT, color);
+}
+
+
+/*
+* Copies a w-by-h block of RGB565 pixels (rows packed end to end) into the
+*   back buffer, clipped. The rows share a span, so flush() sends the block in
+*   one address window.
+*/
+void SSD1331Framebuffer::blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* src) {
+  int16_t x0 = (x < 0) ? 0 : x;
+  int16_t y0 = (y < 0) ? 0 : y;
+  int16_t x1 = x + w - 1;
+  int16_t y1 = y + h - 1;
+  if (x1 >= SSD1331_FB_WIDTH)  x1 = SSD1331_FB_WIDTH - 1;
+  if (y1 >= SSD1331_FB_HEIGHT) y1 = SSD1331_FB_HEIGHT - 1;
+  if ((nullptr == src) || (x0 > x1) || (y0 > y1)) {
+    return;
+  }
+  const uint16_t BYTES = (x1 - x0 + 1) * sizeof(uint16_t);
+  for (int16_t row = y0; row <= y1; row++) {
+    memcpy(&_fb[(row * SSD1331_FB_WIDTH) + x0], &src[((row - y) * w) + (x0 - x)], BYTES);
+    _mark(x0, x1, row);
+  }
+}
+
+
+/*******************************************************************************
+* Internals
+*******************************************************************************/
+
+/*
+* Clipped rectangle fill. Negative sizes are normalized the same way that
+*   Adafruit_GFX does it.
+*/
+void SSD1331Framebuffer::_fill(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (w < 0) {  x += w + 1;  w = -w;  }
+  if (h < 0) {  y += h + 1;  h = -h;  }
+  int16_t x1 = x + w - 1;
+  int16_t y1 = y + h - 1;
+  if (x < 0) x = 0;
+  if (y < 0) y = 0;
+  if (x1 >= SSD1331_FB_WIDTH)  x1 = SSD1331_FB_WIDTH - 1;
+  if (y1 >= SSD1331_FB_HEIGHT) y1 = SSD1331_FB_HEIGHT - 1;
+  if ((x > x1) || (y > y1)) {
+    return;
+  }
+  for (int16_t row = y; row <= y1; row++) {
+    uint16_t* p = &_fb[(row * SSD1331_FB_WIDTH) + x];
+    for (int16_t col = x; col <= x1; col++) {
+      *p++ = color;
+    }
+    _mark(x, x1, row);
+  }
+}
+
+
+/*
+* Shrink a row's dirty span to the pixels that differ from the front buffer.
+* Returns false if the row turns out to be clean.
+*/
+bool SSD1331Framebuffer::_trim_row(uint8_t y) {
+  if (!_row_dirty(y)) {
+    return false;
+  }
+  const uint16_t* fb = &_fb[y * SSD1331_FB_WIDTH];
+  const uint16_t* fr = &_front[y * SSD1331_FB_WIDTH];
+  uint8_t x0 = _dirty_x0[y];
+  uint8_t x1 = _dirty_x1[y];
+  while ((x0 <= x1) && (_swap(fb[x0]) == fr[x0])) {  x0++;  }
+  while ((x1 > x0) && (_swap(fb[x1]) == fr[x1])) {   x1--;  }
+  if (x0 > x1) {
+    _dirty_x0[y] = SSD1331_FB_WIDTH - 1;
+    _dirty_x1[y] = 0;
+    return false;
+  }
+  _dirty_x0[y] = x0;
+  _dirty_x1[y] = x1;
+  return true;
+}
+
+
+/*
+* Turn the dirty spans into address windows, copy the pixels they cover into
+*   the front buffer, and mark everything clean.
+* A window grows downward while sending the extra clean pixels is cheaper
+*   than opening another window.
+*/
+void SSD1331Framebuffer::_plan_windows() {
+  _win_count  = 0;
+  _last_bytes = 0;
+  uint8_t y = 0;
+  while (y < SSD1331_FB_HEIGHT) {
+    if (!_trim_row(y)) {
+      y++;
+      continue;
+    }
+    uint8_t x0 = _dirty_x0[y];
+    uint8_t x1 = _dirty_x1[y];
+    const uint8_t y0 = y++;
+    while ((y < SSD1331_FB_HEIGHT) && _trim_row(y)) {
+      const uint8_t  nx0   = (_dirty_x0[y] < x0) ? _dirty_x0[y] : x0;
+      const uint8_t  nx1   = (_dirty_x1[y] > x1) ? _dirty_x1[y] : x1;
+      const uint32_t rows  = y - y0;
+      const uint32_t split = (rows * (x1 - x0 + 1)) + (_dirty_x1[y] - _dirty_x0[y] + 1) + (SSD1331_FB_WINDOW_BYTES / 2);
+      const uint32_t merge = (rows + 1) * (nx1 - nx0 + 1);
+      if (merge > split) {
+        break;
+      }
+      x0 = nx0;
+      x1 = nx1;
+      y++;
+    }
+    FlushWindow* win = &_win[_win_count++];
+    win->x0 = x0;
+    win->x1 = x1;
+    win->y0 = y0;
+    win->y1 = y - 1;
+    for (uint8_t row = win->y0; row <= win->y1; row++) {
+      const uint16_t offset = (row * SSD1331_FB_WIDTH) + x0;
+      for (uint8_t i = 0; i <= (x1 - x0); i++) {
+        _front[offset + i] = _swap(_fb[offset + i]);
+      }
+    }
+    _last_bytes += SSD1331_FB_WINDOW_BYTES + ((uint32_t) (x1 - x0 + 1) * (y - y0) * 2);
+  }
+
+  for (uint8_t i = 0; i < SSD1331_FB_HEIGHT; i++) {
+    _dirty_x0[i] = SSD1331_FB_WIDTH - 1;
+    _dirty_x1[i] = 0;
+  }
+}
+
+
+/*
+* Address the current window, and send its first row. Without DMA, every row
+*   of every window is sent before this returns.
+*/
+void SSD1331Framebuffer::_start_window() {
+  const FlushWindow* win = &_win[_win_idx];
+  _panel->setAddrWindow(win->x0, win->y0, (win->x1 - win->x0) + 1, (win->y1 - win->y0) + 1);
+  _row = win->y0;
+  #if defined(SSD1331_FB_USE_DMA)
+    _start_row();
+  #else
+    for (; _row <= win->y1; _row++) {
+      _panel->writePixels(&_front[(_row * SSD1331_FB_WIDTH) + win->x0], (win->x1 - win->x0) + 1, true, true);
+    }
+    if (++_win_idx < _win_count) {
+      _start_window();
+    }
+    else {
+      _xfer_done();
+    }
+  #endif
+}
+
+
+#if defined(SSD1331_FB_USE_DMA)
+/*
+* Rows of a window are not contiguous in the front buffer unless the window
+*   is full-width. The panel wraps within the window, so one transfer per row
+*   lands them in the right place.
+*/
+void SSD1331Framebuffer::_start_row() {
+  const FlushWindow* win = &_win[_win_idx];
+  const uint16_t len = ((win->x1 - win->x0) + 1) << 1;
+  _spi->transfer(&_front[(_row * SSD1331_FB_WIDTH) + win->x0], nullptr, len, _dma_event);
+}
+
+
+/*
+* Runs in interrupt context when each row's transfer completes. Starting the
+*   next row is only a DMA restart. Anything that writes commands is left to
+*   service().
+*/
+void SSD1331Framebuffer::_dma_isr(EventResponderRef ev) {
+  SSD1331Framebuffer* fb = (SSD1331Framebuffer*) ev.getContext();
+  const FlushWindow* win = &fb->_win[fb->_win_idx];
+  if (fb->_row < win->y1) {
+    fb->_row++;
+    fb->_start_row();
+  }
+  else {
+    fb->_win_done = true;
+  }
+}
+#endif  // SSD1331_FB_USE_DMA
+
+
+/*
+* The last row of the frame is out. Let go of the bus.
+*/
+void SSD1331Framebuffer::_xfer_done() {
+  _panel->endWrite();
+  _last_xfer_us = micros() - _xfer_t0;
+  _xfer_us += _last_xfer_us;
+  if (_last_xfer_us > _max_xfer_us) {
+    _max_xfer_us = _last_xfer_us;
+  }
+  _xfer_active = false;
+  if (nullptr != _lock) {
+    _lock->release(this);
+  }
+}
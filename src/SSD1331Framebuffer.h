@@ -0,0 +1,153 @@
+/*
+* A double-buffered RAM framebuffer for the SSD1331.
+*
+* All drawing lands in a 96x64 RGB565 back buffer, and nothing goes to the
+*   panel until flush() is called at the end of a frame. The buffer keeps the
+*   leftmost and rightmost touched pixel for each row. At flush, each dirty
+*   span is trimmed against the front buffer (what the panel is showing, or
+*   is about to). So redrawing something that didn't change (including a
+*   fillScreen() followed by the same content) costs nothing on the wire.
+*   Adjacent dirty rows are merged into one address window when that is
+*   cheaper than opening a new one.
+*
+* flush() copies the changed spans into the front buffer (in the panel's
+*   byte order), and starts the transfer. On the Teensy, the pixels are
+*   streamed by SPI DMA, one row per transfer. Each completion starts the
+*   next row of the window from the DMA interrupt. Opening the next window
+*   takes blocking command writes, so the interrupt only flags that the
+*   window is out, and service() (called from the main loop) opens the next
+*   one, or ends the frame. So flush() returns as soon as the copy is done,
+*   and the app is free to render the next frame into the back buffer while
+*   the last one is on the wire. A flush() that finds the last one still
+*   running does nothing, and leaves the dirty spans to be picked up by the
+*   next one.
+* The SPI bus is held (by way of an optional SPIBusLock) from the start of a
+*   frame's transfer until its last row is sent.
+*
+* Rotation is not supported. The buffers are in the panel's native orientation.
+*
+* Each flush counts the bytes it put on the SPI bus (address windows and
+*   pixels), the CPU time flush() took, and the wall time of the transfer.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+#include <SPI.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1331.h>
+#include "SPIBusLock.h"
+
+#if defined(__IMXRT1062__)
+  #include <EventResponder.h>
+  #define SSD1331_FB_USE_DMA
+#endif
+
+#ifndef __SSD1331_FRAMEBUFFER_H_
+#define __SSD1331_FRAMEBUFFER_H_
+
+#define SSD1331_FB_WIDTH        96
+#define SSD1331_FB_HEIGHT       64
+#define SSD1331_FB_PIXELS       (SSD1331_FB_WIDTH * SSD1331_FB_HEIGHT)
+#define SSD1331_FB_WINDOW_BYTES  6   // Column and row address commands.
+
+
+class SSD1331Framebuffer : public Adafruit_GFX {
+  public:
+    SSD1331Framebuffer(Adafruit_SSD1331* panel, SPIClass* spi, SPIBusLock* lock = nullptr);
+
+    void    begin(uint32_t freq = 0);
+    int8_t  flush();
+    int8_t  service();
+    void    wait();
+    void    invalidate();
+    void    blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t* src);
+    inline bool      busy() {     return _xfer_active;   };
+    inline bool      serviceDue() {  return _win_done;   };
+    inline uint16_t* buffer() {   return _fb;            };
+    inline uint16_t  getPixel(int16_t x, int16_t y) {
+      return _in_bounds(x, y) ? _fb[(y * SSD1331_FB_WIDTH) + x] : 0;
+    };
+
+    void resetStats();
+    void printDebug(StringBuilder*);
+    inline uint32_t lastFlushBytes() {  return _last_bytes;    };
+    inline uint32_t lastFlushUs() {     return _last_xfer_us;  };
+
+    /* Overrides from Adafruit_GFX. */
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void writePixel(int16_t x, int16_t y, uint16_t color);
+    void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void fillScreen(uint16_t color);
+    void startWrite() {};
+    void endWrite() {};
+
+
+  private:
+    struct FlushWindow {
+      uint8_t x0;
+      uint8_t x1;
+      uint8_t y0;
+      uint8_t y1;
+    };
+
+    Adafruit_SSD1331* _panel;
+    SPIClass*         _spi;
+    SPIBusLock*       _lock;
+    uint16_t _fb[SSD1331_FB_PIXELS];        // Back buffer. Drawing goes here.
+    uint16_t _front[SSD1331_FB_PIXELS];     // Panel contents, big-endian.
+    uint8_t  _dirty_x0[SSD1331_FB_HEIGHT];  // x0 > x1 means the row is clean.
+    uint8_t  _dirty_x1[SSD1331_FB_HEIGHT];
+
+    /* Transfer state. Rows are advanced from the DMA interrupt. Windows by service(). */
+    FlushWindow       _win[SSD1331_FB_HEIGHT];
+    uint8_t           _win_count  = 0;
+    volatile uint8_t  _win_idx    = 0;
+    volatile uint8_t  _row        = 0;
+    volatile bool     _win_done   = false;   // The current window is out.
+    volatile bool     _xfer_active = false;
+    uint32_t          _xfer_t0    = 0;
+    #if defined(SSD1331_FB_USE_DMA)
+      EventResponder  _dma_event;
+    #endif
+
+    uint32_t _frames       = 0;   // Flushes that sent anything.
+    uint32_t _idle         = 0;   // Flushes that found nothing changed.
+    uint32_t _deferred     = 0;   // Flushes put off by a transfer in progress.
+    uint32_t _windows      = 0;
+    uint32_t _bytes        = 0;
+    uint32_t _cpu_us       = 0;
+    uint32_t _xfer_us      = 0;
+    uint32_t _last_bytes   = 0;
+    uint32_t _last_cpu_us  = 0;
+    uint32_t _last_xfer_us = 0;
+    uint32_t _max_xfer_us  = 0;
+
+    void _fill(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    bool _trim_row(uint8_t y);
+    void _plan_windows();
+    void _start_window();
+    void _start_row();
+    void _xfer_done();
+
+    #if defined(SSD1331_FB_USE_DMA)
+      static void _dma_isr(EventResponderRef);
+    #endif
+
+    inline bool _in_bounds(int16_t x, int16_t y) {
+      return ((x >= 0) && (y >= 0) && (x < SSD1331_FB_WIDTH) && (y < SSD1331_FB_HEIGHT));
+    };
+    inline bool _row_dirty(uint8_t y) {  return (_dirty_x0[y] <= _dirty_x1[y]);  };
+    inline void _mark(uint8_t x0, uint8_t x1, uint8_t y) {
+      if (x0 < _dirty_x0[y]) _dirty_x0[y] = x0;
+      if (x1 > _dirty_x1[y]) _dirty_x1[y] = x1;
+    };
+    static inline uint16_t _swap(uint16_t c) {  return (uint16_t) ((c << 8) | (c >> 8));  };
+};
+
+#endif  // __SSD1331_FRAMEBUFFER_H_
@@ -0,0 +1,213 @@
+/*
+* A publish/subscribe hub for sensor readings.
+* See the header file for the rules.
+*/
+
+#include <string.h>
+#include "SampleBus.h"
+
+
+/*
+* Adds a subscriber for the given sensors (a bitmask of SensorIDs) and
+*   channels (a bitmask of channel numbers).
+* Returns 0 on success, or -1 if the table is full.
+*/
+int8_t SampleBus::subscribe(SampleSubscriberFxn fxn, uint16_t sensor_mask, uint8_t channel_mask) {
+  if ((nullptr == fxn) || (_sub_count >= SAMPLE_BUS_MAX_SUBS)) {
+    return -1;
+  }
+  _subs[_sub_count].fxn          = fxn;
+  _subs[_sub_count].sensor_mask  = sensor_mask;
+  _subs[_sub_count].channel_mask = channel_mask;
+  _sub_count++;
+  return 0;
+}
+
+
+int8_t SampleBus::unsubscribe(SampleSubscriberFxn fxn) {
+  for (uint8_t i = 0; i < _sub_count; i++) {
+    if (fxn == _subs[i].fxn) {
+      for (uint8_t n = i + 1; n < _sub_count; n++) {
+        _subs[n - 1] = _subs[n];   // Keep the order of the rest.
+      }
+      _sub_count--;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+
+int8_t SampleBus::publish(uint8_t sensor, uint8_t channel, uint32_t t_us, float value) {
+  return publish(sensor, channel, t_us, &value, 1);
+}
+
+
+/*
+* Publishes a small vector, carried in the sample.
+* Returns the number of subscribers it went to, or -1 if it was dropped.
+*/
+int8_t SampleBus::publish(uint8_t sensor, uint8_t channel, uint32_t t_us, const float* values, uint8_t count) {
+  if (count > SAMPLE_BUS_INLINE_VALUES) {
+    return -1;
+  }
+  Sample* s = _take(sensor, channel, t_us);
+  if (nullptr == s) {
+    return -1;
+  }
+  memcpy(s->_vals, values, count * sizeof(float));
+  s->count = count;
+  return _deliver(s);
+}
+
+
+/*
+* Returns a frame buffer for a driver to fill, or nullptr if they are all in
+*   use. It must be handed back with publishFrame() or releaseFrame().
+*/
+float* SampleBus::acquireFrame() {
+  for (uint8_t i = 0; i < SAMPLE_BUS_FRAMES; i++) {
+    if (!_frame_used[i]) {
+      _frame_used[i] = true;
+      return _frames[i];
+    }
+  }
+  _drops++;
+  return nullptr;
+}
+
+
+void SampleBus::releaseFrame(float* frame) {
+  for (uint8_t i = 0; i < SAMPLE_BUS_FRAMES; i++) {
+    if (frame == _frames[i]) {
+      _frame_used[i] = false;
+      return;
+    }
+  }
+}
+
+
+/*
+* Publishes a frame from acquireFrame(). The bus owns the frame from here on,
+*   and frees it when the last reference to the sample goes.
+* Returns the number of subscribers it went to, or -1 if it was dropped.
+*/
+int8_t SampleBus::publishFrame(uint8_t sensor, uint8_t channel, uint32_t t_us, float* frame, uint8_t count) {
+  Sample* s = (count <= SAMPLE_BUS_FRAME_VALUES) ? _take(sensor, channel, t_us) : nullptr;
+  if (nullptr == s) {
+    releaseFrame(frame);
+    return -1;
+  }
+  s->_frame = frame;
+  s->count  = count;
+  return _deliver(s);
+}
+
+
+/*
+* Returns the last sample published on a sensor/channel, or nullptr if there
+*   hasn't been one. It is good until the next publish on that sensor/channel,
+*   unless retained.
+*/
+const Sample* SampleBus::latest(uint8_t sensor, uint8_t channel) {
+  if ((sensor >= SAMPLE_BUS_SENSORS) || (channel >= SAMPLE_BUS_CHANNELS)) {
+    return nullptr;
+  }
+  return _latest[sensor][channel];
+}
+
+
+float SampleBus::latestValue(uint8_t sensor, uint8_t channel, uint8_t i, float fallback) {
+  const Sample* s = latest(sensor, channel);
+  return ((nullptr != s) && (i < s->count)) ? s->value(i) : fallback;
+}
+
+
+void SampleBus::retain(const Sample* cs) {
+  Sample* s = (Sample*) cs;
+  s->_refs++;
+}
+
+
+void SampleBus::release(const Sample* cs) {
+  Sample* s = (Sample*) cs;
+  if ((0 == s->_refs) || (0 < --s->_refs)) {
+    return;
+  }
+  if (nullptr != s->_frame) {
+    releaseFrame(s->_frame);
+    s->_frame = nullptr;
+  }
+  _in_use--;
+}
+
+
+void SampleBus::resetStats() {
+  _published  = 0;
+  _deliveries = 0;
+  _drops      = 0;
+  _in_use_max = _in_use;
+}
+
+
+void SampleBus::printDebug(StringBuilder* output) {
+  uint8_t frames = 0;
+  for (uint8_t i = 0; i < SAMPLE_BUS_FRAMES; i++) {
+    if (_frame_used[i]) frames++;
+  }
+  output->concatf("Sample bus: %u subscribers\n", _sub_count);
+  output->concatf("\tPublished:   %u\n", _published);
+  output->concatf("\tDeliveries:  %u\n", _deliveries);
+  output->concatf("\tDropped:     %u\n", _drops);
+  output->concatf("\tSamples:     %u in use (max %u of %u)\n", _in_use, _in_use_max, SAMPLE_BUS_POOL);
+  output->concatf("\tFrames:      %u of %u in use\n", frames, SAMPLE_BUS_FRAMES);
+}
+
+
+/* Finds a free slot, and holds it on behalf of the publisher. */
+Sample* SampleBus::_take(uint8_t sensor, uint8_t channel, uint32_t t_us) {
+  if ((sensor >= SAMPLE_BUS_SENSORS) || (channel >= SAMPLE_BUS_CHANNELS)) {
+    return nullptr;
+  }
+  for (uint8_t i = 0; i < SAMPLE_BUS_POOL; i++) {
+    Sample* s = &_pool[i];
+    if (0 == s->_refs) {
+      s->_refs   = 1;
+      s->_frame  = nullptr;
+      s->t_us    = t_us;
+      s->sensor  = sensor;
+      s->channel = channel;
+      s->count   = 0;
+      _in_use++;
+      if (_in_use > _in_use_max) _in_use_max = _in_use;
+      return s;
+    }
+  }
+  _drops++;
+  return nullptr;
+}
+
+
+/*
+* Hands a sample to its subscribers, makes it the latest for its stream, and
+*   drops the publisher's hold on it.
+*/
+int8_t SampleBus::_deliver(Sample* s) {
+  int8_t ret = 0;
+  const uint16_t S_BIT = 1 << s->sensor;
+  const uint8_t  C_BIT = 1 << s->channel;
+  _published++;
+  for (uint8_t i = 0; i < _sub_count; i++) {
+    if ((_subs[i].sensor_mask & S_BIT) && (_subs[i].channel_mask & C_BIT)) {
+      _subs[i].fxn(s);
+      ret++;
+    }
+  }
+  _deliveries += ret;
+  Sample** slot = &_latest[s->sensor][s->channel];
+  if (nullptr != *slot) {
+    release(*slot);
+  }
+  *slot = s;     // Takes over the publisher's reference.
+  return ret;
+}
@@ -0,0 +1,119 @@
+/*
+* A publish/subscribe hub for sensor readings.
+*
+* Each reading is a Sample: which sensor (a SensorID), which channel of that
+*   sensor, when (microseconds), and its values. A small vector (up to
+*   SAMPLE_BUS_INLINE_VALUES) is carried in the Sample itself. Anything larger
+*   (such as a thermopile frame) lives in a frame buffer taken from the bus
+*   with acquireFrame(), which the driver fills in place, and hands back with
+*   publishFrame().
+*
+* Samples and frames come from fixed pools, and are reference counted. A
+*   subscriber is called with a pointer into the pool, and nothing is copied
+*   on the way. A subscriber that wants to hold a sample past its callback can
+*   retain() it, and must release() it later. The bus itself holds the latest
+*   sample of every sensor/channel, so that code that only wants the current
+*   value (such as a display) can ask for it with latest() rather than
+*   subscribing. If a pool runs dry, the publish fails and is counted. Nothing
+*   in here allocates.
+*
+* Delivery is synchronous. publish() calls every matching subscriber, in the
+*   order they subscribed, before it returns. A subscriber may itself publish
+*   (to derive one stream from another). None of this is safe to call from an
+*   ISR.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __SAMPLE_BUS_H_
+#define __SAMPLE_BUS_H_
+
+#define SAMPLE_BUS_SENSORS        16    // SensorIDs must be less than this.
+#define SAMPLE_BUS_CHANNELS        8    // Per sensor. Channel masks are 8 bits.
+#define SAMPLE_BUS_INLINE_VALUES   4
+#define SAMPLE_BUS_POOL           32    // Samples
+#define SAMPLE_BUS_FRAMES          3    // Frame buffers
+#define SAMPLE_BUS_FRAME_VALUES   64
+#define SAMPLE_BUS_MAX_SUBS       12
+
+#define SAMPLE_BUS_ALL_SENSORS    0xFFFF
+#define SAMPLE_BUS_ALL_CHANNELS   0xFF
+
+class SampleBus;
+
+
+/*******************************************************************************
+* One timestamped reading.
+*******************************************************************************/
+class Sample {
+  public:
+    uint32_t t_us    = 0;
+    uint8_t  sensor  = 0;
+    uint8_t  channel = 0;
+    uint8_t  count   = 0;     // Number of values.
+
+    inline const float* values() const {  return (nullptr != _frame) ? _frame : _vals;  };
+    inline float value(uint8_t i = 0) const {  return (i < count) ? values()[i] : 0.0f;  };
+
+
+  private:
+    float   _vals[SAMPLE_BUS_INLINE_VALUES];
+    float*  _frame = nullptr;
+    uint8_t _refs  = 0;       // 0 means the slot is free.
+
+    friend class SampleBus;
+};
+
+typedef void (*SampleSubscriberFxn)(const Sample*);
+
+
+/*******************************************************************************
+* The hub.
+*******************************************************************************/
+class SampleBus {
+  public:
+    int8_t subscribe(SampleSubscriberFxn, uint16_t sensor_mask, uint8_t channel_mask = SAMPLE_BUS_ALL_CHANNELS);
+    int8_t unsubscribe(SampleSubscriberFxn);
+
+    int8_t publish(uint8_t sensor, uint8_t channel, uint32_t t_us, float value);
+    int8_t publish(uint8_t sensor, uint8_t channel, uint32_t t_us, const float* values, uint8_t count);
+    float* acquireFrame();
+    int8_t publishFrame(uint8_t sensor, uint8_t channel, uint32_t t_us, float* frame, uint8_t count);
+    void   releaseFrame(float* frame);
+
+    const Sample* latest(uint8_t sensor, uint8_t channel);
+    float         latestValue(uint8_t sensor, uint8_t channel, uint8_t i = 0, float fallback = 0.0f);
+    void retain(const Sample*);
+    void release(const Sample*);
+
+    void resetStats();
+    void printDebug(StringBuilder*);
+
+
+  private:
+    struct Subscription {
+      SampleSubscriberFxn fxn          = nullptr;
+      uint16_t            sensor_mask  = 0;
+      uint8_t             channel_mask = 0;
+    };
+
+    Sample       _pool[SAMPLE_BUS_POOL];
+    float        _frames[SAMPLE_BUS_FRAMES][SAMPLE_BUS_FRAME_VALUES];
+    bool         _frame_used[SAMPLE_BUS_FRAMES] = {false};
+    Sample*      _latest[SAMPLE_BUS_SENSORS][SAMPLE_BUS_CHANNELS] = {{nullptr}};
+    Subscription _subs[SAMPLE_BUS_MAX_SUBS];
+    uint8_t      _sub_count = 0;
+
+    uint32_t _published  = 0;
+    uint32_t _deliveries = 0;
+    uint32_t _drops      = 0;   // Publishes refused for want of a slot.
+    uint8_t  _in_use     = 0;
+    uint8_t  _in_use_max = 0;
+
+    Sample* _take(uint8_t sensor, uint8_t channel, uint32_t t_us);
+    int8_t  _deliver(Sample*);
+};
+
+#endif  // __SAMPLE_BUS_H_
@@ -0,0 +1,454 @@
+/*
+* A non-blocking sample logger that writes whole 512-byte sectors.
+* See the header file for the rules and the format.
+*/
+
+#include <string.h>
+#include "SampleLogger.h"
+
+static inline void _put16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+}
+
+static inline void _put32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+
+uint16_t log_get16(const uint8_t* p) {
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+uint32_t log_get32(const uint8_t* p) {
+  return ((uint32_t) p[0]) | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+/*
+* CRC-32 (the zlib one), a nibble at a time. The 16-entry table costs 64
+*   bytes, rather than 1K, and a sector still takes only a few microseconds.
+*/
+uint32_t log_crc32(const uint8_t* buf, uint32_t len) {
+  static const uint32_t TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+
+/* Fills in the CRC of a sector whose CRC field is at the given offset. */
+static void _seal_crc(uint8_t* s, uint8_t offset) {
+  _put32(s + offset, 0);
+  _put32(s + offset, log_crc32(s, LOG_SECTOR_BYTES));
+}
+
+
+
+#if defined(ARDUINO)
+/*******************************************************************************
+* SdLogSink
+*******************************************************************************/
+
+int8_t SdLogSink::open(const char* name, uint32_t sectors) {
+  _file = _fs->open(name, O_RDWR | O_CREAT | O_TRUNC);
+  if (!_file) {
+    return -1;
+  }
+  if (!_file.preAllocate((uint64_t) sectors * LOG_SECTOR_BYTES)) {
+    _file.close();
+    return -2;
+  }
+  return 0;
+}
+
+
+int8_t SdLogSink::close(uint32_t sectors_written) {
+  if (!_file) {
+    return -1;
+  }
+  // Give back the preallocated space we didn't use.
+  const bool TRUNCATED = _file.truncate((uint64_t) sectors_written * LOG_SECTOR_BYTES);
+  _file.close();
+  return TRUNCATED ? 0 : -2;
+}
+
+
+bool SdLogSink::busy() {
+  return _file.isBusy();
+}
+
+
+int8_t SdLogSink::writeSector(const uint8_t* buf) {
+  return (LOG_SECTOR_BYTES == _file.write(buf, LOG_SECTOR_BYTES)) ? 0 : -1;
+}
+#endif   // ARDUINO
+
+
+
+/*******************************************************************************
+* LogMemSink
+*******************************************************************************/
+
+int8_t LogMemSink::open(const char* name, uint32_t sectors) {
+  (void) name;   // There is only the one file.
+  if (sectors > _cap) {
+    return -2;
+  }
+  _written = 0;
+  _open    = true;
+  return 0;
+}
+
+
+/*
+* Returns 0 if the logger's count agrees with what arrived here, or -1 if not.
+*/
+int8_t LogMemSink::close(uint32_t sectors_written) {
+  _open = false;
+  return (sectors_written == _written) ? 0 : -1;
+}
+
+
+int8_t LogMemSink::writeSector(const uint8_t* buf) {
+  if (!_open || (_written >= _cap)) {
+    return -1;
+  }
+  memcpy(_mem + (_written * LOG_SECTOR_BYTES), buf, LOG_SECTOR_BYTES);
+  _written++;
+  return 0;
+}
+
+
+
+/*******************************************************************************
+* SampleLogger
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+SampleLogger::SampleLogger(LogSink* s, LogClockFxn clock_ms, LogClockFxn clock_us) :
+  _sink(s), _clock_ms(clock_ms), _clock_us(clock_us) {}
+
+
+/*
+* Opens and preallocates the file, and starts accepting samples.
+* Returns 0 on success, or the sink's error code.
+*/
+int8_t SampleLogger::start(const char* name, uint32_t max_sectors) {
+  if (_logging || (max_sectors <= LOG_FOOTER_SECTORS)) {
+    return -1;
+  }
+  int8_t ret = _sink->open(name, max_sectors);
+  if (0 == ret) {
+    _max_sectors = max_sectors;
+    _written     = 0;
+    _seq         = 0;
+    _fill        = 0;
+    _flush       = 0;
+    _ready       = 0;
+    _file_mask   = 0;
+    _file_first  = 0;
+    _file_last   = 0;
+    _file_recs   = 0;
+    _file_drops  = 0;
+    _index_count = 0;
+    _stride      = 1;
+    _begin_sector();
+    resetStats();
+    _logging     = true;
+  }
+  return ret;
+}
+
+
+/*
+* Seals whatever is buffered, writes it all out along with the footer, and
+*   closes the file. This is the only call that waits on the card.
+*/
+int8_t SampleLogger::stop() {
+  if (!_logging) {
+    return -1;
+  }
+  _logging = false;
+  if (_used > LOG_SECTOR_HEADER) {
+    // With the ring full, the sector after this one is the oldest unwritten
+    //   one. Make room before sealing, or its header would be overwritten.
+    _drain(LOG_BUFFER_SECTORS - 2);
+    if (_ready < (LOG_BUFFER_SECTORS - 1)) {
+      _seal();
+    }
+    else {
+      _dropped    += _fill_count;   // The card failed us.
+      _file_drops += _fill_count;
+      _file_recs  -= _fill_count;
+    }
+  }
+  _drain(0);
+  _ready = 0;
+  _write_footer();
+  return _sink->close(_written);
+}
+
+
+/*
+* Appends one record to the sector being filled. If it doesn't fit, that
+*   sector is sealed and the next one is started. If there is no next one,
+*   the record is dropped.
+* Returns 0 if the record was taken, or -1 if it was dropped.
+*/
+int8_t SampleLogger::log(uint8_t sensor, uint32_t t_ms, const void* payload, uint8_t len) {
+  if (!_logging || (len > LOG_RECORD_MAX_PAYLOAD)) {
+    return -1;
+  }
+  const uint16_t REC_LEN = LOG_RECORD_HEADER + len;
+  if ((_used + REC_LEN) > LOG_SECTOR_BYTES) {
+    if (_ready >= (LOG_BUFFER_SECTORS - 1)) {
+      _dropped++;
+      _file_drops++;
+      return -1;
+    }
+    _seal();
+  }
+  if (_seq >= (_max_sectors - LOG_FOOTER_SECTORS)) {
+    _dropped++;   // The file is full, less room for the footer.
+    _file_drops++;
+    return -1;
+  }
+  uint8_t* rec = &_buf[_fill][_used];
+  rec[0] = sensor;
+  rec[1] = len;
+  _put32(rec + 2, t_ms);
+  memcpy(rec + LOG_RECORD_HEADER, payload, len);
+  if (LOG_SECTOR_HEADER == _used) {
+    _fill_t0    = _clock_ms();
+    _fill_first = t_ms;
+    if (0 == _seq) {
+      _file_first = t_ms;
+    }
+  }
+  _fill_mask |= (uint16_t) (1 << (sensor & 0x0F));
+  _fill_count++;
+  _file_last = t_ms;
+  _file_recs++;
+  _used += REC_LEN;
+  _records++;
+  _bytes += REC_LEN;
+  return 0;
+}
+
+
+int8_t SampleLogger::logFloats(uint8_t sensor, uint32_t t_ms, const float* vals, uint8_t count) {
+  return log(sensor, t_ms, vals, (uint8_t) (count * sizeof(float)));
+}
+
+
+/*
+* The background step. Seals a stale partial sector, and writes at most one
+*   sealed sector, if the card is ready for it.
+* Returns 1 if a sector was written, 0 if there was nothing to do (or the card
+*   was busy), or -1 on a write error.
+*/
+int8_t SampleLogger::service() {
+  if (_logging && (_used > LOG_SECTOR_HEADER) && (_ready < (LOG_BUFFER_SECTORS - 1))) {
+    if ((_clock_ms() - _fill_t0) >= LOG_SEAL_MS) {
+      _seal();
+    }
+  }
+  if (0 == _ready) {
+    return 0;
+  }
+  if (_sink->busy()) {
+    _busy_skips++;
+    return 0;
+  }
+  const uint32_t T0  = _clock_us();
+  const int8_t   RET = _sink->writeSector(_buf[_flush]);
+  const uint32_t DT  = _clock_us() - T0;
+  _write_us += DT;
+  if (DT > _write_max) _write_max = DT;
+  if (0 != RET) {
+    _write_errs++;
+    return -1;
+  }
+  if (++_flush >= LOG_BUFFER_SECTORS) _flush = 0;
+  _ready--;
+  _written++;
+  return 1;
+}
+
+
+void SampleLogger::resetStats() {
+  _records    = 0;
+  _bytes      = 0;
+  _dropped    = 0;
+  _busy_skips = 0;
+  _write_us   = 0;
+  _write_max  = 0;
+  _write_errs = 0;
+  _ready_max  = _ready;
+  _stats_t0   = _clock_ms();
+}
+
+
+void SampleLogger::printDebug(StringBuilder* output) {
+  const uint32_t ELAPSED_MS = _clock_ms() - _stats_t0;
+  output->concatf("Logger: %s\n", _logging ? "logging" : "stopped");
+  output->concatf("\tSectors written:   %u of %u\n", _written, _max_sectors);
+  output->concatf("\tIndex:             %u entries, 1 per %u chunks\n", _index_count, _stride);
+  output->concatf("\tRecords:           %u (%u bytes)\n", _records, _bytes);
+  output->concatf("\tThroughput:        %u bytes/s\n", (ELAPSED_MS > 0) ? (uint32_t) (((uint64_t) _bytes * 1000) / ELAPSED_MS) : 0);
+  output->concatf("\tDropped records:   %u\n", _dropped);
+  output->concatf("\tBacklog:           %u (max %u of %u)\n", _ready, _ready_max, LOG_BUFFER_SECTORS);
+  output->concatf("\tCard busy skips:   %u\n", _busy_skips);
+  output->concatf("\tWrite errors:      %u\n", _write_errs);
+  output->concatf(
+    "\tSector write (us): mean %u  max %u\n",
+    (_written > 0) ? (_write_us / _written) : 0, _write_max
+  );
+}
+
+
+/*
+* Finishes the header of the sector being filled, queues it for the card, and
+*   starts the next one.
+*/
+void SampleLogger::_seal() {
+  uint8_t* s = _buf[_fill];
+  memset(s + _used, 0, LOG_SECTOR_BYTES - _used);
+  _put16(s + 2, _used);
+  _put16(s + 8, _fill_mask);
+  _put16(s + 10, _fill_count);
+  _put32(s + 12, _fill_first);
+  _seal_crc(s, 16);
+  _file_mask |= _fill_mask;
+  _index_chunk(_seq, _fill_first);
+  _ready++;
+  if (_ready > _ready_max) _ready_max = _ready;
+  if (++_fill >= LOG_BUFFER_SECTORS) _fill = 0;
+  _seq++;
+  _begin_sector();
+}
+
+
+void SampleLogger::_begin_sector() {
+  uint8_t* s = _buf[_fill];
+  _put16(s, LOG_SECTOR_MAGIC);
+  _put16(s + 2, LOG_SECTOR_HEADER);
+  _put32(s + 4, _seq);
+  _used       = LOG_SECTOR_HEADER;
+  _fill_mask  = 0;
+  _fill_count = 0;
+}
+
+
+/*
+* Notes the first time of every Nth chunk. When the index is full, N doubles,
+*   and the entries that are no longer on the stride are dropped.
+*/
+void SampleLogger::_index_chunk(uint32_t chunk, uint32_t t_ms) {
+  if (0 != (chunk % _stride)) {
+    return;
+  }
+  if (_index_count >= LOG_INDEX_ENTRIES) {
+    _stride = _stride << 1;
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < _index_count; i++) {
+      if (0 == (_index[i].chunk % _stride)) {
+        _index[kept++] = _index[i];
+      }
+    }
+    _index_count = kept;
+    if (0 != (chunk % _stride)) {
+      return;
+    }
+  }
+  _index[_index_count].t_ms  = t_ms;
+  _index[_index_count].chunk = chunk;
+  _index_count++;
+}
+
+
+/*
+* Writes the index and the trailer after the last data chunk. The ring is
+*   empty by now, so its first buffer is borrowed to build them.
+*/
+int8_t SampleLogger::_write_footer() {
+  const uint32_t DATA_CHUNKS = _written;
+  uint8_t* s = _buf[0];
+  uint16_t entries = 0;
+  while ((entries < _index_count) && (_index[entries].chunk < DATA_CHUNKS)) {
+    entries++;   // Drop entries for chunks that never made it out.
+  }
+  const uint32_t INDEX_SECTORS = (entries + LOG_INDEX_PER_SECTOR - 1) / LOG_INDEX_PER_SECTOR;
+
+  for (uint32_t n = 0; n < INDEX_SECTORS; n++) {
+    const uint16_t FIRST = n * LOG_INDEX_PER_SECTOR;
+    const uint16_t COUNT = ((entries - FIRST) < LOG_INDEX_PER_SECTOR) ? (entries - FIRST) : LOG_INDEX_PER_SECTOR;
+    memset(s, 0, LOG_SECTOR_BYTES);
+    _put16(s, LOG_INDEX_MAGIC);
+    _put16(s + 2, COUNT);
+    for (uint16_t i = 0; i < COUNT; i++) {
+      _put32(s + 8 + (i * 8), _index[FIRST + i].t_ms);
+      _put32(s + 12 + (i * 8), _index[FIRST + i].chunk);
+    }
+    _seal_crc(s, 4);
+    if (0 != _write_blocking(s)) {
+      return -1;
+    }
+  }
+
+  memset(s, 0, LOG_SECTOR_BYTES);
+  _put16(s, LOG_TRAILER_MAGIC);
+  _put16(s + 2, LOG_FORMAT_VERSION);
+  _put32(s + 8, DATA_CHUNKS);
+  _put32(s + 12, INDEX_SECTORS);
+  _put32(s + 16, entries);
+  _put32(s + 20, _stride);
+  _put32(s + 24, _file_first);
+  _put32(s + 28, _file_last);
+  _put16(s + 32, _file_mask);
+  _put32(s + 36, _file_recs);
+  _put32(s + 40, _file_drops);
+  _seal_crc(s, 4);
+  return _write_blocking(s);
+}
+
+
+/*
+* Writes sealed sectors, waiting on the card as needed, until no more than the
+*   given number are left. Stops early if the file is full or a write fails.
+*/
+void SampleLogger::_drain(uint8_t backlog) {
+  while ((_ready > backlog) && (_written < _max_sectors)) {
+    if (!_sink->busy()) {
+      if (0 > service()) {
+        return;
+      }
+    }
+  }
+}
+
+
+int8_t SampleLogger::_write_blocking(const uint8_t* buf) {
+  if (_written >= _max_sectors) {
+    return -1;
+  }
+  while (_sink->busy()) {}
+  if (0 != _sink->writeSector(buf)) {
+    _write_errs++;
+    return -1;
+  }
+  _written++;
+  return 0;
+}
@@ -0,0 +1,237 @@
+/*
+* A non-blocking sample logger that writes whole 512-byte sectors.
+*
+* Samples are serialized into a small ring of sector buffers in RAM. When a
+*   sector fills (or gets old), it is sealed, and the next one takes over.
+*   Sealed sectors are written out by service(), one per call, and only when
+*   the sink says the card is not busy. So a sample never waits on the card,
+*   and the main loop never spends more than one sector write per pass. If the
+*   card falls so far behind that the ring fills, new samples are dropped (and
+*   counted) rather than blocking.
+*
+* The file is preallocated when logging starts, so that sector writes don't
+*   touch the allocation table. It is trimmed to what was written at stop().
+*
+* Where sectors go is the job of a LogSink. SdLogSink writes to a file on an
+*   SdFat volume. LogMemSink writes to a caller-supplied RAM array, so that
+*   the logger (and anything that reads its output) can be exercised in a
+*   host build.
+*
+* Files are made of 512-byte sectors, and every sector is a self-contained
+*   chunk: it says which sensors it holds, when its first record was taken,
+*   and carries a CRC. So a reader can skip chunks it doesn't care about
+*   without parsing them, and can binary-search chunks by time.
+*
+* When logging stops, a footer is written after the last data chunk: a few
+*   sectors of sparse index (the first time of every Nth chunk), and then a
+*   trailer sector that describes the file. The index has a fixed number of
+*   entries. When it fills, N doubles and every other entry is dropped, so
+*   RAM use doesn't depend on the length of the recording. A file that never
+*   got its footer (power loss) is still readable. It just takes a few more
+*   sector reads to open and seek.
+*
+* Chunk layout (little-endian):
+*   0   uint16  LOG_SECTOR_MAGIC
+*   2   uint16  Bytes used, including this header.
+*   4   uint32  Sequence number. The first chunk of a file is 0.
+*   8   uint16  Bitmask of the SensorIDs that have records in this chunk.
+*   10  uint16  Record count
+*   12  uint32  Time of the first record (ms)
+*   16  uint32  CRC-32 of the whole sector, taken with this field zeroed.
+*   20  Records, back to back. A record never spans chunks. Record times
+*         never decrease through a file.
+*
+* Record layout:
+*   0   uint8   Sensor ID
+*   1   uint8   Payload length
+*   2   uint32  Time (ms)
+*   6   Payload
+*
+* Index sector layout:
+*   0   uint16  LOG_INDEX_MAGIC
+*   2   uint16  Entries in this sector
+*   4   uint32  CRC-32, as above.
+*   8   Entries of {uint32 time (ms), uint32 chunk number}, in order.
+*
+* Trailer sector layout (always the last sector of the file):
+*   0   uint16  LOG_TRAILER_MAGIC
+*   2   uint16  LOG_FORMAT_VERSION
+*   4   uint32  CRC-32, as above.
+*   8   uint32  Data chunks. The index starts right after them.
+*   12  uint32  Index sectors
+*   16  uint32  Index entries
+*   20  uint32  Index stride (chunks per entry)
+*   24  uint32  Time of the first record (ms)
+*   28  uint32  Time of the last record (ms)
+*   32  uint16  Bitmask of all SensorIDs in the file.
+*   34  uint16  Reserved
+*   36  uint32  Records
+*   40  uint32  Records dropped while logging.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#if defined(ARDUINO)
+  #include <SD.h>
+#endif
+
+#ifndef __SAMPLE_LOGGER_H_
+#define __SAMPLE_LOGGER_H_
+
+#define LOG_SECTOR_BYTES        512
+#define LOG_SECTOR_HEADER       20
+#define LOG_RECORD_HEADER        6
+#define LOG_RECORD_MAX_PAYLOAD  (LOG_SECTOR_BYTES - LOG_SECTOR_HEADER - LOG_RECORD_HEADER)
+#define LOG_SECTOR_MAGIC        0x4C4D    // "ML"
+#define LOG_INDEX_MAGIC         0x494D    // "MI"
+#define LOG_TRAILER_MAGIC       0x544D    // "MT"
+#define LOG_FORMAT_VERSION      1
+#define LOG_INDEX_PER_SECTOR    ((LOG_SECTOR_BYTES - 8) / 8)
+#define LOG_INDEX_SECTORS       8
+#define LOG_INDEX_ENTRIES       (LOG_INDEX_PER_SECTOR * LOG_INDEX_SECTORS)
+#define LOG_FOOTER_SECTORS      (LOG_INDEX_SECTORS + 1)
+#define LOG_BUFFER_SECTORS      8         // RAM ring. Must be at least 2.
+#define LOG_SEAL_MS             2000      // Oldest a partial sector may get.
+
+typedef uint32_t (*LogClockFxn)();
+
+/* One entry of the sparse index. */
+typedef struct {
+  uint32_t t_ms;
+  uint32_t chunk;
+} LogIndexEntry;
+
+uint32_t log_crc32(const uint8_t* buf, uint32_t len);
+uint16_t log_get16(const uint8_t* p);
+uint32_t log_get32(const uint8_t* p);
+
+
+/*******************************************************************************
+* Base class for anything that stores sectors on behalf of the logger.
+*******************************************************************************/
+class LogSink {
+  public:
+    /* Opens a fresh file with room for the given number of sectors. */
+    virtual int8_t open(const char* name, uint32_t sectors) = 0;
+    /* Trims the file to the given number of sectors, and closes it. */
+    virtual int8_t close(uint32_t sectors_written) = 0;
+    /* True if a write now would have to wait. */
+    virtual bool   busy() = 0;
+    virtual int8_t writeSector(const uint8_t* buf) = 0;
+};
+
+
+#if defined(ARDUINO)
+/*******************************************************************************
+* Sink for a file on an SdFat volume.
+*******************************************************************************/
+class SdLogSink : public LogSink {
+  public:
+    SdLogSink(SdFs* fs) : _fs(fs) {};
+
+    int8_t open(const char* name, uint32_t sectors);
+    int8_t close(uint32_t sectors_written);
+    bool   busy();
+    int8_t writeSector(const uint8_t* buf);
+
+
+  private:
+    SdFs*  _fs;
+    FsFile _file;
+};
+#endif   // ARDUINO
+
+
+/*******************************************************************************
+* Sink for a block of RAM. For host builds.
+*******************************************************************************/
+class LogMemSink : public LogSink {
+  public:
+    LogMemSink(uint8_t* mem, uint32_t sectors) : _mem(mem), _cap(sectors) {};
+
+    int8_t open(const char* name, uint32_t sectors);
+    int8_t close(uint32_t sectors_written);
+    bool   busy() {   return false;   };
+    int8_t writeSector(const uint8_t* buf);
+
+    inline uint32_t sectors() {   return _written;   };
+
+
+  private:
+    uint8_t* _mem;
+    uint32_t _cap;
+    uint32_t _written = 0;
+    bool     _open    = false;
+};
+
+
+/*******************************************************************************
+* The logger itself.
+*******************************************************************************/
+class SampleLogger {
+  public:
+    SampleLogger(LogSink*, LogClockFxn clock_ms, LogClockFxn clock_us);
+
+    int8_t start(const char* name, uint32_t max_sectors);
+    int8_t stop();
+    int8_t log(uint8_t sensor, uint32_t t_ms, const void* payload, uint8_t len);
+    int8_t logFloats(uint8_t sensor, uint32_t t_ms, const float* vals, uint8_t count);
+    int8_t service();
+    void   resetStats();
+    void   printDebug(StringBuilder*);
+
+    inline bool     logging() {       return _logging;          };
+    inline uint32_t sectorsWritten() {  return _written;        };
+    inline uint32_t indexStride() {   return _stride;           };
+    inline uint32_t dropped() {       return _dropped;          };
+    inline uint8_t  backlog() {       return _ready;            };
+
+
+  private:
+    LogSink*          _sink;
+    const LogClockFxn _clock_ms;
+    const LogClockFxn _clock_us;
+    uint8_t  _buf[LOG_BUFFER_SECTORS][LOG_SECTOR_BYTES];
+    uint8_t  _fill       = 0;       // Sector being filled.
+    uint8_t  _flush      = 0;       // Oldest sealed sector.
+    uint8_t  _ready      = 0;       // Sealed sectors waiting for the card.
+    uint16_t _used       = 0;       // Bytes in the sector being filled.
+    uint32_t _fill_t0    = 0;       // When the sector being filled got its first record.
+    uint32_t _fill_first = 0;       // Time of its first record.
+    uint16_t _fill_mask  = 0;       // Sensors in it.
+    uint16_t _fill_count = 0;       // Records in it.
+    uint32_t _seq        = 0;       // Sequence number of the sector being filled.
+    uint32_t _max_sectors = 0;
+    uint32_t _written    = 0;
+    bool     _logging    = false;
+    uint16_t _file_mask  = 0;       // Sensors in the whole file.
+    uint32_t _file_first = 0;
+    uint32_t _file_last  = 0;
+    uint32_t _file_recs  = 0;
+    uint32_t _file_drops = 0;
+
+    LogIndexEntry _index[LOG_INDEX_ENTRIES];
+    uint16_t _index_count = 0;
+    uint32_t _stride      = 1;      // Chunks per index entry.
+
+    uint32_t _records    = 0;
+    uint32_t _bytes      = 0;       // Record bytes accepted.
+    uint32_t _dropped    = 0;       // Records refused for want of buffer or file.
+    uint32_t _busy_skips = 0;       // Passes that found the card busy.
+    uint32_t _write_us   = 0;       // Time spent in the sink.
+    uint32_t _write_max  = 0;
+    uint32_t _write_errs = 0;
+    uint8_t  _ready_max  = 0;
+    uint32_t _stats_t0   = 0;
+
+    void   _seal();
+    void   _begin_sector();
+    void   _index_chunk(uint32_t chunk, uint32_t t_ms);
+    void   _drain(uint8_t backlog);
+    int8_t _write_footer();
+    int8_t _write_blocking(const uint8_t* buf);
+};
+
+#endif  // __SAMPLE_LOGGER_H_
@@ -0,0 +1,274 @@
+/*
+* A deadline-driven co-operative scheduler for the main loop.
+* See the header file for the rules.
+*/
+
+#include "Scheduler.h"
+
+
+/*******************************************************************************
+* CoopTask
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+CoopTask::CoopTask(const char* name, CoopTaskFxn fxn, uint32_t period_us, uint8_t priority) :
+  NAME(name), _fxn(fxn), _period(period_us), _priority(priority) {}
+
+
+void CoopTask::resetStats() {
+  _run_count  = 0;
+  _overruns   = 0;
+  _jitter_max = 0;
+  _jitter_sum = 0;
+  _exec_max   = 0;
+}
+
+
+void CoopTask::printDebug(StringBuilder* output) {
+  output->concatf(
+    "%-12s %9u %3u %9u %7u %7u %7u %6u\n",
+    NAME, _period, _priority, _run_count, jitterMean(), _jitter_max, _exec_max, _overruns
+  );
+}
+
+
+
+/*******************************************************************************
+* CoopScheduler
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+CoopScheduler::CoopScheduler(CoopClockFxn c) : _clock(c) {
+  for (uint8_t i = 0; i < COOP_SCHEDULER_MAX_TASKS; i++) {
+    _heap[i] = nullptr;
+  }
+}
+
+/*
+* Destructor
+*/
+CoopScheduler::~CoopScheduler() {}
+
+
+/*
+* Adds a task to the heap, with a deadline one period from now. One-shots are
+*   accepted but not queued. They will be queued by the first fireIn/fireAt.
+* Returns...
+*   -2 if the heap is full.
+*   -1 if the task is already queued.
+*   0  on success.
+*/
+int8_t CoopScheduler::addTask(CoopTask* t) {
+  if (t->queued()) {
+    return -1;
+  }
+  if (t->oneShot()) {
+    return 0;
+  }
+  t->_deadline = _clock() + t->_period;
+  return _heap_insert(t);
+}
+
+
+/*
+* Removes a task from the heap. It is not an error to remove a task that is
+*   not queued.
+*/
+int8_t CoopScheduler::removeTask(CoopTask* t) {
+  if (t->queued()) {
+    _heap_remove(t->_heap_idx);
+  }
+  return 0;
+}
+
+
+/*
+* Sets the task's next deadline. If the task is already queued, it is moved
+*   within the heap. Otherwise, it is inserted.
+*/
+int8_t CoopScheduler::fireAt(CoopTask* t, uint32_t deadline) {
+  t->_deadline = deadline;
+  if (t->queued()) {
+    _heap_fix(t->_heap_idx);
+    return 0;
+  }
+  return _heap_insert(t);
+}
+
+
+int8_t CoopScheduler::fireIn(CoopTask* t, uint32_t delay_us) {
+  return fireAt(t, _clock() + delay_us);
+}
+
+
+/*
+* Runs every task that is due, in deadline order, up to a limit.
+* A task that reschedules itself into the past will not be run more than once
+*   per call, since the limit bounds the work.
+* Returns the number of tasks that were run.
+*/
+int8_t CoopScheduler::serviceTasks(uint8_t max_runs) {
+  int8_t ret = 0;
+  while ((_count > 0) && (ret < max_runs)) {
+    CoopTask* t = _heap[0];
+    const uint32_t now = _clock();
+    const int32_t  lateness = (int32_t) (now - t->_deadline);
+    if (lateness < 0) {
+      break;   // Nothing else is due.
+    }
+    const uint32_t dispatched_deadline = t->_deadline;
+
+    if (t->oneShot()) {
+      _heap_remove(0);
+    }
+    else {
+      // Schedule against the deadline, not the clock, to avoid drift.
+      uint32_t missed = (uint32_t) lateness / t->_period;
+      t->_deadline += (missed + 1) * t->_period;
+      t->_overruns += missed;
+      _sift_down(0);
+    }
+
+    t->_flags |= COOP_TASK_FLAG_RUNNING;
+    t->_fxn();
+    t->_flags &= ~COOP_TASK_FLAG_RUNNING;
+
+    const uint32_t exec_time = _clock() - now;
+    const uint32_t jitter    = now - dispatched_deadline;
+    t->_run_count++;
+    t->_jitter_sum += jitter;
+    if (jitter > t->_jitter_max) {      t->_jitter_max = jitter;     }
+    if (exec_time > t->_exec_max) {     t->_exec_max = exec_time;    }
+    ret++;
+  }
+  return ret;
+}
+
+
+/*
+* Returns false if nothing is scheduled. Otherwise, writes the earliest
+*   deadline to the given pointer.
+*/
+bool CoopScheduler::nextDeadline(uint32_t* deadline) {
+  if (0 == _count) {
+    return false;
+  }
+  *deadline = _heap[0]->_deadline;
+  return true;
+}
+
+
+/*
+* How long the caller may sleep before something needs doing.
+* Returns 0 if something is already due, or 0xFFFFFFFF if the heap is empty.
+*/
+uint32_t CoopScheduler::usUntilNextDeadline() {
+  if (0 == _count) {
+    return 0xFFFFFFFF;
+  }
+  int32_t diff = (int32_t) (_heap[0]->_deadline - _clock());
+  return (diff > 0) ? (uint32_t) diff : 0;
+}
+
+
+void CoopScheduler::resetStats() {
+  for (uint8_t i = 0; i < _count; i++) {
+    _heap[i]->resetStats();
+  }
+}
+
+
+void CoopScheduler::printDebug(StringBuilder* output) {
+  const uint32_t now = _clock();
+  output->concatf("-- CoopScheduler: %u tasks (max %u)\n", _count, COOP_SCHEDULER_MAX_TASKS);
+  output->concat("Task            Period Pri      Runs JitMean  JitMax ExecMax Overrun\n");
+  for (uint8_t i = 0; i < _count; i++) {
+    _heap[i]->printDebug(output);
+  }
+  if (_count > 0) {
+    output->concatf("Next deadline: %s in %dus\n", _heap[0]->NAME, (int32_t) (_heap[0]->_deadline - now));
+  }
+}
+
+
+/*******************************************************************************
+* Heap mechanics
+*******************************************************************************/
+
+int8_t CoopScheduler::_heap_insert(CoopTask* t) {
+  if (_count >= COOP_SCHEDULER_MAX_TASKS) {
+    return -2;
+  }
+  _heap[_count] = t;
+  t->_heap_idx = _count;
+  t->_flags |= COOP_TASK_FLAG_QUEUED;
+  _sift_up(_count++);
+  return 0;
+}
+
+
+void CoopScheduler::_heap_remove(uint8_t idx) {
+  CoopTask* t = _heap[idx];
+  t->_flags &= ~COOP_TASK_FLAG_QUEUED;
+  _count--;
+  if (idx != _count) {
+    _heap[idx] = _heap[_count];
+    _heap[idx]->_heap_idx = idx;
+    _heap_fix(idx);
+  }
+  _heap[_count] = nullptr;
+}
+
+
+/*
+* Restore heap order around an element whose deadline changed.
+*/
+void CoopScheduler::_heap_fix(uint8_t idx) {
+  if ((idx > 0) && _before(_heap[idx], _heap[(idx - 1) >> 1])) {
+    _sift_up(idx);
+  }
+  else {
+    _sift_down(idx);
+  }
+}
+
+
+void CoopScheduler::_sift_up(uint8_t idx) {
+  while (idx > 0) {
+    uint8_t parent = (idx - 1) >> 1;
+    if (!_before(_heap[idx], _heap[parent])) {
+      break;
+    }
+    _swap(idx, parent);
+    idx = parent;
+  }
+}
+
+
+void CoopScheduler::_sift_down(uint8_t idx) {
+  while (true) {
+    uint8_t l = (idx << 1) + 1;
+    uint8_t r = l + 1;
+    uint8_t best = idx;
+    if ((l < _count) && _before(_heap[l], _heap[best])) {   best = l;   }
+    if ((r < _count) && _before(_heap[r], _heap[best])) {   best = r;   }
+    if (best == idx) {
+      break;
+    }
+    _swap(idx, best);
+    idx = best;
+  }
+}
+
+
+void CoopScheduler::_swap(uint8_t a, uint8_t b) {
+  CoopTask* tmp = _heap[a];
+  _heap[a] = _heap[b];
+  _heap[b] = tmp;
+  _heap[a]->_heap_idx = a;
+  _heap[b]->_heap_idx = b;
+}
@@ -0,0 +1,129 @@
+/*
+* A deadline-driven co-operative scheduler for the main loop.
+*
+* Tasks are statically allocated by their owners and registered with the
+*   scheduler, which keeps them in a min-heap ordered by deadline (with
+*   priority breaking ties). Nothing in here allocates memory.
+*
+* All time values are in microseconds, and are taken from a clock function
+*   supplied at construction. On the Teensy this is micros(). A host build
+*   supplies a virtual clock so that timing behavior can be driven and
+*   observed deterministically. Comparisons are done with signed differences,
+*   so the 32-bit wrap of the clock (~71 minutes) is harmless so long as no
+*   deadline is more than ~35 minutes out.
+*
+* Periodic tasks are rescheduled against their previous deadline (not against
+*   the time they actually ran), so lateness does not accumulate as drift. If
+*   a task is so late that one or more whole periods were missed, those periods
+*   are skipped and counted as overruns.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __COOP_SCHEDULER_H_
+#define __COOP_SCHEDULER_H_
+
+#define COOP_SCHEDULER_MAX_TASKS      24
+
+/* Task flags */
+#define COOP_TASK_FLAG_QUEUED       0x01  // Task is in the scheduler's heap.
+#define COOP_TASK_FLAG_RUNNING      0x02  // Task is executing now.
+
+class CoopScheduler;
+
+typedef void     (*CoopTaskFxn)();
+typedef uint32_t (*CoopClockFxn)();
+
+
+/*******************************************************************************
+* A single schedulable unit of work.
+* A period of zero makes the task a one-shot. One-shots are dropped from the
+*   heap after they run, and must be re-armed with fireIn()/fireAt().
+* Priority is only used to order tasks whose deadlines are equal. Higher
+*   values run first.
+*******************************************************************************/
+class CoopTask {
+  public:
+    const char* const NAME;
+
+    CoopTask(const char* name, CoopTaskFxn fxn, uint32_t period_us, uint8_t priority = 128);
+
+    inline uint32_t period() {      return _period;     };
+    inline void     period(uint32_t x) {  _period = x;  };
+    inline uint32_t deadline() {    return _deadline;   };
+    inline uint8_t  priority() {    return _priority;   };
+    inline bool     queued() {      return (_flags & COOP_TASK_FLAG_QUEUED);  };
+    inline bool     oneShot() {     return (0 == _period);  };
+
+    /* Timing statistics. */
+    inline uint32_t runCount() {    return _run_count;   };
+    inline uint32_t overruns() {    return _overruns;    };
+    inline uint32_t jitterMax() {   return _jitter_max;  };
+    inline uint32_t execMax() {     return _exec_max;    };
+    inline uint32_t jitterMean() {
+      return (_run_count > 0) ? (uint32_t) (_jitter_sum / _run_count) : 0;
+    };
+    void resetStats();
+    void printDebug(StringBuilder*);
+
+
+  private:
+    friend class CoopScheduler;
+    CoopTaskFxn _fxn;
+    uint32_t    _period;
+    uint32_t    _deadline   = 0;
+    uint32_t    _run_count  = 0;
+    uint32_t    _overruns   = 0;
+    uint32_t    _jitter_max = 0;
+    uint32_t    _exec_max   = 0;
+    uint64_t    _jitter_sum = 0;
+    uint8_t     _priority;
+    uint8_t     _flags      = 0;
+    uint8_t     _heap_idx   = 0;
+};
+
+
+/*******************************************************************************
+* The scheduler itself.
+*******************************************************************************/
+class CoopScheduler {
+  public:
+    CoopScheduler(CoopClockFxn);
+    ~CoopScheduler();
+
+    int8_t   addTask(CoopTask*);                  // Starts after one period.
+    int8_t   removeTask(CoopTask*);
+    int8_t   fireAt(CoopTask*, uint32_t deadline);
+    int8_t   fireIn(CoopTask*, uint32_t delay_us);
+    int8_t   serviceTasks(uint8_t max_runs = COOP_SCHEDULER_MAX_TASKS);
+    bool     nextDeadline(uint32_t* deadline);
+    uint32_t usUntilNextDeadline();
+    void     resetStats();
+    void     printDebug(StringBuilder*);
+
+    inline uint8_t  taskCount() {   return _count;     };
+    inline uint32_t now() {         return _clock();   };
+
+
+  private:
+    const CoopClockFxn _clock;
+    CoopTask* _heap[COOP_SCHEDULER_MAX_TASKS];
+    uint8_t   _count = 0;
+
+    int8_t _heap_insert(CoopTask*);
+    void   _heap_remove(uint8_t idx);
+    void   _heap_fix(uint8_t idx);
+    void   _sift_up(uint8_t idx);
+    void   _sift_down(uint8_t idx);
+    void   _swap(uint8_t a, uint8_t b);
+
+    /* Does task a need to run before task b? */
+    inline bool _before(CoopTask* a, CoopTask* b) {
+      int32_t diff = (int32_t) (a->_deadline - b->_deadline);
+      return (diff == 0) ? (a->_priority > b->_priority) : (diff < 0);
+    };
+};
+
+#endif  // __COOP_SCHEDULER_H_
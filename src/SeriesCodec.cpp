@@ -0,0 +1,568 @@
+/*
+* Compressed storage for long sensor histories.
+* See the header file for the format.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "SeriesCodec.h"
+
+
+/*******************************************************************************
+* Bit packing. MSB first.
+*******************************************************************************/
+
+static inline void _put_bits(uint8_t* buf, uint16_t* pos, uint32_t val, uint8_t n) {
+  while (n > 0) {
+    n--;
+    const uint16_t P = *pos;
+    if ((val >> n) & 1) {
+      buf[P >> 3] |= (uint8_t) (0x80 >> (P & 7));
+    }
+    else {
+      buf[P >> 3] &= (uint8_t) ~(0x80 >> (P & 7));
+    }
+    *pos = P + 1;
+  }
+}
+
+static inline uint32_t _get_bits(const uint8_t* buf, uint16_t* pos, uint8_t n) {
+  uint32_t ret = 0;
+  while (n > 0) {
+    n--;
+    const uint16_t P = *pos;
+    ret = (ret << 1) | ((buf[P >> 3] >> (7 - (P & 7))) & 1);
+    *pos = P + 1;
+  }
+  return ret;
+}
+
+static inline uint32_t _zigzag(int32_t x) {    return ((uint32_t) x << 1) ^ (uint32_t) (x >> 31);   }
+static inline int32_t  _unzigzag(uint32_t x) { return (int32_t) (x >> 1) ^ -((int32_t) (x & 1));    }
+
+/*
+* Both the time and quantized value records are a unary prefix that picks a
+*   width, followed by that many bits. Widths are by prefix length.
+*/
+static const uint8_t DOD_WIDTHS[]   = {0, 7, 9, 12, 32};
+static const uint8_t DELTA_WIDTHS[] = {0, 3, 7, 12, 32};
+
+static inline uint8_t _prefix_class(uint32_t u, const uint8_t* widths, uint32_t bias) {
+  if (0 == u) return 0;
+  for (uint8_t i = 1; i < 4; i++) {
+    if ((u - bias) < (1UL << widths[i])) return i;
+  }
+  return 4;
+}
+
+/* Returns the bits a prefixed record will take. */
+static inline uint8_t _prefix_bits(uint8_t cls, const uint8_t* widths) {
+  return ((cls < 4) ? (cls + 1) : 4) + widths[cls];
+}
+
+static inline void _put_prefixed(uint8_t* buf, uint16_t* pos, uint32_t u, uint8_t cls, const uint8_t* widths, uint32_t bias) {
+  if (0 == cls) {
+    _put_bits(buf, pos, 0, 1);
+    return;
+  }
+  _put_bits(buf, pos, (cls < 4) ? ((1UL << (cls + 1)) - 2) : 0x0F, (cls < 4) ? (cls + 1) : 4);
+  _put_bits(buf, pos, (cls < 4) ? (u - bias) : u, widths[cls]);
+}
+
+static inline uint32_t _get_prefixed(const uint8_t* buf, uint16_t* pos, const uint8_t* widths, uint32_t bias) {
+  uint8_t cls = 0;
+  while ((cls < 4) && _get_bits(buf, pos, 1)) {
+    cls++;
+  }
+  if (0 == cls) return 0;
+  const uint32_t RAW = _get_bits(buf, pos, widths[cls]);
+  return (cls < 4) ? (RAW + bias) : RAW;
+}
+
+/* The XOR record. Returns its length in bits, and the window it would leave. */
+static inline uint8_t _xor_bits(uint32_t x, uint8_t w_lead, uint8_t w_trail, uint8_t* lead, uint8_t* trail) {
+  if (0 == x) return 1;
+  uint8_t l = (uint8_t) __builtin_clz(x);
+  uint8_t t = (uint8_t) __builtin_ctz(x);
+  if (l > 31) l = 31;
+  if ((0xFF != w_lead) && (l >= w_lead) && (t >= w_trail)) {
+    *lead  = w_lead;
+    *trail = w_trail;
+    return 2 + (32 - w_lead - w_trail);
+  }
+  *lead  = l;
+  *trail = t;
+  return 2 + 5 + 5 + (32 - l - t);
+}
+
+
+
+/*******************************************************************************
+* CompressedSeries
+*******************************************************************************/
+
+/*
+* Constructor
+*/
+CompressedSeries::CompressedSeries(SeriesClockFxn c, uint16_t blocks, SeriesCodecMode mode, float step) :
+  _clock(c), _mode((step > 0.0f) ? mode : SeriesCodecMode::XOR_FLOAT), _step(step), _cap(blocks) {}
+
+/*
+* Destructor
+*/
+CompressedSeries::~CompressedSeries() {
+  if (nullptr != _ring) {
+    delete[] _ring;
+    _ring = nullptr;
+  }
+}
+
+
+/*
+* Allocates the ring, if it isn't already. Clears all history.
+* Returns 0 on success, or -1 if memory could not be had.
+*/
+int8_t CompressedSeries::init() {
+  if ((nullptr == _ring) && (_cap > 0)) {
+    _ring = new SeriesBlock[_cap];
+    if (nullptr == _ring) {
+      return -1;
+    }
+  }
+  reset();
+  return 0;
+}
+
+
+void CompressedSeries::reset() {
+  _head    = 0;
+  _used    = 0;
+  _samples = 0;
+  _t       = 0;
+  _delta   = 0;
+  _v       = 0;
+  _lead    = 0xFF;
+  _trail   = 0;
+}
+
+
+void CompressedSeries::feed(float v) {
+  feed(v, _clock());
+}
+
+
+/*
+* Appends a sample. If its record doesn't fit in the open block, a new block
+*   is opened with this sample as its header.
+*/
+void CompressedSeries::feed(float v, uint32_t now_ms) {
+  if (!initialized()) {
+    return;
+  }
+  const uint32_t V = _encode_value(v);
+  if (0 == _used) {
+    _open_block(now_ms, V);
+    return;
+  }
+  SeriesBlock* blk = &_ring[_head];
+  const uint32_t DELTA = now_ms - _t;
+  const uint32_t DOD   = _zigzag((int32_t) (DELTA - _delta));
+  const uint8_t  T_CLS = _prefix_class(DOD, DOD_WIDTHS, 0);
+
+  uint8_t  v_cls = 0;
+  uint32_t v_rec = 0;
+  uint8_t  lead  = _lead;
+  uint8_t  trail = _trail;
+  uint8_t  needed = _prefix_bits(T_CLS, DOD_WIDTHS);
+  if (SeriesCodecMode::QUANT_DELTA == _mode) {
+    v_rec   = _zigzag((int32_t) (V - _v));
+    v_cls   = _prefix_class(v_rec, DELTA_WIDTHS, 1);
+    needed += _prefix_bits(v_cls, DELTA_WIDTHS);
+  }
+  else {
+    v_rec   = V ^ _v;
+    needed += _xor_bits(v_rec, _lead, _trail, &lead, &trail);
+  }
+
+  if (((uint32_t) blk->bits + needed) > SERIES_CODEC_PAYLOAD_BITS) {
+    _open_block(now_ms, V);
+    return;
+  }
+
+  uint16_t pos = blk->bits;
+  _put_prefixed(blk->payload, &pos, DOD, T_CLS, DOD_WIDTHS, 0);
+  if (SeriesCodecMode::QUANT_DELTA == _mode) {
+    _put_prefixed(blk->payload, &pos, v_rec, v_cls, DELTA_WIDTHS, 1);
+  }
+  else if (0 == v_rec) {
+    _put_bits(blk->payload, &pos, 0, 1);
+  }
+  else if ((lead == _lead) && (trail == _trail)) {
+    _put_bits(blk->payload, &pos, 2, 2);
+    _put_bits(blk->payload, &pos, v_rec >> trail, 32 - lead - trail);
+  }
+  else {
+    _put_bits(blk->payload, &pos, 3, 2);
+    _put_bits(blk->payload, &pos, lead, 5);
+    _put_bits(blk->payload, &pos, 31 - lead - trail, 5);   // Length, less one.
+    _put_bits(blk->payload, &pos, v_rec >> trail, 32 - lead - trail);
+    _lead  = lead;
+    _trail = trail;
+  }
+  blk->bits = pos;
+  blk->count++;
+  _samples++;
+  _delta = DELTA;
+  _t     = now_ms;
+  _v     = V;
+}
+
+
+/*
+* Points the cursor at the first sample at or after t_ms. Blocks are found by
+*   binary search, and only the block that holds t_ms is scanned.
+* Returns false if there is no such sample.
+*/
+bool CompressedSeries::seek(uint32_t t_ms, SeriesCursor* cur) {
+  if ((0 == _used) || ((int32_t) (t_ms - _t) > 0)) {
+    return false;
+  }
+  cur->_series = this;
+  const uint32_t ORIGIN = _block(0)->t0;
+  if ((int32_t) (t_ms - ORIGIN) <= 0) {
+    cur->_load(0);    // At or before the start of history.
+    return true;
+  }
+  // Find the last block that starts at or before t_ms.
+  uint16_t lo = 0;
+  uint16_t hi = _used - 1;
+  while (lo < hi) {
+    const uint16_t MID = (uint16_t) ((lo + hi + 1) >> 1);
+    if ((_block(MID)->t0 - ORIGIN) <= (t_ms - ORIGIN)) {
+      lo = MID;
+    }
+    else {
+      hi = MID - 1;
+    }
+  }
+  cur->_load(lo);
+  while (cur->_decode()) {
+    if ((int32_t) (cur->_t - t_ms) >= 0) {
+      cur->_pending = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/*
+* Fills lo[] and hi[] with the envelope of the samples in the last span_ms,
+*   divided evenly in time over cols columns, oldest first. A span of 0 means
+*   all of history. Columns with no samples are NAN.
+* Returns the number of columns written.
+*/
+uint16_t CompressedSeries::envelope(uint32_t span_ms, float* lo, float* hi, uint16_t cols) {
+  if ((0 == _used) || (0 == cols)) {
+    return 0;
+  }
+  const uint32_t END   = _clock();
+  const uint32_t START = ((0 == span_ms) || (span_ms > (END - firstTime()))) ? firstTime() : (END - span_ms);
+  const uint32_t WIDTH = (END - START) / cols + 1;
+  for (uint16_t c = 0; c < cols; c++) {
+    lo[c] = NAN;
+    hi[c] = NAN;
+  }
+  SeriesCursor cur;
+  if (seek(START, &cur)) {
+    uint32_t t;
+    float    v;
+    while (cur.next(&t, &v)) {
+      const uint32_t C = (t - START) / WIDTH;
+      if (C >= cols) break;
+      if (isnan(lo[C])) {
+        lo[C] = v;
+        hi[C] = v;
+      }
+      else {
+        if (v < lo[C]) lo[C] = v;
+        if (v > hi[C]) hi[C] = v;
+      }
+    }
+  }
+  return cols;
+}
+
+
+float CompressedSeries::bitsPerSample() {
+  return (_samples > 0) ? ((bytesUsed() * 8.0f) / _samples) : 0.0f;
+}
+
+
+void CompressedSeries::printDebug(StringBuilder* output, const char* name) {
+  output->concatf(
+    "%-10s %8u samples  %3u/%-3u blocks  %.2f bits/sample",
+    name, _samples, _used, _cap, (double) bitsPerSample()
+  );
+  if (_used > 0) {
+    output->concatf("  %us of history\n", (_t - firstTime()) / 1000);
+  }
+  else {
+    output->concat("\n");
+  }
+}
+
+
+uint32_t CompressedSeries::_encode_value(float v) {
+  if (SeriesCodecMode::QUANT_DELTA == _mode) {
+    float q = roundf(v / _step);
+    if (!(q > -2147483520.0f)) q = -2147483520.0f;   // Also catches NAN.
+    if (q > 2147483520.0f)     q = 2147483520.0f;
+    return (uint32_t) (int32_t) q;
+  }
+  uint32_t bits;
+  memcpy(&bits, &v, 4);
+  return bits;
+}
+
+
+float CompressedSeries::_decode_value(uint32_t v) {
+  if (SeriesCodecMode::QUANT_DELTA == _mode) {
+    return (float) ((int32_t) v) * _step;
+  }
+  float ret;
+  memcpy(&ret, &v, 4);
+  return ret;
+}
+
+
+/*
+* Starts a new block with the given sample as its header. If the ring is
+*   full, the oldest block is dropped.
+*/
+void CompressedSeries::_open_block(uint32_t t, uint32_t v) {
+  if (_used > 0) {
+    if (++_head >= _cap) _head = 0;
+  }
+  if (_used < _cap) {
+    _used++;
+  }
+  else {
+    _samples -= _ring[_head].count;
+  }
+  SeriesBlock* blk = &_ring[_head];
+  blk->t0    = t;
+  blk->v0    = v;
+  blk->count = 1;
+  blk->bits  = 0;
+  _samples++;
+  _t     = t;
+  _delta = 0;
+  _v     = v;
+  _lead  = 0xFF;
+  _trail = 0;
+}
+
+
+
+/*******************************************************************************
+* SeriesCursor
+*******************************************************************************/
+
+/*
+* Returns the next sample, in time order, or false if there are no more.
+*/
+bool SeriesCursor::next(uint32_t* t_ms, float* value) {
+  if (nullptr == _series) {
+    return false;
+  }
+  if (!_pending && !_decode()) {
+    return false;
+  }
+  _pending = false;
+  *t_ms  = _t;
+  *value = _series->_decode_value(_v);
+  return true;
+}
+
+
+void SeriesCursor::_load(uint16_t block) {
+  const SeriesBlock* BLK = _series->_block(block);
+  _block   = block;
+  _left    = BLK->count;
+  _bitpos  = 0;
+  _t       = BLK->t0;
+  _delta   = 0;
+  _v       = BLK->v0;
+  _lead    = 0xFF;
+  _trail   = 0;
+  _pending = false;
+  _started = false;
+}
+
+
+/*
+* Decodes the next sample into _t and _v, moving to the next block as needed.
+*/
+bool SeriesCursor::_decode() {
+  while (0 == _left) {
+    if ((_block + 1) >= _series->_used) {
+      return false;
+    }
+    _load(_block + 1);
+  }
+  _left--;
+  if (!_started) {
+    _started = true;   // The header sample.
+    return true;
+  }
+  const uint8_t* BUF = _series->_block(_block)->payload;
+  _delta += (uint32_t) _unzigzag(_get_prefixed(BUF, &_bitpos, DOD_WIDTHS, 0));
+  _t     += _delta;
+  if (SeriesCodecMode::QUANT_DELTA == _series->_mode) {
+    _v += (uint32_t) _unzigzag(_get_prefixed(BUF, &_bitpos, DELTA_WIDTHS, 1));
+  }
+  else if (_get_bits(BUF, &_bitpos, 1)) {
+    if (_get_bits(BUF, &_bitpos, 1)) {
+      _lead  = (uint8_t) _get_bits(BUF, &_bitpos, 5);
+      _trail = (uint8_t) (31 - _lead - _get_bits(BUF, &_bitpos, 5));
+    }
+    _v ^= _get_bits(BUF, &_bitpos, 32 - _lead - _trail) << _trail;
+  }
+  return true;
+}
+
+
+
+/*******************************************************************************
+* Benchmark
+* Encodes an hour of modeled data for each graphed stream, at its real sample
+*   rate, in both value modes. The ring is smaller than an hour, so the cost
+*   reported is the steady state of a full ring. Then decodes what the ring
+*   holds, and checks it against the model.
+*******************************************************************************/
+
+typedef struct {
+  const char* name;
+  float       rate_hz;
+  float       step;       // For QUANT_DELTA. Roughly the sensor's resolution.
+  float (*model)(uint32_t t_ms);
+} CodecBenchStream;
+
+/* Uniform, -1 to 1. A hash of time, so that a model can be re-read at will. */
+static float _bench_noise(uint32_t t) {
+  uint32_t x = t * 2654435761UL;
+  x ^= x >> 15;
+  x *= 0x2C1B3C6DUL;
+  x ^= x >> 12;
+  return ((float) (x >> 8) / 8388608.0f) - 1.0f;
+}
+
+static float _bench_pressure(uint32_t t) {
+  return 101325.0f + (60.0f * sinf(t / 7200000.0f)) - (t / 1000000.0f) + (1.5f * _bench_noise(t));
+}
+
+static float _bench_humidity(uint32_t t) {
+  return 41.0f + (3.0f * sinf(t / 2700000.0f)) + (0.05f * _bench_noise(t));
+}
+
+static float _bench_air_temp(uint32_t t) {
+  return 23.5f + (1.5f * sinf(t / 5400000.0f)) + (0.02f * _bench_noise(t));
+}
+
+static float _bench_lux(uint32_t t) {
+  const float LEVEL = (0 == ((t / 600000) & 1)) ? 320.0f : 45.0f;   // Lights on and off.
+  return LEVEL * (1.0f + (0.01f * _bench_noise(t)));
+}
+
+static float _bench_uv(uint32_t t) {
+  const float DAY = sinf(t / 1000000.0f);
+  return (DAY > 0.0f) ? ((DAY * 600.0f) + (2.0f * _bench_noise(t))) : 0.0f;
+}
+
+static float _bench_therm_mean(uint32_t t) {
+  return 22.0f + (0.8f * sinf(t / 30000.0f)) + (0.06f * _bench_noise(t));
+}
+
+static const CodecBenchStream BENCH_STREAMS[] = {
+  {"pressure",   5.0f,  0.25f,  _bench_pressure},
+  {"humidity",   5.0f,  0.01f,  _bench_humidity},
+  {"air_temp",   5.0f,  0.01f,  _bench_air_temp},
+  {"visible",    4.0f,  0.1f,   _bench_lux},
+  {"uva",        2.0f,  0.1f,   _bench_uv},
+  {"therm_mean", 10.0f, 0.01f,  _bench_therm_mean}
+};
+
+#define CODEC_BENCH_BLOCKS      64
+#define CODEC_BENCH_RAM_BYTES   (96 * sizeof(float))   // One graph window as floats.
+
+
+static int8_t _bench_one(StringBuilder* output, const CodecBenchStream* s, SeriesCodecMode mode, SeriesClockFxn clock_us) {
+  const uint32_t N        = (uint32_t) (s->rate_hz * 3600.0f);
+  const uint32_t INTERVAL = (uint32_t) (1000.0f / s->rate_hz);
+  CompressedSeries series(nullptr, CODEC_BENCH_BLOCKS, mode, s->step);
+  if (0 != series.init()) {
+    output->concatf("%-10s  no memory\n", s->name);
+    return -1;
+  }
+  uint32_t t  = 0;
+  uint32_t t0 = clock_us();
+  for (uint32_t i = 0; i < N; i++) {
+    t += INTERVAL + ((0 == (i & 7)) ? 1 : 0);   // A little scheduler jitter.
+    series.feed(s->model(t), t);
+  }
+  const uint32_t ENC_US = clock_us() - t0;
+
+  SeriesCursor cur;
+  uint32_t errors  = 0;
+  uint32_t decoded = 0;
+  uint32_t last_t  = 0;
+  float    max_err = 0.0f;
+  uint32_t dt;
+  float    dv;
+  t0 = clock_us();
+  if (series.seek(0, &cur)) {
+    while (cur.next(&dt, &dv)) {
+      if ((decoded > 0) && ((dt - last_t) != INTERVAL) && ((dt - last_t) != (INTERVAL + 1))) {
+        errors++;
+      }
+      const float ERR = fabsf(dv - s->model(dt));
+      if (ERR > max_err) max_err = ERR;
+      last_t = dt;
+      decoded++;
+    }
+  }
+  const uint32_t DEC_US = clock_us() - t0;
+  if ((decoded != series.samples()) || (last_t != t)) errors++;
+  if ((SeriesCodecMode::XOR_FLOAT == mode) && (max_err > 0.0f)) errors++;
+
+  const float BITS  = series.bitsPerSample();
+  const float HOURS = (CODEC_BENCH_RAM_BYTES * 8.0f) / (BITS * s->rate_hz * 3600.0f);
+  output->concatf(
+    "%-10s %-5s %6.2f %8.3f %8.3f %9.3f %10.4f %s\n",
+    s->name, (SeriesCodecMode::QUANT_DELTA == mode) ? "quant" : "xor",
+    (double) BITS, (double) ENC_US / N, (double) DEC_US / (decoded ? decoded : 1), (double) HOURS,
+    (double) max_err, (0 == errors) ? "" : "MISMATCH"
+  );
+  return (0 == errors) ? 0 : -1;
+}
+
+
+/*
+* Prints bits per sample, encode and decode cost, and how many hours of each
+*   stream fit in the RAM of one 96-float graph window.
+* Returns 0 if everything decoded correctly.
+*/
+int8_t series_codec_benchmark(StringBuilder* output, SeriesClockFxn clock_us) {
+  int8_t ret = 0;
+  output->concatf(
+    "Raw floats are 32 bits/sample. Bits include block headers and slack.\n"
+    "Stream     Mode    bits  enc(us)  dec(us)  hrs/%uB    max_err\n",
+    (unsigned) CODEC_BENCH_RAM_BYTES
+  );
+  for (uint8_t i = 0; i < sizeof(BENCH_STREAMS) / sizeof(CodecBenchStream); i++) {
+    if (0 != _bench_one(output, &BENCH_STREAMS[i], SeriesCodecMode::XOR_FLOAT, clock_us)) ret = -1;
+    if (0 != _bench_one(output, &BENCH_STREAMS[i], SeriesCodecMode::QUANT_DELTA, clock_us)) ret = -1;
+  }
+  return ret;
+}
@@ -0,0 +1,146 @@
+/*
+* Compressed storage for long sensor histories.
+*
+* Samples are (time, value) pairs, packed into a ring of fixed-size blocks.
+*   Each block starts with its first sample in the clear. The rest of the
+*   block is a bitstream with one variable-length record per sample:
+*   - Time is coded as the change in the sampling interval (delta-of-delta)
+*       in milliseconds. A steady sample rate costs one bit per sample.
+*   - Value is coded one of two ways:
+*       XOR_FLOAT:    The float is XOR'd against the last one, and only the
+*                       bits that changed are kept. Lossless.
+*       QUANT_DELTA:  The value is rounded to a multiple of a step (which
+*                       should be the sensor's resolution), and the change
+*                       in that integer is kept. A repeat costs one bit.
+*
+* Since every block can be decoded on its own, a time can be found by binary
+*   search over the block headers, followed by a scan of at most one block.
+*   When the ring is full, the oldest block is dropped whole.
+*
+* All times are in milliseconds, and are taken from a clock function supplied
+*   at construction.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __SERIES_CODEC_H_
+#define __SERIES_CODEC_H_
+
+#define SERIES_CODEC_BLOCK_BYTES    128
+#define SERIES_CODEC_HEADER_BYTES    12
+#define SERIES_CODEC_PAYLOAD_BITS   ((SERIES_CODEC_BLOCK_BYTES - SERIES_CODEC_HEADER_BYTES) * 8)
+
+typedef uint32_t (*SeriesClockFxn)();
+
+enum class SeriesCodecMode : uint8_t {
+  XOR_FLOAT   = 0,
+  QUANT_DELTA = 1
+};
+
+class CompressedSeries;
+
+
+/*******************************************************************************
+* One block of samples. The header is the first sample, uncoded.
+*******************************************************************************/
+typedef struct {
+  uint32_t t0;        // Time of the first sample.
+  uint32_t v0;        // First value. Float bits, or the quantized integer.
+  uint16_t count;     // Samples in the block, including the first.
+  uint16_t bits;      // Payload bits used.
+  uint8_t  payload[SERIES_CODEC_BLOCK_BYTES - SERIES_CODEC_HEADER_BYTES];
+} SeriesBlock;
+
+
+/*******************************************************************************
+* Decoder state for walking a series forward in time.
+*******************************************************************************/
+class SeriesCursor {
+  public:
+    bool next(uint32_t* t_ms, float* value);
+
+
+  private:
+    CompressedSeries* _series  = nullptr;
+    uint16_t _block    = 0;     // Logical index. 0 is the oldest block.
+    uint16_t _left     = 0;     // Samples not yet returned from this block.
+    uint16_t _bitpos   = 0;
+    uint32_t _t        = 0;
+    uint32_t _delta    = 0;
+    uint32_t _v        = 0;
+    uint8_t  _lead     = 0;
+    uint8_t  _trail    = 0;
+    bool     _pending  = false;  // _t and _v hold a sample that wasn't returned.
+    bool     _started  = false;  // The first sample of the block was returned.
+
+    void _load(uint16_t block);
+    bool _decode();
+
+    friend class CompressedSeries;
+};
+
+
+/*******************************************************************************
+* A ring of compressed blocks for one stream.
+*******************************************************************************/
+class CompressedSeries {
+  public:
+    CompressedSeries(SeriesClockFxn, uint16_t blocks, SeriesCodecMode mode = SeriesCodecMode::XOR_FLOAT, float step = 0.0f);
+    ~CompressedSeries();
+
+    int8_t   init();
+    void     reset();
+    void     feed(float v);
+    void     feed(float v, uint32_t now_ms);
+    bool     seek(uint32_t t_ms, SeriesCursor*);
+    uint16_t envelope(uint32_t span_ms, float* lo, float* hi, uint16_t cols);
+    void     printDebug(StringBuilder*, const char* name);
+
+    inline bool     initialized() {  return (nullptr != _ring);  };
+    inline uint32_t samples() {      return _samples;           };
+    inline uint16_t blocksUsed() {   return _used;              };
+    inline uint32_t bytesUsed() {    return (uint32_t) _used * SERIES_CODEC_BLOCK_BYTES;  };
+    inline uint32_t firstTime() {    return (_used > 0) ? _block(0)->t0 : 0;  };
+    inline uint32_t lastTime() {     return _t;                 };
+    inline float    last() {         return _decode_value(_v);  };
+
+    /* Average cost of a sample, in bits, counting headers and block slack. */
+    float bitsPerSample();
+
+
+  private:
+    const SeriesClockFxn  _clock;
+    const SeriesCodecMode _mode;
+    const float           _step;
+    SeriesBlock* _ring     = nullptr;
+    uint16_t     _cap      = 0;
+    uint16_t     _head     = 0;     // Physical index of the open block.
+    uint16_t     _used     = 0;
+    uint32_t     _samples  = 0;     // Samples held in the ring.
+
+    /* Encoder state, as of the last sample. */
+    uint32_t _t      = 0;
+    uint32_t _delta  = 0;
+    uint32_t _v      = 0;
+    uint8_t  _lead   = 0xFF;   // Window of the last XOR. 0xFF means none yet.
+    uint8_t  _trail  = 0;
+
+    inline SeriesBlock* _block(uint16_t logical) {
+      uint32_t idx = (uint32_t) _head + _cap - (_used - 1) + logical;
+      while (idx >= _cap) idx -= _cap;
+      return &_ring[idx];
+    };
+
+    uint32_t _encode_value(float v);
+    float    _decode_value(uint32_t v);
+    void     _open_block(uint32_t t, uint32_t v);
+
+    friend class SeriesCursor;
+};
+
+
+int8_t series_codec_benchmark(StringBuilder*, SeriesClockFxn clock_us);
+
+#endif  // __SERIES_CODEC_H_
@@ -16,7 +16,6 @@ local, and you've found our code helpful, please buy us a round!
 Distributed as-is; no warranty is given.
 ******************************************************************************/
 #include "TMP102.h"
-#include <Wire.h>
 
 #define TEMPERATURE_REGISTER 0x00
 #define CONFIG_REGISTER 0x01
@@ -25,15 +24,15 @@ Distributed as-is; no warranty is given.
 
 
 
-TMP102::TMP102(uint8_t addr, uint8_t alrt_pin) : _ADDR(addr), _ALRT_PIN(alrt_pin) {}
+TMP102::TMP102(uint8_t addr, uint8_t alrt_pin) : I2CDevice(addr), _ALRT_PIN(alrt_pin) {}
 
 TMP102::~TMP102() {}
 
 
-int8_t TMP102::init(TwoWire* b) {
+int8_t TMP102::init(I2CBusQueue* b) {
   int8_t ret = _ll_pin_init();
   if (nullptr != b) {
-    _bus = b;
+    _bus_queue = b;
     if (0 == ret) {
       ret = conversionRate(TMP102DataRate::RATE_4_HZ);
       if (0 == ret) {
@@ -51,10 +50,11 @@ int8_t TMP102::init(TwoWire* b) {
 
 
 /*
-* Poll the class for updates.
+* Poll the class for updates. Temperature reads are queued, and reported by a
+*   later call to poll() once they have landed.
 * Returns...
 *   -3 if not initialized and enabled.
-*   -1 if data needed to be read, but doing so failed.
+*   -1 if data needed to be read, but the read couldn't be queued.
 *   0  if nothing needs doing.
 *   1  if data was read and is fresh.
 *   2  An alert is pending.
@@ -63,10 +63,14 @@ int8_t TMP102::poll() {
   int8_t ret = -3;
   if (initialized() && enabled()) {
     ret = 0;
-    if (dataReady()) {
-      _temp = readTemp();
+    if (_tmp_flag(TMP102_FLAG_DATA_FRESH)) {
+      _tmp_clear_flag(TMP102_FLAG_DATA_FRESH);
       ret = 1;  // TODO: need to rework return value.
     }
+    else if (dataReady() && !_temp_op.inFlight()) {
+      ret = (0 == _read_registers_async(&_temp_op, TEMPERATURE_REGISTER, _temp_buf, 2)) ? 0 : -1;
+      _last_read = millis();
+    }
 
     if (255 != _ALRT_PIN) {
       // TODO: Read pin.
@@ -79,35 +83,26 @@ int8_t TMP102::poll() {
 }
 
 
-int8_t TMP102::openPointerRegister(uint8_t pointerReg) {
-  _bus->beginTransmission(_ADDR); // Connect to TMP102
-  _bus->write(pointerReg); // Open specified register
-  return _bus->endTransmission(); // Close communication with TMP102
-}
-
-
-uint8_t TMP102::readRegister(bool registerNumber){
-  uint8_t registerByte[2];  // We'll store the data from the registers here
-  // Read current configuration register value
-  _bus->requestFrom((uint8_t) _ADDR, (uint8_t) 2);   // Read two bytes from TMP102
-  if (_bus->available()) {
-    registerByte[0] = (_bus->read());  // Read first byte
-    registerByte[1] = (_bus->read());  // Read second byte
+/*
+* Called by the bus queue when a temperature read finishes.
+*/
+int8_t TMP102::io_op_callback(I2CBusOp* op) {
+  if (op == &_temp_op) {
+    if (op->complete()) {
+      _temp = _convert_temp(_temp_buf);
+      _tmp_set_flag(TMP102_FLAG_DATA_FRESH);
+      _count_sample();
+    }
+    else {
+      _ptr_reg = -1;   // A failed read leaves the pointer in doubt.
+    }
   }
-  return registerByte[registerNumber];
+  return 0;
 }
 
 
-float TMP102::readTemp() {
-  uint8_t registerByte[2];  // Store the data from the register here
+float TMP102::_convert_temp(uint8_t* registerByte) {
   int16_t digitalTemp;  // Temperature stored in TMP102 register
-  // Read Temperature
-  // Change pointer address to temperature register (0)
-  openPointerRegister(TEMPERATURE_REGISTER);
-  // Read from temperature register
-  registerByte[0] = readRegister(0);
-  registerByte[1] = readRegister(1);
-
   // Bit 0 of second byte will always be 0 in 12-bit readings and 1 in 13-bit
   if(registerByte[1]&0x01) {  // 13 bit mode
     // Combine bytes to create a signed int
@@ -127,15 +122,14 @@ float TMP102::readTemp() {
       digitalTemp |= 0xF000;
     }
   }
-  _last_read = millis();
   // Convert digital reading to analog temperature (1-bit is equal to 0.0625 C)
   return _normalize_units_returned(digitalTemp * 0.0625);
 }
 
 
 uint16_t TMP102::_data_period_ms() {
-  const uint8_t SCALARS[4] = {1, 4, 16, 32};
-  return (((uint16_t) SCALARS[(_flags >> 6) & 3]) * 250);
+  const uint16_t PERIODS[4] = {4000, 1000, 250, 125};
+  return PERIODS[(_flags >> 6) & 3];
 }
 
 
@@ -149,23 +143,15 @@ int8_t TMP102::conversionRate(TMP102DataRate r) {
   uint8_t rate = (uint8_t) r; // Make sure rate is not set higher than 3.
   uint8_t registerByte[2]; // Store the data from the register here
   if (rate < 4) {
-    // Change pointer address to configuration register (0x01)
-    openPointerRegister(CONFIG_REGISTER);
-
     // Read current configuration register value
-    registerByte[0] = readRegister(0);
-    registerByte[1] = readRegister(1);
+    _read_registers(CONFIG_REGISTER, registerByte, 2);
 
     // Load new conversion rate
     registerByte[1] &= 0x3F;  // Clear CR0/1 (bit 6 and 7 of second byte)
     registerByte[1] |= rate << 6;  // Shift in new conversion rate
 
     // Set configuration registers
-    _bus->beginTransmission(_ADDR);
-    _bus->write(CONFIG_REGISTER);   // Point to configuration register
-    _bus->write(registerByte[0]);  // Write first byte
-    _bus->write(registerByte[1]);  // Write second byte
-    ret = _bus->endTransmission();      // Close communication with TMP102
+    ret = _write_registers(CONFIG_REGISTER, registerByte, 2);
     if (0 == ret) {
       _tmp_clear_flag(TMP102_FLAG_DATA_RATE_MASK);
       _tmp_set_flag((uint16_t)(rate << 6));
@@ -179,23 +165,15 @@ int8_t TMP102::extendedMode(bool mode) {
   int8_t ret = -1;
   uint8_t registerByte[2]; // Store the data from the register here
 
-  // Change pointer address to configuration register (0x01)
-  openPointerRegister(CONFIG_REGISTER);
-
   // Read current configuration register value
-  registerByte[0] = readRegister(0);
-  registerByte[1] = readRegister(1);
+  _read_registers(CONFIG_REGISTER, registerByte, 2);
 
   // Load new value for extention mode
   registerByte[1] &= 0xEF;    // Clear EM (bit 4 of second byte)
   registerByte[1] |= mode<<4;  // Shift in new exentended mode bit
 
   // Set configuration registers
-  _bus->beginTransmission(_ADDR);
-  _bus->write(CONFIG_REGISTER);    // Point to configuration register
-  _bus->write(registerByte[0]);    // Write first byte
-  _bus->write(registerByte[1]);    // Write second byte
-  ret = _bus->endTransmission();   // Close communication with TMP102
+  ret = _write_registers(CONFIG_REGISTER, registerByte, 2);
   if (0 == ret) {
     _tmp_set_flag(TMP102_FLAG_EXTENDED_MODE, mode);
   }
@@ -207,11 +185,8 @@ int8_t TMP102::enabled(bool x) {
   int8_t ret = -1;
   uint8_t registerByte; // Store the data from the register here
 
-  // Change pointer address to configuration register (0x01)
-  openPointerRegister(CONFIG_REGISTER);
-
   // Read current configuration register value
-  registerByte = readRegister(0);
+  _read_registers(CONFIG_REGISTER, &registerByte, 1);
 
   if (x) {
     registerByte &= 0xFE;  // Clear SD (bit 0 of first byte)
@@ -221,10 +196,7 @@ int8_t TMP102::enabled(bool x) {
   }
 
   // Set configuration register
-  _bus->beginTransmission(_ADDR);
-  _bus->write(CONFIG_REGISTER);  // Point to configuration register
-  _bus->write(registerByte);     // Write first byte
-  ret = _bus->endTransmission();       // Close communication with TMP102
+  ret = _write_registers(CONFIG_REGISTER, &registerByte, 1);
   if (0 == ret) {
     _tmp_set_flag(TMP102_FLAG_ENABLED, x);
   }
@@ -236,21 +208,15 @@ int8_t TMP102::alertPolarity(bool polarity) {
   int8_t ret = -1;
   uint8_t registerByte; // Store the data from the register here
 
-  // Change pointer address to configuration register (1)
-  openPointerRegister(CONFIG_REGISTER);
-
   // Read current configuration register value
-  registerByte = readRegister(0);
+  _read_registers(CONFIG_REGISTER, &registerByte, 1);
 
   // Load new value for polarity
   registerByte &= 0xFB; // Clear POL (bit 2 of registerByte)
   registerByte |= polarity<<2;  // Shift in new POL bit
 
   // Set configuration register
-  _bus->beginTransmission(_ADDR);
-  _bus->write(CONFIG_REGISTER);  // Point to configuration register
-  _bus->write(registerByte);      // Write first byte
-  ret = _bus->endTransmission();       // Close communication with TMP102
+  ret = _write_registers(CONFIG_REGISTER, &registerByte, 1);
   if (0 == ret) {
     _tmp_set_flag(TMP102_FLAG_ALRT_ACTIVE_HIGH, polarity);
   }
@@ -260,10 +226,9 @@ int8_t TMP102::alertPolarity(bool polarity) {
 
 bool TMP102::alert() {
   uint8_t registerByte; // Store the data from the register here
-  // Change pointer address to configuration register (1)
-  openPointerRegister(CONFIG_REGISTER);
-  registerByte = readRegister(1);   // Read current configuration register value
-  registerByte &= 0x20;  // Clear everything but the alert bit (bit 5)
+  uint8_t cfg[2] = {0, 0};
+  _read_registers(CONFIG_REGISTER, cfg, 2);   // Read current configuration register value
+  registerByte = cfg[1] & 0x20;  // Clear everything but the alert bit (bit 5)
   return registerByte>>5;
 }
 
@@ -286,11 +251,7 @@ int8_t TMP102::setLowTemp(float degrees) {
   }
 
   // Write to T_LOW Register
-  _bus->beginTransmission(_ADDR);
-  _bus->write(T_LOW_REGISTER);   // Point to T_LOW
-  _bus->write(registerByte[0]);  // Write first byte
-  _bus->write(registerByte[1]);  // Write second byte
-  ret = _bus->endTransmission();      // Close communication with TMP102
+  ret = _write_registers(T_LOW_REGISTER, registerByte, 2);
   return ret;
 }
 
@@ -312,11 +273,7 @@ int8_t TMP102::setHighTemp(float degrees) {
   }
 
   // Write to T_HIGH Register
-  _bus->beginTransmission(_ADDR);
-  _bus->write(T_HIGH_REGISTER);      // Point to T_HIGH register
-  _bus->write(registerByte[0]);      // Write first byte
-  _bus->write(registerByte[1]);      // Write second byte
-  ret = _bus->endTransmission();    // Close communication with TMP102
+  ret = _write_registers(T_HIGH_REGISTER, registerByte, 2);
   return ret;
 }
 
@@ -325,9 +282,7 @@ float TMP102::readLowTemp() {
   uint8_t registerByte[2];  // Store the data from the register here
   int16_t digitalTemp;    // Store the digital temperature value here
 
-  openPointerRegister(T_LOW_REGISTER);
-  registerByte[0] = readRegister(0);
-  registerByte[1] = readRegister(1);
+  _read_registers(T_LOW_REGISTER, registerByte, 2);
 
   if (extendedMode()) {  // 13 bit mode
     // Combine bytes to create a signed int
@@ -356,9 +311,7 @@ float TMP102::readHighTemp() {
   uint8_t registerByte[2];  // Store the data from the register here
   int16_t digitalTemp;    // Store the digital temperature value here
 
-  openPointerRegister(T_HIGH_REGISTER);
-  registerByte[0] = readRegister(0);
-  registerByte[1] = readRegister(1);
+  _read_registers(T_HIGH_REGISTER, registerByte, 2);
 
   if (extendedMode()) { // 13 bit mode
     // Combine bytes to create a signed int
@@ -387,21 +340,15 @@ int8_t TMP102::setFault(uint8_t faultSetting) {
   int8_t ret = -1;
   uint8_t registerByte; // Store the data from the register here
   faultSetting = faultSetting&3; // Make sure rate is not set higher than 3.
-  // Change pointer address to configuration register (0x01)
-  openPointerRegister(CONFIG_REGISTER);
-
   // Read current configuration register value
-  registerByte = readRegister(0);
+  _read_registers(CONFIG_REGISTER, &registerByte, 1);
 
   // Load new conversion rate
   registerByte &= 0xE7;  // Clear F0/1 (bit 3 and 4 of first byte)
   registerByte |= faultSetting<<3;  // Shift new fault setting
 
-  // Set configuration registers
-  _bus->beginTransmission(_ADDR);
-  _bus->write(CONFIG_REGISTER);   // Point to configuration register
-  _bus->write(registerByte);     // Write byte to register
-  ret = _bus->endTransmission();       // Close communication with TMP102
+  // Set configuration register
+  ret = _write_registers(CONFIG_REGISTER, &registerByte, 1);
   return ret;
 }
 
@@ -410,21 +357,15 @@ int8_t TMP102::setAlertMode(bool mode) {
   int8_t ret = -1;
   uint8_t registerByte; // Store the data from the register here
 
-  // Change pointer address to configuration register (1)
-  openPointerRegister(CONFIG_REGISTER);
-
   // Read current configuration register value
-  registerByte = readRegister(0);
+  _read_registers(CONFIG_REGISTER, &registerByte, 1);
 
   // Load new conversion rate
   registerByte &= 0xFD;  // Clear old TM bit (bit 1 of first byte)
   registerByte |= mode<<1;  // Shift in new TM bit
 
-  // Set configuration registers
-  _bus->beginTransmission(_ADDR);
-  _bus->write(CONFIG_REGISTER);   // Point to configuration register
-  _bus->write(registerByte);     // Write byte to register
-  ret = _bus->endTransmission();       // Close communication with TMP102
+  // Set configuration register
+  ret = _write_registers(CONFIG_REGISTER, &registerByte, 1);
   return ret;
 }
 
@@ -456,6 +397,42 @@ float TMP102::_normalize_units_returned(float temperature) {
 }
 
 
+/*
+* Register access. The part keeps its pointer register between transactions,
+*   so once it points at the temperature register, each sample is a bare
+*   2-byte read. Anything that moves the pointer is tracked here.
+*/
+int8_t TMP102::_write_registers(uint8_t reg, uint8_t* buf, uint8_t len) {
+  _pointer_moved(reg);
+  return _bus_write(reg, buf, len);
+}
+
+
+int8_t TMP102::_read_registers(uint8_t reg, uint8_t* buf, uint8_t len) {
+  _pointer_moved(reg);
+  return _bus_read(reg, buf, len);
+}
+
+
+int8_t TMP102::_read_registers_async(I2CBusOp* op, uint8_t reg, uint8_t* buf, uint8_t len) {
+  const int16_t sub_addr = (reg == _ptr_reg) ? -1 : reg;
+  _ptr_reg = reg;
+  return _bus_read_async(op, sub_addr, buf, len);
+}
+
+
+/*
+* Blocking access jumps ahead of anything queued. If a queued read was
+*   counting on the pointer staying put, give it back its register address.
+*/
+void TMP102::_pointer_moved(uint8_t reg) {
+  if (_temp_op.inFlight() && (_temp_op.sub_addr < 0)) {
+    _temp_op.sub_addr = _ptr_reg;
+  }
+  _ptr_reg = reg;
+}
+
+
 /*
 * Idempotently setup the low-level pin details.
 */
@@ -16,7 +16,7 @@ local, and you've found our code helpful, please buy us a round!
 Distributed as-is; no warranty is given.
 ******************************************************************************/
 #include <Arduino.h>
-#include <Wire.h>
+#include "I2CBusQueue.h"
 
 #ifndef __TMP102_DRIVER_H_
 #define __TMP102_DRIVER_H_
@@ -30,6 +30,7 @@ Distributed as-is; no warranty is given.
 #define TMP102_FLAG_FREEDOM_UNITS    0x0020  // Units in Fahrenheit if true. Celcius if not.
 #define TMP102_FLAG_DATA_RATE_MASK   0x00C0  // Hold 2-bit rate setting.
 #define TMP102_FLAG_ALRT_ACTIVE_HIGH 0x0100  // Alert pin is active high.
+#define TMP102_FLAG_DATA_FRESH       0x0200  // Data arrived that poll() hasn't reported.
 
 enum class TMP102DataRate : uint8_t {
   RATE_0_25_HZ  = 0x00,    // 0 - 0.25 Hz
@@ -40,14 +41,17 @@ enum class TMP102DataRate : uint8_t {
 
 
 
-class TMP102 {
+class TMP102 : public I2CDevice {
   public:
     TMP102(uint8_t addr, uint8_t alert_pin);
     ~TMP102();
 
-    int8_t init(TwoWire* bus = &Wire);
+    int8_t init(I2CBusQueue*);
     int8_t poll();
 
+    /* Overrides from I2CDevice. */
+    int8_t io_op_callback(I2CBusOp*);
+
     inline bool  devFound() {         return _tmp_flag(TMP102_FLAG_DEVICE_PRESENT);  };
     inline bool  enabled() {          return _tmp_flag(TMP102_FLAG_ENABLED);         };
     inline bool  initialized() {      return _tmp_flag(TMP102_FLAG_INITIALIZED);     };
@@ -93,20 +97,21 @@ class TMP102 {
 
 
   private:
-    const uint8_t _ADDR;        // 0x48, 0x49, 0x4A, 0x4B
     const uint8_t _ALRT_PIN;
     uint16_t      _flags     = 0;
-    TwoWire*      _bus       = nullptr;
     uint32_t      _last_read = 0;
     float         _temp      = 0.0;
+    I2CBusOp      _temp_op;
+    uint8_t       _temp_buf[2];
+    int16_t       _ptr_reg   = -1;   // Pointer register, if known.
 
-    int8_t  openPointerRegister(uint8_t pointerReg); // Changes the pointer register
-    uint8_t readRegister(bool registerNumber);  // reads 1 byte of from register
-    float   readTemp();        // Returns the temperature in selected units.
+    float    _convert_temp(uint8_t*);  // Returns the temperature in selected units.
 
     int8_t   _ll_pin_init();
-    int8_t   _write_register(uint8_t reg, uint8_t val);
-    int8_t   _read_registers(uint8_t reg, uint8_t len);
+    int8_t   _write_registers(uint8_t reg, uint8_t* buf, uint8_t len);
+    int8_t   _read_registers(uint8_t reg, uint8_t* buf, uint8_t len);
+    int8_t   _read_registers_async(I2CBusOp*, uint8_t reg, uint8_t* buf, uint8_t len);
+    void     _pointer_moved(uint8_t reg);
     float    _normalize_units_accepted(float deg);
     float    _normalize_units_returned(float deg);
     uint16_t _data_period_ms();
@@ -44,6 +44,7 @@
 /**************************************************************************/
 
 #include "TSL2561.h"
+#include "IRQEventQueue.h"
 
 /*******************************************************************************
 * Internal constants
@@ -128,13 +129,16 @@
 volatile static bool tsl_irq_fired = false;
 
 /* ISR */
-void tsl_isr_fxn() {   tsl_irq_fired = true;   }
+void tsl_isr_fxn() {
+  tsl_irq_fired = true;
+  irq_queue.push(IRQSource::TSL2561, micros());
+}
 
 
 /*
 * Constructor
 */
-TSL2561::TSL2561(uint8_t a, uint8_t _i_pin) : _IRQ_PIN(_i_pin), _ADDR(a) {}
+TSL2561::TSL2561(uint8_t a, uint8_t _i_pin) : I2CDevice(a), _IRQ_PIN(_i_pin) {}
 
 
 /*
@@ -149,15 +153,15 @@ TSL2561::~TSL2561() {}
 *         gain. Then powers down the chip.
 * @returns 0 if sensor is found and initialized, negative otherwise.
 */
-int8_t TSL2561::init(TwoWire* b) {
+int8_t TSL2561::init(I2CBusQueue* b) {
   int8_t ret = -1;
   _ll_pin_init();
   _tsl_clear_flag(TSL2561_FLAG_INITIALIZED);
   if (nullptr != b) {
-    _i2c = b;
+    _bus_queue = b;
     /* Make sure we're actually connected */
-    uint8_t x = _read8(TSL2561_REGISTER_ID);
-    if (x & 0x05) { // ID code for TSL2561
+    uint8_t x = _read8(0x80 | TSL2561_REGISTER_ID);
+    if (0x10 != (x & 0xB0)) { // PARTNO is 0001 (CS) or 0101 (T/FN/CL) for TSL2561.
       ret = -2;
     }
     else {
@@ -173,15 +177,20 @@ int8_t TSL2561::init(TwoWire* b) {
 
 
 /*
-* Poll the class for updates.
+* Poll the class for updates. Channel reads are queued, and the lux calculation
+*   is done by a later call to poll() once they have landed.
 */
 int8_t TSL2561::poll() {
   int8_t ret = -3;
   if (initialized() && enabled()) {
     ret = 0;
-    if (255 != _IRQ_PIN) {
+    if (_tsl_flag(TSL2561_FLAG_DATA_FRESH)) {
+      _tsl_clear_flag(TSL2561_FLAG_DATA_FRESH);
+      ret = (0 <= calculateLux()) ? 1 : -1;
+    }
+    else if (255 != _IRQ_PIN) {
       if (tsl_irq_fired) {
-        ret = (0 <= calculateLux()) ? 1 : -1;
+        ret = (0 == getLuminosity()) ? 0 : -1;
         tsl_irq_fired = !digitalRead(_IRQ_PIN);
       }
     }
@@ -193,7 +202,7 @@ int8_t TSL2561::poll() {
         case TSLIntegrationTime::MS_101:   r_interval -= 301;  // No break
         case TSLIntegrationTime::MS_402:
           if ((now - _last_read) >= r_interval) {
-            ret = (0 <= calculateLux()) ? 1 :-1;
+            ret = (0 == getLuminosity()) ? 0 : -1;
           }
           break;
         case TSLIntegrationTime::INVALID:
@@ -206,6 +215,18 @@ int8_t TSL2561::poll() {
 }
 
 
+/*
+* Called by the bus queue as each channel arrives. The queue is FIFO, so
+*   channel 1 finishing means both have.
+*/
+int8_t TSL2561::io_op_callback(I2CBusOp* op) {
+  if ((op == &_data_ops[1]) && _data_ops[0].complete() && _data_ops[1].complete()) {
+    _process_data_registers();
+  }
+  return 0;
+}
+
+
 /*!
 * @brief      Sets the integration time for the TSL2561. Higher time means
 *             more light captured (better for low light conditions) but will
@@ -250,93 +271,73 @@ void TSL2561::highGain(bool x) {
 
 
 /*!
-* @brief  Gets the broadband (mixed lighting) and IR only values from
-*         the TSL2561, adjusting gain if auto-gain is enabled
-* @param  broadband Pointer to a uint16_t we will fill with a sensor
-*                   reading from the IR+visible light diode.
-* @param  ir Pointer to a uint16_t we will fill with a sensor the
-*            IR-only light diode.
+* @brief  Queues a read of the broadband (mixed lighting) and IR only values
+*         from the TSL2561. Gain is adjusted when they arrive, if auto-gain
+*         is enabled.
+* @returns 0 if the read was queued, negative otherwise.
 */
 int8_t TSL2561::getLuminosity() {
   int8_t ret = -1;
-  bool valid = false;
-  if (initialized()) {
-    /* If Auto gain disabled get a single reading and continue */
-    if (!autogain()) {
-      _read_data_registers(&_broadband, &_infrared);
-      ret = 0;
-    }
-    else {
-      /* Read data until we find a valid range */
-      bool _agcCheck = false;
-      do {
-        uint16_t _b, _ir;
-        uint16_t _hi, _lo;
-
-        /* Get the hi/low threshold for the current integration time */
-        switch(integrationTime()) {
-          case TSLIntegrationTime::MS_13:
-            _hi = TSL2561_AGC_THI_13MS;
-            _lo = TSL2561_AGC_TLO_13MS;
-            break;
-          case TSLIntegrationTime::MS_101:
-            _hi = TSL2561_AGC_THI_101MS;
-            _lo = TSL2561_AGC_TLO_101MS;
-            break;
-          case TSLIntegrationTime::MS_402:
-            _hi = TSL2561_AGC_THI_402MS;
-            _lo = TSL2561_AGC_TLO_402MS;
-            break;
-          default:
-            ret = -2;
-            return ret;
-        }
-
-        _read_data_registers(&_b, &_ir);
-
-        /* Run an auto-gain check if we haven't already done so ... */
-        if (!_agcCheck) {
-          if ((_b < _lo) && (!highGain())) {
-            /* Increase the gain and try again */
-            highGain(true);
-            /* Drop the previous conversion results */
-            _read_data_registers(&_b, &_ir);
-            /* Set a flag to indicate we've adjusted the gain */
-            _agcCheck = true;
-          }
-          else if ((_b > _hi) && highGain()) {
-            /* Drop gain to 1x and try again */
-            highGain(false);
-            /* Drop the previous conversion results */
-            _read_data_registers(&_b, &_ir);
-            /* Set a flag to indicate we've adjusted the gain */
-            _agcCheck = true;
-          }
-          else {
-            /* Nothing to look at here, keep moving ....
-            Reading is either valid, or we're already at the chips limits */
-            _broadband = _b;
-            _infrared = _ir;
-            ret = 0;
-            valid = true;
-          }
-        }
-        else {
-          /* If we've already adjusted the gain once, just return the new results.
-          This avoids endless loops where a value is at one extreme pre-gain,
-          and the the other extreme post-gain */
-          _broadband = _b;
-          _infrared = _ir;
-          ret = 0;
-          valid = true;
-        }
-      } while (!valid);
+  if (initialized() && !_data_ops[0].inFlight() && !_data_ops[1].inFlight()) {
+    /* Channel 0 is visible + infrared. Channel 1 is infrared. */
+    ret = _bus_read_async(&_data_ops[0], 0x80 | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN0_LOW, &_data_buf[0], 2);
+    if (0 == ret) {
+      ret = _bus_read_async(&_data_ops[1], 0x80 | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN1_LOW, &_data_buf[2], 2);
     }
+    _last_read = millis();
   }
   return ret;
 }
 
 
+/*
+* Both channels have arrived. If auto-gain is enabled and the reading is out of
+*   range, the gain is changed and the reading is dropped, since the next
+*   integration period is the first to use the new gain. A reading taken right
+*   after a gain change is always accepted. This avoids endless loops where a
+*   value is at one extreme pre-gain, and the the other extreme post-gain.
+*/
+void TSL2561::_process_data_registers() {
+  uint16_t _b  = ((uint16_t) _data_buf[1] << 8) | _data_buf[0];
+  uint16_t _ir = ((uint16_t) _data_buf[3] << 8) | _data_buf[2];
+  if (autogain() && !_tsl_flag(TSL2561_FLAG_AGC_ADJUSTED)) {
+    uint16_t _hi, _lo;
+    /* Get the hi/low threshold for the current integration time */
+    switch (integrationTime()) {
+      case TSLIntegrationTime::MS_13:
+        _hi = TSL2561_AGC_THI_13MS;
+        _lo = TSL2561_AGC_TLO_13MS;
+        break;
+      case TSLIntegrationTime::MS_101:
+        _hi = TSL2561_AGC_THI_101MS;
+        _lo = TSL2561_AGC_TLO_101MS;
+        break;
+      case TSLIntegrationTime::MS_402:
+        _hi = TSL2561_AGC_THI_402MS;
+        _lo = TSL2561_AGC_TLO_402MS;
+        break;
+      default:
+        return;
+    }
+    if ((_b < _lo) && (!highGain())) {
+      highGain(true);     // Increase the gain and try again.
+      _tsl_set_flag(TSL2561_FLAG_AGC_ADJUSTED);
+      return;
+    }
+    else if ((_b > _hi) && highGain()) {
+      highGain(false);    // Drop gain to 1x and try again.
+      _tsl_set_flag(TSL2561_FLAG_AGC_ADJUSTED);
+      return;
+    }
+  }
+  _tsl_clear_flag(TSL2561_FLAG_AGC_ADJUSTED);
+  _broadband = _b;
+  _infrared  = _ir;
+  _tsl_set_flag(TSL2561_FLAG_DATA_FRESH);
+  _count_sample();
+}
+
+
 /**
 * Enable the device by setting the control bit to 0x03
 */
@@ -360,13 +361,12 @@ int8_t TSL2561::disable() {
 
 
 /*!
-* @brief  Converts the raw sensor values to the standard SI lux equivalent.
-* @param  broadband The 16-bit sensor reading from the IR+visible light diode.
-* @param  ir The 16-bit sensor reading from the IR-only light diode.
+* @brief  Converts the most recent raw sensor values to the standard SI lux
+*         equivalent. Does no I/O.
 * @returns negative on error, 0 on nominal return, or 1 on saturation.
 */
 int8_t TSL2561::calculateLux() {
-  int8_t ret = getLuminosity();
+  int8_t ret = initialized() ? 0 : -1;
   uint16_t clipThreshold;
   unsigned long chScale;
   if (0 <= ret) {
@@ -469,10 +469,7 @@ int8_t TSL2561::_ll_pin_init() {
 * @param  value The 8-bit value we're writing to the register
 */
 void TSL2561::_write8 (uint8_t reg, uint8_t value) {
-  _i2c->beginTransmission(_ADDR);
-  _i2c->write(reg);
-  _i2c->write(value);
-  _i2c->endTransmission();
+  _bus_write8(reg, value);
 }
 
 
@@ -482,41 +479,7 @@ void TSL2561::_write8 (uint8_t reg, uint8_t value) {
 * @returns 8-bit value containing single byte data read
 */
 uint8_t TSL2561::_read8(uint8_t reg) {
-  _i2c->beginTransmission(_ADDR);
-  _i2c->write(reg);
-  _i2c->endTransmission();
-  _i2c->requestFrom((int) _ADDR, 1);
-  return _i2c-> read();
-}
-
-
-/*!
-* @brief  Reads a 16 bit values over I2C
-* @param  reg I2C register to read from
-* @returns 16-bit value containing 2-byte data read
-*/
-uint16_t TSL2561::_read16(uint8_t reg) {
-  uint16_t x, t;
-  _i2c->beginTransmission(_ADDR);
-  _i2c->write(reg);
-  _i2c->endTransmission();
-  _i2c->requestFrom((int) _ADDR, 2);
-  t = _i2c->read();
-  x = _i2c->read();
-  x <<= 8;
-  x |= t;
+  uint8_t x = 0;
+  _bus_read(reg, &x, 1);
   return x;
 }
-
-
-/**
-* Read luminosity on both channels.
-*/
-void TSL2561::_read_data_registers(uint16_t* bb, uint16_t* ir) {
-  /* Reads a two byte value from channel 0 (visible + infrared) */
-  *bb = _read16(0x80 | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN0_LOW);
-
-  /* Reads a two byte value from channel 1 (infrared) */
-  *ir = _read16(0x80 | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN1_LOW);
-  _last_read = millis();
-}
@@ -24,7 +24,7 @@
  */
 
 #include <Arduino.h>
-#include <Wire.h>
+#include "I2CBusQueue.h"
 
 #ifndef __TSL2561_DRIVER_H_
 #define __TSL2561_DRIVER_H_
@@ -37,6 +37,8 @@
 #define TSL2561_FLAG_AUTOGAIN         0x0010  // Class will adjust hardware gain automatically.
 #define TSL2561_FLAG_GAIN_16X         0x0020  // Is the low-light setting on?
 #define TSL2561_FLAG_INTEGRATION_MASK 0x00C0  // Integration time mask.
+#define TSL2561_FLAG_DATA_FRESH       0x0100  // Data arrived that poll() hasn't reported.
+#define TSL2561_FLAG_AGC_ADJUSTED     0x0200  // Autogain changed the gain on the last read.
 
 /* I2C address options */
 #define TSL2561_ADDR_LOW          (0x29)    ///< Default address (pin pulled low)
@@ -77,13 +79,17 @@ enum class TSLIntegrationTime : uint8_t {
 /*******************************************************************************
 * Class definition
 *******************************************************************************/
-class TSL2561 {
+class TSL2561 : public I2CDevice {
   public:
     TSL2561(uint8_t addr, uint8_t irq_pin = 255);
     ~TSL2561();
 
-    int8_t init(TwoWire*);
+    int8_t init(I2CBusQueue*);
     int8_t poll();
+
+    /* Overrides from I2CDevice. */
+    int8_t io_op_callback(I2CBusOp*);
+
     int8_t enable();
     int8_t disable();
 
@@ -108,19 +114,18 @@ class TSL2561 {
 
   private:
     const uint8_t _IRQ_PIN;
-    const uint8_t _ADDR;
     uint16_t _flags     = 0;
     uint16_t _broadband = 0;
     uint16_t _infrared  = 0;
     uint32_t _lux       = 0;
     uint32_t _last_read = 0;
-    TwoWire* _i2c       = nullptr;
+    I2CBusOp _data_ops[2];   // Channel 0, channel 1.
+    uint8_t  _data_buf[4];
 
-    void     _read_data_registers(uint16_t *broadband, uint16_t *ir);
+    void     _process_data_registers();
     int8_t   _ll_pin_init();
     void     _write8(uint8_t reg, uint8_t value);
     uint8_t  _read8(uint8_t reg);
-    uint16_t _read16(uint8_t reg);
 
     /* Flag manipulation inlines */
     inline uint16_t _tsl_flags() {                return _flags;           };
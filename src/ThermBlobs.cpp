@@ -0,0 +1,344 @@
+/*
+* Hot-spot detection and tracking on the 8x8 thermopile frame.
+* See the header file for the rules.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "ThermBlobs.h"
+
+#define THERM_BLOB_PENDING   0xFF   // Foreground, not yet labeled.
+#define THERM_BLOB_UNCOUNTED 0xFE   // Foreground, in a blob past THERM_BLOB_MAX_BLOBS.
+
+
+ThermBlobTracker::ThermBlobTracker(ThermClockFxn clock_us) : _clock_us(clock_us) {
+  reset();
+}
+
+
+/*
+* Forgets the background and all tracks. The next frame becomes the background.
+*/
+void ThermBlobTracker::reset() {
+  _bg_valid    = false;
+  _blob_count  = 0;
+  _track_count = 0;
+  memset(_labels, 0, sizeof(_labels));
+}
+
+
+/*
+* Runs one frame through every stage. Call once per frame, in C.
+*/
+void ThermBlobTracker::process(const float* pixels) {
+  const uint32_t T0 = _clock_us();
+  if (!_bg_valid) {
+    memcpy(_bg, pixels, sizeof(_bg));
+    _bg_valid = true;
+  }
+  _label(pixels);
+  for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+    const float ALPHA = (0 == _labels[i]) ? THERM_BLOB_BG_ALPHA : THERM_BLOB_FG_ALPHA;
+    _bg[i] += (pixels[i] - _bg[i]) * ALPHA;
+  }
+  _track();
+
+  _stat_us_last = _clock_us() - T0;
+  _stat_us_sum += _stat_us_last;
+  if (_stat_us_last > _stat_us_max) _stat_us_max = _stat_us_last;
+  _stat_frames++;
+}
+
+
+const ThermTrack* ThermBlobTracker::primary() {
+  const ThermTrack* ret = nullptr;
+  for (uint8_t i = 0; i < _track_count; i++) {
+    if (0 == _tracks[i].misses) {
+      if ((nullptr == ret) || (_tracks[i].blob.peak > ret->blob.peak)) {
+        ret = &_tracks[i];
+      }
+    }
+  }
+  return ret;
+}
+
+
+void ThermBlobTracker::resetStats() {
+  _stat_frames  = 0;
+  _stat_dropped = 0;
+  _stat_us_last = 0;
+  _stat_us_max  = 0;
+  _stat_us_sum  = 0;
+}
+
+
+void ThermBlobTracker::printDebug(StringBuilder* output) {
+  output->concatf("Thermal blobs (%.2f C over background)\n", (double) _threshold);
+  output->concatf("\tFrames:     %u (%u blobs over the limit)\n", _stat_frames, _stat_dropped);
+  if (_stat_frames > 0) {
+    output->concatf(
+      "\tTime:       %u us last, %u / %u us mean/max\n",
+      _stat_us_last, (uint32_t) (_stat_us_sum / _stat_frames), _stat_us_max
+    );
+  }
+  output->concatf("\tBlobs:      %u in the last frame, %u tracks\n", _blob_count, _track_count);
+  for (uint8_t i = 0; i < _track_count; i++) {
+    const ThermTrack* T = &_tracks[i];
+    output->concatf(
+      "\t  #%-5u (%.2f, %.2f)  %2u px  peak %.2f C  mean %.2f C  age %u%s\n",
+      T->id, (double) T->blob.x, (double) T->blob.y, T->blob.pixels,
+      (double) T->blob.peak, (double) T->blob.mean, T->age,
+      (T->misses > 0) ? "  (coasting)" : ""
+    );
+  }
+}
+
+
+
+/*******************************************************************************
+* Internals
+*******************************************************************************/
+
+/*
+* Thresholds the frame against the background, and labels and measures the
+*   blobs in it. Each pixel is pushed onto the fill stack at most once, so the
+*   stack never needs to be bigger than the frame.
+*/
+void ThermBlobTracker::_label(const float* pixels) {
+  for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+    _labels[i] = ((pixels[i] - _bg[i]) > _threshold) ? THERM_BLOB_PENDING : 0;
+  }
+  _blob_count = 0;
+  for (uint8_t seed = 0; seed < THERM_FRAME_PIXELS; seed++) {
+    if (THERM_BLOB_PENDING != _labels[seed]) {
+      continue;
+    }
+    const bool    COUNTED = (_blob_count < THERM_BLOB_MAX_BLOBS);
+    const uint8_t LABEL   = COUNTED ? (_blob_count + 1) : THERM_BLOB_UNCOUNTED;
+    uint8_t stack[THERM_FRAME_PIXELS];
+    uint8_t depth = 0;
+    float   sum_w = 0.0f;
+    float   sum_x = 0.0f;
+    float   sum_y = 0.0f;
+    float   sum_t = 0.0f;
+    uint8_t count = 0;
+    uint8_t peak  = seed;
+    stack[depth++] = seed;
+    _labels[seed]  = LABEL;
+    while (depth > 0) {
+      const uint8_t P  = stack[--depth];
+      const int8_t  PX = P & 0x07;
+      const int8_t  PY = P >> 3;
+      const float   W  = pixels[P] - _bg[P];
+      sum_w += W;
+      sum_x += W * PX;
+      sum_y += W * PY;
+      sum_t += pixels[P];
+      count++;
+      if (pixels[P] > pixels[peak]) peak = P;
+      for (int8_t dy = -1; dy <= 1; dy++) {
+        for (int8_t dx = -1; dx <= 1; dx++) {
+          const int8_t NX = PX + dx;
+          const int8_t NY = PY + dy;
+          if ((NX < 0) || (NX > 7) || (NY < 0) || (NY > 7)) {
+            continue;
+          }
+          const uint8_t N = (NY << 3) | NX;
+          if (THERM_BLOB_PENDING == _labels[N]) {
+            _labels[N] = LABEL;
+            stack[depth++] = N;
+          }
+        }
+      }
+    }
+    if (COUNTED) {
+      ThermBlob* b = &_blobs[_blob_count++];
+      b->x        = sum_x / sum_w;
+      b->y        = sum_y / sum_w;
+      b->peak     = pixels[peak];
+      b->mean     = sum_t / count;
+      b->pixels   = count;
+      b->peak_idx = peak;
+    }
+    else {
+      _stat_dropped++;
+    }
+  }
+}
+
+
+/*
+* Matches this frame's blobs to the tracks, closest pair first, and then
+*   retires tracks that have coasted too long and starts tracks for blobs that
+*   matched nothing.
+*/
+void ThermBlobTracker::_track() {
+  const float GATE_SQ = THERM_BLOB_GATE * THERM_BLOB_GATE;
+  bool blob_used[THERM_BLOB_MAX_BLOBS]  = {false};
+  bool track_hit[THERM_BLOB_MAX_BLOBS]  = {false};
+  while (true) {
+    float   best   = GATE_SQ;
+    uint8_t best_b = THERM_BLOB_MAX_BLOBS;
+    uint8_t best_t = THERM_BLOB_MAX_BLOBS;
+    for (uint8_t t = 0; t < _track_count; t++) {
+      if (track_hit[t]) continue;
+      for (uint8_t b = 0; b < _blob_count; b++) {
+        if (blob_used[b]) continue;
+        const float DX = _blobs[b].x - _tracks[t].blob.x;
+        const float DY = _blobs[b].y - _tracks[t].blob.y;
+        const float D_SQ = (DX * DX) + (DY * DY);
+        if (D_SQ <= best) {
+          best   = D_SQ;
+          best_b = b;
+          best_t = t;
+        }
+      }
+    }
+    if (THERM_BLOB_MAX_BLOBS == best_b) {
+      break;
+    }
+    blob_used[best_b] = true;
+    track_hit[best_t] = true;
+    _tracks[best_t].blob   = _blobs[best_b];
+    _tracks[best_t].misses = 0;
+  }
+
+  // Age the tracks, and drop the ones that have been gone too long.
+  uint8_t kept = 0;
+  for (uint8_t t = 0; t < _track_count; t++) {
+    ThermTrack* tr = &_tracks[t];
+    if (!track_hit[t]) {
+      tr->misses++;
+    }
+    if (tr->age < 0xFFFF) tr->age++;
+    if (tr->misses <= THERM_BLOB_MAX_MISSES) {
+      if (kept != t) {
+        _tracks[kept] = *tr;
+      }
+      kept++;
+    }
+  }
+  _track_count = kept;
+
+  for (uint8_t b = 0; b < _blob_count; b++) {
+    if (!blob_used[b] && (_track_count < THERM_BLOB_MAX_BLOBS)) {
+      ThermTrack* tr = &_tracks[_track_count++];
+      tr->blob   = _blobs[b];
+      tr->id     = _next_id++;
+      tr->age    = 0;
+      tr->misses = 0;
+      if (0 == _next_id) _next_id = 1;
+    }
+  }
+}
+
+
+
+/*******************************************************************************
+* Benchmark
+*******************************************************************************/
+
+#define THERM_BLOB_BENCH_FRAMES    600
+#define THERM_BLOB_BENCH_SETTLE     20   // Frames of empty room first.
+#define THERM_BLOB_BUDGET_US    100000   // One frame at 10FPS.
+
+/* Back and forth across [lo, hi], at speed pixels per frame. */
+static float _blob_bench_sweep(uint16_t f, float lo, float hi, float speed) {
+  const float SPAN  = hi - lo;
+  float d = fmodf(f * speed, 2.0f * SPAN);
+  return lo + ((d > SPAN) ? ((2.0f * SPAN) - d) : d);
+}
+
+
+/*
+* An empty room at 22C, with sensor noise. After it has settled, two warm
+*   bodies walk across it on separate rows, in opposite directions.
+*/
+static void _blob_bench_frame(float* pixels, uint32_t* seed, uint16_t f, float* bodies) {
+  for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+    *seed = (*seed * 1664525) + 1013904223;
+    pixels[i] = 22.0f + ((int8_t) (*seed >> 24)) * (0.25f / 128.0f);
+  }
+  if (f < THERM_BLOB_BENCH_SETTLE) {
+    return;
+  }
+  const uint16_t F = f - THERM_BLOB_BENCH_SETTLE;
+  bodies[0] = _blob_bench_sweep(F, 0.5f, 6.5f, 0.15f);
+  bodies[1] = 1.5f;
+  bodies[2] = 6.5f - _blob_bench_sweep(F, 0.0f, 6.0f, 0.2f);
+  bodies[3] = 5.5f;
+  for (uint8_t n = 0; n < 2; n++) {
+    for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+      const float DX = (i & 0x07) - bodies[n * 2];
+      const float DY = (i >> 3) - bodies[(n * 2) + 1];
+      pixels[i] += 6.0f * expf(-((DX * DX) + (DY * DY)) / (2.0f * 0.64f));
+    }
+  }
+}
+
+
+/*
+* Runs the tracker over a synthetic scene, and checks that it found both bodies,
+*   kept the same ID on each for the whole run, and put them where they were.
+* Returns 0 if it did, or -1 if it didn't.
+*/
+int8_t therm_blob_benchmark(StringBuilder* output, ThermClockFxn clock_us) {
+  ThermBlobTracker tracker(clock_us);
+  float    pixels[THERM_FRAME_PIXELS];
+  float    bodies[4]  = {0.0f, 0.0f, 0.0f, 0.0f};
+  uint32_t seed       = 1;
+  uint16_t ids[2]     = {0, 0};
+  uint32_t id_changes = 0;
+  uint32_t missing    = 0;
+  float    pos_err    = 0.0f;
+  float    pos_sum    = 0.0f;
+  uint32_t pos_count  = 0;
+  uint32_t false_pos  = 0;
+
+  for (uint16_t f = 0; f < THERM_BLOB_BENCH_FRAMES; f++) {
+    _blob_bench_frame(pixels, &seed, f, bodies);
+    tracker.process(pixels);
+    if (f < THERM_BLOB_BENCH_SETTLE) {
+      false_pos += tracker.blobs();
+      continue;
+    }
+    for (uint8_t n = 0; n < 2; n++) {
+      const ThermTrack* best = nullptr;
+      float best_d = THERM_BLOB_GATE;
+      for (uint8_t t = 0; t < tracker.trackCount(); t++) {
+        const ThermTrack* T = tracker.track(t);
+        const float D = hypotf(T->blob.x - bodies[n * 2], T->blob.y - bodies[(n * 2) + 1]);
+        if ((0 == T->misses) && (D < best_d)) {
+          best   = T;
+          best_d = D;
+        }
+      }
+      if (nullptr == best) {
+        missing++;
+        continue;
+      }
+      if ((0 != ids[n]) && (ids[n] != best->id)) id_changes++;
+      ids[n]   = best->id;
+      pos_err  = fmaxf(pos_err, best_d);
+      pos_sum += best_d;
+      pos_count++;
+    }
+  }
+
+  const bool PASS = (0 == false_pos) && (0 == missing) && (0 == id_changes) && (pos_err < 0.5f);
+  output->concatf("Thermal blob tracking, %u frames\n", THERM_BLOB_BENCH_FRAMES);
+  output->concatf("\tBlobs in empty room: %u\n", false_pos);
+  output->concatf("\tBodies missed:       %u\n", missing);
+  output->concatf("\tID changes:          %u\n", id_changes);
+  output->concatf(
+    "\tCentroid error:      %.3f px mean, %.3f px max\n",
+    (double) ((pos_count > 0) ? (pos_sum / pos_count) : 0.0f), (double) pos_err
+  );
+  tracker.printDebug(output);
+  output->concatf(
+    "\tWorst frame is %.4f%% of a 10FPS frame.\n",
+    (double) (100.0f * tracker.worstUs() / THERM_BLOB_BUDGET_US)
+  );
+  output->concatf("\t%s\n", PASS ? "Passed." : "FAILED.");
+  return PASS ? 0 : -1;
+}
@@ -0,0 +1,108 @@
+/*
+* Hot-spot detection and tracking on the 8x8 thermopile frame.
+*
+* Each frame goes through these stages, in one call to process():
+*   - Background: every pixel keeps a running average of itself. Pixels that
+*     are background follow it at THERM_BLOB_BG_ALPHA per frame. Pixels that
+*     are foreground follow it far more slowly (THERM_BLOB_FG_ALPHA), so that
+*     something warm that stays put is still seen for a long while, but is
+*     absorbed in the end.
+*   - Foreground: a pixel is foreground if it is warmer than its background
+*     by more than the threshold.
+*   - Labeling: foreground pixels are grouped into blobs by 8-connectivity,
+*     with a flood fill on a fixed stack.
+*   - Measurement: each blob gets a centroid (weighted by how far each pixel
+*     is above its background, so it lands between pixels), its peak and mean
+*     temperatures, and its size.
+*   - Tracking: blobs are matched to the tracks of the last frame, nearest
+*     first, within THERM_BLOB_GATE pixels. A blob with no match starts a new
+*     track with a new ID. A track with no blob coasts for up to
+*     THERM_BLOB_MAX_MISSES frames before it is dropped.
+*
+* Coordinates are in pixels of the frame as displayed (after rotation), from
+*   the center of the top-left pixel. Temperatures are in C.
+*
+* Everything is in fixed arrays. Nothing allocates, and the work per frame is
+*   bounded by the size of the frame and THERM_BLOB_MAX_BLOBS.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+#include "ThermFrame.h"
+
+#ifndef __THERM_BLOBS_H_
+#define __THERM_BLOBS_H_
+
+#define THERM_BLOB_MAX_BLOBS      8      // Blobs per frame, and live tracks.
+#define THERM_BLOB_THRESHOLD   1.5f      // C above background.
+#define THERM_BLOB_BG_ALPHA   0.0625f    // 1/16
+#define THERM_BLOB_FG_ALPHA  0.000244f   // About 1/4096. Ten minutes or so, at 10FPS.
+#define THERM_BLOB_GATE        2.0f      // Pixels a track can move in a frame.
+#define THERM_BLOB_MAX_MISSES     3      // Frames a track can coast.
+
+/* One blob in one frame. */
+typedef struct {
+  float   x;          // Centroid
+  float   y;
+  float   peak;       // C
+  float   mean;       // C
+  uint8_t pixels;
+  uint8_t peak_idx;
+} ThermBlob;
+
+/* A blob followed from frame to frame. */
+typedef struct {
+  ThermBlob blob;     // As last seen.
+  uint16_t  id;       // Never 0 for a live track.
+  uint16_t  age;      // Frames since it was first seen.
+  uint8_t   misses;   // Frames since it was last seen. 0 if it is in this one.
+} ThermTrack;
+
+
+class ThermBlobTracker {
+  public:
+    ThermBlobTracker(ThermClockFxn clock_us);
+
+    void    process(const float* pixels);
+    void    reset();
+
+    inline uint8_t blobs() {       return _blob_count;    };   // In the last frame.
+    inline uint8_t trackCount() {  return _track_count;   };   // Including coasting ones.
+    inline const ThermTrack* track(uint8_t i) {  return (i < _track_count) ? &_tracks[i] : nullptr;  };
+    const ThermTrack* primary();   // The hottest track seen in the last frame.
+
+    inline void  threshold(float c) {  _threshold = c;      };
+    inline float threshold() {         return _threshold;   };
+    inline bool  foreground(uint8_t i) {  return (i < THERM_FRAME_PIXELS) && (0 != _labels[i]);  };
+
+    inline uint32_t worstUs() {   return _stat_us_max;   };
+    void resetStats();
+    void printDebug(StringBuilder*);
+
+
+  private:
+    ThermClockFxn _clock_us;
+    float      _threshold   = THERM_BLOB_THRESHOLD;
+    bool       _bg_valid    = false;
+    uint8_t    _blob_count  = 0;
+    uint8_t    _track_count = 0;
+    uint16_t   _next_id     = 1;
+    float      _bg[THERM_FRAME_PIXELS];
+    uint8_t    _labels[THERM_FRAME_PIXELS];   // 0 for background. Otherwise, blob index + 1.
+    ThermBlob  _blobs[THERM_BLOB_MAX_BLOBS];
+    ThermTrack _tracks[THERM_BLOB_MAX_BLOBS];
+    uint32_t   _stat_frames  = 0;
+    uint32_t   _stat_dropped = 0;   // Blobs past THERM_BLOB_MAX_BLOBS.
+    uint32_t   _stat_us_last = 0;
+    uint32_t   _stat_us_max  = 0;
+    uint64_t   _stat_us_sum  = 0;
+
+    void _label(const float* pixels);
+    void _track();
+};
+
+
+int8_t therm_blob_benchmark(StringBuilder*, ThermClockFxn clock_us);
+
+#endif  // __THERM_BLOBS_H_
@@ -0,0 +1,228 @@
+/*
+* Processing for the 8x8 thermopile frame.
+* See the header file for the rules.
+*/
+
+#include <math.h>
+#include "ThermFrame.h"
+
+#define THERM_BENCH_FRAMES   1000
+#define THERM_FRAME_BUDGET_US  100000   // One frame at 10FPS.
+
+
+/* Sensor is rotated 90-deg. */
+const uint8_t THERM_ROTATION[THERM_FRAME_PIXELS] = {
+   7, 15, 23, 31, 39, 47, 55, 63,
+   6, 14, 22, 30, 38, 46, 54, 62,
+   5, 13, 21, 29, 37, 45, 53, 61,
+   4, 12, 20, 28, 36, 44, 52, 60,
+   3, 11, 19, 27, 35, 43, 51, 59,
+   2, 10, 18, 26, 34, 42, 50, 58,
+   1,  9, 17, 25, 33, 41, 49, 57,
+   0,  8, 16, 24, 32, 40, 48, 56
+};
+
+
+/*
+* The driver treats the pixel registers as 12-bit sign-magnitude. This
+*   matches it, so that both paths give the same numbers.
+*/
+static inline int32_t _therm_decode(int16_t r) {
+  return (r & 0x0800) ? -(int32_t) (r & ~0x0800) : (int32_t) r;
+}
+
+
+/*
+* Rotates and converts a raw frame into pixels (in C), and fills in its stats.
+*/
+void therm_frame_process(const int16_t* raw, float* pixels, ThermFrameStats* stats) {
+  int32_t  sum    = 0;
+  uint32_t sum_sq = 0;
+  int32_t  lo     = INT32_MAX;
+  int32_t  hi     = INT32_MIN;
+  uint8_t  lo_idx = 0;
+  uint8_t  hi_idx = 0;
+  for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+    const int32_t V = _therm_decode(raw[THERM_ROTATION[i]]);
+    pixels[i] = V * THERM_RAW_TO_C;
+    sum    += V;
+    sum_sq += (uint32_t) (V * V);
+    if (V < lo) {  lo = V;  lo_idx = i;  }
+    if (V > hi) {  hi = V;  hi_idx = i;  }
+  }
+  // N^2 * variance, exactly.
+  const int64_t N2_VAR = ((int64_t) sum_sq * THERM_FRAME_PIXELS) - ((int64_t) sum * sum);
+  stats->min     = lo * THERM_RAW_TO_C;
+  stats->max     = hi * THERM_RAW_TO_C;
+  stats->mean    = sum * (THERM_RAW_TO_C / THERM_FRAME_PIXELS);
+  stats->stdev   = sqrtf((float) N2_VAR) * (THERM_RAW_TO_C / THERM_FRAME_PIXELS);
+  stats->min_idx = lo_idx;
+  stats->max_idx = hi_idx;
+}
+
+
+/*
+* Stats for a frame that is already in C, by Welford's method.
+*/
+void therm_frame_stats(const float* pixels, ThermFrameStats* stats) {
+  float   mean   = 0.0f;
+  float   m2     = 0.0f;
+  uint8_t lo_idx = 0;
+  uint8_t hi_idx = 0;
+  for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+    const float V     = pixels[i];
+    const float DELTA = V - mean;
+    mean += DELTA / (i + 1);
+    m2   += DELTA * (V - mean);
+    if (V < pixels[lo_idx]) lo_idx = i;
+    if (V > pixels[hi_idx]) hi_idx = i;
+  }
+  stats->min     = pixels[lo_idx];
+  stats->max     = pixels[hi_idx];
+  stats->mean    = mean;
+  stats->stdev   = sqrtf(m2 / THERM_FRAME_PIXELS);
+  stats->min_idx = lo_idx;
+  stats->max_idx = hi_idx;
+}
+
+
+
+/*******************************************************************************
+* Benchmark
+*******************************************************************************/
+
+static volatile bool  _therm_fahrenheit = false;   // Keeps the unit branch real.
+static volatile float _therm_sink       = 0.0f;
+
+/* As GridEYE::getPixelTemperature() does it, out of line. */
+static float __attribute__((noinline)) _therm_ref_pixel(const int16_t* raw, uint8_t pixel) {
+  const int16_t R = (pixel < 64) ? raw[pixel] : 0;
+  int16_t temperature = R;
+  if (temperature & (1 << 11)) {
+    temperature &= ~(1 << 11);
+    temperature = temperature * -1;
+  }
+  float deg = temperature * 0.25;
+  if (_therm_fahrenheit) {
+    deg = deg * 1.8 + 32;
+  }
+  return deg;
+}
+
+
+/* The way read_thermopile_sensor() used to work. */
+static void _therm_ref_process(const int16_t* raw, float* pixels, ThermFrameStats* stats) {
+  for (uint8_t i = 0; i < 8; i++) {
+    for (uint8_t n = 0; n < 8; n++) {
+      uint8_t pix_idx = (7 - n) | (i << 3);
+      uint8_t arr_idx = (n << 3) | (i);
+      pixels[arr_idx] = _therm_ref_pixel(raw, pix_idx);
+    }
+  }
+  float  field_min = pixels[0];
+  float  field_max = pixels[0];
+  double field_sum = 0.0;
+  for (uint8_t i = 0; i < 64; i++) {
+    field_min = (pixels[i] < field_min) ? pixels[i] : field_min;
+    field_max = (pixels[i] > field_max) ? pixels[i] : field_max;
+    field_sum += pixels[i];
+  }
+  const float FIELD_MEAN = field_sum / 64.0;
+  double deviation_sum = 0.0;
+  for (uint8_t i = 0; i < 64; i++) {
+    deviation_sum += (pixels[i] - FIELD_MEAN) * (pixels[i] - FIELD_MEAN);
+  }
+  stats->min   = field_min;
+  stats->max   = field_max;
+  stats->mean  = FIELD_MEAN;
+  stats->stdev = (float) sqrt(deviation_sum / 64);
+}
+
+
+/*
+* A room at about 22C, with a warm body in it that moves, and now and then a
+*   pixel below zero. Raw registers, as the sensor would give them.
+*/
+static void _therm_synth_frame(int16_t* raw, uint32_t* seed, uint16_t frame) {
+  for (uint8_t i = 0; i < 64; i++) {
+    *seed = (*seed * 1664525) + 1013904223;
+    int16_t v = 88 + (int16_t) ((*seed >> 24) & 0x0F);
+    const uint8_t BODY = (frame >> 2) & 0x3F;
+    if ((i == BODY) || (i == ((BODY + 1) & 0x3F)) || (i == ((BODY + 8) & 0x3F))) {
+      v = 140 + (int16_t) ((*seed >> 20) & 0x07);
+    }
+    if (0 == ((*seed >> 8) & 0xFF)) {
+      v = 0x0800 | 8;   // -2C
+    }
+    raw[i] = v;
+  }
+}
+
+
+/*
+* Checks the one-pass path against the old one over synthetic frames, and
+*   times both.
+* Returns 0 if they agreed, or -1 if they didn't.
+*/
+int8_t therm_frame_benchmark(StringBuilder* output, ThermClockFxn clock_us) {
+  int16_t raw[THERM_FRAME_PIXELS];
+  float   ref_px[THERM_FRAME_PIXELS];
+  float   new_px[THERM_FRAME_PIXELS];
+  ThermFrameStats ref_st;
+  ThermFrameStats new_st;
+  ThermFrameStats flt_st;
+  uint32_t seed     = 1;
+  float    px_err   = 0.0f;
+  float    st_err   = 0.0f;
+  float    flt_err  = 0.0f;
+  uint32_t peak_err = 0;
+
+  for (uint16_t f = 0; f < THERM_BENCH_FRAMES; f++) {
+    _therm_synth_frame(raw, &seed, f);
+    _therm_ref_process(raw, ref_px, &ref_st);
+    therm_frame_process(raw, new_px, &new_st);
+    therm_frame_stats(new_px, &flt_st);
+    for (uint8_t i = 0; i < THERM_FRAME_PIXELS; i++) {
+      px_err = fmaxf(px_err, fabsf(ref_px[i] - new_px[i]));
+    }
+    st_err = fmaxf(st_err, fabsf(ref_st.min - new_st.min));
+    st_err = fmaxf(st_err, fabsf(ref_st.max - new_st.max));
+    st_err = fmaxf(st_err, fabsf(ref_st.mean - new_st.mean));
+    st_err = fmaxf(st_err, fabsf(ref_st.stdev - new_st.stdev));
+    flt_err = fmaxf(flt_err, fabsf(flt_st.mean - new_st.mean));
+    flt_err = fmaxf(flt_err, fabsf(flt_st.stdev - new_st.stdev));
+    if ((new_px[new_st.min_idx] != new_st.min) || (new_px[new_st.max_idx] != new_st.max)) {
+      peak_err++;
+    }
+  }
+
+  // Timing, over the same frame, so that only the processing differs.
+  uint32_t t0 = clock_us();
+  for (uint16_t f = 0; f < THERM_BENCH_FRAMES; f++) {
+    _therm_ref_process(raw, ref_px, &ref_st);
+    _therm_sink = ref_st.stdev;
+  }
+  const uint32_t REF_US = clock_us() - t0;
+  t0 = clock_us();
+  for (uint16_t f = 0; f < THERM_BENCH_FRAMES; f++) {
+    therm_frame_process(raw, new_px, &new_st);
+    _therm_sink = new_st.stdev;
+  }
+  const uint32_t NEW_US = clock_us() - t0;
+
+  const float REF_FRAME_US = (float) REF_US / THERM_BENCH_FRAMES;
+  const float NEW_FRAME_US = (float) NEW_US / THERM_BENCH_FRAMES;
+  const bool  PASS = (0.0f == px_err) && (st_err < 0.001f) && (flt_err < 0.001f) && (0 == peak_err);
+  output->concatf("Thermopile frame processing, %u frames\n", THERM_BENCH_FRAMES);
+  output->concatf("\tPixel error:   %.6f C\n", (double) px_err);
+  output->concatf("\tStats error:   %.6f C (float path %.6f C)\n", (double) st_err, (double) flt_err);
+  output->concatf("\tPeak misses:   %u\n", peak_err);
+  output->concatf("\tOld path:      %8.2f us/frame\n", (double) REF_FRAME_US);
+  output->concatf(
+    "\tOne pass:      %8.2f us/frame  (%.1fx, %.4f%% of a 10FPS frame)\n",
+    (double) NEW_FRAME_US, (NEW_US > 0) ? ((double) REF_US / NEW_US) : 0.0,
+    (double) (100.0f * NEW_FRAME_US / THERM_FRAME_BUDGET_US)
+  );
+  output->concatf("\t%s\n", PASS ? "Agreed." : "DISAGREED.");
+  return PASS ? 0 : -1;
+}
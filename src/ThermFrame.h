@@ -0,0 +1,51 @@
+/*
+* Processing for the 8x8 thermopile frame.
+*
+* The GridEYE leaves its frame as 64 raw registers, in quarter degrees C,
+*   with the sensor mounted 90 degrees off from the display. The frame is
+*   processed in one pass over those raw values:
+*   - Rotation is a lookup in THERM_ROTATION, which gives the sensor pixel
+*     for each pixel of the frame as displayed.
+*   - Sum, sum of squares, and min/max (with where they were) are kept in
+*     integers. At most 64 values of 11 bits each, so the sum of squares fits
+*     in 32 bits, and the variance is exact.
+*   - Floats only come in at the end: once per pixel for the output frame,
+*     and once for each of the stats.
+* Everything here is in Celsius, regardless of the driver's units flag.
+*
+* Replayed frames arrive as floats, and have a single-pass float form.
+*
+* therm_frame_benchmark() runs this against the way it was done before (a
+*   driver call per pixel, then a second pass in double for the deviation),
+*   checks that they agree, and times both.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+
+#ifndef __THERM_FRAME_H_
+#define __THERM_FRAME_H_
+
+#define THERM_FRAME_PIXELS   64
+#define THERM_RAW_TO_C       0.25f     // Degrees C per LSB of a pixel.
+
+typedef uint32_t (*ThermClockFxn)();
+
+typedef struct {
+  float   min;       // C
+  float   max;       // C
+  float   mean;      // C
+  float   stdev;     // C
+  uint8_t min_idx;   // Where min and max are, in the rotated frame.
+  uint8_t max_idx;
+} ThermFrameStats;
+
+/* Sensor pixel for each pixel of the displayed frame. */
+extern const uint8_t THERM_ROTATION[THERM_FRAME_PIXELS];
+
+void   therm_frame_process(const int16_t* raw, float* pixels, ThermFrameStats*);
+void   therm_frame_stats(const float* pixels, ThermFrameStats*);
+int8_t therm_frame_benchmark(StringBuilder*, ThermClockFxn clock_us);
+
+#endif  // __THERM_FRAME_H_
@@ -0,0 +1,169 @@
+/*
+* Color palettes for thermal images.
+* See the header file for the rules.
+*/
+
+#include <math.h>
+#include "ThermPalette.h"
+
+/* A key color, and where it falls in the table. */
+typedef struct {
+  uint8_t pos;
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+} ThermPaletteKey;
+
+static const ThermPaletteKey _keys_ironbow[] = {
+  {   0,   0,   0,   0 },
+  {  48,  40,   0, 150 },
+  {  96, 150,   0, 150 },
+  { 150, 230,  60,  20 },
+  { 200, 255, 170,   0 },
+  { 240, 255, 240,  80 },
+  { 255, 255, 255, 255 }
+};
+
+static const ThermPaletteKey _keys_grayscale[] = {
+  {   0,   0,   0,   0 },
+  { 255, 255, 255, 255 }
+};
+
+static const ThermPaletteKey _keys_rainbow[] = {
+  {   0,   0,   0, 128 },
+  {  32,   0,   0, 255 },
+  {  96,   0, 255, 255 },
+  { 128,   0, 255,   0 },
+  { 160, 255, 255,   0 },
+  { 224, 255,   0,   0 },
+  { 255, 255, 255, 255 }
+};
+
+static const ThermPaletteKey _keys_classic[] = {
+  {   0,   0,   0, 255 },
+  { 128,   0,   0,   0 },
+  { 255, 255,   0,   0 }
+};
+
+
+ThermPalette::ThermPalette(ThermPaletteID id) {
+  if (0 != setPalette(id)) {
+    setPalette(ThermPaletteID::IRONBOW);
+  }
+  _set_range(0.0f, THERM_PALETTE_MIN_SPAN);
+}
+
+
+/*
+* Builds the table for the given palette, by linear interpolation between its
+*   key colors.
+* Returns 0 on success, or -1 if there is no such palette.
+*/
+int8_t ThermPalette::setPalette(ThermPaletteID id) {
+  const ThermPaletteKey* keys = nullptr;
+  uint8_t count = 0;
+  switch (id) {
+    case ThermPaletteID::IRONBOW:
+      keys  = _keys_ironbow;
+      count = sizeof(_keys_ironbow) / sizeof(ThermPaletteKey);
+      break;
+    case ThermPaletteID::GRAYSCALE:
+      keys  = _keys_grayscale;
+      count = sizeof(_keys_grayscale) / sizeof(ThermPaletteKey);
+      break;
+    case ThermPaletteID::RAINBOW:
+      keys  = _keys_rainbow;
+      count = sizeof(_keys_rainbow) / sizeof(ThermPaletteKey);
+      break;
+    case ThermPaletteID::CLASSIC:
+      keys  = _keys_classic;
+      count = sizeof(_keys_classic) / sizeof(ThermPaletteKey);
+      break;
+    default:
+      return -1;
+  }
+  uint8_t k = 0;
+  for (uint16_t i = 0; i < THERM_PALETTE_SIZE; i++) {
+    while ((k < (count - 2)) && (i > keys[k + 1].pos)) {
+      k++;
+    }
+    const ThermPaletteKey* A = &keys[k];
+    const ThermPaletteKey* B = &keys[k + 1];
+    const int32_t SPAN = B->pos - A->pos;
+    const int32_t F    = (int32_t) i - A->pos;
+    const uint8_t RED  = A->r + (((B->r - A->r) * F) / SPAN);
+    const uint8_t GRN  = A->g + (((B->g - A->g) * F) / SPAN);
+    const uint8_t BLU  = A->b + (((B->b - A->b) * F) / SPAN);
+    _lut[i] = ((uint16_t) (RED & 0xF8) << 8) | ((uint16_t) (GRN & 0xFC) << 3) | (BLU >> 3);
+  }
+  _id = id;
+  return 0;
+}
+
+
+/*
+* Moves the range toward a frame's min and max. Call once per frame.
+*/
+void ThermPalette::autoRange(float frame_min, float frame_max) {
+  float lo = _lo;
+  float hi = _hi;
+  if (!_ranged) {
+    lo = frame_min;
+    hi = frame_max;
+  }
+  else {
+    // Widen at once. Narrow slowly, and only past the dead band.
+    if (frame_min < lo) {
+      lo = frame_min;
+    }
+    else if ((frame_min - lo) > THERM_PALETTE_HYSTERESIS) {
+      lo += (frame_min - lo) * THERM_PALETTE_SMOOTHING;
+    }
+    if (frame_max > hi) {
+      hi = frame_max;
+    }
+    else if ((hi - frame_max) > THERM_PALETTE_HYSTERESIS) {
+      hi -= (hi - frame_max) * THERM_PALETTE_SMOOTHING;
+    }
+  }
+  if ((hi - lo) < THERM_PALETTE_MIN_SPAN) {
+    // Grow about the middle.
+    const float MID = (hi + lo) * 0.5f;
+    lo = MID - (THERM_PALETTE_MIN_SPAN * 0.5f);
+    hi = MID + (THERM_PALETTE_MIN_SPAN * 0.5f);
+  }
+  _set_range(lo, hi);
+  _ranged = true;
+}
+
+
+const char* ThermPalette::paletteStr(ThermPaletteID id) {
+  switch (id) {
+    case ThermPaletteID::IRONBOW:    return "IRONBOW";
+    case ThermPaletteID::GRAYSCALE:  return "GRAYSCALE";
+    case ThermPaletteID::RAINBOW:    return "RAINBOW";
+    case ThermPaletteID::CLASSIC:    return "CLASSIC";
+    default:                         break;
+  }
+  return "INVALID";
+}
+
+
+
+/*******************************************************************************
+* Internals
+*******************************************************************************/
+
+/*
+* Works out the fixed-point offset and scale for a range.
+*/
+void ThermPalette::_set_range(float t_min, float t_max) {
+  _lo     = t_min;
+  _hi     = t_max;
+  _lo_q   = lroundf(t_min * THERM_PALETTE_Q);
+  _span_q = lroundf(t_max * THERM_PALETTE_Q) - _lo_q;
+  if (_span_q < 1) {
+    _span_q = 1;
+  }
+  _scale  = ((int32_t) (THERM_PALETTE_SIZE - 1) << 16) / _span_q;
+}
@@ -0,0 +1,78 @@
+/*
+* Color palettes for thermal images, and the temperature range they span.
+*
+* A palette is a 256-entry RGB565 table, built from a handful of key colors
+*   when the palette is chosen. Coloring a pixel is then a subtract, a
+*   multiply, and a lookup, all in integers:
+*   index = (t - range_min) * 255 / (range_max - range_min)
+*   ...with t in the same fixed point as the upscaler (1/16 C), and the
+*   division folded into a Q16 scale that is worked out once per range.
+*
+* The range is auto-ranged with hysteresis, rather than snapped to each
+*   frame's min and max:
+*   - It widens at once, so that nothing in a frame is ever out of range.
+*   - It narrows only once the frame has moved in by more than
+*     THERM_PALETTE_HYSTERESIS, and then only a fraction of the way per frame.
+*   - It never gets narrower than THERM_PALETTE_MIN_SPAN, so that a uniform
+*     scene shows as uniform, rather than as sensor noise at full contrast.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#ifndef __THERM_PALETTE_H_
+#define __THERM_PALETTE_H_
+
+#define THERM_PALETTE_SIZE        256
+#define THERM_PALETTE_Q            16     // Fixed-point units per degree C.
+#define THERM_PALETTE_MIN_SPAN   2.0f     // C
+#define THERM_PALETTE_HYSTERESIS 0.5f     // C
+#define THERM_PALETTE_SMOOTHING  0.1f     // Fraction of the way to narrow, per frame.
+
+enum class ThermPaletteID : uint8_t {
+  IRONBOW   = 0,
+  GRAYSCALE = 1,
+  RAINBOW   = 2,
+  CLASSIC   = 3,   // Blue below the middle, red above. As the tricorder always was.
+  INVALID   = 4
+};
+
+
+class ThermPalette {
+  public:
+    ThermPalette(ThermPaletteID id = ThermPaletteID::IRONBOW);
+
+    int8_t setPalette(ThermPaletteID);
+    void   autoRange(float frame_min, float frame_max);
+
+    inline ThermPaletteID  palette() {    return _id;        };
+    inline float           rangeMin() {   return _lo;        };
+    inline float           rangeMax() {   return _hi;        };
+    inline const uint16_t* table() {      return _lut;       };
+
+    /* t is in 1/THERM_PALETTE_Q C. */
+    inline uint8_t index(int32_t t) {
+      const int32_t D = t - _lo_q;
+      if (D <= 0)       return 0;
+      if (D >= _span_q) return (THERM_PALETTE_SIZE - 1);
+      return (uint8_t) ((D * _scale) >> 16);
+    };
+    inline uint16_t color(int32_t t) {    return _lut[index(t)];   };
+
+    static const char* paletteStr(ThermPaletteID);
+
+
+  private:
+    ThermPaletteID _id     = ThermPaletteID::INVALID;
+    bool     _ranged = false;    // Has the range ever been set?
+    float    _lo     = 0.0f;     // C
+    float    _hi     = 0.0f;     // C
+    int32_t  _lo_q   = 0;
+    int32_t  _span_q = 1;
+    int32_t  _scale  = 0;        // Q16 index per fixed-point unit.
+    uint16_t _lut[THERM_PALETTE_SIZE];
+
+    void _set_range(float t_min, float t_max);
+};
+
+#endif  // __THERM_PALETTE_H_
@@ -0,0 +1,227 @@
+/*
+* Bilinear upscaling of the 8x8 thermopile frame.
+* See the header file for the rules.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "ThermUpscaler.h"
+
+#if defined(THERM_UPSCALER_DSP)
+  #include <arm_acle.h>
+#endif
+
+#define THERM_UPSCALER_BENCH_FRAMES   200
+#define THERM_UPSCALER_BUDGET_US    100000   // One frame at 10FPS.
+
+
+ThermUpscaler::ThermUpscaler(uint8_t size) {
+  if (0 != setSize(size)) {
+    setSize(32);
+  }
+}
+
+
+/*
+* Sets the output size, and works out the sample positions and weights for it.
+* Returns 0 on success, or -1 if the size isn't a multiple of 8 between 8 and
+*   THERM_UPSCALER_MAX_SIZE.
+*/
+int8_t ThermUpscaler::setSize(uint8_t size) {
+  if ((size < 8) || (size > THERM_UPSCALER_MAX_SIZE) || (size & 0x07)) {
+    return -1;
+  }
+  for (uint8_t i = 0; i < size; i++) {
+    // Center of output pixel i, in source pixels (Q8), less half a pixel.
+    int32_t pos = ((((int32_t) i * 2) + 1) * 1024 / size) - 128;
+    if (pos < 0) pos = 0;
+    uint8_t  idx = pos >> 8;
+    uint16_t w   = pos & 0xFF;
+    if (idx >= 7) {
+      idx = 6;
+      w   = 256;
+    }
+    _idx[i] = idx;
+    _wts[i] = ((uint32_t) w << 16) | (uint32_t) (256 - w);
+  }
+  _size = size;
+  return 0;
+}
+
+
+/*
+* Converts the frame to fixed point, and widens each of its rows.
+*/
+void ThermUpscaler::prepare(const float* pixels) {
+  for (uint8_t i = 0; i < 64; i++) {
+    float c = pixels[i] * THERM_UPSCALER_Q;
+    if (c > 32767.0f)  c = 32767.0f;
+    if (c < -32767.0f) c = -32767.0f;
+    _src[i] = (int16_t) lroundf(c);
+  }
+  for (uint8_t r = 0; r < 8; r++) {
+    const int16_t* SRC = &_src[r << 3];
+    int16_t*       row = _rows[r];
+    for (uint8_t x = 0; x < _size; x++) {
+      const int16_t* P = &SRC[_idx[x]];
+      const int32_t  W = _wts[x] >> 16;
+      row[x] = (int16_t) (((P[0] * (256 - W)) + (P[1] * W) + 128) >> 8);
+    }
+  }
+}
+
+
+/*
+* Makes output line y from the two widened rows around it.
+*/
+void ThermUpscaler::line(uint8_t y, int16_t* out, bool use_dsp) {
+  const int16_t* T   = _rows[_idx[y]];
+  const int16_t* B   = _rows[_idx[y] + 1];
+  const uint32_t WTS = _wts[y];
+  #if defined(THERM_UPSCALER_DSP)
+  if (use_dsp) {
+    for (uint8_t x = 0; x < _size; x += 2) {
+      uint32_t t;
+      uint32_t b;
+      memcpy(&t, &T[x], 4);
+      memcpy(&b, &B[x], 4);
+      // Top and bottom of each pixel as a halfword pair, against (256-w, w).
+      const uint32_t LO  = (t & 0x0000FFFF) | (b << 16);
+      const uint32_t HI  = (t >> 16) | (b & 0xFFFF0000);
+      const int32_t  P0  = (__smuad(LO, WTS) + 128) >> 8;
+      const int32_t  P1  = (__smuad(HI, WTS) + 128) >> 8;
+      const uint32_t OUT = ((uint32_t) P0 & 0x0000FFFF) | ((uint32_t) P1 << 16);
+      memcpy(&out[x], &OUT, 4);
+    }
+    return;
+  }
+  #else
+  (void) use_dsp;
+  #endif
+  const int32_t W_T = WTS & 0xFFFF;
+  const int32_t W_B = WTS >> 16;
+  for (uint8_t x = 0; x < _size; x++) {
+    out[x] = (int16_t) (((T[x] * W_T) + (B[x] * W_B) + 128) >> 8);
+  }
+}
+
+
+/*
+* Scales the frame into image(), colored by the palette over its current range.
+*/
+void ThermUpscaler::render(const float* pixels, ThermPalette* palette) {
+  prepare(pixels);
+  uint16_t* img = _image;
+  for (uint8_t y = 0; y < _size; y++) {
+    line(y, _line);
+    for (uint8_t x = 0; x < _size; x++) {
+      *img++ = palette->color(_line[x]);
+    }
+  }
+}
+
+
+
+/*******************************************************************************
+* Benchmark
+*******************************************************************************/
+
+/*
+* A room at about 22C, with a warm body drifting through it and a cold spot
+*   in one corner.
+*/
+static void _upscaler_synth_frame(float* pixels, uint32_t* seed, uint16_t frame) {
+  const float BX = 3.5f + 3.0f * sinf(frame * 0.05f);
+  const float BY = 3.5f + 3.0f * cosf(frame * 0.07f);
+  for (uint8_t i = 0; i < 64; i++) {
+    *seed = (*seed * 1664525) + 1013904223;
+    const float DX = (i & 0x07) - BX;
+    const float DY = (i >> 3) - BY;
+    float v = 22.0f + ((*seed >> 24) & 0x0F) * 0.0625f;
+    v += 14.0f * expf(-0.5f * ((DX * DX) + (DY * DY)));
+    if (0 == i) v = -4.0f;
+    pixels[i] = v;
+  }
+}
+
+
+/* The same sampling as setSize(), in float. */
+static float _upscaler_ref_pos(uint8_t i, uint8_t size) {
+  float u = ((i + 0.5f) * 8.0f / size) - 0.5f;
+  return (u < 0.0f) ? 0.0f : ((u > 7.0f) ? 7.0f : u);
+}
+
+static float _upscaler_ref_value(const float* pixels, uint8_t size, uint8_t x, uint8_t y) {
+  const float U  = _upscaler_ref_pos(x, size);
+  const float V  = _upscaler_ref_pos(y, size);
+  const int   X0 = (U >= 7.0f) ? 6 : (int) U;
+  const int   Y0 = (V >= 7.0f) ? 6 : (int) V;
+  const float FX = U - X0;
+  const float FY = V - Y0;
+  const float* P = &pixels[(Y0 << 3) + X0];
+  const float TOP = (P[0] * (1.0f - FX)) + (P[1] * FX);
+  const float BOT = (P[8] * (1.0f - FX)) + (P[9] * FX);
+  return (TOP * (1.0f - FY)) + (BOT * FY);
+}
+
+
+/*
+* Checks each output size against float bilinear, and the DSP loop against the
+*   portable one, then times render() at each size.
+* Returns 0 if everything agreed, or -1 if something didn't.
+*/
+int8_t therm_upscaler_benchmark(StringBuilder* output, ThermUpscaler* upscaler, ThermUpscalerClockFxn clock_us) {
+  const uint8_t SIZES[2]  = {32, 64};
+  const uint8_t OLD_SIZE  = upscaler->size();
+  // Rounding at the input, across, and down. Half a unit each.
+  const float   MAX_ERR_C = 1.5f / THERM_UPSCALER_Q;
+  ThermPalette palette;
+  float    pixels[64];
+  int16_t  portable[THERM_UPSCALER_MAX_SIZE];
+  uint32_t seed     = 1;
+  float    err      = 0.0f;
+  uint32_t dsp_miss = 0;
+
+  output->concatf("Thermal upscaler, %u frames\n", THERM_UPSCALER_BENCH_FRAMES);
+  for (uint8_t s = 0; s < sizeof(SIZES); s++) {
+    upscaler->setSize(SIZES[s]);
+    for (uint16_t f = 0; f < THERM_UPSCALER_BENCH_FRAMES; f++) {
+      _upscaler_synth_frame(pixels, &seed, f);
+      upscaler->prepare(pixels);
+      for (uint8_t y = 0; y < SIZES[s]; y++) {
+        int16_t fast[THERM_UPSCALER_MAX_SIZE];
+        upscaler->line(y, fast, true);
+        upscaler->line(y, portable, false);
+        for (uint8_t x = 0; x < SIZES[s]; x++) {
+          const float REF = _upscaler_ref_value(pixels, SIZES[s], x, y);
+          err = fmaxf(err, fabsf(((float) portable[x] / THERM_UPSCALER_Q) - REF));
+          if (fast[x] != portable[x]) dsp_miss++;
+        }
+      }
+    }
+
+    // Timing, over the same frame, so that only the scaling differs.
+    palette.autoRange(-4.0f, 36.0f);
+    uint32_t t0 = clock_us();
+    for (uint16_t f = 0; f < THERM_UPSCALER_BENCH_FRAMES; f++) {
+      upscaler->render(pixels, &palette);
+    }
+    const float FRAME_US = (float) (clock_us() - t0) / THERM_UPSCALER_BENCH_FRAMES;
+    output->concatf(
+      "\t%2ux%-2u render: %8.2f us/frame  (%.3f%% of a 10FPS frame)\n",
+      SIZES[s], SIZES[s], (double) FRAME_US,
+      (double) (100.0f * FRAME_US / THERM_UPSCALER_BUDGET_US)
+    );
+  }
+  upscaler->setSize(OLD_SIZE);
+
+  const bool PASS = (err <= MAX_ERR_C) && (0 == dsp_miss);
+  output->concatf("\tError vs float: %.4f C (bound %.4f C)\n", (double) err, (double) MAX_ERR_C);
+  #if defined(THERM_UPSCALER_DSP)
+    output->concatf("\tDSP vs portable: %u mismatched pixels\n", dsp_miss);
+  #else
+    output->concat("\tNo DSP extension. Portable loop only.\n");
+  #endif
+  output->concatf("\t%s\n", PASS ? "Agreed." : "DISAGREED.");
+  return PASS ? 0 : -1;
+}
@@ -0,0 +1,74 @@
+/*
+* Bilinear upscaling of the 8x8 thermopile frame into an RGB565 image.
+*
+* The frame is converted once to fixed point (1/16 degree C), and scaled in
+*   two passes:
+*   - Across: each of the 8 source rows is widened to the output width.
+*   - Down: each output line blends the two widened rows around it.
+*   Sample positions are pixel centers, clamped at the edges. Which source
+*   pixels each output coordinate falls between, and the Q8 weights, are
+*   worked out once by setSize().
+*
+* The down pass is where nearly all of the work is. On parts with the DSP
+*   extension (the Cortex-M7), it takes two pixels per 32-bit word: the two
+*   rows are packed into halfword pairs, and SMUAD does both multiplies and
+*   the add for a pixel in one instruction. Elsewhere, a portable loop does
+*   the same arithmetic, and gives the same results.
+*
+* Each output line is colored as it is made, by one palette lookup per pixel,
+*   and lands in image(), which is laid out to be handed to a framebuffer
+*   blit() in one piece.
+*
+* therm_upscaler_benchmark() checks the fixed-point output against a float
+*   bilinear, checks the DSP loop against the portable one (where there is a
+*   DSP loop), and times a frame at each size. It borrows the given upscaler,
+*   and puts its size back afterward.
+*/
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <StringBuilder.h>
+#include "ThermPalette.h"
+
+#ifndef __THERM_UPSCALER_H_
+#define __THERM_UPSCALER_H_
+
+#if defined(__ARM_FEATURE_DSP)
+  #define THERM_UPSCALER_DSP
+#endif
+
+#define THERM_UPSCALER_MAX_SIZE   64    // Output is square, and a multiple of 8.
+#define THERM_UPSCALER_Q          THERM_PALETTE_Q   // Fixed-point units per degree C.
+
+typedef uint32_t (*ThermUpscalerClockFxn)();
+
+
+class ThermUpscaler {
+  public:
+    ThermUpscaler(uint8_t size = 32);
+
+    int8_t setSize(uint8_t size);
+    void   render(const float* pixels, ThermPalette*);
+
+    /* The stages of render(), without color. Lines are in 1/16 C. */
+    void   prepare(const float* pixels);
+    void   line(uint8_t y, int16_t* out, bool use_dsp = true);
+
+    inline uint8_t         size() {    return _size;     };
+    inline const uint16_t* image() {   return _image;    };
+
+
+  private:
+    uint8_t  _size = 0;
+    uint8_t  _idx[THERM_UPSCALER_MAX_SIZE];    // Lower source pixel for each output coordinate.
+    uint32_t _wts[THERM_UPSCALER_MAX_SIZE];    // Packed Q8 weights: (w << 16) | (256 - w)
+    int16_t  _src[64];
+    int16_t  _rows[8][THERM_UPSCALER_MAX_SIZE] __attribute__((aligned(4)));   // Source rows, widened.
+    int16_t  _line[THERM_UPSCALER_MAX_SIZE]    __attribute__((aligned(4)));
+    uint16_t _image[THERM_UPSCALER_MAX_SIZE * THERM_UPSCALER_MAX_SIZE];
+};
+
+
+int8_t therm_upscaler_benchmark(StringBuilder*, ThermUpscaler*, ThermUpscalerClockFxn clock_us);
+
+#endif  // __THERM_UPSCALER_H_
@@ -31,8 +31,6 @@
 
 #include "VEML6075.h"
 
-#define VEML6075_ADDRESS   0x10
-
 #define VEML6075_REGISTER_LENGTH 2   // 2 bytes per register
 #define NUM_INTEGRATION_TIMES 5
 
@@ -86,13 +84,13 @@ const float UVB_RESPONSIVITY[NUM_INTEGRATION_TIMES] = {
 };
 
 
-VEML6075::VEML6075() {}
+VEML6075::VEML6075() : I2CDevice(VEML6075_ADDRESS) {}
 
 
-VEML6075_error_t VEML6075::init(TwoWire* b) {
+VEML6075_error_t VEML6075::init(I2CBusQueue* b) {
   VEML6075_error_t err = VEML6075_ERROR_UNDEFINED;
   if (nullptr != b) {
-    _i2c = b;
+    _bus_queue = b;
     if (VEML6075_ERROR_SUCCESS == _connected()) {
       if (VEML6075_ERROR_SUCCESS == enabled(true)) {   // Power on
         err = setIntegrationTime(IT_100MS);      // Set intergration time to 100ms
@@ -111,10 +109,11 @@ VEML6075_error_t VEML6075::init(TwoWire* b) {
 
 
 /*
-* Poll the class for updates.
+* Poll the class for updates. Data reads are queued, and reported by a later
+*   call to poll() once they have all landed.
 * Returns...
 *   -3 if not initialized and enabled.
-*   -1 if data needed to be read, but doing so failed.
+*   -1 if data needed to be read, but the read couldn't be queued.
 *   0  if nothing needs doing.
 *   1  if data was read and is fresh.
 */
@@ -122,14 +121,35 @@ int8_t VEML6075::poll() {
   int8_t ret = -3;
   if (initialized() && enabled()) {
     ret = 0;
-    if ((_last_read + _integrationTime) <= millis()) {
-      ret = (VEML6075_ERROR_SUCCESS == _read_data()) ? 1 : -1;
+    if (_veml_flag(VEML6075_FLAG_DATA_FRESH)) {
+      _veml_clear_flag(VEML6075_FLAG_DATA_FRESH);
+      ret = 1;
+    }
+    else if ((_last_read + _integrationTime) <= millis()) {
+      ret = (VEML6075_ERROR_SUCCESS == _read_data()) ? 0 : -1;
     }
   }
   return ret;
 }
 
 
+/*
+* Called by the bus queue as each data register arrives. The queue is FIFO, so
+*   the last op finishing means they all have.
+*/
+int8_t VEML6075::io_op_callback(I2CBusOp* op) {
+  if (op == &_data_ops[3]) {
+    for (uint8_t i = 0; i < 4; i++) {
+      if (!_data_ops[i].complete()) {
+        return 0;
+      }
+    }
+    _process_data();
+  }
+  return 0;
+}
+
+
 VEML6075_error_t VEML6075::setIntegrationTime(VEML6075::veml6075_uv_it_t it) {
   veml6075_t conf;
   if (it >= IT_RESERVED_0) {
@@ -282,36 +302,49 @@ float VEML6075::index() {
 
 
 /*
-* Encompasses UVA, UVB, UVCOMP1, and UVCOMP2. Stores raw values in shadows.
+* Encompasses UVA, UVB, UVCOMP1, and UVCOMP2. Queues a read of each. The
+*   shadows are updated by _process_data() when they arrive.
+* Each command code is a 16-bit register, and the part doesn't advance to the
+*   next code on a longer read. So these can't be merged into a burst.
 */
 VEML6075_error_t VEML6075::_read_data() {
   VEML6075_error_t err = VEML6075_ERROR_UNDEFINED;
   if (initialized() && enabled()) {
-    uint8_t buffer[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-    err = readI2CBuffer(&buffer[0], VEML6075::REG_UVA_DATA, 2);
-    if (VEML6075_ERROR_SUCCESS == err) {
-      err = readI2CBuffer(&buffer[2], VEML6075::REG_UVB_DATA, 2);
-      if (VEML6075_ERROR_SUCCESS == err) {
-        err = readI2CBuffer(&buffer[4], VEML6075::REG_UVCOMP1_DATA, 2);
-        if (VEML6075_ERROR_SUCCESS == err) {
-          err = readI2CBuffer(&buffer[6], VEML6075::REG_UVCOMP2_DATA, 2);
-          if (VEML6075_ERROR_SUCCESS == err) {
-            uint16_t new_uva = (buffer[0] & 0x00FF) | ((buffer[1] & 0x00FF) << 8);
-            uint16_t new_uvb = (buffer[2] & 0x00FF) | ((buffer[3] & 0x00FF) << 8);
-            _lastCOMP1 = (buffer[4] & 0x00FF) | ((buffer[5] & 0x00FF) << 8);
-            _lastCOMP2 = (buffer[6] & 0x00FF) | ((buffer[7] & 0x00FF) << 8);
-            _last_read = millis();
-            _lastUVA = ((float) new_uva) - ((UVA_A_COEF * UV_ALPHA * _lastCOMP1) / UV_GAMMA) - ((UVA_B_COEF * UV_ALPHA * _lastCOMP2) / UV_DELTA);
-            _lastUVB = ((float) new_uvb) - ((UVA_C_COEF * UV_BETA  * _lastCOMP1) / UV_GAMMA) - ((UVA_D_COEF * UV_BETA  * _lastCOMP2) / UV_DELTA);
-          }
-        }
+    const VEML6075_REGISTER_t DATA_REGS[4] = {
+      REG_UVA_DATA, REG_UVB_DATA, REG_UVCOMP1_DATA, REG_UVCOMP2_DATA
+    };
+    for (uint8_t i = 0; i < 4; i++) {
+      if (_data_ops[i].inFlight()) {
+        return err;
+      }
+    }
+    err = VEML6075_ERROR_SUCCESS;
+    for (uint8_t i = 0; i < 4; i++) {
+      if (0 != _bus_read_async(&_data_ops[i], DATA_REGS[i], &_data_buf[i << 1], VEML6075_REGISTER_LENGTH)) {
+        err = VEML6075_ERROR_READ;
       }
     }
+    _last_read = millis();
   }
   return err;
 }
 
 
+/*
+* Stores raw values in shadows, and calculates compensated UVA and UVB.
+*/
+void VEML6075::_process_data() {
+  uint16_t new_uva = (_data_buf[0] & 0x00FF) | ((_data_buf[1] & 0x00FF) << 8);
+  uint16_t new_uvb = (_data_buf[2] & 0x00FF) | ((_data_buf[3] & 0x00FF) << 8);
+  _lastCOMP1 = (_data_buf[4] & 0x00FF) | ((_data_buf[5] & 0x00FF) << 8);
+  _lastCOMP2 = (_data_buf[6] & 0x00FF) | ((_data_buf[7] & 0x00FF) << 8);
+  _lastUVA = ((float) new_uva) - ((UVA_A_COEF * UV_ALPHA * _lastCOMP1) / UV_GAMMA) - ((UVA_B_COEF * UV_ALPHA * _lastCOMP2) / UV_DELTA);
+  _lastUVB = ((float) new_uvb) - ((UVA_C_COEF * UV_BETA  * _lastCOMP1) / UV_GAMMA) - ((UVA_D_COEF * UV_BETA  * _lastCOMP2) / UV_DELTA);
+  _veml_set_flag(VEML6075_FLAG_DATA_FRESH);
+  _count_sample();
+}
+
+
 VEML6075_error_t VEML6075::_connected() {
   veml6075_t devID;
   VEML6075_error_t err = VEML6075_ERROR_INVALID_ADDRESS;
@@ -326,30 +359,12 @@ VEML6075_error_t VEML6075::_connected() {
 
 
 VEML6075_error_t VEML6075::readI2CBuffer(uint8_t* dest, VEML6075_REGISTER_t startRegister, uint16_t len) {
-  //VEML6075_DEBUGLN((STORAGE("(readI2CBuffer): read ") + String(len) + STORAGE(" @ 0x") + String(startRegister, HEX)));
-  _i2c->beginTransmission((uint8_t) VEML6075_ADDRESS);
-  _i2c->write(startRegister);
-  if (_i2c->endTransmission(false) != 0) {
-    //VEML6075_DEBUGLN(STORAGE("    ERR (readI2CBuffer): End transmission"));
-    return VEML6075_ERROR_READ;
-  }
-
-  _i2c->requestFrom((uint8_t) VEML6075_ADDRESS, (uint8_t)len);
-  for (uint16_t i = 0; i < len; i++) {
-    dest[i] = _i2c->read();
-    //VEML6075_DEBUGLN((STORAGE("    ") + String(i) + STORAGE(": 0x") + String(dest[i], HEX)));
-  }
-  return VEML6075_ERROR_SUCCESS;
+  return (0 == _bus_read(startRegister, dest, len)) ? VEML6075_ERROR_SUCCESS : VEML6075_ERROR_READ;
 }
 
 
 VEML6075_error_t VEML6075::writeI2CBuffer(uint8_t* src, VEML6075_REGISTER_t startRegister, uint16_t len) {
-  _i2c->beginTransmission((uint8_t) VEML6075_ADDRESS);
-  _i2c->write(startRegister);
-  for (uint16_t i = 0; i < len; i++) {
-    _i2c->write(src[i]);
-  }
-  return (_i2c->endTransmission(true) == 0) ? VEML6075_ERROR_SUCCESS : VEML6075_ERROR_WRITE;
+  return (0 == _bus_write(startRegister, src, len)) ? VEML6075_ERROR_SUCCESS : VEML6075_ERROR_WRITE;
 }
 
 
@@ -38,7 +38,7 @@
 */
 
 #include <Arduino.h>
-#include <Wire.h>
+#include "I2CBusQueue.h"
 
 #ifndef __VEML6075_DRIVER_H_
 #define __VEML6075_DRIVER_H_
@@ -51,6 +51,9 @@
 #define VEML6075_FLAG_AF_ENABLED       0x0010  //
 #define VEML6075_FLAG_TRIGGER_ENABLED  0x0020  //
 #define VEML6075_FLAG_DYNAMIC_HIGH     0x0040  //
+#define VEML6075_FLAG_DATA_FRESH       0x0080  // Data arrived that poll() hasn't reported.
+
+#define VEML6075_ADDRESS   0x10
 
 
 /*
@@ -74,7 +77,7 @@ typedef enum {
 } VEML6075_error_t;
 
 
-class VEML6075 {
+class VEML6075 : public I2CDevice {
   public:
     typedef enum {
         IT_50MS,
@@ -108,9 +111,12 @@ class VEML6075 {
 
     VEML6075();
 
-    VEML6075_error_t init(TwoWire* wirePort = &Wire);
+    VEML6075_error_t init(I2CBusQueue*);
     int8_t poll();
 
+    /* Overrides from I2CDevice. */
+    int8_t io_op_callback(I2CBusOp*);
+
     inline bool devFound() {        return _veml_flag(VEML6075_FLAG_DEVICE_PRESENT);  };
     inline bool initialized() {     return _veml_flag(VEML6075_FLAG_INITIALIZED);     };
     inline bool enabled() {         return _veml_flag(VEML6075_FLAG_ENABLED);         };
@@ -139,7 +145,6 @@ class VEML6075 {
 
 
   private:
-    TwoWire*  _i2c             = nullptr;
     uint16_t  _flags           = 0;
     uint16_t  _integrationTime = 0;
     uint32_t  _last_read       = 0;
@@ -150,6 +155,8 @@ class VEML6075 {
     float     _lastIndex       = 0.0;
     float     _aResponsivity   = UVA_RESPONSIVITY_100MS_UNCOVERED;
     float     _bResponsivity   = UVB_RESPONSIVITY_100MS_UNCOVERED;
+    I2CBusOp  _data_ops[4];    // One per data register. They are not contiguous.
+    uint8_t   _data_buf[8];
     // VEML6075 registers:
     typedef enum {
         REG_UV_CONF = 0x00,
@@ -161,6 +168,7 @@ class VEML6075 {
     } VEML6075_REGISTER_t;
 
     VEML6075_error_t _read_data();
+    void _process_data();
     VEML6075_error_t _connected();
 
     // I2C Read/Write